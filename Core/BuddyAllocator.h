@@ -0,0 +1,209 @@
+#pragma once
+
+#include "Platform.h"
+
+// Buddy allocator over the bytes of a heap. Blocks are MinBlockSize << Level and start on a multiple of their
+// own size, so every allocation is aligned to its rounded up size for free. It only hands out offsets and never
+// touches the memory, so it has no D3D dependencies.
+struct BuddyAllocator
+{
+	static const uint64_t InvalidOffset = ~0ull;
+	static const uint8_t FreeBit = 0x80;
+
+	uint64_t Size = 0;
+	uint64_t MinBlockSize = 0;
+	int NumLevels = 0;
+	uint64_t UsedBytes = 0;
+	int NumAllocations = 0;
+
+	// Per MinBlockSize slot: on the first slot of each block, its level plus FreeBit when it's free, and
+	// the links of the free list for that level
+	std::vector<uint8_t> SlotLevel;
+	std::vector<int32_t> NextFree;
+	std::vector<int32_t> PrevFree;
+	std::vector<int32_t> FreeHeads;
+
+	// InSize must be MinBlockSize times a power of two
+	void Init(uint64_t InSize, uint64_t InMinBlockSize)
+	{
+		ASSERT(InMinBlockSize > 0 && (InMinBlockSize & (InMinBlockSize - 1)) == 0);
+		ASSERT(InSize % InMinBlockSize == 0);
+		const uint64_t NumSlots = InSize / InMinBlockSize;
+		ASSERT(NumSlots > 0 && (NumSlots & (NumSlots - 1)) == 0 && NumSlots <= (1ull << 30));
+
+		Size = InSize;
+		MinBlockSize = InMinBlockSize;
+		NumLevels = 1;
+		while ((1ull << (NumLevels - 1)) < NumSlots)
+		{
+			NumLevels++;
+		}
+		UsedBytes = 0;
+		NumAllocations = 0;
+
+		SlotLevel.assign((size_t)NumSlots, 0);
+		NextFree.assign((size_t)NumSlots, -1);
+		PrevFree.assign((size_t)NumSlots, -1);
+		FreeHeads.assign(NumLevels, -1);
+		PushFree(0, NumLevels - 1);
+	}
+
+	uint64_t GetBlockSize(int Level) const
+	{
+		return MinBlockSize << Level;
+	}
+
+	// Alignment must be a power of two. Returns InvalidOffset when no free block is big enough.
+	uint64_t Allocate(uint64_t Bytes, uint64_t Alignment = 1)
+	{
+		const uint64_t Needed = Bytes > Alignment ? Bytes : Alignment;
+		int Level = 0;
+		while (Level < NumLevels && GetBlockSize(Level) < Needed)
+		{
+			Level++;
+		}
+
+		int Found = Level;
+		while (Found < NumLevels && FreeHeads[Found] < 0)
+		{
+			Found++;
+		}
+		if (Found >= NumLevels)
+		{
+			return InvalidOffset;
+		}
+
+		// Split the block down to size, the upper halves going back on the free lists
+		const int32_t Slot = FreeHeads[Found];
+		RemoveFree(Slot, Found);
+		while (Found > Level)
+		{
+			Found--;
+			PushFree(Slot + (1 << Found), Found);
+		}
+
+		SlotLevel[Slot] = (uint8_t)Level;
+		UsedBytes += GetBlockSize(Level);
+		NumAllocations++;
+		return Slot * MinBlockSize;
+	}
+
+	void Free(uint64_t Offset)
+	{
+		ASSERT(Offset < Size && Offset % MinBlockSize == 0);
+		int32_t Slot = (int32_t)(Offset / MinBlockSize);
+		int Level = SlotLevel[Slot];
+		ASSERT((Level & FreeBit) == 0);
+
+		UsedBytes -= GetBlockSize(Level);
+		NumAllocations--;
+
+		// Merge with the buddy for as long as it's free and whole
+		while (Level + 1 < NumLevels)
+		{
+			const int32_t Buddy = Slot ^ (1 << Level);
+			if (SlotLevel[Buddy] != (FreeBit | Level))
+			{
+				break;
+			}
+			RemoveFree(Buddy, Level);
+			Slot = Slot < Buddy ? Slot : Buddy;
+			Level++;
+		}
+		PushFree(Slot, Level);
+	}
+
+	uint64_t GetAllocationSize(uint64_t Offset) const
+	{
+		return GetBlockSize(SlotLevel[(size_t)(Offset / MinBlockSize)] & ~FreeBit);
+	}
+
+	uint64_t GetLargestFreeBlock() const
+	{
+		for (int Level = NumLevels - 1; Level >= 0; Level--)
+		{
+			if (FreeHeads[Level] >= 0)
+			{
+				return GetBlockSize(Level);
+			}
+		}
+		return 0;
+	}
+
+	// Walks every block checking that they tile the heap, that free blocks are on their lists and fully merged,
+	// and that the counters agree
+	bool Validate() const
+	{
+		uint64_t Used = 0;
+		int Allocations = 0;
+		std::vector<int> FreeCounts(NumLevels, 0);
+		for (size_t Slot = 0; Slot < SlotLevel.size();)
+		{
+			const int Level = SlotLevel[Slot] & ~FreeBit;
+			if (Level >= NumLevels || Slot % ((size_t)1 << Level) != 0)
+			{
+				return false;
+			}
+			if (SlotLevel[Slot] & FreeBit)
+			{
+				const size_t Buddy = Slot ^ ((size_t)1 << Level);
+				if (Level + 1 < NumLevels && SlotLevel[Buddy] == SlotLevel[Slot])
+				{
+					return false;
+				}
+				FreeCounts[Level]++;
+			}
+			else
+			{
+				Used += GetBlockSize(Level);
+				Allocations++;
+			}
+			Slot += (size_t)1 << Level;
+		}
+
+		for (int Level = 0; Level < NumLevels; Level++)
+		{
+			int Count = 0;
+			for (int32_t Slot = FreeHeads[Level]; Slot >= 0; Slot = NextFree[Slot])
+			{
+				if (SlotLevel[Slot] != (FreeBit | Level) || Count++ > FreeCounts[Level])
+				{
+					return false;
+				}
+			}
+			if (Count != FreeCounts[Level])
+			{
+				return false;
+			}
+		}
+		return Used == UsedBytes && Allocations == NumAllocations;
+	}
+
+	void PushFree(int32_t Slot, int Level)
+	{
+		SlotLevel[Slot] = (uint8_t)(FreeBit | Level);
+		PrevFree[Slot] = -1;
+		NextFree[Slot] = FreeHeads[Level];
+		if (FreeHeads[Level] >= 0)
+		{
+			PrevFree[FreeHeads[Level]] = Slot;
+		}
+		FreeHeads[Level] = Slot;
+	}
+
+	void RemoveFree(int32_t Slot, int Level)
+	{
+		if (PrevFree[Slot] >= 0)
+		{
+			NextFree[PrevFree[Slot]] = NextFree[Slot];
+		}
+		else
+		{
+			FreeHeads[Level] = NextFree[Slot];
+		}
+		if (NextFree[Slot] >= 0)
+		{
+			PrevFree[NextFree[Slot]] = PrevFree[Slot];
+		}
+	}
+};
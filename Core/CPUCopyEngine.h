@@ -0,0 +1,446 @@
+#pragma once
+
+#include "Platform.h"
+
+// CPU reference copy engine: the whole-resource and subresource copies the GPU copy tests time,
+// done on the host by a pool of NUMA-pinned worker threads, as a baseline for the GPU numbers
+
+typedef void (*CopyKernelFunc)(uint8_t* Dst, const uint8_t* Src, size_t Size);
+
+inline void CopyKernelMemcpy(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	memcpy(Dst, Src, Size);
+}
+
+#if CPU_X86
+// Fast with ERMS (enhanced rep movsb), where the microcode picks the copy width itself
+inline void CopyKernelRepMovsb(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	PlatformRepMovsb(Dst, Src, Size);
+}
+
+CPU_TARGET("avx2") inline void CopyKernelAVX2(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	size_t i = 0;
+	for (; i + 128 <= Size; i += 128)
+	{
+		__m256i A = _mm256_loadu_si256((const __m256i*)(Src + i));
+		__m256i B = _mm256_loadu_si256((const __m256i*)(Src + i + 32));
+		__m256i C = _mm256_loadu_si256((const __m256i*)(Src + i + 64));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(Src + i + 96));
+		_mm256_storeu_si256((__m256i*)(Dst + i), A);
+		_mm256_storeu_si256((__m256i*)(Dst + i + 32), B);
+		_mm256_storeu_si256((__m256i*)(Dst + i + 64), C);
+		_mm256_storeu_si256((__m256i*)(Dst + i + 96), D);
+	}
+	memcpy(Dst + i, Src + i, Size - i);
+}
+
+CPU_TARGET("avx512f") inline void CopyKernelAVX512(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	size_t i = 0;
+	for (; i + 256 <= Size; i += 256)
+	{
+		__m512i A = _mm512_loadu_si512(Src + i);
+		__m512i B = _mm512_loadu_si512(Src + i + 64);
+		__m512i C = _mm512_loadu_si512(Src + i + 128);
+		__m512i D = _mm512_loadu_si512(Src + i + 192);
+		_mm512_storeu_si512(Dst + i, A);
+		_mm512_storeu_si512(Dst + i + 64, B);
+		_mm512_storeu_si512(Dst + i + 128, C);
+		_mm512_storeu_si512(Dst + i + 192, D);
+	}
+	memcpy(Dst + i, Src + i, Size - i);
+}
+
+// Streaming stores skip the read-for-ownership of the destination and don't evict the cache,
+// which pays off once a copy is bigger than the last level cache
+inline void CopyKernelNonTemporal(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	size_t Head = (size_t)(-(intptr_t)Dst & 15);
+	Head = Head < Size ? Head : Size;
+	memcpy(Dst, Src, Head);
+
+	size_t i = Head;
+	for (; i + 64 <= Size; i += 64)
+	{
+		__m128i A = _mm_loadu_si128((const __m128i*)(Src + i));
+		__m128i B = _mm_loadu_si128((const __m128i*)(Src + i + 16));
+		__m128i C = _mm_loadu_si128((const __m128i*)(Src + i + 32));
+		__m128i D = _mm_loadu_si128((const __m128i*)(Src + i + 48));
+		_mm_stream_si128((__m128i*)(Dst + i), A);
+		_mm_stream_si128((__m128i*)(Dst + i + 16), B);
+		_mm_stream_si128((__m128i*)(Dst + i + 32), C);
+		_mm_stream_si128((__m128i*)(Dst + i + 48), D);
+	}
+	_mm_sfence();
+	memcpy(Dst + i, Src + i, Size - i);
+}
+#elif CPU_ARM64
+inline void CopyKernelNeon(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+	size_t i = 0;
+	for (; i + 64 <= Size; i += 64)
+	{
+		uint8x16_t A = vld1q_u8(Src + i);
+		uint8x16_t B = vld1q_u8(Src + i + 16);
+		uint8x16_t C = vld1q_u8(Src + i + 32);
+		uint8x16_t D = vld1q_u8(Src + i + 48);
+		vst1q_u8(Dst + i, A);
+		vst1q_u8(Dst + i + 16, B);
+		vst1q_u8(Dst + i + 32, C);
+		vst1q_u8(Dst + i + 48, D);
+	}
+	memcpy(Dst + i, Src + i, Size - i);
+}
+#endif
+
+struct CopyKernelInfo
+{
+	const char* Name;
+	CopyKernelFunc Func;
+	bool Supported;
+};
+
+inline std::vector<CopyKernelInfo> GetCopyKernels()
+{
+	const CPUFeatures& Features = GetCPUFeatures();
+	(void)Features;
+	std::vector<CopyKernelInfo> Kernels;
+	Kernels.push_back({ "memcpy", CopyKernelMemcpy, true });
+#if CPU_X86
+	Kernels.push_back({ "rep movsb", CopyKernelRepMovsb, Features.ERMS });
+	Kernels.push_back({ "AVX2", CopyKernelAVX2, Features.AVX2 });
+	Kernels.push_back({ "AVX-512", CopyKernelAVX512, Features.AVX512F });
+	Kernels.push_back({ "NT stores", CopyKernelNonTemporal, true });
+#elif CPU_ARM64
+	Kernels.push_back({ "NEON", CopyKernelNeon, true });
+#endif
+	return Kernels;
+}
+
+// Cached copies for anything that fits in a typical last level cache, streaming stores above that
+inline CopyKernelFunc SelectCopyKernel(size_t CopySize)
+{
+#if CPU_X86
+	if (CopySize >= 32 * 1024 * 1024)
+	{
+		return CopyKernelNonTemporal;
+	}
+#endif
+	(void)CopySize;
+	return CopyKernelMemcpy;
+}
+
+// Host memory committed on chosen NUMA nodes. A striped buffer puts stripe i on node i, so the
+// copy engine can hand each stripe to the workers running on the node that owns it.
+struct NumaBuffer
+{
+	static const size_t Granularity = 64 * 1024;
+
+	uint8_t* Data = nullptr;
+	size_t Size = 0;
+	size_t Reserved = 0;
+	size_t StripeSize = 0;
+	int NumStripes = 1;
+
+	NumaBuffer() = default;
+	NumaBuffer(const NumaBuffer&) = delete;
+	NumaBuffer& operator=(const NumaBuffer&) = delete;
+	~NumaBuffer() { Free(); }
+
+	// Node is an index into GetNumaTopology().Nodes, or -1 to stripe the buffer across all of them
+	void Allocate(size_t InSize, int Node = -1)
+	{
+		const NumaTopology& Topology = GetNumaTopology();
+		Size = InSize;
+		Reserved = (InSize + Granularity - 1) / Granularity * Granularity;
+		Data = ReserveNumaPages(Reserved);
+		ASSERT(Data != nullptr);
+
+		NumStripes = Node < 0 ? (int)Topology.Nodes.size() : 1;
+		StripeSize = (Reserved / NumStripes + Granularity - 1) / Granularity * Granularity;
+		for (int Stripe = 0; Stripe < NumStripes; Stripe++)
+		{
+			size_t Offset = StripeSize * Stripe;
+			if (Offset >= Reserved)
+			{
+				NumStripes = Stripe;
+				break;
+			}
+			size_t Length = Reserved - Offset < StripeSize ? Reserved - Offset : StripeSize;
+			bool bCommitted = CommitNumaPages(Data + Offset, Length, Node < 0 ? Stripe : Node);
+			ASSERT(bCommitted);
+		}
+
+		// Fault the pages in now so page faults don't land in the first timed copy
+		memset(Data, 0, Size);
+	}
+
+	void Free()
+	{
+		if (Data != nullptr)
+		{
+			ReleaseNumaPages(Data, Reserved);
+			Data = nullptr;
+		}
+	}
+
+	// Index into GetNumaTopology().Nodes of the node holding Offset
+	int GetNode(size_t Offset, int DefaultNode) const
+	{
+		if (NumStripes <= 1)
+		{
+			return DefaultNode;
+		}
+		int Stripe = (int)(Offset / StripeSize);
+		return Stripe < NumStripes ? Stripe : NumStripes - 1;
+	}
+};
+
+// A texture laid out the way GetCopyableFootprints places one in a buffer: subresources start on
+// 512 byte boundaries and rows on 256 byte boundaries. Subresource i is mip i % MipLevels of slice i / MipLevels.
+struct CPUTexture
+{
+	struct Subresource
+	{
+		size_t Offset = 0;
+		int Width = 0;
+		int Height = 0;
+		int RowPitch = 0;
+	};
+
+	int Width = 0;
+	int Height = 0;
+	int ArraySize = 0;
+	int MipLevels = 0;
+	int BytesPerPixel = 0;
+	int Node = -1;
+	std::vector<Subresource> Subresources;
+	NumaBuffer Memory;
+
+	void Init(int InWidth, int InHeight, int InArraySize, int InMipLevels, int InBytesPerPixel, int InNode = -1)
+	{
+		Width = InWidth;
+		Height = InHeight;
+		ArraySize = InArraySize;
+		MipLevels = InMipLevels;
+		BytesPerPixel = InBytesPerPixel;
+		Node = InNode;
+
+		size_t Offset = 0;
+		for (int Slice = 0; Slice < ArraySize; Slice++)
+		{
+			for (int Mip = 0; Mip < MipLevels; Mip++)
+			{
+				Subresource Sub;
+				Sub.Offset = Offset;
+				Sub.Width = Width >> Mip > 0 ? Width >> Mip : 1;
+				Sub.Height = Height >> Mip > 0 ? Height >> Mip : 1;
+				Sub.RowPitch = (Sub.Width * BytesPerPixel + 255) & ~255;
+				Subresources.push_back(Sub);
+
+				Offset += (size_t)Sub.RowPitch * Sub.Height;
+				Offset = (Offset + 511) & ~(size_t)511;
+			}
+		}
+
+		Memory.Allocate(Offset, Node);
+	}
+
+	uint8_t* GetTexel(int SubresourceIndex, int X, int Y) const
+	{
+		const Subresource& Sub = Subresources[SubresourceIndex];
+		return Memory.Data + Sub.Offset + (size_t)Y * Sub.RowPitch + (size_t)X * BytesPerPixel;
+	}
+};
+
+// Same meaning as D3D12_BOX, with only the 2D part used
+struct CopyBox
+{
+	int Left, Top, Right, Bottom;
+};
+
+// Runs copies on a pool of worker threads pinned round robin to the NUMA nodes. A copy is cut into
+// chunks of about ChunkBytes, each filed under the node that owns its destination; workers drain
+// their own node's chunks first and then help the others.
+struct CPUCopyEngine
+{
+	static const size_t ChunkBytes = 256 * 1024;
+
+	struct CopyRange
+	{
+		uint8_t* Dst;
+		const uint8_t* Src;
+		size_t Size;
+	};
+
+	struct Chunk
+	{
+		int FirstRange;
+		int EndRange;
+	};
+
+	CopyKernelFunc Kernel = CopyKernelMemcpy;
+
+	std::vector<std::thread> Workers;
+	std::vector<int> WorkerNodes;
+
+	std::mutex Mutex;
+	std::condition_variable WorkAvailable;
+	std::condition_variable WorkDone;
+	uint64_t Generation = 0;
+	bool ShuttingDown = false;
+
+	// The current job, written before Generation is bumped and read-only while it runs
+	std::vector<CopyRange> Ranges;
+	std::vector<Chunk> Chunks;
+	std::vector<std::vector<int>> NodeChunks;
+	std::unique_ptr<std::atomic<int>[]> NodeCursors;
+	std::atomic<int> ChunksRemaining;
+	int BusyWorkers = 0;
+
+	void Start(int NumThreads)
+	{
+		const NumaTopology& Topology = GetNumaTopology();
+		NodeChunks.resize(Topology.Nodes.size());
+		NodeCursors.reset(new std::atomic<int>[Topology.Nodes.size()]);
+
+		for (int i = 0; i < NumThreads; i++)
+		{
+			int Node = i % (int)Topology.Nodes.size();
+			WorkerNodes.push_back(Node);
+			Workers.emplace_back([this, Node]() { WorkerLoop(Node); });
+		}
+	}
+
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			ShuttingDown = true;
+		}
+		WorkAvailable.notify_all();
+		for (std::thread& Worker : Workers)
+		{
+			Worker.join();
+		}
+		Workers.clear();
+		WorkerNodes.clear();
+	}
+
+	void CopyResource(CPUTexture& Dst, const CPUTexture& Src)
+	{
+		ASSERT(Dst.Memory.Size == Src.Memory.Size);
+
+		Ranges.clear();
+		for (size_t Offset = 0; Offset < Src.Memory.Size; Offset += ChunkBytes)
+		{
+			size_t Size = Src.Memory.Size - Offset < ChunkBytes ? Src.Memory.Size - Offset : ChunkBytes;
+			Ranges.push_back({ Dst.Memory.Data + Offset, Src.Memory.Data + Offset, Size });
+		}
+		Execute(Dst, 1);
+	}
+
+	// SrcBox == nullptr copies the whole source subresource
+	void CopySubresourceRegion(CPUTexture& Dst, int DstSubresource, int DstX, int DstY, const CPUTexture& Src, int SrcSubresource, const CopyBox* SrcBox)
+	{
+		ASSERT(Dst.BytesPerPixel == Src.BytesPerPixel);
+		const CPUTexture::Subresource& SrcSub = Src.Subresources[SrcSubresource];
+		CopyBox Box = SrcBox ? *SrcBox : CopyBox{ 0, 0, SrcSub.Width, SrcSub.Height };
+		ASSERT(Box.Right <= SrcSub.Width && Box.Bottom <= SrcSub.Height);
+		ASSERT(DstX + Box.Right - Box.Left <= Dst.Subresources[DstSubresource].Width);
+		ASSERT(DstY + Box.Bottom - Box.Top <= Dst.Subresources[DstSubresource].Height);
+
+		const size_t RowBytes = (size_t)(Box.Right - Box.Left) * Src.BytesPerPixel;
+		Ranges.clear();
+		for (int y = Box.Top; y < Box.Bottom; y++)
+		{
+			Ranges.push_back({ Dst.GetTexel(DstSubresource, DstX, DstY + y - Box.Top), Src.GetTexel(SrcSubresource, Box.Left, y), RowBytes });
+		}
+		Execute(Dst, (int)((ChunkBytes + RowBytes - 1) / RowBytes));
+	}
+
+private:
+	void Execute(const CPUTexture& Dst, int RangesPerChunk)
+	{
+		Chunks.clear();
+		for (std::vector<int>& Node : NodeChunks)
+		{
+			Node.clear();
+		}
+		for (int First = 0; First < (int)Ranges.size(); First += RangesPerChunk)
+		{
+			int End = First + RangesPerChunk < (int)Ranges.size() ? First + RangesPerChunk : (int)Ranges.size();
+			size_t DstOffset = Ranges[First].Dst - Dst.Memory.Data;
+			NodeChunks[Dst.Memory.GetNode(DstOffset, Dst.Node < 0 ? 0 : Dst.Node)].push_back((int)Chunks.size());
+			Chunks.push_back({ First, End });
+		}
+
+		// Not worth waking the pool for a single chunk
+		if (Workers.empty() || Chunks.size() <= 1)
+		{
+			for (const Chunk& C : Chunks)
+			{
+				RunChunk(C);
+			}
+			return;
+		}
+
+		std::unique_lock<std::mutex> Lock(Mutex);
+		for (size_t Node = 0; Node < NodeChunks.size(); Node++)
+		{
+			NodeCursors[Node] = 0;
+		}
+		ChunksRemaining = (int)Chunks.size();
+		BusyWorkers = (int)Workers.size();
+		Generation++;
+		WorkAvailable.notify_all();
+		WorkDone.wait(Lock, [&]() { return BusyWorkers == 0; });
+	}
+
+	void RunChunk(const Chunk& C)
+	{
+		for (int i = C.FirstRange; i < C.EndRange; i++)
+		{
+			Kernel(Ranges[i].Dst, Ranges[i].Src, Ranges[i].Size);
+		}
+	}
+
+	void WorkerLoop(int Node)
+	{
+		PinCurrentThreadToNumaNode(Node);
+
+		uint64_t SeenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				WorkAvailable.wait(Lock, [&]() { return ShuttingDown || Generation != SeenGeneration; });
+				if (ShuttingDown)
+				{
+					return;
+				}
+				SeenGeneration = Generation;
+			}
+
+			const int NumNodes = (int)NodeChunks.size();
+			for (int n = 0; n < NumNodes && ChunksRemaining > 0; n++)
+			{
+				int QueueNode = (Node + n) % NumNodes;
+				const std::vector<int>& Queue = NodeChunks[QueueNode];
+				for (int i = NodeCursors[QueueNode]++; i < (int)Queue.size(); i = NodeCursors[QueueNode]++)
+				{
+					RunChunk(Chunks[Queue[i]]);
+					ChunksRemaining--;
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				BusyWorkers--;
+			}
+			WorkDone.notify_one();
+		}
+	}
+};
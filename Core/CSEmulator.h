@@ -0,0 +1,447 @@
+#pragma once
+
+#include "WorkStealingScheduler.h"
+
+// CPU emulation of a compute dispatch. Groups are spread over the cores by a WorkStealingScheduler,
+// and a group kernel runs all the threads of one group, normally as SIMD lanes.
+
+// The order the flat group index walks the group grid in, i.e. which groups run close together in time
+enum class CSDispatchOrder
+{
+	RowMajor,		// X fastest, the order GPUs usually launch groups in
+	ColumnMajor,	// Y fastest
+	Morton,			// Z-order curve over X and Y, so nearby groups share cache lines in both directions
+	ColumnTiled,	// Row-major within strips TileWidth groups wide, strips left to right
+};
+
+inline const char* GetDispatchOrderName(CSDispatchOrder Order)
+{
+	switch (Order)
+	{
+	case CSDispatchOrder::ColumnMajor: return "column";
+	case CSDispatchOrder::Morton: return "morton";
+	case CSDispatchOrder::ColumnTiled: return "tiled";
+	default: return "row";
+	}
+}
+
+struct CSDispatch
+{
+	uint32_t NumThreads[3] = { 1, 1, 1 };	// [numthreads(X, Y, Z)]
+	uint32_t GroupCount[3] = { 1, 1, 1 };	// Dispatch(X, Y, Z)
+	CSDispatchOrder Order = CSDispatchOrder::RowMajor;
+	uint32_t TileWidth = 8;					// Strip width in groups, for ColumnTiled
+};
+
+// Runs every thread of the group GroupID. Thread (i, j, k) of the group has SV_GroupThreadID (i, j, k)
+// and SV_DispatchThreadID GroupID * NumThreads + (i, j, k).
+typedef void (*CSGroupKernel)(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3]);
+
+// Even bits of Value packed into the low half
+inline uint32_t CompactBits(uint32_t Value)
+{
+	Value &= 0x55555555;
+	Value = (Value | (Value >> 1)) & 0x33333333;
+	Value = (Value | (Value >> 2)) & 0x0f0f0f0f;
+	Value = (Value | (Value >> 4)) & 0x00ff00ff;
+	Value = (Value | (Value >> 8)) & 0x0000ffff;
+	return Value;
+}
+
+// Side of the power of two square a Morton walk covers the X and Y group counts with
+inline uint32_t GetMortonSide(const CSDispatch& Dispatch)
+{
+	uint32_t Side = 1;
+	while (Side < Dispatch.GroupCount[0] || Side < Dispatch.GroupCount[1])
+	{
+		Side *= 2;
+	}
+	return Side;
+}
+
+// Morton order walks a power of two square covering the grid, so some flat indices land outside it
+inline uint32_t GetDispatchIndexCount(const CSDispatch& Dispatch)
+{
+	if (Dispatch.Order == CSDispatchOrder::Morton)
+	{
+		const uint32_t Side = GetMortonSide(Dispatch);
+		return Side * Side * Dispatch.GroupCount[2];
+	}
+	return Dispatch.GroupCount[0] * Dispatch.GroupCount[1] * Dispatch.GroupCount[2];
+}
+
+// Returns false for the padding indices of a Morton walk
+inline bool MapDispatchIndex(const CSDispatch& Dispatch, uint32_t Index, uint32_t GroupID[3])
+{
+	const uint32_t CountX = Dispatch.GroupCount[0];
+	const uint32_t CountY = Dispatch.GroupCount[1];
+	switch (Dispatch.Order)
+	{
+	case CSDispatchOrder::ColumnMajor:
+		GroupID[1] = Index % CountY;
+		GroupID[0] = (Index / CountY) % CountX;
+		GroupID[2] = Index / (CountX * CountY);
+		return true;
+	case CSDispatchOrder::Morton:
+	{
+		const uint32_t SliceSize = GetDispatchIndexCount(Dispatch) / Dispatch.GroupCount[2];
+		const uint32_t Code = Index % SliceSize;
+		GroupID[0] = CompactBits(Code);
+		GroupID[1] = CompactBits(Code >> 1);
+		GroupID[2] = Index / SliceSize;
+		return GroupID[0] < CountX && GroupID[1] < CountY;
+	}
+	case CSDispatchOrder::ColumnTiled:
+	{
+		// Every strip but the last is full width, so the strip comes straight from the flat index
+		const uint32_t Flat = Index % (CountX * CountY);
+		const uint32_t StripSize = Dispatch.TileWidth * CountY;
+		const uint32_t Strip = Flat / StripSize;
+		const uint32_t StripWidth = std::min(Dispatch.TileWidth, CountX - Strip * Dispatch.TileWidth);
+		const uint32_t InStrip = Flat - Strip * StripSize;
+		GroupID[0] = Strip * Dispatch.TileWidth + InStrip % StripWidth;
+		GroupID[1] = InStrip / StripWidth;
+		GroupID[2] = Index / (CountX * CountY);
+		return true;
+	}
+	default:
+		GroupID[0] = Index % CountX;
+		GroupID[1] = (Index / CountX) % CountY;
+		GroupID[2] = Index / (CountX * CountY);
+		return true;
+	}
+}
+
+struct CSDispatchJob
+{
+	const CSDispatch* Dispatch;
+	CSGroupKernel Kernel;
+	void* Context;
+};
+
+inline void RunCSDispatchRange(void* Context, uint32_t Begin, uint32_t End)
+{
+	const CSDispatchJob& Job = *(const CSDispatchJob*)Context;
+	for (uint32_t Index = Begin; Index < End; Index++)
+	{
+		uint32_t GroupID[3];
+		if (MapDispatchIndex(*Job.Dispatch, Index, GroupID))
+		{
+			Job.Kernel(Job.Context, *Job.Dispatch, GroupID);
+		}
+	}
+}
+
+// The CPU equivalent of ID3D12GraphicsCommandList::Dispatch. Groups are handed out in ranges
+// of about 4096 threads, so tiny groups don't drown in scheduling overhead.
+inline void DispatchCPU(WorkStealingScheduler& Scheduler, const CSDispatch& Dispatch, CSGroupKernel Kernel, void* Context)
+{
+	const uint32_t ThreadsPerGroup = Dispatch.NumThreads[0] * Dispatch.NumThreads[1] * Dispatch.NumThreads[2];
+	const uint32_t Grain = ThreadsPerGroup >= 4096 ? 1 : 4096 / ThreadsPerGroup;
+	CSDispatchJob Job = { &Dispatch, Kernel, Context };
+	Scheduler.Run(GetDispatchIndexCount(Dispatch), Grain, RunCSDispatchRange, &Job);
+}
+
+// Emulation of the copy compute shader: OutTexture[tid.xy] = InTexture[tid.xy] on 4 byte texels.
+// Threads outside the texture are dropped, as out of bounds UAV writes are on the GPU.
+struct CSCopyContext
+{
+	const uint8_t* Src;
+	uint8_t* Dst;
+	int Width;
+	int Height;
+	int Pitch;
+};
+
+// One thread at a time, exactly as the HLSL reads
+inline void CSCopyKernelScalar(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	const CSCopyContext& Copy = *(const CSCopyContext*)Context;
+	for (uint32_t ty = 0; ty < Dispatch.NumThreads[1]; ty++)
+	{
+		for (uint32_t tx = 0; tx < Dispatch.NumThreads[0]; tx++)
+		{
+			uint32_t X = GroupID[0] * Dispatch.NumThreads[0] + tx;
+			uint32_t Y = GroupID[1] * Dispatch.NumThreads[1] + ty;
+			if (X < (uint32_t)Copy.Width && Y < (uint32_t)Copy.Height)
+			{
+				memcpy(Copy.Dst + (size_t)Y * Copy.Pitch + X * 4, Copy.Src + (size_t)Y * Copy.Pitch + X * 4, 4);
+			}
+		}
+	}
+}
+
+#if CPU_X86
+// One row of the group as 8 lane AVX2 instructions, the last one masked
+CPU_TARGET("avx2") inline void CSCopyLanesAVX2(uint32_t* Dst, const uint32_t* Src, int ActiveLanes)
+{
+	int Lane = 0;
+	for (; Lane + 8 <= ActiveLanes; Lane += 8)
+	{
+		_mm256_storeu_si256((__m256i*)(Dst + Lane), _mm256_loadu_si256((const __m256i*)(Src + Lane)));
+	}
+	if (Lane < ActiveLanes)
+	{
+		const __m256i LaneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i Mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(ActiveLanes - Lane), LaneIndex);
+		_mm256_maskstore_epi32((int*)(Dst + Lane), Mask, _mm256_maskload_epi32((const int*)(Src + Lane), Mask));
+	}
+}
+#endif
+
+// Each row of the group's threads runs as SIMD lanes, one texel per lane, with inactive lanes masked off
+inline void CSCopyKernelLanes(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	const CSCopyContext& Copy = *(const CSCopyContext*)Context;
+	const uint32_t X0 = GroupID[0] * Dispatch.NumThreads[0];
+	if (X0 >= (uint32_t)Copy.Width)
+	{
+		return;
+	}
+	const int ActiveLanes = (int)(Dispatch.NumThreads[0] < Copy.Width - X0 ? Dispatch.NumThreads[0] : Copy.Width - X0);
+#if CPU_X86
+	const bool bAVX2 = GetCPUFeatures().AVX2;
+#endif
+
+	for (uint32_t ty = 0; ty < Dispatch.NumThreads[1]; ty++)
+	{
+		const uint32_t Y = GroupID[1] * Dispatch.NumThreads[1] + ty;
+		if (Y >= (uint32_t)Copy.Height)
+		{
+			break;
+		}
+		const uint32_t* Src = (const uint32_t*)(Copy.Src + (size_t)Y * Copy.Pitch) + X0;
+		uint32_t* Dst = (uint32_t*)(Copy.Dst + (size_t)Y * Copy.Pitch) + X0;
+
+		int Lane = 0;
+#if CPU_X86
+		if (bAVX2)
+		{
+			CSCopyLanesAVX2(Dst, Src, ActiveLanes);
+			continue;
+		}
+		for (; Lane + 4 <= ActiveLanes; Lane += 4)
+		{
+			_mm_storeu_si128((__m128i*)(Dst + Lane), _mm_loadu_si128((const __m128i*)(Src + Lane)));
+		}
+#elif CPU_ARM64
+		for (; Lane + 4 <= ActiveLanes; Lane += 4)
+		{
+			vst1q_u32(Dst + Lane, vld1q_u32(Src + Lane));
+		}
+#endif
+		for (; Lane < ActiveLanes; Lane++)
+		{
+			Dst[Lane] = Src[Lane];
+		}
+	}
+}
+
+// Emulation of ComputeShaderCodeTileCopy for any group size: every thread loads a 2x2 spread of texels into
+// a tile twice the group's size, then after the barrier every thread writes the same spread back out.
+// The barrier falls out of running the group's threads in two passes.
+inline void CSCopyKernelGroupShared(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	const CSCopyContext& Copy = *(const CSCopyContext*)Context;
+	const uint32_t GroupX = Dispatch.NumThreads[0];
+	const uint32_t GroupY = Dispatch.NumThreads[1];
+	const uint32_t TileWidth = GroupX * 2;
+	const uint32_t BaseX = GroupID[0] * TileWidth;
+	const uint32_t BaseY = GroupID[1] * GroupY * 2;
+	// groupshared tops out at 32KB, so a 64x64 tile of 4 byte texels is the most a group can hold
+	uint32_t Tile[64 * 64];
+	ASSERT(TileWidth * GroupY * 2 <= 64 * 64);
+
+	for (uint32_t ty = 0; ty < GroupY; ty++)
+	{
+		for (uint32_t tx = 0; tx < GroupX; tx++)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				const uint32_t PX = tx + (i & 1) * GroupX;
+				const uint32_t PY = ty + (i >> 1) * GroupY;
+				const uint32_t X = BaseX + PX;
+				const uint32_t Y = BaseY + PY;
+				// Out of bounds SRV loads return 0
+				uint32_t Texel = 0;
+				if (X < (uint32_t)Copy.Width && Y < (uint32_t)Copy.Height)
+				{
+					memcpy(&Texel, Copy.Src + (size_t)Y * Copy.Pitch + X * 4, 4);
+				}
+				Tile[PY * TileWidth + PX] = Texel;
+			}
+		}
+	}
+
+	// GroupMemoryBarrierWithGroupSync()
+
+	for (uint32_t ty = 0; ty < GroupY; ty++)
+	{
+		for (uint32_t tx = 0; tx < GroupX; tx++)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				const uint32_t PX = tx + (i & 1) * GroupX;
+				const uint32_t PY = ty + (i >> 1) * GroupY;
+				const uint32_t X = BaseX + PX;
+				const uint32_t Y = BaseY + PY;
+				if (X < (uint32_t)Copy.Width && Y < (uint32_t)Copy.Height)
+				{
+					memcpy(Copy.Dst + (size_t)Y * Copy.Pitch + X * 4, &Tile[PY * TileWidth + PX], 4);
+				}
+			}
+		}
+	}
+}
+
+// Emulation of ComputeShaderCodeWaveRowCopy at a fixed wave size. A group of NumThreads[0] threads
+// copies RowSpan texels of row GroupID[1], each wave taking an even share and its lanes stepping
+// through the share together. A wave size over the group size leaves part of the wave inactive. Wave
+// WaveIndex holds SV_GroupIndex WaveIndex * LaneCount onwards, the packing the shader assumes.
+struct CSWaveCopyContext
+{
+	CSCopyContext Copy;
+	uint32_t LaneCount;		// WaveGetLaneCount()
+	uint32_t RowSpan;		// Texels per group
+};
+
+inline void CSCopyKernelWaveRows(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	const CSWaveCopyContext& Wave = *(const CSWaveCopyContext*)Context;
+	const CSCopyContext& Copy = Wave.Copy;
+	const uint32_t Y = GroupID[1];
+	if (Y >= (uint32_t)Copy.Height)
+	{
+		return;
+	}
+	const uint32_t GroupThreads = Dispatch.NumThreads[0];
+	const uint32_t WavesPerGroup = (GroupThreads + Wave.LaneCount - 1) / Wave.LaneCount;
+	const uint32_t Span = Wave.RowSpan / WavesPerGroup;
+	const uint32_t* Src = (const uint32_t*)(Copy.Src + (size_t)Y * Copy.Pitch);
+	uint32_t* Dst = (uint32_t*)(Copy.Dst + (size_t)Y * Copy.Pitch);
+
+	for (uint32_t WaveIndex = 0; WaveIndex < WavesPerGroup; WaveIndex++)
+	{
+		// WaveActiveCountBits(true): the last wave only has the group's leftover threads
+		const uint32_t ActiveLanes = std::min(Wave.LaneCount, GroupThreads - WaveIndex * Wave.LaneCount);
+		const uint32_t Start = GroupID[0] * Wave.RowSpan + WaveIndex * Span;
+		// Each step of the loop is one instruction across the wave, lane i on texel Step + i
+		for (uint32_t Step = 0; Step < Span; Step += ActiveLanes)
+		{
+			for (uint32_t Lane = 0; Lane < ActiveLanes && Step + Lane < Span; Lane++)
+			{
+				const uint32_t X = Start + Step + Lane;
+				if (X < (uint32_t)Copy.Width)
+				{
+					Dst[X] = Src[X];
+				}
+			}
+		}
+	}
+}
+
+// Emulation of ComputeShaderCodeBufferCopy and ComputeShaderCodeBufferCopyWide: each thread of a
+// NumThreads[0] group copies LoadsPerThread uint4s, load i of the group covering one contiguous span.
+// Raw buffer accesses past the end read 0 and drop their writes.
+struct CSBufferCopyContext
+{
+	const uint8_t* Src;
+	uint8_t* Dst;
+	size_t Size;
+	uint32_t LoadsPerThread;
+};
+
+inline void CSCopyKernelByteAddress(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	const CSBufferCopyContext& Copy = *(const CSBufferCopyContext*)Context;
+	const uint32_t GroupThreads = Dispatch.NumThreads[0];
+	for (uint32_t i = 0; i < Copy.LoadsPerThread; i++)
+	{
+		const size_t SpanOffset = ((size_t)GroupID[0] * Copy.LoadsPerThread + i) * GroupThreads * 16;
+		for (uint32_t Thread = 0; Thread < GroupThreads; Thread++)
+		{
+			const size_t Offset = SpanOffset + (size_t)Thread * 16;
+			if (Offset + 16 > Copy.Size)
+			{
+				return;
+			}
+#if CPU_X86
+			_mm_storeu_si128((__m128i*)(Copy.Dst + Offset), _mm_loadu_si128((const __m128i*)(Copy.Src + Offset)));
+#elif CPU_ARM64
+			vst1q_u8(Copy.Dst + Offset, vld1q_u8(Copy.Src + Offset));
+#else
+			memcpy(Copy.Dst + Offset, Copy.Src + Offset, 16);
+#endif
+		}
+	}
+}
+
+// Dispatch() size for ComputeShaderCodeRemap: one group per flat index of the order, in rows DispatchX wide
+inline void GetRemapDispatchSize(const CSDispatch& Dispatch, uint32_t& DispatchX, uint32_t& DispatchY)
+{
+	DispatchX = Dispatch.Order == CSDispatchOrder::Morton ? GetMortonSide(Dispatch) : Dispatch.GroupCount[0];
+	DispatchY = GetDispatchIndexCount(Dispatch) / DispatchX;
+}
+
+// The defines ComputeShaderCodeRemap is compiled with for a square group dispatch
+inline std::vector<std::pair<std::string, std::string>> GetRemapCopyShaderDefines(const CSDispatch& Dispatch)
+{
+	uint32_t DispatchX = 0, DispatchY = 0;
+	GetRemapDispatchSize(Dispatch, DispatchX, DispatchY);
+
+	return
+	{
+		{ "GROUP_SIZE", std::to_string(Dispatch.NumThreads[0]) },
+		{ "GROUPS_X", std::to_string(Dispatch.GroupCount[0]) },
+		{ "GROUPS_Y", std::to_string(Dispatch.GroupCount[1]) },
+		{ "DISPATCH_X", std::to_string(DispatchX) },
+		{ "TILE_WIDTH", std::to_string(Dispatch.TileWidth) },
+		{ "REMAP_ORDER", std::to_string((int)Dispatch.Order) },
+	};
+}
+
+struct CSCoverageContext
+{
+	std::vector<uint32_t> Counts;
+	int Width;
+	int Height;
+};
+
+inline void CSCoverageKernel(void* Context, const CSDispatch& Dispatch, const uint32_t GroupID[3])
+{
+	CSCoverageContext& Coverage = *(CSCoverageContext*)Context;
+	for (uint32_t ty = 0; ty < Dispatch.NumThreads[1]; ty++)
+	{
+		for (uint32_t tx = 0; tx < Dispatch.NumThreads[0]; tx++)
+		{
+			uint32_t X = GroupID[0] * Dispatch.NumThreads[0] + tx;
+			uint32_t Y = GroupID[1] * Dispatch.NumThreads[1] + ty;
+			if (X < (uint32_t)Coverage.Width && Y < (uint32_t)Coverage.Height)
+			{
+				Coverage.Counts[(size_t)Y * Coverage.Width + X]++;
+			}
+		}
+	}
+}
+
+// Runs the dispatch's group remap on the CPU emulator, one thread so the counts need no atomics,
+// and checks every texel of a Width x Height texture is written exactly once
+inline bool CheckDispatchCoverage(const CSDispatch& Dispatch, int Width, int Height)
+{
+	CSCoverageContext Coverage;
+	Coverage.Counts.assign((size_t)Width * Height, 0);
+	Coverage.Width = Width;
+	Coverage.Height = Height;
+
+	WorkStealingScheduler Inline;
+	DispatchCPU(Inline, Dispatch, CSCoverageKernel, &Coverage);
+
+	for (uint32_t Count : Coverage.Counts)
+	{
+		if (Count != 1)
+		{
+			return false;
+		}
+	}
+	return true;
+}
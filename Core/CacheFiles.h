@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Hashing.h"
+
+#include <functional>
+
+// Writes Header then Data under a temporary name and moves it over Path, so a reader never sees half a file
+inline bool WriteFileReplacing(const std::string& Path, const void* Header, size_t HeaderSize, const void* Data, size_t DataSize)
+{
+	char TempSuffix[32] = {};
+	snprintf(TempSuffix, sizeof(TempSuffix), ".%u.tmp", (unsigned)std::hash<std::thread::id>()(std::this_thread::get_id()));
+	const std::string TempPath = Path + TempSuffix;
+
+	FILE* File = nullptr;
+	if (fopen_s(&File, TempPath.c_str(), "wb") != 0 || File == nullptr)
+	{
+		return false;
+	}
+
+	bool bWritten = fwrite(Header, HeaderSize, 1, File) == 1 && fwrite(Data, 1, DataSize, File) == DataSize;
+	bWritten = fclose(File) == 0 && bWritten;
+
+	if (!bWritten || !PlatformReplaceFile(TempPath.c_str(), Path.c_str()))
+	{
+		remove(TempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+// A shader cache file is this header followed by the bytecode. Bump the version when the layout or the
+// compiler changes in a way the key doesn't capture.
+const uint32_t ShaderCacheFileMagic = 0x48435353;	// "SSCH"
+const uint32_t ShaderCacheFileVersion = 1;
+
+struct ShaderCacheFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint64_t ByteCodeHash;
+	uint64_t ByteCodeSize;
+};
+
+// Everything that goes into a compile. Each string is hashed with its terminator, so fields can't run
+// into each other.
+inline uint64_t GetShaderCacheKey(const char* Source, const char* EntryPoint, const char* Target, uint32_t Flags, const std::vector<std::pair<std::string, std::string>>& Defines)
+{
+	const uint32_t Version = ShaderCacheFileVersion;
+	uint64_t Hash = HashBytes(&Version, sizeof(Version));
+	Hash = HashBytes(Source, strlen(Source) + 1, Hash);
+	Hash = HashBytes(EntryPoint, strlen(EntryPoint) + 1, Hash);
+	Hash = HashBytes(Target, strlen(Target) + 1, Hash);
+	Hash = HashBytes(&Flags, sizeof(Flags), Hash);
+	for (const auto& Define : Defines)
+	{
+		Hash = HashBytes(Define.first.c_str(), Define.first.size() + 1, Hash);
+		Hash = HashBytes(Define.second.c_str(), Define.second.size() + 1, Hash);
+	}
+	return Hash;
+}
+
+inline std::string GetShaderCachePath(const std::string& Directory, uint64_t Key)
+{
+	char Filename[32] = {};
+	snprintf(Filename, sizeof(Filename), "/%016llx.cso", (unsigned long long)Key);
+	return Directory + Filename;
+}
+
+// Anything missing, truncated, corrupt or for another key returns false
+inline bool ReadShaderCacheFile(const std::string& Path, uint64_t Key, std::vector<uint8_t>& ByteCode)
+{
+	ByteCode.clear();
+	FILE* File = nullptr;
+	if (fopen_s(&File, Path.c_str(), "rb") != 0 || File == nullptr)
+	{
+		return false;
+	}
+
+	ShaderCacheFileHeader Header = {};
+	bool bValid = fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == ShaderCacheFileMagic && Header.Version == ShaderCacheFileVersion &&
+		Header.Key == Key && Header.ByteCodeSize > 0 && Header.ByteCodeSize < (64u << 20);
+	if (bValid)
+	{
+		ByteCode.resize((size_t)Header.ByteCodeSize);
+		bValid = fread(ByteCode.data(), 1, ByteCode.size(), File) == ByteCode.size() && HashBytes(ByteCode.data(), ByteCode.size()) == Header.ByteCodeHash;
+	}
+	fclose(File);
+	if (!bValid)
+	{
+		ByteCode.clear();
+	}
+	return bValid;
+}
+
+// Another thread or process may write the same key at the same time, which writes the same bytes
+inline bool WriteShaderCacheFile(const std::string& Path, uint64_t Key, const void* ByteCode, size_t ByteCodeSize)
+{
+	ShaderCacheFileHeader Header = {};
+	Header.Magic = ShaderCacheFileMagic;
+	Header.Version = ShaderCacheFileVersion;
+	Header.Key = Key;
+	Header.ByteCodeSize = ByteCodeSize;
+	Header.ByteCodeHash = HashBytes(ByteCode, ByteCodeSize);
+	return WriteFileReplacing(Path, &Header, sizeof(Header), ByteCode, ByteCodeSize);
+}
+
+// The pipeline library file: this header, then the serialized library. The driver rejects a library
+// it didn't write, but only after it has been handed the data; the adapter IDs catch a file copied
+// to another GPU, and the hash catches one that was cut short.
+struct PipelineCacheFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VendorId;
+	uint32_t DeviceId;
+	uint32_t SubSysId;
+	uint32_t Revision;
+	uint64_t DataSize;
+	uint64_t DataHash;
+};
+
+const uint32_t PipelineCacheMagic = 0x4C505350;	// "PSPL"
+const uint32_t PipelineCacheVersion = 1;
+
+inline bool WritePipelineCacheFile(const std::string& Path, const PipelineCacheFileHeader& Identity, const void* Data, size_t DataSize)
+{
+	PipelineCacheFileHeader Header = Identity;
+	Header.DataSize = DataSize;
+	Header.DataHash = HashBytes(Data, DataSize);
+	return WriteFileReplacing(Path, &Header, sizeof(Header), Data, DataSize);
+}
+
+// Fills Data only if the file was written for Identity's adapter and is intact
+inline bool ReadPipelineCacheFile(const std::string& Path, const PipelineCacheFileHeader& Identity, std::vector<uint8_t>& Data)
+{
+	Data.clear();
+
+	FILE* File = nullptr;
+	if (fopen_s(&File, Path.c_str(), "rb") != 0 || File == nullptr)
+	{
+		return false;
+	}
+
+	PipelineCacheFileHeader Header = {};
+	bool bValid = fread(&Header, sizeof(Header), 1, File) == 1 && Header.Magic == Identity.Magic && Header.Version == Identity.Version &&
+		Header.VendorId == Identity.VendorId && Header.DeviceId == Identity.DeviceId &&
+		Header.SubSysId == Identity.SubSysId && Header.Revision == Identity.Revision && Header.DataSize < (256u << 20);
+	if (bValid)
+	{
+		Data.resize((size_t)Header.DataSize);
+		bValid = fread(Data.data(), 1, Data.size(), File) == Data.size() && HashBytes(Data.data(), Data.size()) == Header.DataHash;
+	}
+	fclose(File);
+
+	if (!bValid)
+	{
+		Data.clear();
+	}
+	return bValid;
+}
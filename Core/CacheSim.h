@@ -0,0 +1,375 @@
+#pragma once
+
+#include "CSEmulator.h"
+#include "Swizzle.h"
+
+// Offline cache model for the copy tests: replays the texel addresses each copy method touches, in the
+// order the hardware roughly issues them, through per-CU L1s and a shared L2, and counts DRAM traffic.
+// Waves are coalesced into one request per distinct L1 line. L1s are write-through without write allocate,
+// and the L2 is write-back: write misses allocate without a fill, as the written bytes cover their sectors.
+
+struct CacheLevelConfig
+{
+	int SizeKB;
+	int LineSize;
+	int Ways;
+};
+
+struct CacheSimConfig
+{
+	CacheLevelConfig L1 = { 16, 128, 4 };
+	CacheLevelConfig L2 = { 2048, 128, 16 };
+	int NumCUs = 16;
+	int WaveSize = 32;
+};
+
+// One set associative LRU cache
+struct CacheSim
+{
+	int LineShift = 0;
+	int NumSets = 0;
+	int Ways = 0;
+	std::vector<uint64_t> Tags;		// Line address per way, ~0 when empty
+	std::vector<uint64_t> LastUse;
+	std::vector<uint8_t> Dirty;
+	uint64_t Clock = 0;
+	uint64_t Hits = 0;
+	uint64_t Misses = 0;
+	uint64_t Writebacks = 0;
+
+	void Init(const CacheLevelConfig& Config)
+	{
+		ASSERT((Config.LineSize & (Config.LineSize - 1)) == 0);
+		LineShift = 0;
+		while ((1 << LineShift) < Config.LineSize)
+		{
+			LineShift++;
+		}
+		Ways = Config.Ways;
+		NumSets = std::max(1, Config.SizeKB * 1024 / (Config.LineSize * Config.Ways));
+		Tags.assign((size_t)NumSets * Ways, ~0ull);
+		LastUse.assign((size_t)NumSets * Ways, 0);
+		Dirty.assign((size_t)NumSets * Ways, 0);
+	}
+
+	// Returns true on a hit. A miss takes the least recently used way, counting a writeback if it was dirty.
+	bool Access(uint64_t Address, bool bWrite)
+	{
+		const uint64_t Line = Address >> LineShift;
+		const size_t Set = (size_t)(Line % NumSets) * Ways;
+		Clock++;
+
+		size_t Victim = Set;
+		for (size_t Way = Set; Way < Set + Ways; Way++)
+		{
+			if (Tags[Way] == Line)
+			{
+				LastUse[Way] = Clock;
+				Dirty[Way] |= bWrite ? 1 : 0;
+				Hits++;
+				return true;
+			}
+			if (LastUse[Way] < LastUse[Victim])
+			{
+				Victim = Way;
+			}
+		}
+
+		Misses++;
+		Writebacks += Dirty[Victim];
+		Tags[Victim] = Line;
+		LastUse[Victim] = Clock;
+		Dirty[Victim] = bWrite ? 1 : 0;
+		return false;
+	}
+
+	// Writes back every dirty line, as at the end of a frame
+	uint64_t Flush()
+	{
+		uint64_t Count = 0;
+		for (uint8_t& Bit : Dirty)
+		{
+			Count += Bit;
+			Bit = 0;
+		}
+		Writebacks += Count;
+		return Count;
+	}
+};
+
+enum class SimLayout
+{
+	Linear,				// Rows at a 256 byte aligned pitch, as in an upload or readback buffer
+	Tiled,				// MortonSwizzle4KB
+	StandardSwizzle,	// StandardSwizzle64KB
+};
+
+inline const char* GetSimLayoutName(SimLayout Layout)
+{
+	return Layout == SimLayout::StandardSwizzle ? "std64k" : Layout == SimLayout::Tiled ? "tiled" : "linear";
+}
+
+// nullptr for the linear layout
+inline const SwizzleLayout* GetSimSwizzle(SimLayout Layout)
+{
+	return Layout == SimLayout::StandardSwizzle ? &StandardSwizzle64KB : Layout == SimLayout::Tiled ? &MortonSwizzle4KB : nullptr;
+}
+
+// Byte offset of a 4 byte texel
+inline uint64_t GetSimTexelOffset(SimLayout Layout, int Width, int X, int Y)
+{
+	if (const SwizzleLayout* Swizzle = GetSimSwizzle(Layout))
+	{
+		return GetSwizzledTexelOffset(*Swizzle, Width, X, Y);
+	}
+	const uint64_t RowPitch = ((uint64_t)Width * 4 + 255) & ~255ull;
+	return (uint64_t)Y * RowPitch + (uint64_t)X * 4;
+}
+
+// Texel coordinates packed as X | Y << 16
+inline uint32_t PackSimTexel(uint32_t X, uint32_t Y)
+{
+	return X | (Y << 16);
+}
+
+// The texels one wave reads from the source and writes to the same place in the destination
+struct SimWave
+{
+	uint32_t FirstTexel;	// Into the stream's texel list
+	uint32_t NumTexels;
+	int CU;					// -1 for the copy engine, which bypasses the L1s
+};
+
+struct SimStream
+{
+	std::vector<uint32_t> Texels;
+	std::vector<SimWave> Waves;
+
+	void AddWave(int CU, uint32_t FirstTexel)
+	{
+		if (Texels.size() > FirstTexel)
+		{
+			Waves.push_back({ FirstTexel, (uint32_t)Texels.size() - FirstTexel, CU });
+		}
+	}
+};
+
+// The compute copy: groups launch in the dispatch's order and are dealt to the CUs round robin,
+// and a group's threads fill waves in SV_GroupIndex order, so a 1x1 group is a wave with one live lane
+inline void BuildCSCopyStream(const CSDispatch& Dispatch, int Width, int Height, const CacheSimConfig& Config, SimStream& Stream)
+{
+	const uint32_t IndexCount = GetDispatchIndexCount(Dispatch);
+	int NextCU = 0;
+	for (uint32_t Index = 0; Index < IndexCount; Index++)
+	{
+		uint32_t GroupID[3];
+		if (!MapDispatchIndex(Dispatch, Index, GroupID))
+		{
+			continue;
+		}
+
+		uint32_t WaveStart = (uint32_t)Stream.Texels.size();
+		int Lane = 0;
+		for (uint32_t ty = 0; ty < Dispatch.NumThreads[1]; ty++)
+		{
+			for (uint32_t tx = 0; tx < Dispatch.NumThreads[0]; tx++)
+			{
+				uint32_t X = GroupID[0] * Dispatch.NumThreads[0] + tx;
+				uint32_t Y = GroupID[1] * Dispatch.NumThreads[1] + ty;
+				if (X < (uint32_t)Width && Y < (uint32_t)Height)
+				{
+					Stream.Texels.push_back(PackSimTexel(X, Y));
+				}
+				if (++Lane == Config.WaveSize)
+				{
+					Stream.AddWave(NextCU, WaveStart);
+					WaveStart = (uint32_t)Stream.Texels.size();
+					Lane = 0;
+				}
+			}
+		}
+		Stream.AddWave(NextCU, WaveStart);
+		NextCU = (NextCU + 1) % Config.NumCUs;
+	}
+}
+
+// The pixel shader copy: the rasterizer walks the screen in 8 x 8 pixel tiles, row-major, deals them to the
+// CUs round robin, and packs each into waves of 2 x 2 quads
+inline void BuildPSCopyStream(int Width, int Height, const CacheSimConfig& Config, SimStream& Stream)
+{
+	int NextCU = 0;
+	for (int TileY = 0; TileY < Height; TileY += 8)
+	{
+		for (int TileX = 0; TileX < Width; TileX += 8)
+		{
+			uint32_t WaveStart = (uint32_t)Stream.Texels.size();
+			int Lane = 0;
+			for (int QuadY = TileY; QuadY < TileY + 8; QuadY += 2)
+			{
+				for (int QuadX = TileX; QuadX < TileX + 8; QuadX += 2)
+				{
+					for (int i = 0; i < 4; i++)
+					{
+						int X = QuadX + (i & 1);
+						int Y = QuadY + (i >> 1);
+						if (X < Width && Y < Height)
+						{
+							Stream.Texels.push_back(PackSimTexel(X, Y));
+						}
+					}
+					Lane += 4;
+					if (Lane >= Config.WaveSize)
+					{
+						Stream.AddWave(NextCU, WaveStart);
+						WaveStart = (uint32_t)Stream.Texels.size();
+						Lane = 0;
+					}
+				}
+			}
+			Stream.AddWave(NextCU, WaveStart);
+			NextCU = (NextCU + 1) % Config.NumCUs;
+		}
+	}
+}
+
+// CopyResource: the copy engine streams both resources in memory order, a wave's worth at a time
+inline void BuildCopyResourceStream(SimLayout Layout, int Width, int Height, const CacheSimConfig& Config, SimStream& Stream)
+{
+	uint32_t WaveStart = 0;
+	auto AddTexel = [&](int X, int Y)
+	{
+		if (X < Width && Y < Height)
+		{
+			Stream.Texels.push_back(PackSimTexel(X, Y));
+			if (Stream.Texels.size() - WaveStart == (size_t)Config.WaveSize)
+			{
+				Stream.AddWave(-1, WaveStart);
+				WaveStart = (uint32_t)Stream.Texels.size();
+			}
+		}
+	};
+
+	if (const SwizzleLayout* Swizzle = GetSimSwizzle(Layout))
+	{
+		for (int TileY = 0; TileY < Height; TileY += Swizzle->TileHeight)
+		{
+			for (int TileX = 0; TileX < Width; TileX += Swizzle->TileWidth)
+			{
+				for (uint32_t Offset = 0; Offset < (uint32_t)(Swizzle->TileWidth * Swizzle->TileHeight * 4); Offset += 4)
+				{
+					AddTexel(TileX + ExtractBits(Offset, Swizzle->XMask), TileY + ExtractBits(Offset, Swizzle->YMask));
+				}
+			}
+		}
+	}
+	else
+	{
+		for (int Y = 0; Y < Height; Y++)
+		{
+			for (int X = 0; X < Width; X++)
+			{
+				AddTexel(X, Y);
+			}
+		}
+	}
+	Stream.AddWave(-1, WaveStart);
+}
+
+struct CacheSimResult
+{
+	uint64_t Requests = 0;		// Wave loads and stores
+	uint64_t Lanes = 0;			// Live lanes over all requests
+	uint64_t Transactions = 0;	// Distinct L1 lines over all requests
+	uint64_t L1Hits = 0;
+	uint64_t L1Accesses = 0;
+	uint64_t L2Hits = 0;
+	uint64_t L2Accesses = 0;
+	uint64_t DRAMReadBytes = 0;
+	uint64_t DRAMWriteBytes = 0;
+};
+
+// Replays a stream, the CUs taking turns issuing their next wave. Each wave loads its texels from the source
+// and then stores them to the destination, which sits after the source in memory.
+inline CacheSimResult SimulateCopy(const SimStream& Stream, SimLayout Layout, int Width, int Height, const CacheSimConfig& Config)
+{
+	std::vector<CacheSim> L1s(Config.NumCUs);
+	for (CacheSim& L1 : L1s)
+	{
+		L1.Init(Config.L1);
+	}
+	CacheSim L2;
+	L2.Init(Config.L2);
+
+	const uint64_t DstBase = (GetSimTexelOffset(Layout, Width, Width - 1, Height - 1) + 4 + 65535) & ~65535ull;
+	const uint64_t L1LineMask = ~(uint64_t)(Config.L1.LineSize - 1);
+
+	// Waves per CU in launch order; the copy engine queue goes last
+	std::vector<std::vector<uint32_t>> Queues(Config.NumCUs + 1);
+	for (uint32_t i = 0; i < (uint32_t)Stream.Waves.size(); i++)
+	{
+		const int CU = Stream.Waves[i].CU;
+		Queues[CU < 0 ? Config.NumCUs : CU].push_back(i);
+	}
+
+	CacheSimResult Result;
+	std::vector<uint64_t> Lines;
+	auto Issue = [&](const SimWave& Wave, int CU, uint64_t Base, bool bWrite)
+	{
+		Lines.clear();
+		for (uint32_t i = 0; i < Wave.NumTexels; i++)
+		{
+			const uint32_t Texel = Stream.Texels[Wave.FirstTexel + i];
+			const uint64_t Line = (Base + GetSimTexelOffset(Layout, Width, Texel & 0xffff, Texel >> 16)) & L1LineMask;
+			if (std::find(Lines.begin(), Lines.end(), Line) == Lines.end())
+			{
+				Lines.push_back(Line);
+			}
+		}
+		Result.Requests++;
+		Result.Lanes += Wave.NumTexels;
+		Result.Transactions += Lines.size();
+
+		for (uint64_t Line : Lines)
+		{
+			if (!bWrite && CU >= 0)
+			{
+				Result.L1Accesses++;
+				if (L1s[CU].Access(Line, false))
+				{
+					Result.L1Hits++;
+					continue;
+				}
+			}
+			Result.L2Accesses++;
+			if (L2.Access(Line, bWrite))
+			{
+				Result.L2Hits++;
+			}
+			else if (!bWrite)
+			{
+				Result.DRAMReadBytes += Config.L2.LineSize;
+			}
+		}
+	};
+
+	std::vector<size_t> Next(Queues.size(), 0);
+	bool bIssued = true;
+	while (bIssued)
+	{
+		bIssued = false;
+		for (size_t q = 0; q < Queues.size(); q++)
+		{
+			if (Next[q] < Queues[q].size())
+			{
+				const SimWave& Wave = Stream.Waves[Queues[q][Next[q]++]];
+				Issue(Wave, Wave.CU, 0, false);
+				Issue(Wave, Wave.CU, DstBase, true);
+				bIssued = true;
+			}
+		}
+	}
+
+	L2.Flush();
+	Result.DRAMWriteBytes = L2.Writebacks * Config.L2.LineSize;
+	return Result;
+}
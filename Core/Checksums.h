@@ -0,0 +1,338 @@
+#pragma once
+
+#include "Platform.h"
+
+#if CPU_ARM64 && !defined(_MSC_VER)
+#include <arm_acle.h>
+#endif
+
+// Checksum kernels take and return the running checksum state, so they can be chained over
+// several buffers and mixed (the SIMD ones hand their unaligned tails to the scalar ones).
+// For CRC32 the state is the bit-inverted register, ~0 at the start.
+typedef uint32_t (*ChecksumFunc)(uint32_t State, const uint8_t* Data, size_t Len);
+
+struct Crc32Tables
+{
+	uint32_t Table[8][256];
+
+	Crc32Tables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t Crc = i;
+			for (int Bit = 0; Bit < 8; Bit++)
+			{
+				Crc = (Crc >> 1) ^ (0xEDB88320u & (0u - (Crc & 1)));
+			}
+			Table[0][i] = Crc;
+		}
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			for (int Slice = 1; Slice < 8; Slice++)
+			{
+				Table[Slice][i] = (Table[Slice - 1][i] >> 8) ^ Table[0][Table[Slice - 1][i] & 0xff];
+			}
+		}
+	}
+};
+
+inline const Crc32Tables& GetCrc32Tables()
+{
+	static const Crc32Tables Tables;
+	return Tables;
+}
+
+// One table lookup per byte, same as the writer's built-in CRC
+inline uint32_t Crc32Bytewise(uint32_t Crc, const uint8_t* Data, size_t Len)
+{
+	const Crc32Tables& T = GetCrc32Tables();
+	for (size_t i = 0; i < Len; i++)
+	{
+		Crc = (Crc >> 8) ^ T.Table[0][(Crc ^ Data[i]) & 0xff];
+	}
+	return Crc;
+}
+
+// Slicing-by-8: eight independent lookups per 8 bytes instead of a serial chain of eight
+inline uint32_t Crc32Slice8(uint32_t Crc, const uint8_t* Data, size_t Len)
+{
+	const Crc32Tables& T = GetCrc32Tables();
+	while (Len >= 8)
+	{
+		uint32_t Lo, Hi;
+		memcpy(&Lo, Data, 4);
+		memcpy(&Hi, Data + 4, 4);
+		Lo ^= Crc;
+		Crc = T.Table[7][Lo & 0xff] ^ T.Table[6][(Lo >> 8) & 0xff] ^ T.Table[5][(Lo >> 16) & 0xff] ^ T.Table[4][Lo >> 24] ^
+			T.Table[3][Hi & 0xff] ^ T.Table[2][(Hi >> 8) & 0xff] ^ T.Table[1][(Hi >> 16) & 0xff] ^ T.Table[0][Hi >> 24];
+		Data += 8;
+		Len -= 8;
+	}
+	return Crc32Bytewise(Crc, Data, Len);
+}
+
+#if CPU_X86
+// Folds a 128-bit accumulator forward by the distance K's constants are for, into the next block
+CPU_TARGET("pclmul") inline __m128i Crc32PclmulFold(__m128i Acc, __m128i Next, __m128i K)
+{
+	__m128i Lo = _mm_clmulepi64_si128(Acc, K, 0x00);
+	__m128i Hi = _mm_clmulepi64_si128(Acc, K, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(Hi, Lo), Next);
+}
+
+// Carry-less multiply folding (Gopal et al., "Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ"), four 128-bit lanes in flight, then folded down and Barrett reduced to 32 bits.
+// Constants are for the bit-reflected zlib polynomial.
+CPU_TARGET("pclmul,sse4.1") inline uint32_t Crc32Pclmul(uint32_t Crc, const uint8_t* Data, size_t Len)
+{
+	if (Len < 64)
+	{
+		return Crc32Slice8(Crc, Data, Len);
+	}
+
+	const __m128i K1K2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i K3K4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i K5K0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+	const __m128i Poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i Mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i X1 = _mm_loadu_si128((const __m128i*)(Data + 0x00));
+	__m128i X2 = _mm_loadu_si128((const __m128i*)(Data + 0x10));
+	__m128i X3 = _mm_loadu_si128((const __m128i*)(Data + 0x20));
+	__m128i X4 = _mm_loadu_si128((const __m128i*)(Data + 0x30));
+	X1 = _mm_xor_si128(X1, _mm_cvtsi32_si128((int)Crc));
+	Data += 64;
+	Len -= 64;
+
+	while (Len >= 64)
+	{
+		X1 = Crc32PclmulFold(X1, _mm_loadu_si128((const __m128i*)(Data + 0x00)), K1K2);
+		X2 = Crc32PclmulFold(X2, _mm_loadu_si128((const __m128i*)(Data + 0x10)), K1K2);
+		X3 = Crc32PclmulFold(X3, _mm_loadu_si128((const __m128i*)(Data + 0x20)), K1K2);
+		X4 = Crc32PclmulFold(X4, _mm_loadu_si128((const __m128i*)(Data + 0x30)), K1K2);
+		Data += 64;
+		Len -= 64;
+	}
+
+	// Fold the four lanes into one, then any remaining 16 byte blocks into that
+	X1 = Crc32PclmulFold(X1, X2, K3K4);
+	X1 = Crc32PclmulFold(X1, X3, K3K4);
+	X1 = Crc32PclmulFold(X1, X4, K3K4);
+	while (Len >= 16)
+	{
+		X1 = Crc32PclmulFold(X1, _mm_loadu_si128((const __m128i*)Data), K3K4);
+		Data += 16;
+		Len -= 16;
+	}
+
+	// 128 -> 64 bits
+	__m128i X2Fold = _mm_clmulepi64_si128(X1, K3K4, 0x10);
+	X1 = _mm_xor_si128(_mm_srli_si128(X1, 8), X2Fold);
+	X2Fold = _mm_srli_si128(X1, 4);
+	X1 = _mm_clmulepi64_si128(_mm_and_si128(X1, Mask32), K5K0, 0x00);
+	X1 = _mm_xor_si128(X1, X2Fold);
+
+	// Barrett reduction to 32 bits
+	__m128i T = _mm_clmulepi64_si128(_mm_and_si128(X1, Mask32), Poly, 0x10);
+	T = _mm_clmulepi64_si128(_mm_and_si128(T, Mask32), Poly, 0x00);
+	X1 = _mm_xor_si128(X1, T);
+
+	return Crc32Slice8((uint32_t)_mm_extract_epi32(X1, 1), Data, Len);
+}
+#endif
+
+#if CPU_ARM64
+CPU_TARGET("+crc") inline uint32_t Crc32Arm(uint32_t Crc, const uint8_t* Data, size_t Len)
+{
+	while (Len >= 8)
+	{
+		uint64_t Value;
+		memcpy(&Value, Data, 8);
+		Crc = __crc32d(Crc, Value);
+		Data += 8;
+		Len -= 8;
+	}
+	while (Len > 0)
+	{
+		Crc = __crc32b(Crc, *Data++);
+		Len--;
+	}
+	return Crc;
+}
+#endif
+
+// Largest n such that 255n(n+1)/2 + (n+1)(65520) fits in 32 bits, the sums are reduced at least that often
+const uint32_t AdlerBase = 65521;
+const uint32_t AdlerNMax = 5552;
+
+inline uint32_t Adler32Scalar(uint32_t Adler, const uint8_t* Data, size_t Len)
+{
+	uint32_t S1 = Adler & 0xffff;
+	uint32_t S2 = Adler >> 16;
+	while (Len > 0)
+	{
+		size_t BlockLen = Len < AdlerNMax ? Len : AdlerNMax;
+		Len -= BlockLen;
+		for (size_t i = 0; i < BlockLen; i++)
+		{
+			S1 += Data[i];
+			S2 += S1;
+		}
+		Data += BlockLen;
+		S1 %= AdlerBase;
+		S2 %= AdlerBase;
+	}
+	return (S2 << 16) | S1;
+}
+
+#if CPU_X86
+// 32 bytes per step: s1 from SAD against zero, s2 from byte * [32..1] multiply-adds, plus 32 times the
+// s1 running total at the start of each step
+CPU_TARGET("ssse3") inline uint32_t Adler32SSSE3(uint32_t Adler, const uint8_t* Data, size_t Len)
+{
+	uint32_t S1 = Adler & 0xffff;
+	uint32_t S2 = Adler >> 16;
+
+	const __m128i Tap0 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i Tap1 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Ones = _mm_set1_epi16(1);
+
+	size_t Blocks = Len / 32;
+	Len -= Blocks * 32;
+	while (Blocks > 0)
+	{
+		uint32_t N = (uint32_t)(Blocks < AdlerNMax / 32 ? Blocks : AdlerNMax / 32);
+		Blocks -= N;
+		S2 += S1 * 32 * N;
+
+		__m128i VPrev = _mm_setzero_si128();
+		__m128i VS1 = _mm_setzero_si128();
+		__m128i VS2 = _mm_setzero_si128();
+		for (uint32_t i = 0; i < N; i++)
+		{
+			const __m128i Bytes0 = _mm_loadu_si128((const __m128i*)Data);
+			const __m128i Bytes1 = _mm_loadu_si128((const __m128i*)(Data + 16));
+
+			VPrev = _mm_add_epi32(VPrev, VS1);
+			VS1 = _mm_add_epi32(VS1, _mm_add_epi32(_mm_sad_epu8(Bytes0, Zero), _mm_sad_epu8(Bytes1, Zero)));
+			VS2 = _mm_add_epi32(VS2, _mm_madd_epi16(_mm_maddubs_epi16(Bytes0, Tap0), Ones));
+			VS2 = _mm_add_epi32(VS2, _mm_madd_epi16(_mm_maddubs_epi16(Bytes1, Tap1), Ones));
+			Data += 32;
+		}
+		VS2 = _mm_add_epi32(VS2, _mm_slli_epi32(VPrev, 5));
+
+		VS1 = _mm_add_epi32(VS1, _mm_shuffle_epi32(VS1, _MM_SHUFFLE(1, 0, 3, 2)));
+		VS2 = _mm_add_epi32(VS2, _mm_shuffle_epi32(VS2, _MM_SHUFFLE(2, 3, 0, 1)));
+		VS2 = _mm_add_epi32(VS2, _mm_shuffle_epi32(VS2, _MM_SHUFFLE(1, 0, 3, 2)));
+		S1 += (uint32_t)_mm_cvtsi128_si32(VS1);
+		S2 += (uint32_t)_mm_cvtsi128_si32(VS2);
+		S1 %= AdlerBase;
+		S2 %= AdlerBase;
+	}
+
+	return Adler32Scalar((S2 << 16) | S1, Data, Len);
+}
+#endif
+
+#if CPU_ARM64
+inline uint32_t Adler32Neon(uint32_t Adler, const uint8_t* Data, size_t Len)
+{
+	uint32_t S1 = Adler & 0xffff;
+	uint32_t S2 = Adler >> 16;
+
+	static const uint16_t Taps[32] = { 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+
+	size_t Blocks = Len / 32;
+	Len -= Blocks * 32;
+	while (Blocks > 0)
+	{
+		uint32_t N = (uint32_t)(Blocks < AdlerNMax / 32 ? Blocks : AdlerNMax / 32);
+		Blocks -= N;
+		S2 += S1 * 32 * N;
+
+		uint32x4_t VPrev = vdupq_n_u32(0);
+		uint32x4_t VS1 = vdupq_n_u32(0);
+		// Per-column byte sums, at most 173 * 255 so they fit in 16 bits
+		uint16x8_t Column0 = vdupq_n_u16(0);
+		uint16x8_t Column1 = vdupq_n_u16(0);
+		uint16x8_t Column2 = vdupq_n_u16(0);
+		uint16x8_t Column3 = vdupq_n_u16(0);
+		for (uint32_t i = 0; i < N; i++)
+		{
+			const uint8x16_t Bytes0 = vld1q_u8(Data);
+			const uint8x16_t Bytes1 = vld1q_u8(Data + 16);
+
+			VPrev = vaddq_u32(VPrev, VS1);
+			VS1 = vpadalq_u16(VS1, vpadalq_u8(vpaddlq_u8(Bytes0), Bytes1));
+			Column0 = vaddw_u8(Column0, vget_low_u8(Bytes0));
+			Column1 = vaddw_u8(Column1, vget_high_u8(Bytes0));
+			Column2 = vaddw_u8(Column2, vget_low_u8(Bytes1));
+			Column3 = vaddw_u8(Column3, vget_high_u8(Bytes1));
+			Data += 32;
+		}
+
+		uint32x4_t VS2 = vshlq_n_u32(VPrev, 5);
+		VS2 = vmlal_u16(VS2, vget_low_u16(Column0), vld1_u16(Taps + 0));
+		VS2 = vmlal_u16(VS2, vget_high_u16(Column0), vld1_u16(Taps + 4));
+		VS2 = vmlal_u16(VS2, vget_low_u16(Column1), vld1_u16(Taps + 8));
+		VS2 = vmlal_u16(VS2, vget_high_u16(Column1), vld1_u16(Taps + 12));
+		VS2 = vmlal_u16(VS2, vget_low_u16(Column2), vld1_u16(Taps + 16));
+		VS2 = vmlal_u16(VS2, vget_high_u16(Column2), vld1_u16(Taps + 20));
+		VS2 = vmlal_u16(VS2, vget_low_u16(Column3), vld1_u16(Taps + 24));
+		VS2 = vmlal_u16(VS2, vget_high_u16(Column3), vld1_u16(Taps + 28));
+
+		S1 += vaddvq_u32(VS1);
+		S2 += vaddvq_u32(VS2);
+		S1 %= AdlerBase;
+		S2 %= AdlerBase;
+	}
+
+	return Adler32Scalar((S2 << 16) | S1, Data, Len);
+}
+#endif
+
+inline ChecksumFunc SelectCrc32Kernel()
+{
+	const CPUFeatures& Features = GetCPUFeatures();
+#if CPU_X86
+	if (Features.PCLMUL && Features.SSE41)
+	{
+		return Crc32Pclmul;
+	}
+#elif CPU_ARM64
+	if (Features.ARMCRC32)
+	{
+		return Crc32Arm;
+	}
+#endif
+	(void)Features;
+	return Crc32Slice8;
+}
+
+inline ChecksumFunc SelectAdler32Kernel()
+{
+#if CPU_X86
+	if (GetCPUFeatures().SSSE3)
+	{
+		return Adler32SSSE3;
+	}
+#elif CPU_ARM64
+	return Adler32Neon;
+#endif
+	return Adler32Scalar;
+}
+
+// Used by the PNG writer for its chunk CRCs and zlib trailer
+inline unsigned int Crc32(unsigned char* Buffer, int Len)
+{
+	static const ChecksumFunc Kernel = SelectCrc32Kernel();
+	return ~Kernel(~0u, Buffer, (size_t)Len);
+}
+
+inline unsigned int Adler32(unsigned char* Data, int Len)
+{
+	static const ChecksumFunc Kernel = SelectAdler32Kernel();
+	return Kernel(1, Data, (size_t)Len);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <type_traits>
+#include <utility>
+
+inline uint64_t HashBytes(const void* Data, size_t Size, uint64_t Hash = 0xcbf29ce484222325ull)
+{
+	// FNV-1a, a word at a time
+	const uint8_t* Bytes = (const uint8_t*)Data;
+	size_t i = 0;
+	for (; i + 8 <= Size; i += 8)
+	{
+		uint64_t Word;
+		memcpy(&Word, Bytes + i, sizeof(Word));
+		Hash = (Hash ^ Word) * 0x100000001b3ull;
+	}
+	for (; i < Size; i++)
+	{
+		Hash = (Hash ^ Bytes[i]) * 0x100000001b3ull;
+	}
+	return Hash;
+}
+
+// What the embedded shader table is keyed by: the source, the entry point and each define's name and value,
+// every string with its terminator. shaders/build_shaders.py computes the same key, and --check compares them.
+inline uint64_t GetShaderSourceKey(const char* Source, const char* EntryPoint, const std::vector<std::pair<std::string, std::string>>& Defines)
+{
+	uint64_t Hash = HashBytes(Source, strlen(Source) + 1);
+	Hash = HashBytes(EntryPoint, strlen(EntryPoint) + 1, Hash);
+	for (const auto& Define : Defines)
+	{
+		Hash = HashBytes(Define.first.c_str(), Define.first.size() + 1, Hash);
+		Hash = HashBytes(Define.second.c_str(), Define.second.size() + 1, Hash);
+	}
+	return Hash;
+}
+
+// Hashes pipeline descs a field at a time, so padding is never read and pointers are followed to what they
+// point at. Two descs built separately from the same values get the same key.
+struct PipelineDescHasher
+{
+	uint64_t Hash = 0xcbf29ce484222325ull;
+
+	template <typename T>
+	void Add(const T& Value)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "hash structs field by field");
+		Hash = HashBytes(&Value, sizeof(Value), Hash);
+	}
+
+	void AddString(const char* String)
+	{
+		Add(String != nullptr);
+		if (String)
+		{
+			Hash = HashBytes(String, strlen(String) + 1, Hash);
+		}
+	}
+
+	void AddByteCode(const void* ByteCode, size_t Size)
+	{
+		Add(Size);
+		Hash = HashBytes(ByteCode, Size, Hash);
+	}
+};
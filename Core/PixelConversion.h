@@ -0,0 +1,386 @@
+#pragma once
+
+#include "Platform.h"
+
+// The texture formats the image dumps convert to RGBA8, named after the DXGI formats they stand for
+enum class ConvertFormat
+{
+	R8G8B8A8,
+	B8G8R8A8,
+	R10G10B10A2,
+	R16G16B16A16F,
+	R32G32B32A32F,
+};
+
+inline int GetConvertFormatBytesPerPixel(ConvertFormat Format)
+{
+	switch (Format)
+	{
+	case ConvertFormat::R16G16B16A16F: return 8;
+	case ConvertFormat::R32G32B32A32F: return 16;
+	default: return 4;
+	}
+}
+
+// Converts one row of Width texels to tightly packed RGBA8, the layout the image writers expect
+typedef void (*RowConvertFunc)(const uint8_t* Src, uint8_t* Dst, int Width);
+
+inline void ConvertRowRGBA8(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	memcpy(Dst, Src, (size_t)Width * 4);
+}
+
+inline void ConvertRowBGRA8Scalar(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	for (int x = 0; x < Width; x++)
+	{
+		Dst[x * 4 + 0] = Src[x * 4 + 2];
+		Dst[x * 4 + 1] = Src[x * 4 + 1];
+		Dst[x * 4 + 2] = Src[x * 4 + 0];
+		Dst[x * 4 + 3] = Src[x * 4 + 3];
+	}
+}
+
+// round(v * 255 / 1023) for every 10 bit v
+inline uint32_t Unorm10ToUnorm8(uint32_t Value)
+{
+	return (Value * 1021 + 2048) >> 12;
+}
+
+inline void ConvertRowR10G10B10A2Scalar(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	for (int x = 0; x < Width; x++)
+	{
+		uint32_t Texel;
+		memcpy(&Texel, Src + x * 4, 4);
+		Dst[x * 4 + 0] = (uint8_t)Unorm10ToUnorm8(Texel & 0x3ff);
+		Dst[x * 4 + 1] = (uint8_t)Unorm10ToUnorm8((Texel >> 10) & 0x3ff);
+		Dst[x * 4 + 2] = (uint8_t)Unorm10ToUnorm8((Texel >> 20) & 0x3ff);
+		Dst[x * 4 + 3] = (uint8_t)((Texel >> 30) * 85);
+	}
+}
+
+inline float HalfToFloat(uint16_t Half)
+{
+	uint32_t Sign = (uint32_t)(Half & 0x8000) << 16;
+	uint32_t Exponent = (Half >> 10) & 0x1f;
+	uint32_t Mantissa = Half & 0x3ff;
+	uint32_t Bits;
+	if (Exponent == 0x1f)
+	{
+		Bits = Sign | 0x7f800000 | (Mantissa << 13);
+	}
+	else if (Exponent != 0)
+	{
+		Bits = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+	}
+	else if (Mantissa == 0)
+	{
+		Bits = Sign;
+	}
+	else
+	{
+		// Denormal, renormalize it
+		Exponent = 113;
+		while ((Mantissa & 0x400) == 0)
+		{
+			Mantissa <<= 1;
+			Exponent--;
+		}
+		Bits = Sign | (Exponent << 23) | ((Mantissa & 0x3ff) << 13);
+	}
+	float Result;
+	memcpy(&Result, &Bits, 4);
+	return Result;
+}
+
+// HDR to 8 bit for viewing: Reinhard x / (1 + x) then gamma 2 on color, alpha clamped to [0, 1].
+// Negative and NaN map to 0, and the clamp keeps +inf finite. The SIMD kernels do exactly the same
+// IEEE operations, so all paths produce identical bytes.
+inline uint8_t ToneMapChannel(float Value)
+{
+	float C = Value > 0.0f ? Value : 0.0f;
+	C = C < 65504.0f ? C : 65504.0f;
+	return (uint8_t)(int)(sqrtf(C / (C + 1.0f)) * 255.0f + 0.5f);
+}
+
+inline uint8_t AlphaChannel(float Value)
+{
+	float C = Value > 0.0f ? Value : 0.0f;
+	C = C < 1.0f ? C : 1.0f;
+	return (uint8_t)(int)(C * 255.0f + 0.5f);
+}
+
+inline void ConvertRowRGBA16FScalar(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	for (int x = 0; x < Width; x++)
+	{
+		uint16_t Texel[4];
+		memcpy(Texel, Src + x * 8, 8);
+		Dst[x * 4 + 0] = ToneMapChannel(HalfToFloat(Texel[0]));
+		Dst[x * 4 + 1] = ToneMapChannel(HalfToFloat(Texel[1]));
+		Dst[x * 4 + 2] = ToneMapChannel(HalfToFloat(Texel[2]));
+		Dst[x * 4 + 3] = AlphaChannel(HalfToFloat(Texel[3]));
+	}
+}
+
+inline void ConvertRowRGBA32FScalar(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	for (int x = 0; x < Width; x++)
+	{
+		float Texel[4];
+		memcpy(Texel, Src + x * 16, 16);
+		Dst[x * 4 + 0] = ToneMapChannel(Texel[0]);
+		Dst[x * 4 + 1] = ToneMapChannel(Texel[1]);
+		Dst[x * 4 + 2] = ToneMapChannel(Texel[2]);
+		Dst[x * 4 + 3] = AlphaChannel(Texel[3]);
+	}
+}
+
+#if CPU_X86
+CPU_TARGET("ssse3") inline void ConvertRowBGRA8SSSE3(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i Texels = _mm_loadu_si128((const __m128i*)(Src + x * 4));
+		_mm_storeu_si128((__m128i*)(Dst + x * 4), _mm_shuffle_epi8(Texels, Shuffle));
+	}
+	ConvertRowBGRA8Scalar(Src + x * 4, Dst + x * 4, Width - x);
+}
+
+CPU_TARGET("avx2") inline void ConvertRowBGRA8AVX2(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const __m256i Shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int x = 0;
+	for (; x + 16 <= Width; x += 16)
+	{
+		__m256i Texels0 = _mm256_loadu_si256((const __m256i*)(Src + x * 4));
+		__m256i Texels1 = _mm256_loadu_si256((const __m256i*)(Src + x * 4 + 32));
+		_mm256_storeu_si256((__m256i*)(Dst + x * 4), _mm256_shuffle_epi8(Texels0, Shuffle));
+		_mm256_storeu_si256((__m256i*)(Dst + x * 4 + 32), _mm256_shuffle_epi8(Texels1, Shuffle));
+	}
+	ConvertRowBGRA8SSSE3(Src + x * 4, Dst + x * 4, Width - x);
+}
+
+CPU_TARGET("sse4.1") inline void ConvertRowR10G10B10A2SSE41(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const __m128i Mask10 = _mm_set1_epi32(0x3ff);
+	const __m128i Scale = _mm_set1_epi32(1021);
+	const __m128i Round = _mm_set1_epi32(2048);
+	const __m128i AlphaScale = _mm_set1_epi32(85);
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i Texels = _mm_loadu_si128((const __m128i*)(Src + x * 4));
+		__m128i R = _mm_and_si128(Texels, Mask10);
+		__m128i G = _mm_and_si128(_mm_srli_epi32(Texels, 10), Mask10);
+		__m128i B = _mm_and_si128(_mm_srli_epi32(Texels, 20), Mask10);
+		__m128i A = _mm_mullo_epi32(_mm_srli_epi32(Texels, 30), AlphaScale);
+		R = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(R, Scale), Round), 12);
+		G = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(G, Scale), Round), 12);
+		B = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(B, Scale), Round), 12);
+		__m128i Packed = _mm_or_si128(_mm_or_si128(R, _mm_slli_epi32(G, 8)), _mm_or_si128(_mm_slli_epi32(B, 16), _mm_slli_epi32(A, 24)));
+		_mm_storeu_si128((__m128i*)(Dst + x * 4), Packed);
+	}
+	ConvertRowR10G10B10A2Scalar(Src + x * 4, Dst + x * 4, Width - x);
+}
+
+// One RGBA float pixel per register, see ToneMapChannel
+inline __m128i ToneMapPixelSSE(__m128 Pixel)
+{
+	const __m128 AlphaMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+	const __m128 One = _mm_set1_ps(1.0f);
+	__m128 C = _mm_max_ps(Pixel, _mm_setzero_ps());
+	__m128 Color = _mm_min_ps(C, _mm_set1_ps(65504.0f));
+	Color = _mm_sqrt_ps(_mm_div_ps(Color, _mm_add_ps(Color, One)));
+	__m128 Alpha = _mm_min_ps(C, One);
+	__m128 Mapped = _mm_or_ps(_mm_andnot_ps(AlphaMask, Color), _mm_and_ps(AlphaMask, Alpha));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Mapped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+inline void StoreToneMappedSSE(uint8_t* Dst, __m128i P0, __m128i P1, __m128i P2, __m128i P3)
+{
+	__m128i Words = _mm_packs_epi32(P0, P1);
+	__m128i Words2 = _mm_packs_epi32(P2, P3);
+	_mm_storeu_si128((__m128i*)Dst, _mm_packus_epi16(Words, Words2));
+}
+
+inline void ConvertRowRGBA32FSSE(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const float* Texels = (const float*)Src;
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		StoreToneMappedSSE(Dst + x * 4,
+			ToneMapPixelSSE(_mm_loadu_ps(Texels + x * 4 + 0)),
+			ToneMapPixelSSE(_mm_loadu_ps(Texels + x * 4 + 4)),
+			ToneMapPixelSSE(_mm_loadu_ps(Texels + x * 4 + 8)),
+			ToneMapPixelSSE(_mm_loadu_ps(Texels + x * 4 + 12)));
+	}
+	ConvertRowRGBA32FScalar(Src + x * 16, Dst + x * 4, Width - x);
+}
+
+CPU_TARGET("f16c") inline void ConvertRowRGBA16FF16C(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i Halves01 = _mm_loadu_si128((const __m128i*)(Src + x * 8));
+		__m128i Halves23 = _mm_loadu_si128((const __m128i*)(Src + x * 8 + 16));
+		StoreToneMappedSSE(Dst + x * 4,
+			ToneMapPixelSSE(_mm_cvtph_ps(Halves01)),
+			ToneMapPixelSSE(_mm_cvtph_ps(_mm_srli_si128(Halves01, 8))),
+			ToneMapPixelSSE(_mm_cvtph_ps(Halves23)),
+			ToneMapPixelSSE(_mm_cvtph_ps(_mm_srli_si128(Halves23, 8))));
+	}
+	ConvertRowRGBA16FScalar(Src + x * 8, Dst + x * 4, Width - x);
+}
+#endif
+
+#if CPU_ARM64
+inline void ConvertRowBGRA8Neon(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	int x = 0;
+	for (; x + 16 <= Width; x += 16)
+	{
+		uint8x16x4_t Texels = vld4q_u8(Src + x * 4);
+		uint8x16_t Blue = Texels.val[0];
+		Texels.val[0] = Texels.val[2];
+		Texels.val[2] = Blue;
+		vst4q_u8(Dst + x * 4, Texels);
+	}
+	ConvertRowBGRA8Scalar(Src + x * 4, Dst + x * 4, Width - x);
+}
+
+inline void ConvertRowR10G10B10A2Neon(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const uint32x4_t Mask10 = vdupq_n_u32(0x3ff);
+	const uint32x4_t Round = vdupq_n_u32(2048);
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		uint32x4_t Texels = vld1q_u32((const uint32_t*)(Src + x * 4));
+		uint32x4_t R = vshrq_n_u32(vmlaq_n_u32(Round, vandq_u32(Texels, Mask10), 1021), 12);
+		uint32x4_t G = vshrq_n_u32(vmlaq_n_u32(Round, vandq_u32(vshrq_n_u32(Texels, 10), Mask10), 1021), 12);
+		uint32x4_t B = vshrq_n_u32(vmlaq_n_u32(Round, vandq_u32(vshrq_n_u32(Texels, 20), Mask10), 1021), 12);
+		uint32x4_t A = vmulq_n_u32(vshrq_n_u32(Texels, 30), 85);
+		uint32x4_t Packed = vorrq_u32(vorrq_u32(R, vshlq_n_u32(G, 8)), vorrq_u32(vshlq_n_u32(B, 16), vshlq_n_u32(A, 24)));
+		vst1q_u32((uint32_t*)(Dst + x * 4), Packed);
+	}
+	ConvertRowR10G10B10A2Scalar(Src + x * 4, Dst + x * 4, Width - x);
+}
+
+inline uint32x4_t ToneMapPixelNeon(float32x4_t Pixel)
+{
+	static const uint32_t AlphaMaskBits[4] = { 0, 0, 0, 0xffffffffu };
+	const uint32x4_t AlphaMask = vld1q_u32(AlphaMaskBits);
+	const float32x4_t One = vdupq_n_f32(1.0f);
+	float32x4_t C = vmaxnmq_f32(Pixel, vdupq_n_f32(0.0f));
+	float32x4_t Color = vminq_f32(C, vdupq_n_f32(65504.0f));
+	Color = vsqrtq_f32(vdivq_f32(Color, vaddq_f32(Color, One)));
+	float32x4_t Alpha = vminq_f32(C, One);
+	float32x4_t Mapped = vbslq_f32(AlphaMask, Alpha, Color);
+	return vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(Mapped, 255.0f), vdupq_n_f32(0.5f)));
+}
+
+inline void StoreToneMappedNeon(uint8_t* Dst, uint32x4_t P0, uint32x4_t P1, uint32x4_t P2, uint32x4_t P3)
+{
+	uint16x8_t Words01 = vcombine_u16(vmovn_u32(P0), vmovn_u32(P1));
+	uint16x8_t Words23 = vcombine_u16(vmovn_u32(P2), vmovn_u32(P3));
+	vst1q_u8(Dst, vcombine_u8(vmovn_u16(Words01), vmovn_u16(Words23)));
+}
+
+inline void ConvertRowRGBA32FNeon(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	const float* Texels = (const float*)Src;
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		StoreToneMappedNeon(Dst + x * 4,
+			ToneMapPixelNeon(vld1q_f32(Texels + x * 4 + 0)),
+			ToneMapPixelNeon(vld1q_f32(Texels + x * 4 + 4)),
+			ToneMapPixelNeon(vld1q_f32(Texels + x * 4 + 8)),
+			ToneMapPixelNeon(vld1q_f32(Texels + x * 4 + 12)));
+	}
+	ConvertRowRGBA32FScalar(Src + x * 16, Dst + x * 4, Width - x);
+}
+
+inline void ConvertRowRGBA16FNeon(const uint8_t* Src, uint8_t* Dst, int Width)
+{
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		float16x8_t Halves01 = vreinterpretq_f16_u16(vld1q_u16((const uint16_t*)(Src + x * 8)));
+		float16x8_t Halves23 = vreinterpretq_f16_u16(vld1q_u16((const uint16_t*)(Src + x * 8 + 16)));
+		StoreToneMappedNeon(Dst + x * 4,
+			ToneMapPixelNeon(vcvt_f32_f16(vget_low_f16(Halves01))),
+			ToneMapPixelNeon(vcvt_high_f32_f16(Halves01)),
+			ToneMapPixelNeon(vcvt_f32_f16(vget_low_f16(Halves23))),
+			ToneMapPixelNeon(vcvt_high_f32_f16(Halves23)));
+	}
+	ConvertRowRGBA16FScalar(Src + x * 8, Dst + x * 4, Width - x);
+}
+#endif
+
+// Picks the fastest row converter for Format that the CPU supports, with SIMD capped at MaxSimdLevel
+// (0 = scalar, 1 = SSSE3/SSE4.1/F16C or NEON, 2 = also AVX2)
+inline RowConvertFunc SelectRowConverter(ConvertFormat Format, int MaxSimdLevel = 2)
+{
+	const CPUFeatures& Features = GetCPUFeatures();
+	(void)Features;
+	switch (Format)
+	{
+	case ConvertFormat::R8G8B8A8:
+		return ConvertRowRGBA8;
+	case ConvertFormat::B8G8R8A8:
+#if CPU_X86
+		if (MaxSimdLevel >= 2 && Features.AVX2) return ConvertRowBGRA8AVX2;
+		if (MaxSimdLevel >= 1 && Features.SSSE3) return ConvertRowBGRA8SSSE3;
+#elif CPU_ARM64
+		if (MaxSimdLevel >= 1) return ConvertRowBGRA8Neon;
+#endif
+		return ConvertRowBGRA8Scalar;
+	case ConvertFormat::R10G10B10A2:
+#if CPU_X86
+		if (MaxSimdLevel >= 1 && Features.SSE41) return ConvertRowR10G10B10A2SSE41;
+#elif CPU_ARM64
+		if (MaxSimdLevel >= 1) return ConvertRowR10G10B10A2Neon;
+#endif
+		return ConvertRowR10G10B10A2Scalar;
+	case ConvertFormat::R16G16B16A16F:
+#if CPU_X86
+		if (MaxSimdLevel >= 1 && Features.F16C) return ConvertRowRGBA16FF16C;
+#elif CPU_ARM64
+		if (MaxSimdLevel >= 1) return ConvertRowRGBA16FNeon;
+#endif
+		return ConvertRowRGBA16FScalar;
+	case ConvertFormat::R32G32B32A32F:
+#if CPU_X86
+		if (MaxSimdLevel >= 1) return ConvertRowRGBA32FSSE;
+#elif CPU_ARM64
+		if (MaxSimdLevel >= 1) return ConvertRowRGBA32FNeon;
+#endif
+		return ConvertRowRGBA32FScalar;
+	default:
+		return nullptr;
+	}
+}
+
+// Converts a (possibly pitched) image to tightly packed RGBA8, dropping the row padding in the same pass
+inline void ConvertToRGBA8(const void* Src, int SrcPitch, ConvertFormat Format, int Width, int Height, uint8_t* Dst)
+{
+	RowConvertFunc ConvertRow = SelectRowConverter(Format);
+	ASSERT(ConvertRow != nullptr);
+	if (SrcPitch == 0)
+	{
+		SrcPitch = Width * GetConvertFormatBytesPerPixel(Format);
+	}
+
+	for (int y = 0; y < Height; y++)
+	{
+		ConvertRow((const uint8_t*)Src + (size_t)y * SrcPitch, Dst + (size_t)y * Width * 4, Width);
+	}
+}
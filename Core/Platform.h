@@ -0,0 +1,293 @@
+// The platform layer under the CPU-side code in Core/: CPU feature detection, NUMA placement, and the few
+// file operations the caches need. On Windows these are the Win32 calls the benchmark has always made.
+// Elsewhere they fall back to POSIX with every processor on one NUMA node, so the cores and their tests
+// build and run on Linux.
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#if defined(_WIN32)
+// std::min and std::max, not the macros
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define CPU_ARM64 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif !defined(_WIN32)
+#include <sys/auxv.h>
+#endif
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles any intrinsic anywhere, GCC and Clang only in functions built for its instruction set, so
+// kernels picked at runtime by GetCPUFeatures are tagged with what they use beyond the baseline
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(Features) __attribute__((target(Features)))
+#else
+#define CPU_TARGET(Features)
+#endif
+
+typedef int32_t int32;
+
+#define ASSERT assert
+
+#if !defined(_WIN32)
+inline int fopen_s(FILE** File, const char* Filename, const char* Mode)
+{
+	*File = fopen(Filename, Mode);
+	return *File ? 0 : errno;
+}
+#endif
+
+struct CPUFeatures
+{
+	bool SSSE3 = false;
+	bool SSE41 = false;
+	bool PCLMUL = false;
+	bool AVX2 = false;
+	bool AVX512F = false;
+	bool F16C = false;
+	bool ERMS = false;
+	bool ARMCRC32 = false;
+};
+
+#if CPU_X86
+inline void PlatformCpuid(int Info[4], int Leaf, int SubLeaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(Info, Leaf, SubLeaf);
+#else
+	__asm__ __volatile__("cpuid" : "=a"(Info[0]), "=b"(Info[1]), "=c"(Info[2]), "=d"(Info[3]) : "a"(Leaf), "c"(SubLeaf));
+#endif
+}
+
+inline uint64_t PlatformXgetbv(uint32_t Index)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(Index);
+#else
+	uint32_t Low = 0, High = 0;
+	__asm__ __volatile__("xgetbv" : "=a"(Low), "=d"(High) : "c"(Index));
+	return ((uint64_t)High << 32) | Low;
+#endif
+}
+
+inline void PlatformRepMovsb(uint8_t* Dst, const uint8_t* Src, size_t Size)
+{
+#if defined(_MSC_VER)
+	__movsb(Dst, Src, Size);
+#else
+	__asm__ __volatile__("rep movsb" : "+D"(Dst), "+S"(Src), "+c"(Size) : : "memory");
+#endif
+}
+#endif
+
+inline const CPUFeatures& GetCPUFeatures()
+{
+	static const CPUFeatures Features = []()
+	{
+		CPUFeatures Result;
+#if CPU_X86
+		int Info[4] = {};
+		PlatformCpuid(Info, 0, 0);
+		const int MaxLeaf = Info[0];
+
+		PlatformCpuid(Info, 1, 0);
+		Result.SSSE3 = (Info[2] & (1 << 9)) != 0;
+		Result.SSE41 = (Info[2] & (1 << 19)) != 0;
+		Result.PCLMUL = (Info[2] & (1 << 1)) != 0;
+
+		// AVX state has to be enabled by the OS as well as supported by the CPU
+		const bool OSXSave = (Info[2] & (1 << 27)) != 0;
+		const bool AVXState = OSXSave && (PlatformXgetbv(0) & 6) == 6;
+		const bool AVX512State = AVXState && (PlatformXgetbv(0) & 0xe6) == 0xe6;
+		Result.F16C = AVXState && (Info[2] & (1 << 29)) != 0;
+		if (MaxLeaf >= 7)
+		{
+			PlatformCpuid(Info, 7, 0);
+			Result.AVX2 = AVXState && (Info[1] & (1 << 5)) != 0;
+			Result.AVX512F = AVX512State && (Info[1] & (1 << 16)) != 0;
+			Result.ERMS = (Info[1] & (1 << 9)) != 0;
+		}
+#elif CPU_ARM64
+#if defined(_WIN32)
+		Result.ARMCRC32 = IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+		Result.ARMCRC32 = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+#endif
+		return Result;
+	}();
+	return Features;
+}
+
+// Hardware threads, at least 1 when the count isn't known
+inline int GetMaxThreads()
+{
+	const int Threads = (int)std::thread::hardware_concurrency();
+	return Threads > 0 ? Threads : 1;
+}
+
+// 1, 2, 4, ... below GetMaxThreads, then GetMaxThreads itself: the thread counts the CPU benchmarks sweep
+inline std::vector<int> GetThreadCountSweep()
+{
+	const int MaxThreads = GetMaxThreads();
+	std::vector<int> ThreadCounts;
+	for (int Threads = 1; Threads < MaxThreads; Threads *= 2)
+	{
+		ThreadCounts.push_back(Threads);
+	}
+	ThreadCounts.push_back(MaxThreads);
+	return ThreadCounts;
+}
+
+// Marsaglia's xorshift32, for cheap repeatable pseudo-random streams. State must not be 0.
+inline uint32_t NextXorShift32(uint32_t& State)
+{
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
+
+// Nodes that have processors; memory-only nodes can't run the workers. Without NUMA information, or off
+// Windows, everything is node 0 and threads aren't pinned.
+struct NumaTopology
+{
+	std::vector<uint16_t> Nodes;
+	std::vector<uint16_t> ProcessorGroups;
+	std::vector<uint64_t> ProcessorMasks;	// 0 when the node's threads aren't pinned
+};
+
+inline const NumaTopology& GetNumaTopology()
+{
+	static const NumaTopology Topology = []()
+	{
+		NumaTopology Result;
+#if defined(_WIN32)
+		ULONG HighestNode = 0;
+		if (GetNumaHighestNodeNumber(&HighestNode))
+		{
+			for (ULONG Node = 0; Node <= HighestNode; Node++)
+			{
+				GROUP_AFFINITY Affinity = {};
+				if (GetNumaNodeProcessorMaskEx((USHORT)Node, &Affinity) && Affinity.Mask != 0)
+				{
+					Result.Nodes.push_back((uint16_t)Node);
+					Result.ProcessorGroups.push_back(Affinity.Group);
+					Result.ProcessorMasks.push_back(Affinity.Mask);
+				}
+			}
+		}
+#endif
+		if (Result.Nodes.empty())
+		{
+			Result.Nodes.push_back(0);
+			Result.ProcessorGroups.push_back(0);
+			Result.ProcessorMasks.push_back(0);
+		}
+		return Result;
+	}();
+	return Topology;
+}
+
+// Node is an index into GetNumaTopology().Nodes
+inline void PinCurrentThreadToNumaNode(int Node)
+{
+	const NumaTopology& Topology = GetNumaTopology();
+	if (Topology.ProcessorMasks[Node] == 0)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	GROUP_AFFINITY Affinity = {};
+	Affinity.Mask = (KAFFINITY)Topology.ProcessorMasks[Node];
+	Affinity.Group = Topology.ProcessorGroups[Node];
+	SetThreadGroupAffinity(GetCurrentThread(), &Affinity, nullptr);
+#endif
+}
+
+// Address space for ReserveNumaPages' callers to commit in pieces with CommitNumaPages. Off Windows the
+// whole range is usable at once and pages land on the node of the thread that first touches them.
+inline uint8_t* ReserveNumaPages(size_t Size)
+{
+#if defined(_WIN32)
+	return (uint8_t*)VirtualAlloc(nullptr, Size, MEM_RESERVE, PAGE_READWRITE);
+#else
+	void* Pages = mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return Pages == MAP_FAILED ? nullptr : (uint8_t*)Pages;
+#endif
+}
+
+// Node is an index into GetNumaTopology().Nodes
+inline bool CommitNumaPages(uint8_t* Address, size_t Size, int Node)
+{
+#if defined(_WIN32)
+	return VirtualAllocExNuma(GetCurrentProcess(), Address, Size, MEM_COMMIT, PAGE_READWRITE, GetNumaTopology().Nodes[Node]) != nullptr;
+#else
+	(void)Address;
+	(void)Size;
+	(void)Node;
+	return true;
+#endif
+}
+
+// Size is what was reserved
+inline void ReleaseNumaPages(uint8_t* Address, size_t Size)
+{
+#if defined(_WIN32)
+	(void)Size;
+	VirtualFree(Address, 0, MEM_RELEASE);
+#else
+	munmap(Address, Size);
+#endif
+}
+
+inline void PlatformCreateDirectory(const char* Path)
+{
+#if defined(_WIN32)
+	CreateDirectoryA(Path, nullptr);
+#else
+	mkdir(Path, 0755);
+#endif
+}
+
+// Moves From over To, replacing To if it's there
+inline bool PlatformReplaceFile(const char* From, const char* To)
+{
+#if defined(_WIN32)
+	return MoveFileExA(From, To, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(From, To) == 0;
+#endif
+}
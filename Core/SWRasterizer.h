@@ -0,0 +1,294 @@
+#pragma once
+
+#include "WorkStealingScheduler.h"
+
+// Software rasterizer for the pixel shader copy. The strip is set up in 16.8 fixed point as the hardware
+// does, binned into screen tiles, and the tiles are shaded in parallel on a WorkStealingScheduler.
+// Coverage follows the D3D top-left rule. The pixel shader reads only SV_Position, so nothing is interpolated.
+
+// The divisor PixelShaderCode turns SV_Position into texture coordinates with
+const float PSCopyUVScale = 1024.0f;
+
+// The parts of D3D12_VIEWPORT, D3D12_RECT and D3D12_RASTERIZER_DESC the rasterizer uses
+struct SWViewport
+{
+	float TopLeftX;
+	float TopLeftY;
+	float Width;
+	float Height;
+};
+
+struct SWRect
+{
+	int Left;
+	int Top;
+	int Right;
+	int Bottom;
+};
+
+enum class SWCullMode
+{
+	None,
+	Front,
+	Back,
+};
+
+// Defaults match GetDefaultRasterizerDesc
+struct SWRasterizerState
+{
+	SWCullMode CullMode = SWCullMode::None;
+	bool bFrontCounterClockwise = false;
+};
+
+struct SWShadeState
+{
+	const uint8_t* Texture;		// inputTexture, 4 byte texels
+	int TextureWidth;
+	int TextureHeight;
+	int TexturePitch;
+	uint8_t* RenderTarget;		// Same format as the texture
+	int RenderTargetWidth;
+	int RenderTargetHeight;
+	int RenderTargetPitch;
+};
+
+// Runs the pixel shader for the pixels [X0, X1) of row Y
+typedef void (*SWSpanShader)(const SWShadeState& State, int Y, int X0, int X1);
+
+// Point sampled texel index with wrap addressing, as GetPixelRootSig's static sampler does it
+inline int WrapTexel(float Coord, int Size)
+{
+	float Frac = Coord - floorf(Coord);
+	int Texel = (int)(Frac * (float)Size);
+	return Texel < Size - 1 ? Texel : Size - 1;
+}
+
+// inputTexture.SampleLevel(TexSampler, input.pos.xy / 1024.0, 0). A UNORM texel converts to float
+// and back to a UNORM target of the same format exactly, so the shader copies the texel as is.
+inline void SWShadeSpanScalar(const SWShadeState& State, int Y, int X0, int X1)
+{
+	const float V = ((float)Y + 0.5f) / PSCopyUVScale;
+	const uint32_t* TexRow = (const uint32_t*)(State.Texture + (size_t)WrapTexel(V, State.TextureHeight) * State.TexturePitch);
+	uint32_t* Dst = (uint32_t*)(State.RenderTarget + (size_t)Y * State.RenderTargetPitch);
+	for (int X = X0; X < X1; X++)
+	{
+		Dst[X] = TexRow[WrapTexel(((float)X + 0.5f) / PSCopyUVScale, State.TextureWidth)];
+	}
+}
+
+#if CPU_X86
+// Eight pixels at a time, the same float math as the scalar shader, fetching with a gather
+CPU_TARGET("avx2") inline void SWShadeSpanAVX2(const SWShadeState& State, int Y, int X0, int X1)
+{
+	const float V = ((float)Y + 0.5f) / PSCopyUVScale;
+	const int* TexRow = (const int*)(State.Texture + (size_t)WrapTexel(V, State.TextureHeight) * State.TexturePitch);
+	uint32_t* Dst = (uint32_t*)(State.RenderTarget + (size_t)Y * State.RenderTargetPitch);
+
+	const __m256i LaneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 Half = _mm256_set1_ps(0.5f);
+	const __m256 Scale = _mm256_set1_ps(PSCopyUVScale);
+	const __m256 Size = _mm256_set1_ps((float)State.TextureWidth);
+	const __m256i MaxTexel = _mm256_set1_epi32(State.TextureWidth - 1);
+	for (int X = X0; X < X1; X += 8)
+	{
+		__m256 U = _mm256_div_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(X), LaneIndex)), Half), Scale);
+		__m256 Frac = _mm256_sub_ps(U, _mm256_floor_ps(U));
+		__m256i Texel = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(Frac, Size)), MaxTexel);
+		if (X + 8 <= X1)
+		{
+			_mm256_storeu_si256((__m256i*)(Dst + X), _mm256_i32gather_epi32(TexRow, Texel, 4));
+		}
+		else
+		{
+			const __m256i Mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(X1 - X), LaneIndex);
+			const __m256i Color = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), TexRow, Texel, Mask, 4);
+			_mm256_maskstore_epi32((int*)(Dst + X), Mask, Color);
+		}
+	}
+}
+#endif
+
+// 0 = scalar, 2 = AVX2. SSE2 and NEON have no gather, so below AVX2 the scalar shader is used.
+inline SWSpanShader SelectSWSpanShader(int MaxSimdLevel = 2)
+{
+#if CPU_X86
+	if (MaxSimdLevel >= 2 && GetCPUFeatures().AVX2)
+	{
+		return SWShadeSpanAVX2;
+	}
+#endif
+	return SWShadeSpanScalar;
+}
+
+// Rounds towards negative infinity, B > 0
+inline int64_t FloorDiv(int64_t A, int64_t B)
+{
+	return A >= 0 ? A / B : -((-A + B - 1) / B);
+}
+
+struct SWTriangle
+{
+	int64_t X[3];	// 16.8 fixed point screen position, wound clockwise
+	int64_t Y[3];
+	int MinX;		// Pixel bounds clipped to the viewport and scissor rect, max exclusive
+	int MinY;
+	int MaxX;
+	int MaxY;
+};
+
+struct SWRasterizer
+{
+	static const int TileSize = 64;
+
+	WorkStealingScheduler* Scheduler = nullptr;
+	SWSpanShader Shader = SWShadeSpanScalar;
+	SWRasterizerState RasterizerState;
+
+	// The current draw
+	std::vector<SWTriangle> Triangles;
+	std::vector<std::vector<uint32_t>> Bins;	// Triangle indices per tile, in primitive order
+	int TilesX = 0;
+	int TilesY = 0;
+	SWShadeState State = {};
+
+	// Draws a triangle strip of clip space float4 positions, which VSMain passes through unchanged
+	void DrawTriangleStrip(const float* Positions, int VertexCount, const SWViewport& Viewport, const SWRect& Scissor, const SWShadeState& InState)
+	{
+		State = InState;
+		TilesX = (State.RenderTargetWidth + TileSize - 1) / TileSize;
+		TilesY = (State.RenderTargetHeight + TileSize - 1) / TileSize;
+		Bins.resize((size_t)TilesX * TilesY);
+		for (std::vector<uint32_t>& Bin : Bins)
+		{
+			Bin.clear();
+		}
+		Triangles.clear();
+
+		// Pixels outside the viewport are clipped as well as those outside the scissor rect
+		const int ClipMinX = std::max<int>({ 0, Scissor.Left, (int)ceilf(Viewport.TopLeftX) });
+		const int ClipMinY = std::max<int>({ 0, Scissor.Top, (int)ceilf(Viewport.TopLeftY) });
+		const int ClipMaxX = std::min<int>({ State.RenderTargetWidth, Scissor.Right, (int)floorf(Viewport.TopLeftX + Viewport.Width) });
+		const int ClipMaxY = std::min<int>({ State.RenderTargetHeight, Scissor.Bottom, (int)floorf(Viewport.TopLeftY + Viewport.Height) });
+
+		for (int i = 0; i + 2 < VertexCount; i++)
+		{
+			// Odd triangles of a strip swap their first two vertices to keep the winding
+			const int Index[3] = { (i & 1) ? i + 1 : i, (i & 1) ? i : i + 1, i + 2 };
+
+			SWTriangle Tri = {};
+			for (int v = 0; v < 3; v++)
+			{
+				const float* Pos = Positions + Index[v] * 4;
+				ASSERT(Pos[3] > 0.0f);	// No clipping against the near plane
+				const double ScreenX = Viewport.TopLeftX + (Pos[0] / Pos[3] + 1.0) * 0.5 * Viewport.Width;
+				const double ScreenY = Viewport.TopLeftY + (1.0 - Pos[1] / Pos[3]) * 0.5 * Viewport.Height;
+				Tri.X[v] = (int64_t)floor(ScreenX * 256.0 + 0.5);
+				Tri.Y[v] = (int64_t)floor(ScreenY * 256.0 + 0.5);
+			}
+
+			// Positive area is clockwise on screen, since y points down
+			const int64_t Area = (Tri.X[1] - Tri.X[0]) * (Tri.Y[2] - Tri.Y[0]) - (Tri.Y[1] - Tri.Y[0]) * (Tri.X[2] - Tri.X[0]);
+			if (Area == 0)
+			{
+				continue;
+			}
+			const bool bClockwise = Area > 0;
+			const bool bFrontFacing = RasterizerState.bFrontCounterClockwise ? !bClockwise : bClockwise;
+			if ((RasterizerState.CullMode == SWCullMode::Back && !bFrontFacing) || (RasterizerState.CullMode == SWCullMode::Front && bFrontFacing))
+			{
+				continue;
+			}
+			if (!bClockwise)
+			{
+				std::swap(Tri.X[1], Tri.X[2]);
+				std::swap(Tri.Y[1], Tri.Y[2]);
+			}
+
+			// Pixels whose centers fall inside the bounding box
+			const int64_t MinX = std::min({ Tri.X[0], Tri.X[1], Tri.X[2] });
+			const int64_t MinY = std::min({ Tri.Y[0], Tri.Y[1], Tri.Y[2] });
+			const int64_t MaxX = std::max({ Tri.X[0], Tri.X[1], Tri.X[2] });
+			const int64_t MaxY = std::max({ Tri.Y[0], Tri.Y[1], Tri.Y[2] });
+			Tri.MinX = (int)std::max<int64_t>(ClipMinX, FloorDiv(MinX - 128 + 255, 256));
+			Tri.MinY = (int)std::max<int64_t>(ClipMinY, FloorDiv(MinY - 128 + 255, 256));
+			Tri.MaxX = (int)std::min<int64_t>(ClipMaxX, FloorDiv(MaxX - 128, 256) + 1);
+			Tri.MaxY = (int)std::min<int64_t>(ClipMaxY, FloorDiv(MaxY - 128, 256) + 1);
+			if (Tri.MinX >= Tri.MaxX || Tri.MinY >= Tri.MaxY)
+			{
+				continue;
+			}
+
+			const uint32_t TriIndex = (uint32_t)Triangles.size();
+			Triangles.push_back(Tri);
+			for (int ty = Tri.MinY / TileSize; ty <= (Tri.MaxY - 1) / TileSize; ty++)
+			{
+				for (int tx = Tri.MinX / TileSize; tx <= (Tri.MaxX - 1) / TileSize; tx++)
+				{
+					Bins[(size_t)ty * TilesX + tx].push_back(TriIndex);
+				}
+			}
+		}
+
+		Scheduler->Run((uint32_t)Bins.size(), 1, ShadeTiles, this);
+	}
+
+private:
+	// Narrows [X0, X1) on row Y to the pixels inside the triangle. For each clockwise edge the edge function
+	// E(x) = dx * (py - y0) - dy * (px - x0) is positive inside; pixels exactly on a top or left edge are in.
+	static void ClipSpanToTriangle(const SWTriangle& Tri, int Y, int& X0, int& X1)
+	{
+		const int64_t PixelY = (int64_t)Y * 256 + 128;
+		for (int e = 0; e < 3 && X0 < X1; e++)
+		{
+			const int n = e == 2 ? 0 : e + 1;
+			const int64_t dx = Tri.X[n] - Tri.X[e];
+			const int64_t dy = Tri.Y[n] - Tri.Y[e];
+			const bool bTopLeft = dy < 0 || (dy == 0 && dx > 0);
+			const int64_t Threshold = bTopLeft ? 0 : 1;
+
+			// E(x) = K - dy * 256 * x for the pixel center of column x
+			const int64_t K = dx * (PixelY - Tri.Y[e]) - dy * (128 - Tri.X[e]);
+			if (dy == 0)
+			{
+				if (K < Threshold)
+				{
+					X1 = X0;
+				}
+			}
+			else if (dy > 0)
+			{
+				X1 = (int)std::min<int64_t>(X1, FloorDiv(K - Threshold, dy * 256) + 1);
+			}
+			else
+			{
+				X0 = (int)std::max<int64_t>(X0, -FloorDiv(K - Threshold, -dy * 256));
+			}
+		}
+	}
+
+	static void ShadeTiles(void* Context, uint32_t Begin, uint32_t End)
+	{
+		const SWRasterizer& Raster = *(const SWRasterizer*)Context;
+		for (uint32_t Tile = Begin; Tile < End; Tile++)
+		{
+			const int TileX0 = (int)(Tile % Raster.TilesX) * TileSize;
+			const int TileY0 = (int)(Tile / Raster.TilesX) * TileSize;
+			for (uint32_t TriIndex : Raster.Bins[Tile])
+			{
+				const SWTriangle& Tri = Raster.Triangles[TriIndex];
+				const int RowBegin = std::max(TileY0, Tri.MinY);
+				const int RowEnd = std::min(TileY0 + TileSize, Tri.MaxY);
+				for (int Y = RowBegin; Y < RowEnd; Y++)
+				{
+					int X0 = std::max(TileX0, Tri.MinX);
+					int X1 = std::min(TileX0 + TileSize, Tri.MaxX);
+					ClipSpanToTriangle(Tri, Y, X0, X1);
+					if (X0 < X1)
+					{
+						Raster.Shader(Raster.State, Y, X0, X1);
+					}
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Platform.h"
+
+// What the software device writes for a view: enough to tell views apart and to check copies
+struct SoftwareDescriptor
+{
+	uint64_t Resource;
+	uint32_t Kind;
+	uint32_t Format;
+	uint32_t Dimension;
+	uint32_t Mip;
+	uint32_t Plane;
+	uint32_t Reserved;
+};
+
+// ID3D12Device::CopyDescriptors on host memory: walks both range lists together, copying the overlap of the
+// current pair each step. HandleType is anything with a ptr holding an address, such as
+// D3D12_CPU_DESCRIPTOR_HANDLE. Null sizes mean ranges of one descriptor.
+template <typename HandleType>
+void CopySoftwareDescriptorRanges(uint32_t NumDstRanges, const HandleType* DstStarts, const uint32_t* DstSizes,
+	uint32_t NumSrcRanges, const HandleType* SrcStarts, const uint32_t* SrcSizes, size_t DescriptorSize)
+{
+	uint32_t DstRange = 0, SrcRange = 0, DstOffset = 0, SrcOffset = 0;
+	while (DstRange < NumDstRanges && SrcRange < NumSrcRanges)
+	{
+		const uint32_t DstSize = DstSizes ? DstSizes[DstRange] : 1;
+		const uint32_t SrcSize = SrcSizes ? SrcSizes[SrcRange] : 1;
+		const uint32_t Count = std::min(DstSize - DstOffset, SrcSize - SrcOffset);
+		memcpy((uint8_t*)DstStarts[DstRange].ptr + (size_t)DstOffset * DescriptorSize,
+			(const uint8_t*)SrcStarts[SrcRange].ptr + (size_t)SrcOffset * DescriptorSize, (size_t)Count * DescriptorSize);
+
+		DstOffset += Count;
+		SrcOffset += Count;
+		if (DstOffset == DstSize)
+		{
+			DstRange++;
+			DstOffset = 0;
+		}
+		if (SrcOffset == SrcSize)
+		{
+			SrcRange++;
+			SrcOffset = 0;
+		}
+	}
+}
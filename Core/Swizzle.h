@@ -0,0 +1,306 @@
+#pragma once
+
+#include "Platform.h"
+
+// Tiled texture layouts for 4 byte texels. Within a tile, a texel's byte offset has the bits of its x
+// deposited into XMask and those of its y into YMask; tiles are stored row-major.
+struct SwizzleLayout
+{
+	const char* Name;
+	int TileWidth;
+	int TileHeight;
+	uint32_t XMask;
+	uint32_t YMask;
+};
+
+// D3D12_TEXTURE_LAYOUT_64KB_STANDARD_SWIZZLE at 32 bpp: 128 x 128 texel tiles of 64 byte blocks that are 4 rows of
+// 4 texels, so the low bits are x0 x1 y0 y1, and above them the remaining x and y bits interleave x first
+const SwizzleLayout StandardSwizzle64KB = { "64KB standard", 128, 128, 0x554c, 0xaab0 };
+
+// Byte offsets of texels in the first tile of a 64KB standard swizzle texture, worked out by hand from the
+// D3D12 layout rather than from the masks, to check them against
+struct SwizzleKnownOffset
+{
+	int X;
+	int Y;
+	uint32_t Offset;
+};
+
+const SwizzleKnownOffset StandardSwizzle64KBKnownOffsets[] =
+{
+	{ 1, 0, 4 }, { 3, 0, 12 }, { 0, 1, 16 }, { 0, 3, 48 }, { 4, 0, 64 }, { 0, 4, 128 },
+	{ 8, 0, 256 }, { 0, 8, 512 }, { 5, 6, 228 }, { 127, 127, 65532 },
+};
+
+// Layouts like the undefined swizzles drivers choose: small Morton tiles of the same 4 x 4 blocks, and big
+// tiles of plain rows
+const SwizzleLayout MortonSwizzle4KB = { "4KB morton", 32, 32, 0x054c, 0x0ab0 };
+const SwizzleLayout RowTiled64KB = { "64KB rows", 128, 128, 0x01fc, 0xfe00 };
+
+// The low bits of Value moved to the set bits of Mask, in order
+inline uint32_t DepositBits(uint32_t Value, uint32_t Mask)
+{
+	uint32_t Result = 0;
+	for (uint32_t Bit = 1; Mask != 0; Bit <<= 1)
+	{
+		const uint32_t Lowest = Mask & (0 - Mask);
+		Result |= (Value & Bit) ? Lowest : 0;
+		Mask &= Mask - 1;
+	}
+	return Result;
+}
+
+// The bits of Value under Mask packed into the low bits, the inverse of DepositBits
+inline uint32_t ExtractBits(uint32_t Value, uint32_t Mask)
+{
+	uint32_t Result = 0;
+	for (uint32_t Bit = 1; Mask != 0; Bit <<= 1)
+	{
+		const uint32_t Lowest = Mask & (0 - Mask);
+		Result |= (Value & Lowest) ? Bit : 0;
+		Mask &= Mask - 1;
+	}
+	return Result;
+}
+
+inline size_t GetSwizzledSize(const SwizzleLayout& Layout, int Width, int Height)
+{
+	const size_t TilesX = (Width + Layout.TileWidth - 1) / Layout.TileWidth;
+	const size_t TilesY = (Height + Layout.TileHeight - 1) / Layout.TileHeight;
+	return TilesX * TilesY * Layout.TileWidth * Layout.TileHeight * 4;
+}
+
+inline size_t GetSwizzledTexelOffset(const SwizzleLayout& Layout, int Width, int X, int Y)
+{
+	const size_t TilesX = (Width + Layout.TileWidth - 1) / Layout.TileWidth;
+	const size_t Tile = (size_t)(Y / Layout.TileHeight) * TilesX + X / Layout.TileWidth;
+	return Tile * Layout.TileWidth * Layout.TileHeight * 4 + (DepositBits(X % Layout.TileWidth, Layout.XMask) | DepositBits(Y % Layout.TileHeight, Layout.YMask));
+}
+
+// Converts 4 rows of Count texels (a multiple of 4) of one tile, where XOffsets[i] is the tile offset of
+// texel column i and a 4 x 4 block is 64 contiguous bytes holding its rows in order, as in both Morton layouts
+typedef void (*SwizzleBandFunc)(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count);
+
+// Linear to tiled: row r of a block's 4 texels lands at byte r * 16 of the block
+inline void SwizzleBandScalar(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		uint8_t* Dst = Tile + XOffsets[x];
+		for (int Row = 0; Row < 4; Row++)
+		{
+			memcpy(Dst + Row * 16, Linear + (size_t)Row * Pitch + x * 4, 16);
+		}
+	}
+}
+
+inline void UnswizzleBandScalar(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		const uint8_t* Src = Tile + XOffsets[x];
+		for (int Row = 0; Row < 4; Row++)
+		{
+			memcpy(Linear + (size_t)Row * Pitch + x * 4, Src + Row * 16, 16);
+		}
+	}
+}
+
+#if CPU_X86
+inline void SwizzleBandSSE2(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		const uint8_t* Src = Linear + x * 4;
+		const __m128i R0 = _mm_loadu_si128((const __m128i*)Src);
+		const __m128i R1 = _mm_loadu_si128((const __m128i*)(Src + Pitch));
+		const __m128i R2 = _mm_loadu_si128((const __m128i*)(Src + 2 * Pitch));
+		const __m128i R3 = _mm_loadu_si128((const __m128i*)(Src + 3 * Pitch));
+		__m128i* Dst = (__m128i*)(Tile + XOffsets[x]);
+		_mm_storeu_si128(Dst + 0, R0);
+		_mm_storeu_si128(Dst + 1, R1);
+		_mm_storeu_si128(Dst + 2, R2);
+		_mm_storeu_si128(Dst + 3, R3);
+	}
+}
+
+inline void UnswizzleBandSSE2(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		const __m128i* Src = (const __m128i*)(Tile + XOffsets[x]);
+		const __m128i R0 = _mm_loadu_si128(Src + 0);
+		const __m128i R1 = _mm_loadu_si128(Src + 1);
+		const __m128i R2 = _mm_loadu_si128(Src + 2);
+		const __m128i R3 = _mm_loadu_si128(Src + 3);
+		uint8_t* Dst = Linear + x * 4;
+		_mm_storeu_si128((__m128i*)Dst, R0);
+		_mm_storeu_si128((__m128i*)(Dst + Pitch), R1);
+		_mm_storeu_si128((__m128i*)(Dst + 2 * Pitch), R2);
+		_mm_storeu_si128((__m128i*)(Dst + 3 * Pitch), R3);
+	}
+}
+
+// Two blocks per step: 8 texels of each row, the low 128 bit lane in the first block and the high in the second
+CPU_TARGET("avx2") inline void SwizzleBandAVX2(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	int x = 0;
+	for (; x + 8 <= Count; x += 8)
+	{
+		const uint8_t* Src = Linear + x * 4;
+		const __m256i R0 = _mm256_loadu_si256((const __m256i*)Src);
+		const __m256i R1 = _mm256_loadu_si256((const __m256i*)(Src + Pitch));
+		const __m256i R2 = _mm256_loadu_si256((const __m256i*)(Src + 2 * Pitch));
+		const __m256i R3 = _mm256_loadu_si256((const __m256i*)(Src + 3 * Pitch));
+		__m256i* Block0 = (__m256i*)(Tile + XOffsets[x]);
+		__m256i* Block1 = (__m256i*)(Tile + XOffsets[x + 4]);
+		_mm256_storeu_si256(Block0 + 0, _mm256_permute2x128_si256(R0, R1, 0x20));
+		_mm256_storeu_si256(Block0 + 1, _mm256_permute2x128_si256(R2, R3, 0x20));
+		_mm256_storeu_si256(Block1 + 0, _mm256_permute2x128_si256(R0, R1, 0x31));
+		_mm256_storeu_si256(Block1 + 1, _mm256_permute2x128_si256(R2, R3, 0x31));
+	}
+	SwizzleBandSSE2(Linear + x * 4, Pitch, Tile, XOffsets + x, Count - x);
+}
+
+CPU_TARGET("avx2") inline void UnswizzleBandAVX2(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	int x = 0;
+	for (; x + 8 <= Count; x += 8)
+	{
+		const __m256i* Block0 = (const __m256i*)(Tile + XOffsets[x]);
+		const __m256i* Block1 = (const __m256i*)(Tile + XOffsets[x + 4]);
+		const __m256i A0 = _mm256_loadu_si256(Block0 + 0);
+		const __m256i A1 = _mm256_loadu_si256(Block0 + 1);
+		const __m256i B0 = _mm256_loadu_si256(Block1 + 0);
+		const __m256i B1 = _mm256_loadu_si256(Block1 + 1);
+		uint8_t* Dst = Linear + x * 4;
+		_mm256_storeu_si256((__m256i*)Dst, _mm256_permute2x128_si256(A0, B0, 0x20));
+		_mm256_storeu_si256((__m256i*)(Dst + Pitch), _mm256_permute2x128_si256(A0, B0, 0x31));
+		_mm256_storeu_si256((__m256i*)(Dst + 2 * Pitch), _mm256_permute2x128_si256(A1, B1, 0x20));
+		_mm256_storeu_si256((__m256i*)(Dst + 3 * Pitch), _mm256_permute2x128_si256(A1, B1, 0x31));
+	}
+	UnswizzleBandSSE2(Linear + x * 4, Pitch, Tile, XOffsets + x, Count - x);
+}
+#endif
+
+#if CPU_ARM64
+inline void SwizzleBandNeon(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		const uint8_t* Src = Linear + x * 4;
+		uint8_t* Dst = Tile + XOffsets[x];
+		vst1q_u8(Dst + 0, vld1q_u8(Src));
+		vst1q_u8(Dst + 16, vld1q_u8(Src + Pitch));
+		vst1q_u8(Dst + 32, vld1q_u8(Src + 2 * Pitch));
+		vst1q_u8(Dst + 48, vld1q_u8(Src + 3 * Pitch));
+	}
+}
+
+inline void UnswizzleBandNeon(uint8_t* Linear, int Pitch, uint8_t* Tile, const uint32_t* XOffsets, int Count)
+{
+	for (int x = 0; x < Count; x += 4)
+	{
+		const uint8_t* Src = Tile + XOffsets[x];
+		uint8_t* Dst = Linear + x * 4;
+		vst1q_u8(Dst, vld1q_u8(Src + 0));
+		vst1q_u8(Dst + Pitch, vld1q_u8(Src + 16));
+		vst1q_u8(Dst + 2 * Pitch, vld1q_u8(Src + 32));
+		vst1q_u8(Dst + 3 * Pitch, vld1q_u8(Src + 48));
+	}
+}
+#endif
+
+// 0 = scalar, 1 = SSE2 or NEON, 2 = also AVX2
+inline void SelectSwizzleBandFuncs(int MaxSimdLevel, SwizzleBandFunc& Swizzle, SwizzleBandFunc& Unswizzle)
+{
+	Swizzle = SwizzleBandScalar;
+	Unswizzle = UnswizzleBandScalar;
+#if CPU_X86
+	if (MaxSimdLevel >= 2 && GetCPUFeatures().AVX2)
+	{
+		Swizzle = SwizzleBandAVX2;
+		Unswizzle = UnswizzleBandAVX2;
+	}
+	else if (MaxSimdLevel >= 1)
+	{
+		Swizzle = SwizzleBandSSE2;
+		Unswizzle = UnswizzleBandSSE2;
+	}
+#elif CPU_ARM64
+	if (MaxSimdLevel >= 1)
+	{
+		Swizzle = SwizzleBandNeon;
+		Unswizzle = UnswizzleBandNeon;
+	}
+#endif
+}
+
+// Converts between a linear texture and Layout, either way. Morton layouts go through the band functions
+// in 4 x 4 blocks, row tiled layouts copy whole tile rows, and the texels left over at the right and
+// bottom edges go one at a time. Tiled padding past the texture edges is left as it is.
+inline void ConvertSwizzle(const SwizzleLayout& Layout, uint8_t* Linear, int Pitch, int Width, int Height, uint8_t* Tiled, bool bToTiled, int MaxSimdLevel = 2)
+{
+	SwizzleBandFunc Swizzle = nullptr, Unswizzle = nullptr;
+	SelectSwizzleBandFuncs(MaxSimdLevel, Swizzle, Unswizzle);
+	const SwizzleBandFunc Band = bToTiled ? Swizzle : Unswizzle;
+
+	std::vector<uint32_t> XOffsets(Layout.TileWidth), YOffsets(Layout.TileHeight);
+	for (int i = 0; i < Layout.TileWidth; i++)
+	{
+		XOffsets[i] = DepositBits(i, Layout.XMask);
+	}
+	for (int i = 0; i < Layout.TileHeight; i++)
+	{
+		YOffsets[i] = DepositBits(i, Layout.YMask);
+	}
+	const bool bMortonBlocks = Layout.TileWidth >= 4 && Layout.TileHeight >= 4 && (Layout.XMask & 0x3c) == 0x0c && (Layout.YMask & 0x3c) == 0x30;
+	const bool bLinearRows = Layout.XMask == (uint32_t)(Layout.TileWidth - 1) << 2;
+
+	const size_t TileBytes = (size_t)Layout.TileWidth * Layout.TileHeight * 4;
+	const int TilesX = (Width + Layout.TileWidth - 1) / Layout.TileWidth;
+	for (int TileY = 0; TileY * Layout.TileHeight < Height; TileY++)
+	{
+		for (int TileX = 0; TileX < TilesX; TileX++)
+		{
+			uint8_t* Tile = Tiled + ((size_t)TileY * TilesX + TileX) * TileBytes;
+			const int X0 = TileX * Layout.TileWidth;
+			const int Y0 = TileY * Layout.TileHeight;
+			const int Columns = std::min(Layout.TileWidth, Width - X0);
+			const int Rows = std::min(Layout.TileHeight, Height - Y0);
+
+			int BulkColumns = 0, BulkRows = 0;
+			if (MaxSimdLevel > 0 && bLinearRows)
+			{
+				BulkColumns = Columns;
+				BulkRows = Rows;
+				for (int y = 0; y < Rows; y++)
+				{
+					uint8_t* Row = Linear + (size_t)(Y0 + y) * Pitch + (size_t)X0 * 4;
+					uint8_t* TileRow = Tile + YOffsets[y];
+					memcpy(bToTiled ? TileRow : Row, bToTiled ? Row : TileRow, (size_t)Columns * 4);
+				}
+			}
+			else if (bMortonBlocks)
+			{
+				BulkColumns = Columns & ~3;
+				BulkRows = Rows & ~3;
+				for (int y = 0; y < BulkRows && BulkColumns > 0; y += 4)
+				{
+					Band(Linear + (size_t)(Y0 + y) * Pitch + (size_t)X0 * 4, Pitch, Tile + YOffsets[y], XOffsets.data(), BulkColumns);
+				}
+			}
+
+			// The ragged right and bottom edges
+			for (int y = 0; y < Rows; y++)
+			{
+				for (int x = y < BulkRows ? BulkColumns : 0; x < Columns; x++)
+				{
+					uint8_t* Texel = Linear + (size_t)(Y0 + y) * Pitch + (size_t)(X0 + x) * 4;
+					uint8_t* TileTexel = Tile + (XOffsets[x] | YOffsets[y]);
+					memcpy(bToTiled ? TileTexel : Texel, bToTiled ? Texel : TileTexel, 4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Platform.h"
+
+// RGBA8 frame for the encoder benchmarks and their tests: smooth gradients plus a little noise, so the PNG
+// filters and the JPEG transform have something to predict. The noise comes from Seed, so the frame is
+// the same on every platform.
+inline std::vector<uint8_t> MakeSyntheticImage(int Width, int Height, uint32_t Seed = 1)
+{
+	std::vector<uint8_t> Pixels((size_t)Width * Height * 4);
+	uint32_t State = Seed | 1;
+	for (int y = 0; y < Height; y++)
+	{
+		for (int x = 0; x < Width; x++)
+		{
+			uint8_t* Pixel = &Pixels[((size_t)y * Width + x) * 4];
+			Pixel[0] = (uint8_t)(x / 16 + NextXorShift32(State) % 4);
+			Pixel[1] = (uint8_t)(y / 8 + NextXorShift32(State) % 4);
+			Pixel[2] = (uint8_t)((x + y) / 32);
+			Pixel[3] = 255;
+		}
+	}
+	return Pixels;
+}
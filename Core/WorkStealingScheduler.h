@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Platform.h"
+
+// Work-stealing thread pool for running index ranges. Each worker owns a deque of ranges: it keeps
+// splitting its newest range in half until it is down to the grain size, leaving the other halves
+// on its deque, and runs from the back (small, recently split, cache-warm ranges). A worker that runs
+// dry steals from the front of another worker's deque, where the biggest ranges are.
+struct WorkStealingScheduler
+{
+	typedef void (*RangeFunc)(void* Context, uint32_t Begin, uint32_t End);
+
+	struct Range
+	{
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex Mutex;
+		std::deque<Range> Ranges;
+	};
+
+	std::vector<std::thread> Workers;
+	std::unique_ptr<WorkerQueue[]> Queues;
+
+	std::mutex Mutex;
+	std::condition_variable WorkAvailable;
+	std::condition_variable WorkDone;
+	uint64_t Generation = 0;
+	bool ShuttingDown = false;
+	int BusyWorkers = 0;
+
+	// The current job
+	RangeFunc Func = nullptr;
+	void* Context = nullptr;
+	uint32_t Grain = 1;
+	std::atomic<uint32_t> Remaining;
+	std::atomic<uint32_t> StealCount;
+
+	// Workers are pinned round robin to the NUMA nodes, like the copy engine's
+	void Start(int NumThreads)
+	{
+		Queues.reset(new WorkerQueue[NumThreads]);
+		for (int i = 0; i < NumThreads; i++)
+		{
+			Workers.emplace_back([this, i]() { WorkerLoop(i); });
+		}
+	}
+
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			ShuttingDown = true;
+		}
+		WorkAvailable.notify_all();
+		for (std::thread& Worker : Workers)
+		{
+			Worker.join();
+		}
+		Workers.clear();
+	}
+
+	// Calls InFunc over [0, Count) in ranges of at most InGrain indices, and returns once all have run
+	void Run(uint32_t Count, uint32_t InGrain, RangeFunc InFunc, void* InContext)
+	{
+		if (Count == 0)
+		{
+			return;
+		}
+		if (Workers.empty())
+		{
+			InFunc(InContext, 0, Count);
+			return;
+		}
+
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Func = InFunc;
+		Context = InContext;
+		Grain = InGrain > 0 ? InGrain : 1;
+		Remaining = Count;
+		StealCount = 0;
+
+		// Seed every worker with an equal share; stealing evens out whatever imbalance is left
+		const uint32_t NumWorkers = (uint32_t)Workers.size();
+		for (uint32_t i = 0; i < NumWorkers; i++)
+		{
+			uint32_t Begin = (uint32_t)((uint64_t)Count * i / NumWorkers);
+			uint32_t End = (uint32_t)((uint64_t)Count * (i + 1) / NumWorkers);
+			if (End > Begin)
+			{
+				std::lock_guard<std::mutex> QueueLock(Queues[i].Mutex);
+				Queues[i].Ranges.push_back({ Begin, End });
+			}
+		}
+
+		BusyWorkers = (int)NumWorkers;
+		Generation++;
+		WorkAvailable.notify_all();
+		WorkDone.wait(Lock, [&]() { return BusyWorkers == 0; });
+	}
+
+private:
+	bool PopOwn(int Worker, Range& Out)
+	{
+		std::lock_guard<std::mutex> Lock(Queues[Worker].Mutex);
+		if (Queues[Worker].Ranges.empty())
+		{
+			return false;
+		}
+		Out = Queues[Worker].Ranges.back();
+		Queues[Worker].Ranges.pop_back();
+		return true;
+	}
+
+	bool Steal(int Thief, uint32_t& RandomState, Range& Out)
+	{
+		const int NumWorkers = (int)Workers.size();
+		const int FirstVictim = (int)(NextXorShift32(RandomState) % (uint32_t)NumWorkers);
+		for (int i = 0; i < NumWorkers; i++)
+		{
+			int Victim = (FirstVictim + i) % NumWorkers;
+			if (Victim == Thief)
+			{
+				continue;
+			}
+			std::lock_guard<std::mutex> Lock(Queues[Victim].Mutex);
+			if (!Queues[Victim].Ranges.empty())
+			{
+				Out = Queues[Victim].Ranges.front();
+				Queues[Victim].Ranges.pop_front();
+				StealCount++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerLoop(int Worker)
+	{
+		PinCurrentThreadToNumaNode(Worker % (int)GetNumaTopology().Nodes.size());
+
+		uint32_t RandomState = 0x9e3779b9u * (Worker + 1);
+		uint64_t SeenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				WorkAvailable.wait(Lock, [&]() { return ShuttingDown || Generation != SeenGeneration; });
+				if (ShuttingDown)
+				{
+					return;
+				}
+				SeenGeneration = Generation;
+			}
+
+			while (Remaining > 0)
+			{
+				Range R;
+				if (!PopOwn(Worker, R) && !Steal(Worker, RandomState, R))
+				{
+					// Everything left is already running on other workers
+					std::this_thread::yield();
+					continue;
+				}
+
+				while (R.End - R.Begin > Grain)
+				{
+					uint32_t Mid = R.Begin + (R.End - R.Begin) / 2;
+					std::lock_guard<std::mutex> Lock(Queues[Worker].Mutex);
+					Queues[Worker].Ranges.push_back({ Mid, R.End });
+					R.End = Mid;
+				}
+
+				Func(Context, R.Begin, R.End);
+				Remaining -= R.End - R.Begin;
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				BusyWorkers--;
+			}
+			WorkDone.notify_one();
+		}
+	}
+};
+
+// The pool behind ParallelFor, one worker per core, started on its first call and shut down at exit
+struct ParallelForPool
+{
+	WorkStealingScheduler Scheduler;
+	std::mutex RunMutex;
+	std::once_flag Started;
+
+	~ParallelForPool()
+	{
+		Scheduler.Shutdown();
+	}
+};
+
+// Calls Func(Context, i) for every i in [0, Count), spread across all cores. The pool runs one call at a
+// time, so a call made while it's busy, from inside Func on one of its workers or from another thread,
+// runs inline on the caller instead of waiting or adding threads.
+inline void ParallelFor(int Count, void (*Func)(void*, int), void* Context)
+{
+	static ParallelForPool Pool;
+	std::call_once(Pool.Started, []() { Pool.Scheduler.Start(GetMaxThreads()); });
+
+	std::unique_lock<std::mutex> Lock(Pool.RunMutex, std::try_to_lock);
+	if (Count <= 1 || !Lock.owns_lock())
+	{
+		for (int i = 0; i < Count; i++)
+		{
+			Func(Context, i);
+		}
+		return;
+	}
+
+	struct ForContext
+	{
+		void (*Func)(void*, int);
+		void* Context;
+	};
+	ForContext For = { Func, Context };
+	Pool.Scheduler.Run((uint32_t)Count, 1, [](void* Ctx, uint32_t Begin, uint32_t End)
+	{
+		const ForContext& For = *(const ForContext*)Ctx;
+		for (uint32_t i = Begin; i < End; i++)
+		{
+			For.Func(For.Context, (int)i);
+		}
+	}, &For);
+}
@@ -7,6 +7,28 @@
 #include <thread>
 #include <limits>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+
+#include "Core/Platform.h"
+#include "Core/BuddyAllocator.h"
+#include "Core/CacheFiles.h"
+#include "Core/CacheSim.h"
+#include "Core/Checksums.h"
+#include "Core/CPUCopyEngine.h"
+#include "Core/CSEmulator.h"
+#include "Core/PixelConversion.h"
+#include "Core/SWRasterizer.h"
+#include "Core/SyntheticImage.h"
+#include "Core/SoftwareDescriptors.h"
+#include "Core/Swizzle.h"
 
 #include <Windows.h>
 
@@ -18,6 +40,9 @@
 
 #include <dxgi1_2.h>
 
+#define STBIW_PARALLEL_FOR(count, func, context) ParallelFor(count, func, context)
+#define STBIW_CRC32(buffer, len) Crc32(buffer, len)
+#define STBIW_ADLER32(data, len) Adler32(data, len)
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
@@ -118,10 +143,6 @@ struct CD3DX12_RESOURCE_DESC : public D3D12_RESOURCE_DESC
 };
 
 
-typedef int32_t int32;
-
-#define ASSERT assert
-
 
 #pragma comment(lib, "DXGI.lib")
 #pragma comment(lib, "D3D12.lib")
@@ -189,6 +210,141 @@ const char* ComputeShaderCode16x16 =
 "}\n"
 ;
 
+// The 8x8 copy with its textures picked out of the whole heap by index, from root constants, so each copy
+// only sets its two indices. SM 6.6 indexes ResourceDescriptorHeap directly, which only the DXIL table has:
+// FXC can't compile it. Dispatch(Width / 8, Height / 8).
+const char* ComputeShaderCodeDescriptorHeap =
+"cbuffer CopyIndices : register(b0) { uint SrcIndex; uint DstIndex; };\n"
+"[numthreads(8, 8, 1)]\n"
+"void CSMain(uint3 tid : SV_DispatchThreadID) {\n"
+"    Texture2D<float4> InTexture = ResourceDescriptorHeap[SrcIndex];\n"
+"    RWTexture2D<float4> OutTexture = ResourceDescriptorHeap[DstIndex];\n"
+"    OutTexture[tid.xy] = InTexture[tid.xy];\n"
+"}\n"
+;
+
+// The fallback for ComputeShaderCodeDescriptorHeap without SM 6.6 or the DXIL table: SM 5.1 descriptor
+// indexing into the heap, bound as two unbounded tables once per command list. The per-copy bind is the
+// same two root constants.
+const char* ComputeShaderCodeBindless =
+"Texture2D<float4> Textures[] : register(t0, space1);\n"
+"RWTexture2D<float4> RWTextures[] : register(u0, space2);\n"
+"cbuffer CopyIndices : register(b0) { uint SrcIndex; uint DstIndex; };\n"
+"[numthreads(8, 8, 1)]\n"
+"void CSMain(uint3 tid : SV_DispatchThreadID) {\n"
+"    RWTextures[DstIndex][tid.xy] = Textures[SrcIndex][tid.xy];\n"
+"}\n"
+;
+
+// A buffer copy, 16 bytes a thread. Raw buffers can be bound as root descriptors, which textures can't.
+const char* ComputeShaderCodeBufferCopy =
+"ByteAddressBuffer InBuffer : register(t0);\n"
+"RWByteAddressBuffer OutBuffer : register(u0);\n"
+"[numthreads(64, 1, 1)]\n"
+"void CSMain(uint3 tid : SV_DispatchThreadID) {\n"
+"    OutBuffer.Store4(tid.x * 16, InBuffer.Load4(tid.x * 16));\n"
+"}\n"
+;
+
+// Each thread also copies 4 uint4s, the group's 64 threads covering 4 consecutive 1KB spans, so each load
+// instruction still reads a contiguous 1KB across the group
+const char* ComputeShaderCodeBufferCopyWide =
+"ByteAddressBuffer InBuffer : register(t0);\n"
+"RWByteAddressBuffer OutBuffer : register(u0);\n"
+"[numthreads(64, 1, 1)]\n"
+"void CSMain(uint3 gid : SV_GroupID, uint gi : SV_GroupIndex) {\n"
+"    uint4 Data[4];\n"
+"    [unroll] for (uint i = 0; i < 4; i++) {\n"
+"        Data[i] = InBuffer.Load4(((gid.x * 4 + i) * 64 + gi) * 16);\n"
+"    }\n"
+"    [unroll] for (uint j = 0; j < 4; j++) {\n"
+"        OutBuffer.Store4(((gid.x * 4 + j) * 64 + gi) * 16, Data[j]);\n"
+"    }\n"
+"}\n"
+;
+
+// A 32x32 tile per 16x16 group, read into groupshared memory with each thread loading a 2x2 spread of
+// texels, then written out once the whole tile is in. Dispatch(Width / 32, Height / 32).
+const char* ComputeShaderCodeTileCopy =
+"RWTexture2D<float4> OutTexture;\n"
+"Texture2D<float4> InTexture;\n"
+"groupshared float4 Tile[32 * 32];\n"
+"[numthreads(16, 16, 1)]\n"
+"void CSMain(uint3 gid : SV_GroupID, uint3 gtid : SV_GroupThreadID) {\n"
+"    uint2 Base = gid.xy * 32;\n"
+"    [unroll] for (uint i = 0; i < 4; i++) {\n"
+"        uint2 p = gtid.xy + uint2(i & 1, i >> 1) * 16;\n"
+"        Tile[p.y * 32 + p.x] = InTexture[Base + p];\n"
+"    }\n"
+"    GroupMemoryBarrierWithGroupSync();\n"
+"    [unroll] for (uint j = 0; j < 4; j++) {\n"
+"        uint2 p = gtid.xy + uint2(j & 1, j >> 1) * 16;\n"
+"        OutTexture[Base + p] = Tile[p.y * 32 + p.x];\n"
+"    }\n"
+"}\n"
+;
+
+// A 256 texel run of one row per 64 thread group, split evenly between the group's waves, each wave
+// stepping along its share with every active lane on consecutive texels. Works for any wave size.
+// Needs SM 6.0 wave intrinsics, so it only runs from the DXIL table. Dispatch(Width / 256, Height).
+// A wave's share comes from its first active lane's SV_GroupIndex, so the slot is wave-uniform, but it
+// still assumes drivers pack a 1D group into waves in SV_GroupIndex order, LaneCount threads at a time.
+// The benchmark checks the readback against CSCopyKernelWaveRows, which catches any other packing.
+const char* ComputeShaderCodeWaveRowCopy =
+"RWTexture2D<float4> OutTexture;\n"
+"Texture2D<float4> InTexture;\n"
+"[numthreads(64, 1, 1)]\n"
+"void CSMain(uint3 gid : SV_GroupID, uint gi : SV_GroupIndex) {\n"
+"    uint LaneCount = WaveGetLaneCount();\n"
+"    uint WavesPerGroup = (64 + LaneCount - 1) / LaneCount;\n"
+"    uint ActiveLanes = WaveActiveCountBits(true);\n"
+"    uint Lane = WavePrefixCountBits(true);\n"
+"    uint Span = 256 / WavesPerGroup;\n"
+"    uint WaveSlot = WaveReadLaneFirst(gi) / LaneCount;\n"
+"    uint Start = gid.x * 256 + WaveSlot * Span;\n"
+"    for (uint x = Lane; x < Span; x += ActiveLanes) {\n"
+"        uint2 p = uint2(Start + x, gid.y);\n"
+"        OutTexture[p] = InTexture[p];\n"
+"    }\n"
+"}\n"
+;
+
+// The copy with SV_GroupID remapped, so groups launched close together copy a compact area. The flat
+// index of the row-major, DISPATCH_X wide dispatch goes through the same mapping as MapDispatchIndex,
+// with REMAP_ORDER the CSDispatchOrder value. See GetRemapCopyShaderDefines for the other defines.
+const char* ComputeShaderCodeRemap =
+"RWTexture2D<float4> OutTexture;\n"
+"Texture2D<float4> InTexture;\n"
+"uint CompactBits(uint v) {\n"
+"    v &= 0x55555555;\n"
+"    v = (v | (v >> 1)) & 0x33333333;\n"
+"    v = (v | (v >> 2)) & 0x0f0f0f0f;\n"
+"    v = (v | (v >> 4)) & 0x00ff00ff;\n"
+"    v = (v | (v >> 8)) & 0x0000ffff;\n"
+"    return v;\n"
+"}\n"
+"[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]\n"
+"void CSMain(uint3 gid : SV_GroupID, uint3 gtid : SV_GroupThreadID) {\n"
+"    uint Flat = gid.y * DISPATCH_X + gid.x;\n"
+"    uint2 Group;\n"
+"#if REMAP_ORDER == 1\n"
+"    Group = uint2(Flat / GROUPS_Y, Flat % GROUPS_Y);\n"
+"#elif REMAP_ORDER == 2\n"
+"    Group = uint2(CompactBits(Flat), CompactBits(Flat >> 1));\n"
+"    if (Group.x >= GROUPS_X || Group.y >= GROUPS_Y) return;\n"
+"#elif REMAP_ORDER == 3\n"
+"    uint Strip = Flat / (TILE_WIDTH * GROUPS_Y);\n"
+"    uint StripWidth = min(TILE_WIDTH, GROUPS_X - Strip * TILE_WIDTH);\n"
+"    uint InStrip = Flat - Strip * TILE_WIDTH * GROUPS_Y;\n"
+"    Group = uint2(Strip * TILE_WIDTH + InStrip % StripWidth, InStrip / StripWidth);\n"
+"#else\n"
+"    Group = uint2(Flat % GROUPS_X, Flat / GROUPS_X);\n"
+"#endif\n"
+"    uint2 tid = Group * GROUP_SIZE + gtid.xy;\n"
+"    OutTexture[tid] = InTexture[tid];\n"
+"}\n"
+;
+
 
 #define LOG(msg, ...) do { char OtherStuff[1024] = {}; \
 		snprintf(OtherStuff, sizeof(OtherStuff), msg "\n", ## __VA_ARGS__); \
@@ -233,10 +389,8 @@ D3D12_BLEND_DESC GetDefaultBlendStateDesc() {
 	return Desc;
 }
 
-ID3D12Resource* AllocateTexture(ID3D12Device* Device, int Width, int Height, DXGI_FORMAT Format, D3D12_RESOURCE_FLAGS ResourcceFlags, D3D12_RESOURCE_STATES StartingState)
+D3D12_RESOURCE_DESC GetTextureDesc(int Width, int Height, DXGI_FORMAT Format, D3D12_RESOURCE_FLAGS ResourcceFlags, D3D12_TEXTURE_LAYOUT Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN)
 {
-	ID3D12Resource* Resource = nullptr;
-
 	D3D12_RESOURCE_DESC BackBufferDesc = {};
 	BackBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 	BackBufferDesc.Width = Width;
@@ -245,6 +399,15 @@ ID3D12Resource* AllocateTexture(ID3D12Device* Device, int Width, int Height, DXG
 	BackBufferDesc.SampleDesc.Count = 1;
 	BackBufferDesc.Flags = ResourcceFlags;
 	BackBufferDesc.Format = Format;
+	BackBufferDesc.Layout = Layout;
+	return BackBufferDesc;
+}
+
+ID3D12Resource* AllocateTexture(ID3D12Device* Device, int Width, int Height, DXGI_FORMAT Format, D3D12_RESOURCE_FLAGS ResourcceFlags, D3D12_RESOURCE_STATES StartingState, D3D12_TEXTURE_LAYOUT Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN)
+{
+	ID3D12Resource* Resource = nullptr;
+
+	D3D12_RESOURCE_DESC BackBufferDesc = GetTextureDesc(Width, Height, Format, ResourcceFlags, Layout);
 
 	D3D12_HEAP_PROPERTIES Props = {};
 	Props.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -270,118 +433,71 @@ ID3D12Resource* AllocateUploadTexture(ID3D12Device* Device, int BufferSize)
 	return Resource;
 }
 
-ID3D12Resource* AllocateReadbackTexture(ID3D12Device* Device, int BufferSize)
+// A texture the CPU can map and write in its tiled form, which only the standard swizzle allows
+ID3D12Resource* AllocateCPUVisibleTexture(ID3D12Device* Device, int Width, int Height, DXGI_FORMAT Format)
 {
-	D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
-
 	ID3D12Resource* Resource = nullptr;
 
+	D3D12_RESOURCE_DESC Desc = {};
+	Desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	Desc.Width = Width;
+	Desc.Height = Height;
+	Desc.DepthOrArraySize = 1;
+	Desc.MipLevels = 1;
+	Desc.SampleDesc.Count = 1;
+	Desc.Format = Format;
+	Desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_STANDARD_SWIZZLE;
+
 	D3D12_HEAP_PROPERTIES Props = {};
-	Props.Type = D3D12_HEAP_TYPE_READBACK;
+	Props.Type = D3D12_HEAP_TYPE_CUSTOM;
+	Props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
+	Props.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
 
-	HRESULT hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&Resource));
+	HRESULT hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&Resource));
 	ASSERT(SUCCEEDED(hr));
 
 	return Resource;
 }
 
-ID3D12RootSignature* CreatePixelRootSig(ID3D12Device* Device)
+ID3D12Resource* AllocateReadbackTexture(ID3D12Device* Device, int BufferSize)
 {
-	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
-	RootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-
-
-	D3D12_DESCRIPTOR_RANGE DescriptorRange = {};
-	DescriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-	DescriptorRange.BaseShaderRegister = 0;
-	DescriptorRange.NumDescriptors = 1;
-	DescriptorRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-
-	D3D12_ROOT_PARAMETER RootParam = {};
-	RootParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-	RootParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	RootParam.DescriptorTable.NumDescriptorRanges = 1;
-	RootParam.DescriptorTable.pDescriptorRanges = &DescriptorRange;
-
-	RootSigDesc.NumParameters = 1;
-	RootSigDesc.pParameters = &RootParam;
-
-	D3D12_STATIC_SAMPLER_DESC SamplerDesc = {};
-
-	SamplerDesc.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
-	SamplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	SamplerDesc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	SamplerDesc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	SamplerDesc.MipLODBias = 0;
-	SamplerDesc.MaxAnisotropy = 0;
-	SamplerDesc.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-	SamplerDesc.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
-	SamplerDesc.MinLOD = 0.0f;
-	SamplerDesc.MaxLOD = D3D12_FLOAT32_MAX;
-	SamplerDesc.ShaderRegister = 0;
-	SamplerDesc.RegisterSpace = 0;
-
-	RootSigDesc.NumStaticSamplers = 1;
-	RootSigDesc.pStaticSamplers = &SamplerDesc;
-
-	ID3DBlob* RootSigBlob = nullptr;
-	ID3DBlob* RootSigErrorBlob = nullptr;
-
-	HRESULT hr = D3D12SerializeRootSignature(&RootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &RootSigBlob, &RootSigErrorBlob);
-
-	if (!SUCCEEDED(hr))
-	{
-		const char* ErrStr = (const char*)RootSigErrorBlob->GetBufferPointer();
-		int32 ErrStrLen = RootSigErrorBlob->GetBufferSize();
-		LOG("Root Sig Err: '%.*s'", ErrStrLen, ErrStr);
-	}
+	D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
 
-	ASSERT(SUCCEEDED(hr));
+	ID3D12Resource* Resource = nullptr;
 
-	ID3D12RootSignature* RootSig = nullptr;
-	hr = Device->CreateRootSignature(0, RootSigBlob->GetBufferPointer(), RootSigBlob->GetBufferSize(), IID_PPV_ARGS(&RootSig));
+	D3D12_HEAP_PROPERTIES Props = {};
+	Props.Type = D3D12_HEAP_TYPE_READBACK;
 
+	HRESULT hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&Resource));
 	ASSERT(SUCCEEDED(hr));
 
-	return RootSig;
+	return Resource;
 }
 
-ID3D12PipelineState* CreatePixelPSO(ID3D12Device* Device, ID3D12RootSignature* RootSig, DXGI_FORMAT OutputFormat, ID3DBlob* VSByteCode, ID3DBlob* PSByteCode)
+ID3D12Resource* AllocateBuffer(ID3D12Device* Device, int BufferSize, D3D12_RESOURCE_FLAGS ResourceFlags, D3D12_RESOURCE_STATES StartingState)
 {
-	ID3D12PipelineState* PSO = nullptr;
-	D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
-
-	D3D12_SHADER_BYTECODE VertexShaderByteCode;
-	VertexShaderByteCode.pShaderBytecode = VSByteCode->GetBufferPointer();
-	VertexShaderByteCode.BytecodeLength = VSByteCode->GetBufferSize();
+	D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize, ResourceFlags);
 
-	D3D12_SHADER_BYTECODE PixelShaderByteCode;
-	PixelShaderByteCode.pShaderBytecode = PSByteCode->GetBufferPointer();
-	PixelShaderByteCode.BytecodeLength = PSByteCode->GetBufferSize();
+	ID3D12Resource* Resource = nullptr;
 
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC PSODesc = {};
-	PSODesc.InputLayout = { inputElementDescs, (sizeof(inputElementDescs) / sizeof(inputElementDescs[0])) };
-	PSODesc.pRootSignature = RootSig;
-	PSODesc.VS = VertexShaderByteCode;
-	PSODesc.PS = PixelShaderByteCode;
-	PSODesc.RasterizerState = GetDefaultRasterizerDesc();
-	PSODesc.BlendState = GetDefaultBlendStateDesc();
-	PSODesc.DepthStencilState.DepthEnable = FALSE;
-	PSODesc.DepthStencilState.StencilEnable = FALSE;
-	PSODesc.SampleMask = UINT_MAX;
-	PSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	PSODesc.NumRenderTargets = 1;
-	PSODesc.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM;
-	PSODesc.SampleDesc.Count = 1;
+	D3D12_HEAP_PROPERTIES Props = {};
+	Props.Type = D3D12_HEAP_TYPE_DEFAULT;
 
-	Device->CreateGraphicsPipelineState(&PSODesc, IID_PPV_ARGS(&PSO));
+	HRESULT hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, StartingState, nullptr, IID_PPV_ARGS(&Resource));
+	ASSERT(SUCCEEDED(hr));
 
-	return PSO;
+	return Resource;
 }
 
+// The full screen quad the pixel shader copy draws, as a 4 vertex triangle strip of clip space float4s
+const float PSCopyQuadVertices[16] =
+{
+	-1.0f, -1.0f, 0.0f, 1.0f,
+	 1.0f, -1.0f, 0.0f, 1.0f,
+	-1.0f,  1.0f, 0.0f, 1.0f,
+	 1.0f,  1.0f, 0.0f, 1.0f,
+};
+
 ID3D12Resource* AllocateVertexBuffer(ID3D12Device* Device, int BufferSize)
 {
 	D3D12_RESOURCE_DESC VertResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(BufferSize);
@@ -399,561 +515,5185 @@ ID3D12Resource* AllocateVertexBuffer(ID3D12Device* Device, int BufferSize)
 	hr = VertexBufferRes->Map(0, &readRange, &pVertData);
 	ASSERT(SUCCEEDED(hr));
 
-	{
-		float* pFloatData = (float*)pVertData;
-		pFloatData[0] = -1.0f;
-		pFloatData[1] = -1.0f;
-		pFloatData[2] = 0.0f;
-		pFloatData[3] = 1.0f;
-
-		pFloatData[4] = 1.0f;
-		pFloatData[5] = -1.0f;
-		pFloatData[6] = 0.0f;
-		pFloatData[7] = 1.0f;
-
-		pFloatData[8] = -1.0f;
-		pFloatData[9] = 1.0f;
-		pFloatData[10] = 0.0f;
-		pFloatData[11] = 1.0f;
-
-		pFloatData[12] = 1.0f;
-		pFloatData[13] = 1.0f;
-		pFloatData[14] = 0.0f;
-		pFloatData[15] = 1.0f;
-	}
+	ASSERT(BufferSize <= (int)sizeof(PSCopyQuadVertices));
+	memcpy(pVertData, PSCopyQuadVertices, BufferSize);
 
 	VertexBufferRes->Unmap(0, nullptr);
 
 	return VertexBufferRes;
 }
 
-void SetTextureUploadRandomBytes(const char* Filename, ID3D12Resource* TextureUploadResource, int BufferSize, int Width, int Height, int Pitch)
+// Resource heap tier 1 can't mix these in one heap, so each gets heaps of its own
+enum PlacedHeapKind
 {
-	void* pTexturePixelData = nullptr;
-	HRESULT hr = TextureUploadResource->Map(0, nullptr, &pTexturePixelData);
-	ASSERT(SUCCEEDED(hr));
-
-	for (int i = 0; i < BufferSize; i++)
-	{
-		((uint8_t*)pTexturePixelData)[i] = (uint8_t)(rand() % 256);
-	}
-
-	stbi_write_png(Filename, Width, Height, 4, pTexturePixelData, Pitch);
-
-	TextureUploadResource->Unmap(0, nullptr);
-}
+	PlacedHeapBuffers,
+	PlacedHeapTextures,
+	PlacedHeapTargets,
+	PlacedHeapKindCount,
+};
 
-void UploadTextureResource(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* TextureUploadResource, ID3D12Resource* TextureResource, int32 Width, int32 Height, int32 Pitch, D3D12_RESOURCE_STATES StartingState)
+struct PlacedAllocation
 {
-	D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
-	CopyLocSrc.pResource = TextureUploadResource;
-	CopyLocSrc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-	CopyLocSrc.PlacedFootprint.Offset = 0;
-	CopyLocSrc.PlacedFootprint.Footprint.Width = Width;
-	CopyLocSrc.PlacedFootprint.Footprint.Height = Height;
-	CopyLocSrc.PlacedFootprint.Footprint.Depth = 1;
-	CopyLocSrc.PlacedFootprint.Footprint.RowPitch = Pitch;
-	CopyLocSrc.PlacedFootprint.Footprint.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	ID3D12Heap* Heap = nullptr;
+	uint64_t Offset = 0;
+	uint64_t Size = 0;
+	int Kind = 0;
+	int HeapIndex = -1;
+};
 
-	CopyLocDst.pResource = TextureResource;
-	CopyLocDst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-	CopyLocDst.SubresourceIndex = 0;
+// Sub-allocates placed resources out of large heaps, one buddy allocator per heap, so creating a transient
+// texture is a free list pop plus CreatePlacedResource instead of a whole heap allocation. More than one
+// resource can be placed in an allocation to alias transient targets, with an aliasing barrier between uses.
+struct PlacedResourceAllocator
+{
+	static const uint64_t HeapSize = 64ull * 1024 * 1024;
 
+	struct HeapBlock
 	{
-		D3D12_RESOURCE_BARRIER Barrier = {};
-		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		Barrier.Transition.pResource = TextureResource;
-		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		Barrier.Transition.StateBefore = StartingState;
-		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+		ID3D12Heap* Heap = nullptr;
+		BuddyAllocator Allocator;
+	};
 
-		CommandList->ResourceBarrier(1, &Barrier);
+	ID3D12Device* Device = nullptr;
+	D3D12_HEAP_TYPE HeapType = D3D12_HEAP_TYPE_DEFAULT;
+	std::vector<HeapBlock> Heaps[PlacedHeapKindCount];
+
+	void Init(ID3D12Device* InDevice, D3D12_HEAP_TYPE InHeapType = D3D12_HEAP_TYPE_DEFAULT)
+	{
+		Device = InDevice;
+		HeapType = InHeapType;
 	}
 
-	CommandList->CopyTextureRegion(&CopyLocDst, 0, 0, 0, &CopyLocSrc, nullptr);
+	// Everything placed in the heaps must have been released already
+	void Shutdown()
+	{
+		for (std::vector<HeapBlock>& KindHeaps : Heaps)
+		{
+			for (HeapBlock& Block : KindHeaps)
+			{
+				ASSERT(Block.Allocator.NumAllocations == 0);
+				Block.Heap->Release();
+			}
+			KindHeaps.clear();
+		}
+	}
 
+	static int GetHeapKind(const D3D12_RESOURCE_DESC& Desc)
 	{
-		D3D12_RESOURCE_BARRIER Barrier = {};
-		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		Barrier.Transition.pResource = TextureResource;
-		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-		Barrier.Transition.StateAfter = StartingState;
+		if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return PlacedHeapBuffers;
+		}
+		const D3D12_RESOURCE_FLAGS TargetFlags = (D3D12_RESOURCE_FLAGS)(D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+		return (Desc.Flags & TargetFlags) ? PlacedHeapTargets : PlacedHeapTextures;
+	}
 
-		CommandList->ResourceBarrier(1, &Barrier);
+	// Tries the 4KB small resource alignment first, which the runtime only grants to small textures that
+	// aren't render targets, and leaves Desc.Alignment set to whatever was granted
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(D3D12_RESOURCE_DESC& Desc)
+	{
+		if (GetHeapKind(Desc) == PlacedHeapTextures && Desc.SampleDesc.Count <= 1)
+		{
+			Desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+			D3D12_RESOURCE_ALLOCATION_INFO Info = Device->GetResourceAllocationInfo(0, 1, &Desc);
+			if (Info.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			{
+				return Info;
+			}
+		}
+		Desc.Alignment = 0;
+		return Device->GetResourceAllocationInfo(0, 1, &Desc);
 	}
-}
 
-void CopyRenderTargetDataToReadback(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* DestResource, ID3D12Resource* ReadbackRT, int RTWidth, int RTHeight, int Pitch, D3D12_RESOURCE_STATES StartingState)
-{
-	D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
-	CopyLocDst.pResource = ReadbackRT;
-	CopyLocDst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-	CopyLocDst.PlacedFootprint.Offset = 0;
-	CopyLocDst.PlacedFootprint.Footprint.Width = RTWidth;
-	CopyLocDst.PlacedFootprint.Footprint.Height = RTHeight;
-	CopyLocDst.PlacedFootprint.Footprint.Depth = 1;
-	CopyLocDst.PlacedFootprint.Footprint.RowPitch = Pitch;
-	CopyLocDst.PlacedFootprint.Footprint.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	// Returns false for anything the heaps can't hold (too big, or MSAA aligned), which callers should commit instead
+	bool Allocate(const D3D12_RESOURCE_ALLOCATION_INFO& Info, int Kind, PlacedAllocation* Allocation)
+	{
+		if (Info.SizeInBytes > HeapSize || Info.Alignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+		{
+			return false;
+		}
 
-	CopyLocSrc.pResource = DestResource;
-	CopyLocSrc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-	CopyLocSrc.SubresourceIndex = 0;
+		std::vector<HeapBlock>& KindHeaps = Heaps[Kind];
+		for (int HeapIndex = 0; HeapIndex <= (int)KindHeaps.size(); HeapIndex++)
+		{
+			if (HeapIndex == (int)KindHeaps.size())
+			{
+				const D3D12_HEAP_FLAGS KindFlags[PlacedHeapKindCount] =
+				{
+					D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+					D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+					D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+				};
+
+				D3D12_HEAP_DESC HeapDesc = {};
+				HeapDesc.SizeInBytes = HeapSize;
+				HeapDesc.Properties.Type = HeapType;
+				HeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+				HeapDesc.Flags = KindFlags[Kind];
+
+				HeapBlock Block;
+				HRESULT hr = Device->CreateHeap(&HeapDesc, IID_PPV_ARGS(&Block.Heap));
+				if (FAILED(hr))
+				{
+					return false;
+				}
+				Block.Allocator.Init(HeapSize, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT);
+				KindHeaps.push_back(std::move(Block));
+			}
 
-	//{
-	//	D3D12_RESOURCE_BARRIER Barrier = {};
-	//	Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	//	Barrier.UAV.pResource = DestResource;
-	//
-	//	CommandList->ResourceBarrier(1, &Barrier);
-	//}
+			HeapBlock& Block = KindHeaps[HeapIndex];
+			const uint64_t Offset = Block.Allocator.Allocate(Info.SizeInBytes, Info.Alignment);
+			if (Offset != BuddyAllocator::InvalidOffset)
+			{
+				Allocation->Heap = Block.Heap;
+				Allocation->Offset = Offset;
+				Allocation->Size = Block.Allocator.GetAllocationSize(Offset);
+				Allocation->Kind = Kind;
+				Allocation->HeapIndex = HeapIndex;
+				return true;
+			}
+		}
+		return false;
+	}
 
-	// Transition dest from render target to copy source
+	void Free(PlacedAllocation& Allocation)
 	{
-		D3D12_RESOURCE_BARRIER Barrier = {};
-		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		Barrier.Transition.pResource = DestResource;
-		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		Barrier.Transition.StateBefore = StartingState;
-		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-
-		CommandList->ResourceBarrier(1, &Barrier);
+		ASSERT(Allocation.HeapIndex >= 0);
+		Heaps[Allocation.Kind][Allocation.HeapIndex].Allocator.Free(Allocation.Offset);
+		Allocation = PlacedAllocation();
 	}
 
-	CommandList->CopyTextureRegion(&CopyLocDst, 0, 0, 0, &CopyLocSrc, nullptr);
-
-	// Transition dest back to render target
+	// Places a resource at the start of Allocation. Desc must fit, and the resource aliases anything else
+	// already placed there.
+	ID3D12Resource* CreateResource(const PlacedAllocation& Allocation, const D3D12_RESOURCE_DESC& Desc, D3D12_RESOURCE_STATES StartingState)
 	{
-		D3D12_RESOURCE_BARRIER Barrier = {};
-		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		Barrier.Transition.pResource = DestResource;
-		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
-		Barrier.Transition.StateAfter = StartingState;
+		ID3D12Resource* Resource = nullptr;
+		HRESULT hr = Device->CreatePlacedResource(Allocation.Heap, Allocation.Offset, &Desc, StartingState, nullptr, IID_PPV_ARGS(&Resource));
+		ASSERT(SUCCEEDED(hr));
+		return Resource;
+	}
+};
 
-		CommandList->ResourceBarrier(1, &Barrier);
+// AllocateTexture, placed in Allocator's heaps; Allocation must be freed once the texture is released
+ID3D12Resource* AllocatePlacedTexture(PlacedResourceAllocator& Allocator, int Width, int Height, DXGI_FORMAT Format, D3D12_RESOURCE_FLAGS ResourcceFlags, D3D12_RESOURCE_STATES StartingState, PlacedAllocation* Allocation)
+{
+	D3D12_RESOURCE_DESC Desc = GetTextureDesc(Width, Height, Format, ResourcceFlags);
+	const D3D12_RESOURCE_ALLOCATION_INFO Info = Allocator.GetAllocationInfo(Desc);
+	if (!Allocator.Allocate(Info, PlacedResourceAllocator::GetHeapKind(Desc), Allocation))
+	{
+		return nullptr;
 	}
+	return Allocator.CreateResource(*Allocation, Desc, StartingState);
 }
 
-void WriteReadbackToFile(const char* Filename, ID3D12Resource * RTReadback, int RTWidth, int RTHeight)
+// What makes two pooled resources interchangeable. Buffers only use Width and HeapType.
+struct ResourcePoolKey
 {
-	void* pPixelData = nullptr;
-	HRESULT hr = RTReadback->Map(0, nullptr, &pPixelData);
-	ASSERT(SUCCEEDED(hr));
-
-	stbi_write_png(Filename, RTWidth, RTHeight, 4, pPixelData, 0);
+	D3D12_RESOURCE_DIMENSION Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	uint64_t Width = 0;
+	uint32_t Height = 0;
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+	D3D12_RESOURCE_FLAGS Flags = D3D12_RESOURCE_FLAG_NONE;
+	D3D12_TEXTURE_LAYOUT Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	D3D12_HEAP_TYPE HeapType = D3D12_HEAP_TYPE_DEFAULT;
+
+	static ResourcePoolKey Texture(int Width, int Height, DXGI_FORMAT Format, D3D12_RESOURCE_FLAGS Flags, D3D12_TEXTURE_LAYOUT Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN)
+	{
+		ResourcePoolKey Key;
+		Key.Width = Width;
+		Key.Height = Height;
+		Key.Format = Format;
+		Key.Flags = Flags;
+		Key.Layout = Layout;
+		return Key;
+	}
 
-	RTReadback->Unmap(0, nullptr);
-}
+	// An upload or readback buffer, or a default heap one for the shaders, which is the only kind with flags
+	static ResourcePoolKey Buffer(int Size, D3D12_HEAP_TYPE HeapType, D3D12_RESOURCE_FLAGS Flags = D3D12_RESOURCE_FLAG_NONE)
+	{
+		ResourcePoolKey Key;
+		Key.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		Key.Width = Size;
+		Key.Flags = Flags;
+		Key.HeapType = HeapType;
+		return Key;
+	}
 
-ID3D12DescriptorHeap* GetSRVHeapForTexture(ID3D12Device* Device, ID3D12Resource* Texture)
-{
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
+	bool operator==(const ResourcePoolKey& Other) const
+	{
+		return Dimension == Other.Dimension && Width == Other.Width && Height == Other.Height && Format == Other.Format &&
+			Flags == Other.Flags && Layout == Other.Layout && HeapType == Other.HeapType;
+	}
+};
 
-	ID3D12DescriptorHeap* TextureSRVHeap = nullptr;
+struct GPUResourcePool;
 
-	// TODO: Descriptor heap needs to go somewhere, maybe on texture?
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 1;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	HRESULT hr = Device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&TextureSRVHeap));
+// Hands its resource back to the pool when it goes out of scope. The resource must be left in GetState(),
+// or SetState() told where it was left, so the next user can be transitioned from there.
+struct PooledResource
+{
+	GPUResourcePool* Pool = nullptr;
+	int Index = -1;
+
+	PooledResource() = default;
+	PooledResource(GPUResourcePool* InPool, int InIndex) : Pool(InPool), Index(InIndex) {}
+	PooledResource(const PooledResource&) = delete;
+	PooledResource& operator=(const PooledResource&) = delete;
+	PooledResource(PooledResource&& Other) : Pool(Other.Pool), Index(Other.Index) { Other.Pool = nullptr; }
+	PooledResource& operator=(PooledResource&& Other)
+	{
+		if (this != &Other)
+		{
+			Reset();
+			Pool = Other.Pool;
+			Index = Other.Index;
+			Other.Pool = nullptr;
+		}
+		return *this;
+	}
+	~PooledResource() { Reset(); }
 
-	Device->CreateShaderResourceView(Texture, &srvDesc, TextureSRVHeap->GetCPUDescriptorHandleForHeapStart());
+	inline ID3D12Resource* Get() const;
+	inline D3D12_RESOURCE_STATES GetState() const;
+	inline void SetState(D3D12_RESOURCE_STATES State);
+	inline void Reset();
 
-	return TextureSRVHeap;
-}
+	operator ID3D12Resource*() const { return Get(); }
+	ID3D12Resource* operator->() const { return Get(); }
+};
 
-ID3D12DescriptorHeap* GetSRVUAVHeapForTextures(ID3D12Device* Device, ID3D12Resource* SRVTexture, ID3D12Resource* UAVTexture)
+// Keeps resources alive across benchmark configurations and hands out an idle one with a matching key
+// before creating another. When creating one would go over the budget, the least recently returned idle
+// resources are released first. The benchmarks wait for the GPU after every submission, so a returned
+// resource is never still in use by the time it's reused or released.
+struct GPUResourcePool
 {
-	ID3D12DescriptorHeap* TextureUAVHeap = nullptr;
-
-	// TODO: Descriptor heap needs to go somewhere, maybe on texture?
-	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-	heapDesc.NumDescriptors = 2;
-	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	HRESULT hr = Device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&TextureUAVHeap));
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
+	struct Entry
+	{
+		ResourcePoolKey Key;
+		ID3D12Resource* Resource = nullptr;
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+		uint64_t Bytes = 0;
+		uint64_t LastReturned = 0;
+		bool bInUse = false;
+	};
 
-	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
-	UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	UAVDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	UAVDesc.Texture2D.MipSlice = 0;
+	ID3D12Device* Device = nullptr;
+	uint64_t BudgetBytes = 0;
+	std::vector<Entry> Entries;
+
+	uint64_t LiveBytes = 0;
+	uint64_t PeakBytes = 0;
+	uint64_t ReturnCount = 0;
+	int Acquires = 0;
+	int Hits = 0;
+	int Evictions = 0;
+	int Transitions = 0;
+
+	void Init(ID3D12Device* InDevice, uint64_t InBudgetBytes)
+	{
+		Device = InDevice;
+		BudgetBytes = InBudgetBytes;
+	}
 
-	D3D12_CPU_DESCRIPTOR_HANDLE CPUHandle = TextureUAVHeap->GetCPUDescriptorHandleForHeapStart();
-	Device->CreateShaderResourceView(SRVTexture, &srvDesc, CPUHandle);
+	// All handles must have been returned
+	void Shutdown()
+	{
+		for (Entry& E : Entries)
+		{
+			ASSERT(!E.bInUse);
+			if (E.Resource != nullptr)
+			{
+				E.Resource->Release();
+			}
+		}
+		Entries.clear();
+		LiveBytes = 0;
+	}
 
-	CPUHandle.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	Device->CreateUnorderedAccessView(UAVTexture, nullptr, &UAVDesc, CPUHandle);
+	// An idle resource matching Key, transitioned to State on CommandList if it was left in another one, or a
+	// new resource created in State. Upload and readback buffers are always in GENERIC_READ and COPY_DEST.
+	PooledResource Acquire(ID3D12GraphicsCommandList* CommandList, const ResourcePoolKey& Key, D3D12_RESOURCE_STATES State)
+	{
+		Acquires++;
 
-	return TextureUAVHeap;
-}
+		int Found = -1;
+		for (int i = 0; i < (int)Entries.size(); i++)
+		{
+			const Entry& E = Entries[i];
+			if (E.Resource != nullptr && !E.bInUse && E.Key == Key && (Found < 0 || E.State == State))
+			{
+				Found = i;
+				if (E.State == State)
+				{
+					break;
+				}
+			}
+		}
 
-ID3D12RootSignature* CreateComputeRootSig(ID3D12Device* Device)
-{
-	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+		if (Found >= 0)
+		{
+			Hits++;
+			Entry& E = Entries[Found];
+			if (E.State != State)
+			{
+				D3D12_RESOURCE_BARRIER Barrier = {};
+				Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+				Barrier.Transition.pResource = E.Resource;
+				Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+				Barrier.Transition.StateBefore = E.State;
+				Barrier.Transition.StateAfter = State;
+
+				CommandList->ResourceBarrier(1, &Barrier);
+				E.State = State;
+				Transitions++;
+			}
+			E.bInUse = true;
+			return PooledResource(this, Found);
+		}
 
+		uint64_t Bytes = Key.Width;
+		if (Key.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			D3D12_RESOURCE_DESC Desc = GetTextureDesc((int)Key.Width, Key.Height, Key.Format, Key.Flags, Key.Layout);
+			Bytes = Device->GetResourceAllocationInfo(0, 1, &Desc).SizeInBytes;
+		}
 
-	D3D12_DESCRIPTOR_RANGE DescriptorRanges[2] = {};
-	DescriptorRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-	DescriptorRanges[0].BaseShaderRegister = 0;
-	DescriptorRanges[0].NumDescriptors = 1;
-	DescriptorRanges[0].OffsetInDescriptorsFromTableStart = 0;
+		while (LiveBytes + Bytes > BudgetBytes && EvictOldest())
+		{
+		}
 
-	DescriptorRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-	DescriptorRanges[1].BaseShaderRegister = 0;
-	DescriptorRanges[1].NumDescriptors = 1;
-	DescriptorRanges[1].OffsetInDescriptorsFromTableStart = 0;
+		Entry NewEntry;
+		NewEntry.Key = Key;
+		NewEntry.Bytes = Bytes;
+		NewEntry.bInUse = true;
+		if (Key.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER && Key.HeapType == D3D12_HEAP_TYPE_DEFAULT)
+		{
+			NewEntry.Resource = AllocateBuffer(Device, (int)Key.Width, Key.Flags, State);
+			NewEntry.State = State;
+		}
+		else if (Key.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			ASSERT(Key.HeapType == D3D12_HEAP_TYPE_UPLOAD || Key.HeapType == D3D12_HEAP_TYPE_READBACK);
+			const bool bUpload = Key.HeapType == D3D12_HEAP_TYPE_UPLOAD;
+			NewEntry.Resource = bUpload ? AllocateUploadTexture(Device, (int)Key.Width) : AllocateReadbackTexture(Device, (int)Key.Width);
+			NewEntry.State = bUpload ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COPY_DEST;
+		}
+		else
+		{
+			NewEntry.Resource = AllocateTexture(Device, (int)Key.Width, Key.Height, Key.Format, Key.Flags, State, Key.Layout);
+			NewEntry.State = State;
+		}
 
-	D3D12_ROOT_PARAMETER RootParams[2] = {};
-	RootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-	RootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	RootParams[0].DescriptorTable.NumDescriptorRanges = 1;
-	RootParams[0].DescriptorTable.pDescriptorRanges = &DescriptorRanges[0];
+		LiveBytes += Bytes;
+		PeakBytes = LiveBytes > PeakBytes ? LiveBytes : PeakBytes;
 
-	RootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-	RootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	RootParams[1].DescriptorTable.NumDescriptorRanges = 1;
-	RootParams[1].DescriptorTable.pDescriptorRanges = &DescriptorRanges[1];
+		// Reuse the slot of an evicted entry, so handle indices stay small
+		for (int i = 0; i < (int)Entries.size(); i++)
+		{
+			if (Entries[i].Resource == nullptr)
+			{
+				Entries[i] = NewEntry;
+				return PooledResource(this, i);
+			}
+		}
+		Entries.push_back(NewEntry);
+		return PooledResource(this, (int)Entries.size() - 1);
+	}
 
-	RootSigDesc.NumParameters = 2;
-	RootSigDesc.pParameters = &RootParams[0];
+	void Return(int Index)
+	{
+		Entry& E = Entries[Index];
+		ASSERT(E.bInUse);
+		E.bInUse = false;
+		E.LastReturned = ++ReturnCount;
+	}
 
-	ID3DBlob* RootSigBlob = nullptr;
-	ID3DBlob* RootSigErrorBlob = nullptr;
+	bool EvictOldest()
+	{
+		int Oldest = -1;
+		for (int i = 0; i < (int)Entries.size(); i++)
+		{
+			const Entry& E = Entries[i];
+			if (E.Resource != nullptr && !E.bInUse && (Oldest < 0 || E.LastReturned < Entries[Oldest].LastReturned))
+			{
+				Oldest = i;
+			}
+		}
+		if (Oldest < 0)
+		{
+			return false;
+		}
 
-	HRESULT hr = D3D12SerializeRootSignature(&RootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &RootSigBlob, &RootSigErrorBlob);
+		Entry& E = Entries[Oldest];
+		E.Resource->Release();
+		E.Resource = nullptr;
+		LiveBytes -= E.Bytes;
+		Evictions++;
+		return true;
+	}
 
-	if (!SUCCEEDED(hr))
+	void LogStats() const
 	{
-		const char* ErrStr = (const char*)RootSigErrorBlob->GetBufferPointer();
-		int32 ErrStrLen = RootSigErrorBlob->GetBufferSize();
-		LOG("Root Sig Err: '%.*s'", ErrStrLen, ErrStr);
+		LOG("Resource pool: %d acquires, %.1f%% hits, %d transitions, %d evictions, peak %.1f MB of %.1f MB budget",
+			Acquires, Acquires ? 100.0 * Hits / Acquires : 0.0, Transitions, Evictions, PeakBytes / (1024.0 * 1024.0), BudgetBytes / (1024.0 * 1024.0));
 	}
+};
 
-	ASSERT(SUCCEEDED(hr));
+ID3D12Resource* PooledResource::Get() const
+{
+	return Pool ? Pool->Entries[Index].Resource : nullptr;
+}
 
-	ID3D12RootSignature* RootSig = nullptr;
-	hr = Device->CreateRootSignature(0, RootSigBlob->GetBufferPointer(), RootSigBlob->GetBufferSize(), IID_PPV_ARGS(&RootSig));
+D3D12_RESOURCE_STATES PooledResource::GetState() const
+{
+	return Pool->Entries[Index].State;
+}
 
-	ASSERT(SUCCEEDED(hr));
+void PooledResource::SetState(D3D12_RESOURCE_STATES State)
+{
+	Pool->Entries[Index].State = State;
+}
 
-	return RootSig;
+void PooledResource::Reset()
+{
+	if (Pool != nullptr)
+	{
+		Pool->Return(Index);
+		Pool = nullptr;
+	}
 }
 
-ID3D12PipelineState* CreateComputePSO(ID3D12Device* Device, ID3D12RootSignature* RootSig, ID3DBlob* CSByteCode)
+double GetElapsedSeconds(std::chrono::high_resolution_clock::time_point Start)
 {
-	ID3D12PipelineState* PSO = nullptr;
-	
-	D3D12_SHADER_BYTECODE ComputeShaderByteCode;
-	ComputeShaderByteCode.pShaderBytecode = CSByteCode->GetBufferPointer();
-	ComputeShaderByteCode.BytecodeLength = CSByteCode->GetBufferSize();
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+}
 
-	D3D12_COMPUTE_PIPELINE_STATE_DESC PSODesc = {};
-	PSODesc.CS = ComputeShaderByteCode;
-	PSODesc.pRootSignature = RootSig;
+// One shader to compile. Defines are NAME, VALUE pairs, kept as strings so variants can be built in a loop.
+struct ShaderCompileRequest
+{
+	const char* Name;
+	const char* Source;
+	const char* EntryPoint;
+	const char* Target;
+	UINT Flags = 0;
+	std::vector<std::pair<std::string, std::string>> Defines;
+
+	ID3DBlob* ByteCode = nullptr;
+	bool bFromCache = false;
+	bool bEmbedded = false;
+};
 
-	HRESULT hr = Device->CreateComputePipelineState(&PSODesc, IID_PPV_ARGS(&PSO));
-	ASSERT(SUCCEEDED(hr));
+typedef HRESULT (*ShaderCompileFunc)(const ShaderCompileRequest& Request, ID3DBlob** ByteCode, ID3DBlob** ErrorMsg);
+
+HRESULT CompileShaderD3D(const ShaderCompileRequest& Request, ID3DBlob** ByteCode, ID3DBlob** ErrorMsg)
+{
+	std::vector<D3D_SHADER_MACRO> Macros;
+	for (const auto& Define : Request.Defines)
+	{
+		Macros.push_back({ Define.first.c_str(), Define.second.c_str() });
+	}
+	Macros.push_back({ nullptr, nullptr });
 
-	return PSO;
+	return D3DCompile(Request.Source, strlen(Request.Source), Request.Name, Macros.data(), nullptr, Request.EntryPoint, Request.Target, Request.Flags, 0, ByteCode, ErrorMsg);
 }
 
-struct GPUTimer
+// DXIL compiled offline by shaders/build_shaders.py, which writes shaders/ShaderBlobs.h: one entry per
+// request it knows about, with what the disassembly says about the kernel. DXIL has no register
+// allocation, so there is no register count; that is up to the driver's compiler.
+struct EmbeddedShader
 {
-	ID3D12QueryHeap* QueryHeap = nullptr;
+	uint64_t Key;				// GetEmbeddedShaderKey of the request it was built for
+	const char* Name;
+	const char* Profile;
+	const uint8_t* ByteCode;
+	size_t ByteCodeSize;
+	uint32_t InstructionCount;	// In the entry point, after inlining
+	uint32_t IntrinsicCount;	// dx.op calls: loads, stores, wave ops and the like
+	uint32_t ResourceCount;
+	uint32_t GroupSharedBytes;
+	uint32_t NumThreads[3];
+};
 
-	ID3D12Resource* TimestampReadback = nullptr;
+#if __has_include("shaders/ShaderBlobs.h")
+#include "shaders/ShaderBlobs.h"
+#else
+// No table built, so every shader compiles at runtime
+static const EmbeddedShader* const EmbeddedShaders = nullptr;
+static const int NumEmbeddedShaders = 0;
+#endif
+
+// The source, entry point and defines, but not the target: the table's DXIL stands in for whatever
+// profile the runtime compile would have used. build_shaders.py computes the same hash.
+uint64_t GetEmbeddedShaderKey(const ShaderCompileRequest& Request)
+{
+	return GetShaderSourceKey(Request.Source, Request.EntryPoint, Request.Defines);
+}
 
-	void Init(ID3D12Device* Device)
+// Null if the table wasn't built, or was built from an older version of the source
+const EmbeddedShader* FindEmbeddedShader(const ShaderCompileRequest& Request)
+{
+	const uint64_t Key = GetEmbeddedShaderKey(Request);
+	for (int i = 0; i < NumEmbeddedShaders; i++)
 	{
-		D3D12_QUERY_HEAP_DESC QueryHeapDesc = {};
-		QueryHeapDesc.Count = 1024;
-		QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
-		HRESULT hr = Device->CreateQueryHeap(&QueryHeapDesc, IID_PPV_ARGS(&QueryHeap));
-		ASSERT(SUCCEEDED(hr));
+		if (EmbeddedShaders[i].Key == Key)
+		{
+			return &EmbeddedShaders[i];
+		}
+	}
+	return nullptr;
+}
 
-		D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Buffer(QueryHeapDesc.Count * sizeof(uint64_t));
+// Logs what the table says about Request's kernel, if that is where its bytecode came from
+void LogEmbeddedShaderStats(const ShaderCompileRequest& Request)
+{
+	const EmbeddedShader* Shader = Request.bEmbedded ? FindEmbeddedShader(Request) : nullptr;
+	if (Shader)
+	{
+		LOG("  %-28s %-6s %5d bytes, %4d instructions, %3d intrinsics, %d resources, %5d groupshared bytes, %dx%dx%d threads",
+			Shader->Name, Shader->Profile, (int)Shader->ByteCodeSize, Shader->InstructionCount, Shader->IntrinsicCount, Shader->ResourceCount,
+			Shader->GroupSharedBytes, Shader->NumThreads[0], Shader->NumThreads[1], Shader->NumThreads[2]);
+	}
+}
 
-		D3D12_HEAP_PROPERTIES Props = {};
-		Props.Type = D3D12_HEAP_TYPE_READBACK;
+// Content addressed cache of compiled bytecode on disk. A file is named after the hash of everything that
+// goes into the compile, so an edited shader just misses and leaves its old entry behind. Cache misses are
+// compiled in parallel, and Compile can be pointed at a stub to run the cache without a shader compiler.
+struct ShaderCache
+{
+	std::string Directory;
+	ShaderCompileFunc Compile = CompileShaderD3D;
+	bool bUseEmbedded = true;
 
-		hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&TimestampReadback));
-		ASSERT(SUCCEEDED(hr));
+	// An empty directory keeps everything in memory, compiling every time
+	void Init(const char* InDirectory)
+	{
+		Directory = InDirectory;
+		if (!Directory.empty())
+		{
+			PlatformCreateDirectory(Directory.c_str());
+		}
 	}
 
-	void StartTiming(ID3D12GraphicsCommandList* CommandList)
+	static uint64_t GetKey(const ShaderCompileRequest& Request)
 	{
-		CommandList->EndQuery(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0);
+		return GetShaderCacheKey(Request.Source, Request.EntryPoint, Request.Target, Request.Flags, Request.Defines);
 	}
 
-	void EndTiming(ID3D12GraphicsCommandList* CommandList)
+	std::string GetPath(uint64_t Key) const
 	{
-		CommandList->EndQuery(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 1);
-		CommandList->ResolveQueryData(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, TimestampReadback, 0);
+		return GetShaderCachePath(Directory, Key);
 	}
 
-	void GetTiming(uint64_t* OutStart, uint64_t* OutEnd)
+	ID3DBlob* Load(uint64_t Key) const
 	{
-		void* pPixelData = nullptr;
-		HRESULT hr = TimestampReadback->Map(0, nullptr, &pPixelData);
-		ASSERT(SUCCEEDED(hr));
-
-		*OutStart = ((uint64_t*)pPixelData)[0];
-		*OutEnd = ((uint64_t*)pPixelData)[1];
-
-		TimestampReadback->Unmap(0, nullptr);
+		std::vector<uint8_t> Data;
+		ID3DBlob* ByteCode = nullptr;
+		if (!Directory.empty() && ReadShaderCacheFile(GetPath(Key), Key, Data) && SUCCEEDED(D3DCreateBlob(Data.size(), &ByteCode)))
+		{
+			memcpy(ByteCode->GetBufferPointer(), Data.data(), Data.size());
+		}
+		return ByteCode;
 	}
-};
-
-int main(int argc, char** argv) {
 
-	//ID3D12Debug1* D3D12DebugLayer = nullptr;
-	//D3D12GetDebugInterface(IID_PPV_ARGS(&D3D12DebugLayer));
-	//D3D12DebugLayer->EnableDebugLayer();
+	void Store(uint64_t Key, ID3DBlob* ByteCode) const
+	{
+		if (!Directory.empty())
+		{
+			WriteShaderCacheFile(GetPath(Key), Key, ByteCode->GetBufferPointer(), ByteCode->GetBufferSize());
+		}
+	}
 
+	// Takes Request's bytecode from the embedded table, else loads it from the cache, else compiles and stores it
+	bool Get(ShaderCompileRequest& Request) const
+	{
+		const EmbeddedShader* Embedded = bUseEmbedded ? FindEmbeddedShader(Request) : nullptr;
+		if (Embedded && SUCCEEDED(D3DCreateBlob(Embedded->ByteCodeSize, &Request.ByteCode)))
+		{
+			memcpy(Request.ByteCode->GetBufferPointer(), Embedded->ByteCode, Embedded->ByteCodeSize);
+			Request.bEmbedded = true;
+			return true;
+		}
 
-	IDXGIFactory2* DXGIFactory = nullptr;
+		const uint64_t Key = GetKey(Request);
+		Request.ByteCode = Load(Key);
+		Request.bFromCache = Request.ByteCode != nullptr;
+		if (Request.bFromCache)
+		{
+			return true;
+		}
 
-	HRESULT hr = CreateDXGIFactory(IID_PPV_ARGS(&DXGIFactory));
-	ASSERT(SUCCEEDED(hr));
+		ID3DBlob* ErrorMsg = nullptr;
+		HRESULT hr = Compile(Request, &Request.ByteCode, &ErrorMsg);
+		if (ErrorMsg)
+		{
+			LOG("%s (%s): %s", Request.Name, Request.EntryPoint, (const char*)ErrorMsg->GetBufferPointer());
+			ErrorMsg->Release();
+		}
+		if (FAILED(hr) || Request.ByteCode == nullptr)
+		{
+			return false;
+		}
 
-	IDXGIAdapter* ChosenAdapter = nullptr;
+		Store(Key, Request.ByteCode);
+		return true;
+	}
 
+	// Gets every request, compiling the cache misses in parallel. Returns false if any failed to compile.
+	bool GetAll(ShaderCompileRequest* Requests, int Count) const
 	{
-		IDXGIAdapter* Adapter = nullptr;
-		for (int AdapterIndex = 0; true; AdapterIndex++) {
-			hr = DXGIFactory->EnumAdapters(AdapterIndex, &Adapter);
-			if (!SUCCEEDED(hr)) {
-				break;
-			}
-
-			DXGI_ADAPTER_DESC AdapterDesc = {};
-			Adapter->GetDesc(&AdapterDesc);
+		struct GetAllContext
+		{
+			const ShaderCache* Cache;
+			ShaderCompileRequest* Requests;
+			std::atomic<int> Failures;
+		};
+		GetAllContext Context = { this, Requests, { 0 } };
 
-			// Avoid the WARP adapter or Intel (which will likely be integrated)
-			if (AdapterDesc.VendorId != 0x1414 && AdapterDesc.VendorId != 0x8086) {
-				ChosenAdapter = Adapter;
+		ParallelFor(Count, [](void* Ctx, int i)
+		{
+			GetAllContext* Context = (GetAllContext*)Ctx;
+			if (!Context->Cache->Get(Context->Requests[i]))
+			{
+				Context->Failures++;
 			}
+		}, &Context);
 
-			OutputDebugStringW(L"\nAdapter: ");
-			OutputDebugStringW(AdapterDesc.Description);
-
-			LOG("\nvendor = %X device = %X\nDedicated vid mem: %lld  Dedicated system mem: %lld  Shared system mem: %lld\n",
-				AdapterDesc.VendorId, AdapterDesc.DeviceId,
-				AdapterDesc.DedicatedVideoMemory, AdapterDesc.DedicatedSystemMemory, AdapterDesc.SharedSystemMemory);
-		}
+		return Context.Failures == 0;
 	}
+};
 
-	ASSERT(ChosenAdapter != nullptr);
+const char* ShaderCacheDirectory = "shader_cache";
+bool bUseEmbeddedShaders = true;
 
+uint64_t HashRootSignatureDesc(const D3D12_ROOT_SIGNATURE_DESC& Desc)
+{
+	PipelineDescHasher Hasher;
+	Hasher.Add(Desc.Flags);
+	Hasher.Add(Desc.NumParameters);
+	for (UINT i = 0; i < Desc.NumParameters; i++)
 	{
-		DXGI_ADAPTER_DESC ChosenAdapterDesc = {};
-		ChosenAdapter->GetDesc(&ChosenAdapterDesc);
-
-		OutputDebugStringW(L"\nChosen Adapter: ");
-		OutputDebugStringW(ChosenAdapterDesc.Description);
-		OutputDebugStringW(L"\n");
+		const D3D12_ROOT_PARAMETER& Param = Desc.pParameters[i];
+		Hasher.Add(Param.ParameterType);
+		Hasher.Add(Param.ShaderVisibility);
+		if (Param.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+		{
+			Hasher.Add(Param.DescriptorTable.NumDescriptorRanges);
+			for (UINT j = 0; j < Param.DescriptorTable.NumDescriptorRanges; j++)
+			{
+				const D3D12_DESCRIPTOR_RANGE& Range = Param.DescriptorTable.pDescriptorRanges[j];
+				Hasher.Add(Range.RangeType);
+				Hasher.Add(Range.NumDescriptors);
+				Hasher.Add(Range.BaseShaderRegister);
+				Hasher.Add(Range.RegisterSpace);
+				Hasher.Add(Range.OffsetInDescriptorsFromTableStart);
+			}
+		}
+		else if (Param.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+		{
+			Hasher.Add(Param.Constants.ShaderRegister);
+			Hasher.Add(Param.Constants.RegisterSpace);
+			Hasher.Add(Param.Constants.Num32BitValues);
+		}
+		else
+		{
+			Hasher.Add(Param.Descriptor.ShaderRegister);
+			Hasher.Add(Param.Descriptor.RegisterSpace);
+		}
 	}
+	Hasher.Add(Desc.NumStaticSamplers);
+	for (UINT i = 0; i < Desc.NumStaticSamplers; i++)
+	{
+		const D3D12_STATIC_SAMPLER_DESC& Sampler = Desc.pStaticSamplers[i];
+		Hasher.Add(Sampler.Filter);
+		Hasher.Add(Sampler.AddressU);
+		Hasher.Add(Sampler.AddressV);
+		Hasher.Add(Sampler.AddressW);
+		Hasher.Add(Sampler.MipLODBias);
+		Hasher.Add(Sampler.MaxAnisotropy);
+		Hasher.Add(Sampler.ComparisonFunc);
+		Hasher.Add(Sampler.BorderColor);
+		Hasher.Add(Sampler.MinLOD);
+		Hasher.Add(Sampler.MaxLOD);
+		Hasher.Add(Sampler.ShaderRegister);
+		Hasher.Add(Sampler.RegisterSpace);
+		Hasher.Add(Sampler.ShaderVisibility);
+	}
+	return Hasher.Hash;
+}
 
-	ID3D12Device* Device = nullptr;
-	hr = SUCCEEDED(D3D12CreateDevice(ChosenAdapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&Device)));
-	ASSERT(hr);
-
-
-	// NOTE: Requires Developer Mode
-	Device->SetStablePowerState(true);
-
+// The root signature goes in as its own key rather than its pointer, so the hash holds across runs
+uint64_t HashComputePSODesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSigKey)
+{
+	PipelineDescHasher Hasher;
+	Hasher.Add(RootSigKey);
+	Hasher.AddByteCode(Desc.CS.pShaderBytecode, Desc.CS.BytecodeLength);
+	Hasher.Add(Desc.NodeMask);
+	Hasher.Add(Desc.Flags);
+	return Hasher.Hash;
+}
 
-	ID3DBlob* VSByteCode = nullptr;
-	ID3DBlob* PSByteCode = nullptr;
-	ID3DBlob* CSByteCode1x1 = nullptr;
-	ID3DBlob* CSByteCode2x2 = nullptr;
-	ID3DBlob* CSByteCode4x4 = nullptr;
-	ID3DBlob* CSByteCode8x8 = nullptr;
-	ID3DBlob* CSByteCode16x16 = nullptr;
-	ID3DBlob* ErrorMsg = nullptr;
-	UINT CompilerFlags = 0;
-	hr = D3DCompile(VertexShaderCode, strlen(VertexShaderCode), "<VS_SOURCE>", nullptr, nullptr, "VSMain", "vs_5_0", CompilerFlags, 0, &VSByteCode, &ErrorMsg);
-	if (ErrorMsg)
+uint64_t HashGraphicsPSODesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSigKey)
+{
+	// Stream output isn't used here, so it isn't hashed
+	ASSERT(Desc.StreamOutput.NumEntries == 0);
+
+	PipelineDescHasher Hasher;
+	Hasher.Add(RootSigKey);
+	Hasher.AddByteCode(Desc.VS.pShaderBytecode, Desc.VS.BytecodeLength);
+	Hasher.AddByteCode(Desc.PS.pShaderBytecode, Desc.PS.BytecodeLength);
+	Hasher.AddByteCode(Desc.DS.pShaderBytecode, Desc.DS.BytecodeLength);
+	Hasher.AddByteCode(Desc.HS.pShaderBytecode, Desc.HS.BytecodeLength);
+	Hasher.AddByteCode(Desc.GS.pShaderBytecode, Desc.GS.BytecodeLength);
+
+	const D3D12_BLEND_DESC& Blend = Desc.BlendState;
+	Hasher.Add(Blend.AlphaToCoverageEnable);
+	Hasher.Add(Blend.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& Target : Blend.RenderTarget)
 	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
+		Hasher.Add(Target.BlendEnable);
+		Hasher.Add(Target.LogicOpEnable);
+		Hasher.Add(Target.SrcBlend);
+		Hasher.Add(Target.DestBlend);
+		Hasher.Add(Target.BlendOp);
+		Hasher.Add(Target.SrcBlendAlpha);
+		Hasher.Add(Target.DestBlendAlpha);
+		Hasher.Add(Target.BlendOpAlpha);
+		Hasher.Add(Target.LogicOp);
+		Hasher.Add(Target.RenderTargetWriteMask);
 	}
-	ASSERT(SUCCEEDED(hr));
-
-	hr = D3DCompile(PixelShaderCode, strlen(PixelShaderCode), "<PS_SOURCE>", nullptr, nullptr, "PSMain", "ps_5_0", CompilerFlags, 0, &PSByteCode, &ErrorMsg);
-	if (ErrorMsg)
+	Hasher.Add(Desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& Raster = Desc.RasterizerState;
+	Hasher.Add(Raster.FillMode);
+	Hasher.Add(Raster.CullMode);
+	Hasher.Add(Raster.FrontCounterClockwise);
+	Hasher.Add(Raster.DepthBias);
+	Hasher.Add(Raster.DepthBiasClamp);
+	Hasher.Add(Raster.SlopeScaledDepthBias);
+	Hasher.Add(Raster.DepthClipEnable);
+	Hasher.Add(Raster.MultisampleEnable);
+	Hasher.Add(Raster.AntialiasedLineEnable);
+	Hasher.Add(Raster.ForcedSampleCount);
+	Hasher.Add(Raster.ConservativeRaster);
+
+	const D3D12_DEPTH_STENCIL_DESC& DepthStencil = Desc.DepthStencilState;
+	Hasher.Add(DepthStencil.DepthEnable);
+	Hasher.Add(DepthStencil.DepthWriteMask);
+	Hasher.Add(DepthStencil.DepthFunc);
+	Hasher.Add(DepthStencil.StencilEnable);
+	Hasher.Add(DepthStencil.StencilReadMask);
+	Hasher.Add(DepthStencil.StencilWriteMask);
+	for (const D3D12_DEPTH_STENCILOP_DESC* Face : { &DepthStencil.FrontFace, &DepthStencil.BackFace })
 	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
+		Hasher.Add(Face->StencilFailOp);
+		Hasher.Add(Face->StencilDepthFailOp);
+		Hasher.Add(Face->StencilPassOp);
+		Hasher.Add(Face->StencilFunc);
 	}
-	ASSERT(SUCCEEDED(hr));
 
-	hr = D3DCompile(ComputeShaderCode1x1, strlen(ComputeShaderCode1x1), "<CS_SOURCE>", nullptr, nullptr, "CSMain", "cs_5_0", CompilerFlags, 0, &CSByteCode1x1, &ErrorMsg);
-	if (ErrorMsg)
+	Hasher.Add(Desc.InputLayout.NumElements);
+	for (UINT i = 0; i < Desc.InputLayout.NumElements; i++)
 	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
+		const D3D12_INPUT_ELEMENT_DESC& Element = Desc.InputLayout.pInputElementDescs[i];
+		Hasher.AddString(Element.SemanticName);
+		Hasher.Add(Element.SemanticIndex);
+		Hasher.Add(Element.Format);
+		Hasher.Add(Element.InputSlot);
+		Hasher.Add(Element.AlignedByteOffset);
+		Hasher.Add(Element.InputSlotClass);
+		Hasher.Add(Element.InstanceDataStepRate);
 	}
-	ASSERT(SUCCEEDED(hr));
 
-	hr = D3DCompile(ComputeShaderCode2x2, strlen(ComputeShaderCode2x2), "<CS_SOURCE>", nullptr, nullptr, "CSMain", "cs_5_0", CompilerFlags, 0, &CSByteCode2x2, &ErrorMsg);
-	if (ErrorMsg)
+	Hasher.Add(Desc.IBStripCutValue);
+	Hasher.Add(Desc.PrimitiveTopologyType);
+	Hasher.Add(Desc.NumRenderTargets);
+	for (DXGI_FORMAT Format : Desc.RTVFormats)
 	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
+		Hasher.Add(Format);
 	}
-	ASSERT(SUCCEEDED(hr));
+	Hasher.Add(Desc.DSVFormat);
+	Hasher.Add(Desc.SampleDesc.Count);
+	Hasher.Add(Desc.SampleDesc.Quality);
+	Hasher.Add(Desc.NodeMask);
+	Hasher.Add(Desc.Flags);
+	return Hasher.Hash;
+}
+
+PipelineCacheFileHeader GetPipelineCacheIdentity(const DXGI_ADAPTER_DESC& AdapterDesc)
+{
+	PipelineCacheFileHeader Identity = {};
+	Identity.Magic = PipelineCacheMagic;
+	Identity.Version = PipelineCacheVersion;
+	Identity.VendorId = AdapterDesc.VendorId;
+	Identity.DeviceId = AdapterDesc.DeviceId;
+	Identity.SubSysId = AdapterDesc.SubSysId;
+	Identity.Revision = AdapterDesc.Revision;
+	return Identity;
+}
+
+// Root signatures and PSOs, created once per distinct desc and kept for the life of the device. PSOs are
+// also stored in an ID3D12PipelineLibrary that is written next to the shader cache at shutdown, so a
+// warm run loads them back instead of having the driver compile them again. Everything returned is owned
+// by the cache; callers don't release it.
+struct PipelineCache
+{
+	ID3D12Device* Device = nullptr;
+	ID3D12PipelineLibrary* Library = nullptr;
+	std::vector<uint8_t> LibraryData;	// The library reads pipelines out of this lazily, so it lives as long as Library
+	std::string LibraryPath;
+	PipelineCacheFileHeader Identity = {};
+	bool bLibraryChanged = false;
+
+	std::unordered_map<uint64_t, ID3D12RootSignature*> RootSignatures;
+	std::unordered_map<ID3D12RootSignature*, uint64_t> RootSignatureKeys;
+	std::unordered_map<uint64_t, ID3D12PipelineState*> PipelineStates;
+
+	int Lookups = 0;
+	int Hits = 0;
+	int PSOsLoaded = 0;
+	int PSOsCreated = 0;
+	double LookupSeconds = 0.0;	// Everything spent in the Get functions, hits included
+
+	// An empty directory keeps the cache in memory, without a pipeline library
+	void Init(ID3D12Device* InDevice, const DXGI_ADAPTER_DESC& AdapterDesc, const char* Directory)
+	{
+		Device = InDevice;
+		Identity = GetPipelineCacheIdentity(AdapterDesc);
+
+		ID3D12Device1* Device1 = nullptr;
+		if (Directory[0] == '\0' || FAILED(Device->QueryInterface(IID_PPV_ARGS(&Device1))))
+		{
+			return;
+		}
+
+		PlatformCreateDirectory(Directory);
+		LibraryPath = std::string(Directory) + "/pipelines.bin";
+
+		// A library from another driver version fails here, and is replaced with an empty one
+		HRESULT hr = E_FAIL;
+		if (ReadPipelineCacheFile(LibraryPath, Identity, LibraryData))
+		{
+			hr = Device1->CreatePipelineLibrary(LibraryData.data(), LibraryData.size(), IID_PPV_ARGS(&Library));
+		}
+		if (FAILED(hr))
+		{
+			LibraryData.clear();
+			hr = Device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&Library));
+			bLibraryChanged = true;
+		}
+		if (FAILED(hr))
+		{
+			Library = nullptr;
+		}
+		Device1->Release();
+	}
+
+	void Shutdown()
+	{
+		if (Library && bLibraryChanged)
+		{
+			std::vector<uint8_t> Serialized(Library->GetSerializedSize());
+			if (SUCCEEDED(Library->Serialize(Serialized.data(), Serialized.size())))
+			{
+				WritePipelineCacheFile(LibraryPath, Identity, Serialized.data(), Serialized.size());
+			}
+		}
+
+		for (auto& Entry : PipelineStates)
+		{
+			Entry.second->Release();
+		}
+		for (auto& Entry : RootSignatures)
+		{
+			Entry.second->Release();
+		}
+		PipelineStates.clear();
+		RootSignatures.clear();
+		RootSignatureKeys.clear();
+
+		if (Library)
+		{
+			Library->Release();
+			Library = nullptr;
+		}
+		LibraryData.clear();
+	}
+
+	ID3D12RootSignature* GetRootSignature(const D3D12_ROOT_SIGNATURE_DESC& Desc)
+	{
+		auto Start = std::chrono::high_resolution_clock::now();
+		Lookups++;
+
+		const uint64_t Key = HashRootSignatureDesc(Desc);
+		auto It = RootSignatures.find(Key);
+		if (It != RootSignatures.end())
+		{
+			Hits++;
+			LookupSeconds += GetElapsedSeconds(Start);
+			return It->second;
+		}
+
+		ID3DBlob* RootSigBlob = nullptr;
+		ID3DBlob* RootSigErrorBlob = nullptr;
+
+		HRESULT hr = D3D12SerializeRootSignature(&Desc, D3D_ROOT_SIGNATURE_VERSION_1, &RootSigBlob, &RootSigErrorBlob);
+
+		if (!SUCCEEDED(hr))
+		{
+			const char* ErrStr = (const char*)RootSigErrorBlob->GetBufferPointer();
+			int32 ErrStrLen = RootSigErrorBlob->GetBufferSize();
+			LOG("Root Sig Err: '%.*s'", ErrStrLen, ErrStr);
+		}
+
+		ASSERT(SUCCEEDED(hr));
+
+		ID3D12RootSignature* RootSig = nullptr;
+		hr = Device->CreateRootSignature(0, RootSigBlob->GetBufferPointer(), RootSigBlob->GetBufferSize(), IID_PPV_ARGS(&RootSig));
+
+		ASSERT(SUCCEEDED(hr));
+
+		RootSigBlob->Release();
+
+		RootSignatures[Key] = RootSig;
+		RootSignatureKeys[RootSig] = Key;
+		LookupSeconds += GetElapsedSeconds(Start);
+		return RootSig;
+	}
+
+	ID3D12PipelineState* GetComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc)
+	{
+		return GetPipelineState(Desc, HashComputePSODesc(Desc, GetRootSignatureKey(Desc.pRootSignature)));
+	}
+
+	ID3D12PipelineState* GetGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc)
+	{
+		return GetPipelineState(Desc, HashGraphicsPSODesc(Desc, GetRootSignatureKey(Desc.pRootSignature)));
+	}
+
+	void LogStats() const
+	{
+		LOG("Pipeline cache: %d lookups, %.1f%% hits, %d PSOs loaded from the library, %d created, %.2f ms total",
+			Lookups, Lookups ? 100.0 * Hits / Lookups : 0.0, PSOsLoaded, PSOsCreated, LookupSeconds * 1000.0);
+	}
+
+private:
+	// Only root signatures from this cache have a key
+	uint64_t GetRootSignatureKey(ID3D12RootSignature* RootSig) const
+	{
+		auto It = RootSignatureKeys.find(RootSig);
+		ASSERT(It != RootSignatureKeys.end());
+		return It != RootSignatureKeys.end() ? It->second : 0;
+	}
+
+	HRESULT LoadPipeline(LPCWSTR Name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PSO)
+	{
+		return Library->LoadComputePipeline(Name, &Desc, IID_PPV_ARGS(PSO));
+	}
+
+	HRESULT LoadPipeline(LPCWSTR Name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PSO)
+	{
+		return Library->LoadGraphicsPipeline(Name, &Desc, IID_PPV_ARGS(PSO));
+	}
+
+	HRESULT CreatePipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PSO)
+	{
+		return Device->CreateComputePipelineState(&Desc, IID_PPV_ARGS(PSO));
+	}
+
+	HRESULT CreatePipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PSO)
+	{
+		return Device->CreateGraphicsPipelineState(&Desc, IID_PPV_ARGS(PSO));
+	}
+
+	template <typename DescType>
+	ID3D12PipelineState* GetPipelineState(const DescType& Desc, uint64_t Key)
+	{
+		auto Start = std::chrono::high_resolution_clock::now();
+		Lookups++;
+
+		auto It = PipelineStates.find(Key);
+		if (It != PipelineStates.end())
+		{
+			Hits++;
+			LookupSeconds += GetElapsedSeconds(Start);
+			return It->second;
+		}
+
+		wchar_t Name[24] = {};
+		swprintf(Name, sizeof(Name) / sizeof(Name[0]), L"%016llx", (unsigned long long)Key);
+
+		ID3D12PipelineState* PSO = nullptr;
+		if (Library && SUCCEEDED(LoadPipeline(Name, Desc, &PSO)))
+		{
+			PSOsLoaded++;
+		}
+		else
+		{
+			HRESULT hr = CreatePipeline(Desc, &PSO);
+			ASSERT(SUCCEEDED(hr));
+			PSOsCreated++;
+
+			if (Library && SUCCEEDED(Library->StorePipeline(Name, PSO)))
+			{
+				bLibraryChanged = true;
+			}
+		}
+
+		PipelineStates[Key] = PSO;
+		LookupSeconds += GetElapsedSeconds(Start);
+		return PSO;
+	}
+};
+
+int GetBytesPerPixel(DXGI_FORMAT Format)
+{
+	switch (Format)
+	{
+	case DXGI_FORMAT_R8_UNORM: return 1;
+	case DXGI_FORMAT_R8G8_UNORM: return 2;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT: return 4;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return 8;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+	default: return 0;
+	}
+}
+
+// The row converters' name for Format, which has to be one they take
+ConvertFormat GetConvertFormat(DXGI_FORMAT Format)
+{
+	switch (Format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM: return ConvertFormat::R8G8B8A8;
+	case DXGI_FORMAT_B8G8R8A8_UNORM: return ConvertFormat::B8G8R8A8;
+	case DXGI_FORMAT_R10G10B10A2_UNORM: return ConvertFormat::R10G10B10A2;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return ConvertFormat::R16G16B16A16F;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return ConvertFormat::R32G32B32A32F;
+	default:
+		ASSERT(false);
+		return ConvertFormat::R8G8B8A8;
+	}
+}
+
+enum class DumpFormat
+{
+	PNG,	// smallest, slowest to encode
+	QOI,	// lossless, several times faster than PNG at a somewhat larger size
+	Raw,	// uncompressed with a small header, for mapping straight into analysis tools
+};
+
+DumpFormat DefaultDumpFormat = DumpFormat::PNG;
+
+// The GPU benchmarks' resource pool releases idle resources to stay under this
+int ResourcePoolBudgetMB = 512;
+
+// Swaps the extension of Filename for the one matching Format
+std::string GetDumpFilename(const char* Filename, DumpFormat Format)
+{
+	const char* Extensions[] = { ".png", ".qoi", ".raw" };
+	std::string Result = Filename;
+	size_t Dot = Result.find_last_of('.');
+	if (Dot != std::string::npos && Result.find_first_of("/\\", Dot) == std::string::npos)
+	{
+		Result.resize(Dot);
+	}
+	return Result + Extensions[(int)Format];
+}
+
+// Number of 8 bit channels for formats the PNG and QOI writers take as-is, 0 for formats that need converting first
+int GetWriterComponents(DXGI_FORMAT PixelFormat)
+{
+	switch (PixelFormat)
+	{
+	case DXGI_FORMAT_R8_UNORM: return 1;
+	case DXGI_FORMAT_R8G8_UNORM: return 2;
+	case DXGI_FORMAT_R8G8B8A8_UNORM: return 4;
+	default: return 0;
+	}
+}
+
+// Raw dumps keep the texture's own bytes, the other formats need PixelFormat to be one GetWriterComponents accepts
+bool WriteImageFile(const char* Filename, DumpFormat Format, int Width, int Height, DXGI_FORMAT PixelFormat, const void* Pixels, int Pitch)
+{
+	const int Comp = GetWriterComponents(PixelFormat);
+	switch (Format)
+	{
+	case DumpFormat::QOI:
+		return stbi_write_qoi(Filename, Width, Height, Comp, Pixels, Pitch) != 0;
+	case DumpFormat::Raw:
+		return stbi_write_raw(Filename, Width, Height, PixelFormat, GetBytesPerPixel(PixelFormat), Pixels, Pitch) != 0;
+	default:
+		return stbi_write_png(Filename, Width, Height, Comp, Pixels, Pitch) != 0;
+	}
+}
+
+// Encodes a PNG straight from (possibly pitched) rows, e.g. a mapped readback buffer, without
+// holding a packed copy, the filtered image or the compressed image in memory. Formats the
+// writer can't take directly are converted a band of rows at a time.
+bool StreamPNGToFile(const char* Filename, int Width, int Height, DXGI_FORMAT PixelFormat, const void* Pixels, int Pitch)
+{
+	FILE* File = nullptr;
+	if (fopen_s(&File, Filename, "wb") != 0 || File == nullptr)
+	{
+		return false;
+	}
+
+	const int Comp = GetWriterComponents(PixelFormat);
+	if (Pitch == 0)
+	{
+		Pitch = Width * GetBytesPerPixel(PixelFormat);
+	}
+
+	auto WriteToFile = [](void* Context, void* Data, int Size) { fwrite(Data, 1, Size, (FILE*)Context); };
+	stbi_png_stream* Stream = stbi_write_png_stream_begin(WriteToFile, File, Width, Height, Comp != 0 ? Comp : 4);
+	bool bSuccess = Stream != nullptr;
+	if (bSuccess && Comp != 0)
+	{
+		bSuccess = stbi_write_png_stream_rows(Stream, Pixels, Height, Pitch) != 0;
+	}
+	else if (bSuccess)
+	{
+		const int BandRows = 64;
+		std::vector<uint8_t> Band((size_t)Width * 4 * BandRows);
+		for (int y = 0; y < Height && bSuccess; y += BandRows)
+		{
+			int NumRows = Height - y < BandRows ? Height - y : BandRows;
+			ConvertToRGBA8((const uint8_t*)Pixels + (size_t)y * Pitch, Pitch, GetConvertFormat(PixelFormat), Width, NumRows, Band.data());
+			bSuccess = stbi_write_png_stream_rows(Stream, Band.data(), NumRows, 0) != 0;
+		}
+	}
+	bSuccess = stbi_write_png_stream_end(Stream) != 0 && bSuccess;
+
+	fclose(File);
+	return bSuccess;
+}
+
+// Encodes and writes image dumps on a small pool of worker threads, so the benchmark
+// setup doesn't stall on PNG encoding. The queue owns a tightly packed copy of the pixels,
+// so callers can unmap their resources as soon as Enqueue returns. Pixels in formats the
+// PNG and QOI writers can't take (BGRA, 10 bit, float) are converted to RGBA8 on the way in;
+// raw dumps keep the texture's own bytes and format.
+struct ImageDumpQueue
+{
+	struct DumpJob
+	{
+		std::string Filename;
+		int Width = 0;
+		int Height = 0;
+		DXGI_FORMAT PixelFormat = DXGI_FORMAT_UNKNOWN;
+		DumpFormat Format = DumpFormat::PNG;
+		std::vector<uint8_t> Pixels;
+	};
+
+	std::mutex Mutex;
+	std::condition_variable WorkAvailable;
+	std::condition_variable SpaceAvailable;
+	std::condition_variable QueueIdle;
+
+	std::deque<DumpJob> PendingJobs;
+	std::vector<std::thread> Workers;
+
+	// Hash of the pixels most recently queued for each filename, so identical dumps are skipped
+	std::unordered_map<std::string, uint64_t> LastContentHash;
+
+	// Files a worker is encoding right now
+	std::vector<std::string> ActiveFilenames;
+
+	size_t PendingBytes = 0;
+	size_t MaxPendingBytes = 0;
+	int ActiveJobs = 0;
+	bool ShuttingDown = false;
+
+	int WrittenCount = 0;
+	int SupersededCount = 0;
+	int DuplicateCount = 0;
+
+	void Start(int NumWorkers, size_t InMaxPendingBytes)
+	{
+		MaxPendingBytes = InMaxPendingBytes;
+		for (int i = 0; i < NumWorkers; i++)
+		{
+			Workers.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	// What LastContentHash keeps: the pixels as handed in, before any conversion, so every way of dumping
+	// the same image to a file hashes the same
+	static uint64_t HashDumpPixels(int Width, int Height, DXGI_FORMAT PixelFormat, const void* Pixels, int Pitch)
+	{
+		const int RowBytes = Width * GetBytesPerPixel(PixelFormat);
+		uint64_t Hash = HashBytes(&Width, sizeof(Width)) ^ Height;
+		Hash = HashBytes(&PixelFormat, sizeof(PixelFormat), Hash);
+		for (int y = 0; y < Height; y++)
+		{
+			Hash = HashBytes((const uint8_t*)Pixels + (size_t)y * (Pitch != 0 ? Pitch : RowBytes), RowBytes, Hash);
+		}
+		return Hash;
+	}
+
+	// Takes ownership of tightly packed pixel data. Filename's extension is replaced to match Format.
+	void Enqueue(const char* Filename, int Width, int Height, DXGI_FORMAT PixelFormat, std::vector<uint8_t>&& Pixels, DumpFormat Format = DefaultDumpFormat)
+	{
+		ASSERT(Pixels.size() == (size_t)Width * Height * GetBytesPerPixel(PixelFormat));
+
+		const uint64_t ContentHash = HashDumpPixels(Width, Height, PixelFormat, Pixels.data(), 0);
+		if (Format != DumpFormat::Raw && GetWriterComponents(PixelFormat) == 0)
+		{
+			std::vector<uint8_t> Converted((size_t)Width * Height * 4);
+			ConvertToRGBA8(Pixels.data(), 0, GetConvertFormat(PixelFormat), Width, Height, Converted.data());
+			Pixels = std::move(Converted);
+			PixelFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		EnqueuePacked(GetDumpFilename(Filename, Format), ContentHash, Width, Height, PixelFormat, std::move(Pixels), Format);
+	}
+
+	// Copies the pixels out of (possibly pitched) memory, e.g. a mapped readback buffer,
+	// converting them in the same pass when the writer needs a different layout
+	void Enqueue(const char* Filename, int Width, int Height, DXGI_FORMAT PixelFormat, const void* Pixels, int Pitch, DumpFormat Format = DefaultDumpFormat)
+	{
+		int RowBytes = Width * GetBytesPerPixel(PixelFormat);
+		if (Pitch == 0)
+		{
+			Pitch = RowBytes;
+		}
+
+		const uint64_t ContentHash = HashDumpPixels(Width, Height, PixelFormat, Pixels, Pitch);
+		if (Format != DumpFormat::Raw && GetWriterComponents(PixelFormat) == 0)
+		{
+			std::vector<uint8_t> Converted((size_t)Width * Height * 4);
+			ConvertToRGBA8(Pixels, Pitch, GetConvertFormat(PixelFormat), Width, Height, Converted.data());
+			EnqueuePacked(GetDumpFilename(Filename, Format), ContentHash, Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM, std::move(Converted), Format);
+			return;
+		}
+
+		std::vector<uint8_t> PackedPixels((size_t)RowBytes * Height);
+		for (int y = 0; y < Height; y++)
+		{
+			memcpy(&PackedPixels[(size_t)y * RowBytes], (const uint8_t*)Pixels + (size_t)y * Pitch, RowBytes);
+		}
+
+		EnqueuePacked(GetDumpFilename(Filename, Format), ContentHash, Width, Height, PixelFormat, std::move(PackedPixels), Format);
+	}
+
+	// For images too big to queue a copy of: encodes a PNG out of (possibly pitched) memory on this thread,
+	// under the same rules as Enqueue. An identical dump is skipped, one still queued for the file is
+	// dropped as superseded, and one a worker is encoding is waited for so the two can't write the file
+	// at once. A file is dumped from one thread at a time.
+	void WriteStreamedPNG(const char* InFilename, int Width, int Height, DXGI_FORMAT PixelFormat, const void* Pixels, int Pitch)
+	{
+		const std::string Filename = GetDumpFilename(InFilename, DumpFormat::PNG);
+		const uint64_t ContentHash = HashDumpPixels(Width, Height, PixelFormat, Pixels, Pitch);
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			if (IsDuplicate(Filename, ContentHash))
+			{
+				return;
+			}
+
+			for (auto It = PendingJobs.begin(); It != PendingJobs.end(); ++It)
+			{
+				if (It->Filename == Filename)
+				{
+					PendingBytes -= It->Pixels.size();
+					PendingJobs.erase(It);
+					SupersededCount++;
+					SpaceAvailable.notify_all();
+					break;
+				}
+			}
+			QueueIdle.wait(Lock, [&]() { return std::find(ActiveFilenames.begin(), ActiveFilenames.end(), Filename) == ActiveFilenames.end(); });
+		}
+
+		StreamPNGToFile(Filename.c_str(), Width, Height, PixelFormat, Pixels, Pitch);
 
-	hr = D3DCompile(ComputeShaderCode4x4, strlen(ComputeShaderCode4x4), "<CS_SOURCE>", nullptr, nullptr, "CSMain", "cs_5_0", CompilerFlags, 0, &CSByteCode4x4, &ErrorMsg);
-	if (ErrorMsg)
+		std::lock_guard<std::mutex> Lock(Mutex);
+		WrittenCount++;
+	}
+
+	// With Mutex held. Counts and returns true if ContentHash is what was last dumped to Filename,
+	// otherwise records it.
+	bool IsDuplicate(const std::string& Filename, uint64_t ContentHash)
+	{
+		auto HashIt = LastContentHash.find(Filename);
+		if (HashIt != LastContentHash.end() && HashIt->second == ContentHash)
+		{
+			DuplicateCount++;
+			return true;
+		}
+		LastContentHash[Filename] = ContentHash;
+		return false;
+	}
+
+	// Filename already has its extension, and Pixels are packed in a format the writer for Format takes
+	void EnqueuePacked(const std::string& Filename, uint64_t ContentHash, int Width, int Height, DXGI_FORMAT PixelFormat, std::vector<uint8_t>&& Pixels, DumpFormat Format)
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		if (IsDuplicate(Filename, ContentHash))
+		{
+			return;
+		}
+
+		// A dump that hasn't started yet would just be overwritten on disk, so replace it in place
+		for (DumpJob& Job : PendingJobs)
+		{
+			if (Job.Filename == Filename)
+			{
+				PendingBytes -= Job.Pixels.size();
+				PendingBytes += Pixels.size();
+				Job.Width = Width;
+				Job.Height = Height;
+				Job.PixelFormat = PixelFormat;
+				Job.Format = Format;
+				Job.Pixels = std::move(Pixels);
+				SupersededCount++;
+				return;
+			}
+		}
+
+		// Back-pressure: block the producer until the workers have caught up,
+		// but always let a single job through so oversized images can't deadlock
+		SpaceAvailable.wait(Lock, [&]() { return PendingBytes == 0 || PendingBytes + Pixels.size() <= MaxPendingBytes; });
+
+		DumpJob Job;
+		Job.Filename = Filename;
+		Job.Width = Width;
+		Job.Height = Height;
+		Job.PixelFormat = PixelFormat;
+		Job.Format = Format;
+		Job.Pixels = std::move(Pixels);
+
+		PendingBytes += Job.Pixels.size();
+		PendingJobs.push_back(std::move(Job));
+		WorkAvailable.notify_one();
+	}
+
+	void WorkerLoop()
+	{
+		while (true)
+		{
+			DumpJob Job;
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				WorkAvailable.wait(Lock, [&]() { return ShuttingDown || !PendingJobs.empty(); });
+				if (PendingJobs.empty())
+				{
+					return;
+				}
+
+				Job = std::move(PendingJobs.front());
+				PendingJobs.pop_front();
+				ActiveJobs++;
+				ActiveFilenames.push_back(Job.Filename);
+			}
+
+			WriteImageFile(Job.Filename.c_str(), Job.Format, Job.Width, Job.Height, Job.PixelFormat, Job.Pixels.data(), 0);
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				PendingBytes -= Job.Pixels.size();
+				ActiveJobs--;
+				ActiveFilenames.erase(std::find(ActiveFilenames.begin(), ActiveFilenames.end(), Job.Filename));
+				WrittenCount++;
+			}
+			SpaceAvailable.notify_all();
+			QueueIdle.notify_all();
+		}
+	}
+
+	// Blocks until every queued dump has been written
+	void Flush()
 	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
+		std::unique_lock<std::mutex> Lock(Mutex);
+		QueueIdle.wait(Lock, [&]() { return PendingJobs.empty() && ActiveJobs == 0; });
 	}
+
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			ShuttingDown = true;
+		}
+		WorkAvailable.notify_all();
+
+		for (std::thread& Worker : Workers)
+		{
+			Worker.join();
+		}
+		Workers.clear();
+
+		LOG("Image dumps: %d written, %d superseded before encoding, %d skipped as duplicates", WrittenCount, SupersededCount, DuplicateCount);
+	}
+};
+
+ImageDumpQueue DumpQueue;
+
+void SetTextureUploadRandomBytes(const char* Filename, ID3D12Resource* TextureUploadResource, int BufferSize, int Width, int Height, int Pitch)
+{
+	// Generate the data in cached memory: the upload heap is write-combined, so the dump must not read it back
+	std::vector<uint8_t> PixelData(BufferSize);
+	for (int i = 0; i < BufferSize; i++)
+	{
+		PixelData[i] = (uint8_t)(rand() % 256);
+	}
+
+	void* pTexturePixelData = nullptr;
+	HRESULT hr = TextureUploadResource->Map(0, nullptr, &pTexturePixelData);
 	ASSERT(SUCCEEDED(hr));
 
-	hr = D3DCompile(ComputeShaderCode8x8, strlen(ComputeShaderCode8x8), "<CS_SOURCE>", nullptr, nullptr, "CSMain", "cs_5_0", CompilerFlags, 0, &CSByteCode8x8, &ErrorMsg);
-	if (ErrorMsg)
-	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
-	}
-	ASSERT(SUCCEEDED(hr));
+	memcpy(pTexturePixelData, PixelData.data(), BufferSize);
+
+	TextureUploadResource->Unmap(0, nullptr);
+
+	if (Pitch == Width * 4)
+	{
+		DumpQueue.Enqueue(Filename, Width, Height, DXGI_FORMAT_B8G8R8A8_UNORM, std::move(PixelData));
+	}
+	else
+	{
+		DumpQueue.Enqueue(Filename, Width, Height, DXGI_FORMAT_B8G8R8A8_UNORM, PixelData.data(), Pitch);
+	}
+}
+
+void UploadTextureResource(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* TextureUploadResource, ID3D12Resource* TextureResource, int32 Width, int32 Height, int32 Pitch, D3D12_RESOURCE_STATES StartingState)
+{
+	D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
+	CopyLocSrc.pResource = TextureUploadResource;
+	CopyLocSrc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	CopyLocSrc.PlacedFootprint.Offset = 0;
+	CopyLocSrc.PlacedFootprint.Footprint.Width = Width;
+	CopyLocSrc.PlacedFootprint.Footprint.Height = Height;
+	CopyLocSrc.PlacedFootprint.Footprint.Depth = 1;
+	CopyLocSrc.PlacedFootprint.Footprint.RowPitch = Pitch;
+	CopyLocSrc.PlacedFootprint.Footprint.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+	CopyLocDst.pResource = TextureResource;
+	CopyLocDst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	CopyLocDst.SubresourceIndex = 0;
+
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = TextureResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = StartingState;
+		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+
+	CommandList->CopyTextureRegion(&CopyLocDst, 0, 0, 0, &CopyLocSrc, nullptr);
+
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = TextureResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+		Barrier.Transition.StateAfter = StartingState;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+}
+
+void CopyRenderTargetDataToReadback(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* DestResource, ID3D12Resource* ReadbackRT, int RTWidth, int RTHeight, int Pitch, D3D12_RESOURCE_STATES StartingState)
+{
+	D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
+	CopyLocDst.pResource = ReadbackRT;
+	CopyLocDst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	CopyLocDst.PlacedFootprint.Offset = 0;
+	CopyLocDst.PlacedFootprint.Footprint.Width = RTWidth;
+	CopyLocDst.PlacedFootprint.Footprint.Height = RTHeight;
+	CopyLocDst.PlacedFootprint.Footprint.Depth = 1;
+	CopyLocDst.PlacedFootprint.Footprint.RowPitch = Pitch;
+	CopyLocDst.PlacedFootprint.Footprint.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+	CopyLocSrc.pResource = DestResource;
+	CopyLocSrc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	CopyLocSrc.SubresourceIndex = 0;
+
+	//{
+	//	D3D12_RESOURCE_BARRIER Barrier = {};
+	//	Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	//	Barrier.UAV.pResource = DestResource;
+	//
+	//	CommandList->ResourceBarrier(1, &Barrier);
+	//}
+
+	// Transition dest from render target to copy source
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = DestResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = StartingState;
+		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+
+	CommandList->CopyTextureRegion(&CopyLocDst, 0, 0, 0, &CopyLocSrc, nullptr);
+
+	// Transition dest back to render target
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = DestResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		Barrier.Transition.StateAfter = StartingState;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+}
+
+void SetBufferUploadRandomBytes(ID3D12Resource* BufferUploadResource, int BufferSize)
+{
+	void* pBufferData = nullptr;
+	HRESULT hr = BufferUploadResource->Map(0, nullptr, &pBufferData);
+	ASSERT(SUCCEEDED(hr));
+
+	uint8_t* Bytes = (uint8_t*)pBufferData;
+	for (int i = 0; i < BufferSize; i++)
+	{
+		Bytes[i] = (uint8_t)(rand() % 256);
+	}
+
+	BufferUploadResource->Unmap(0, nullptr);
+}
+
+// The buffer versions of UploadTextureResource and CopyRenderTargetDataToReadback
+void UploadBufferResource(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* BufferUploadResource, ID3D12Resource* BufferResource, int BufferSize, D3D12_RESOURCE_STATES StartingState)
+{
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = BufferResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = StartingState;
+		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+
+	CommandList->CopyBufferRegion(BufferResource, 0, BufferUploadResource, 0, BufferSize);
+
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = BufferResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+		Barrier.Transition.StateAfter = StartingState;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+}
+
+void CopyBufferToReadback(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* BufferResource, ID3D12Resource* ReadbackBuffer, int BufferSize, D3D12_RESOURCE_STATES StartingState)
+{
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = BufferResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = StartingState;
+		Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+
+	CommandList->CopyBufferRegion(ReadbackBuffer, 0, BufferResource, 0, BufferSize);
+
+	{
+		D3D12_RESOURCE_BARRIER Barrier = {};
+		Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		Barrier.Transition.pResource = BufferResource;
+		Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		Barrier.Transition.StateAfter = StartingState;
+
+		CommandList->ResourceBarrier(1, &Barrier);
+	}
+}
+
+void WriteReadbackToFile(const char* Filename, ID3D12Resource * RTReadback, int RTWidth, int RTHeight, DumpFormat Format = DefaultDumpFormat)
+{
+	void* pPixelData = nullptr;
+	HRESULT hr = RTReadback->Map(0, nullptr, &pPixelData);
+	ASSERT(SUCCEEDED(hr));
+
+	if (Format == DumpFormat::PNG && (size_t)RTWidth * RTHeight * 4 > DumpQueue.MaxPendingBytes)
+	{
+		// Too big to queue a copy of, so encode it out of the mapped buffer on this thread instead
+		DumpQueue.WriteStreamedPNG(Filename, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, pPixelData, 0);
+	}
+	else
+	{
+		DumpQueue.Enqueue(Filename, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, pPixelData, 0, Format);
+	}
+
+	RTReadback->Unmap(0, nullptr);
+}
+
+// A descriptor heap from DescriptorDevice. Heap is null on the software device, where both handles are
+// host addresses.
+struct DescriptorDeviceHeap
+{
+	ID3D12DescriptorHeap* Heap = nullptr;
+	D3D12_CPU_DESCRIPTOR_HANDLE CPUStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE GPUStart = {};
+	UINT NumDescriptors = 0;
+};
+
+// The descriptor calls the descriptor code makes. With a device they go straight to it; without one they
+// run on host memory, so descriptor batching can be measured and checked on a machine with no GPU.
+struct DescriptorDevice
+{
+	ID3D12Device* Device = nullptr;
+	UINT DescriptorSize = sizeof(SoftwareDescriptor);
+
+	// Null for the software device. Every heap type has the CBV/SRV/UAV size, as on most hardware.
+	void Init(ID3D12Device* InDevice)
+	{
+		Device = InDevice;
+		DescriptorSize = Device ? Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) : sizeof(SoftwareDescriptor);
+	}
+
+	bool IsSoftware() const
+	{
+		return Device == nullptr;
+	}
+
+	UINT GetDescriptorSize(D3D12_DESCRIPTOR_HEAP_TYPE Type) const
+	{
+		return Device ? Device->GetDescriptorHandleIncrementSize(Type) : DescriptorSize;
+	}
+
+	DescriptorDeviceHeap CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE Type, UINT NumDescriptors, bool bShaderVisible)
+	{
+		DescriptorDeviceHeap Result;
+		Result.NumDescriptors = NumDescriptors;
+		if (Device)
+		{
+			D3D12_DESCRIPTOR_HEAP_DESC HeapDesc = {};
+			HeapDesc.Type = Type;
+			HeapDesc.NumDescriptors = NumDescriptors;
+			HeapDesc.Flags = bShaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+			HRESULT hr = Device->CreateDescriptorHeap(&HeapDesc, IID_PPV_ARGS(&Result.Heap));
+			ASSERT(SUCCEEDED(hr));
+			Result.CPUStart = Result.Heap->GetCPUDescriptorHandleForHeapStart();
+			if (bShaderVisible)
+			{
+				Result.GPUStart = Result.Heap->GetGPUDescriptorHandleForHeapStart();
+			}
+		}
+		else
+		{
+			SoftwareDescriptor* Descriptors = new SoftwareDescriptor[NumDescriptors]();
+			Result.CPUStart.ptr = (SIZE_T)Descriptors;
+			Result.GPUStart.ptr = bShaderVisible ? (UINT64)Descriptors : 0;
+		}
+		return Result;
+	}
+
+	void DestroyHeap(DescriptorDeviceHeap& Heap)
+	{
+		if (Heap.Heap)
+		{
+			Heap.Heap->Release();
+		}
+		else
+		{
+			delete[] (SoftwareDescriptor*)Heap.CPUStart.ptr;
+		}
+		Heap = DescriptorDeviceHeap();
+	}
+
+	void CreateShaderResourceView(ID3D12Resource* Resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* Desc, D3D12_CPU_DESCRIPTOR_HANDLE Dst)
+	{
+		if (Device)
+		{
+			Device->CreateShaderResourceView(Resource, Desc, Dst);
+			return;
+		}
+		SoftwareDescriptor* Descriptor = (SoftwareDescriptor*)Dst.ptr;
+		*Descriptor = { (uint64_t)Resource, 1, (uint32_t)Desc->Format, (uint32_t)Desc->ViewDimension, Desc->Texture2D.MostDetailedMip, Desc->Texture2D.PlaneSlice, 0 };
+	}
+
+	void CreateUnorderedAccessView(ID3D12Resource* Resource, ID3D12Resource* CounterResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* Desc, D3D12_CPU_DESCRIPTOR_HANDLE Dst)
+	{
+		if (Device)
+		{
+			Device->CreateUnorderedAccessView(Resource, CounterResource, Desc, Dst);
+			return;
+		}
+		SoftwareDescriptor* Descriptor = (SoftwareDescriptor*)Dst.ptr;
+		*Descriptor = { (uint64_t)Resource, 2, (uint32_t)Desc->Format, (uint32_t)Desc->ViewDimension, Desc->Texture2D.MipSlice, Desc->Texture2D.PlaneSlice, 0 };
+	}
+
+	void CreateRenderTargetView(ID3D12Resource* Resource, const D3D12_RENDER_TARGET_VIEW_DESC* Desc, D3D12_CPU_DESCRIPTOR_HANDLE Dst)
+	{
+		if (Device)
+		{
+			Device->CreateRenderTargetView(Resource, Desc, Dst);
+			return;
+		}
+		SoftwareDescriptor* Descriptor = (SoftwareDescriptor*)Dst.ptr;
+		*Descriptor = { (uint64_t)Resource, 3, (uint32_t)Desc->Format, (uint32_t)Desc->ViewDimension, Desc->Texture2D.MipSlice, Desc->Texture2D.PlaneSlice, 0 };
+	}
+
+	void CopyDescriptorsSimple(UINT NumDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE Dst, D3D12_CPU_DESCRIPTOR_HANDLE Src, D3D12_DESCRIPTOR_HEAP_TYPE Type)
+	{
+		if (Device)
+		{
+			Device->CopyDescriptorsSimple(NumDescriptors, Dst, Src, Type);
+			return;
+		}
+		memcpy((void*)Dst.ptr, (const void*)Src.ptr, (size_t)NumDescriptors * DescriptorSize);
+	}
+
+	// Null sizes mean ranges of one descriptor, as in ID3D12Device::CopyDescriptors
+	void CopyDescriptors(UINT NumDstRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* DstStarts, const UINT* DstSizes,
+		UINT NumSrcRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* SrcStarts, const UINT* SrcSizes, D3D12_DESCRIPTOR_HEAP_TYPE Type)
+	{
+		if (Device)
+		{
+			Device->CopyDescriptors(NumDstRanges, DstStarts, DstSizes, NumSrcRanges, SrcStarts, SrcSizes, Type);
+			return;
+		}
+		CopySoftwareDescriptorRanges(NumDstRanges, DstStarts, DstSizes, NumSrcRanges, SrcStarts, SrcSizes, DescriptorSize);
+	}
+};
+
+// CBV/SRV/UAV descriptors for the GPU tests. Views are created once per resource in a CPU-only staging
+// heap. Each draw or dispatch copies the views it needs into a table in the one shader-visible heap, so
+// binding a table never switches heaps. Tables come from a ring that is reclaimed by fence value, so a
+// slot is only reused once the GPU is done with the work that read it.
+struct DescriptorAllocator
+{
+	static const UINT InvalidSlot = ~0u;
+	static const UINT MaxCopyRanges = 16;
+
+	DescriptorDevice* Device = nullptr;
+	UINT DescriptorSize = 0;
+
+	DescriptorDeviceHeap StagingHeap;
+	BuddyAllocator StagingSlots;	// In descriptors, so a resource's views can be contiguous
+
+	DescriptorDeviceHeap GPUHeap;
+	UINT RingSize = 0;
+	uint64_t RingHead = 0;	// Descriptors ever allocated from the ring, wasted ones at a wrap included
+	uint64_t RingTail = 0;	// Descriptors ever reclaimed
+	uint64_t RetiredHead = 0;
+
+	struct RetiredRange
+	{
+		uint64_t FenceValue;
+		uint64_t Head;
+	};
+	std::deque<RetiredRange> Retired;
+
+	int TablesAllocated = 0;
+	int CopyCalls = 0;
+	int DescriptorsCopied = 0;
+	int RingFull = 0;
+
+	// Both sizes must be powers of two
+	void Init(DescriptorDevice* InDevice, UINT StagingSize, UINT InRingSize)
+	{
+		Device = InDevice;
+		DescriptorSize = Device->GetDescriptorSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+		StagingHeap = Device->CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, StagingSize, false);
+		StagingSlots.Init(StagingSize, 1);
+
+		GPUHeap = Device->CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, InRingSize, true);
+		RingSize = InRingSize;
+		RingHead = RingTail = RetiredHead = 0;
+		Retired.clear();
+	}
+
+	void Shutdown()
+	{
+		Device->DestroyHeap(StagingHeap);
+		Device->DestroyHeap(GPUHeap);
+	}
+
+	// Count contiguous staging slots, or InvalidSlot when the staging heap is full
+	UINT AllocateViews(UINT Count)
+	{
+		uint64_t Slot = StagingSlots.Allocate(Count);
+		return Slot == BuddyAllocator::InvalidOffset ? InvalidSlot : (UINT)Slot;
+	}
+
+	void FreeViews(UINT Slot)
+	{
+		StagingSlots.Free(Slot);
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetStagingHandle(UINT Slot) const
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE Handle = StagingHeap.CPUStart;
+		Handle.ptr += (SIZE_T)Slot * DescriptorSize;
+		return Handle;
+	}
+
+	// Every table lives in the one heap, so this is bound once per command list
+	void Bind(ID3D12GraphicsCommandList* CommandList)
+	{
+		ASSERT(GPUHeap.Heap != nullptr);
+		CommandList->SetDescriptorHeaps(1, &GPUHeap.Heap);
+	}
+
+	// Copies the views at Slots into a new contiguous table. Consecutive staging slots are copied as one
+	// range: a table that is a single run takes one CopyDescriptorsSimple, and one made of several runs
+	// takes one CopyDescriptors per MaxCopyRanges runs. Returns false when the ring is full; Reclaim, or
+	// wait on the GPU first.
+	bool AllocateTable(const UINT* Slots, UINT Count, D3D12_GPU_DESCRIPTOR_HANDLE* OutTable)
+	{
+		ASSERT(Count > 0 && Count <= RingSize);
+
+		// A table doesn't wrap, so the end of the ring is skipped when it doesn't fit
+		uint64_t Start = RingHead;
+		const uint64_t Offset = Start % RingSize;
+		if (Offset + Count > RingSize)
+		{
+			Start += RingSize - Offset;
+		}
+		if (Start + Count - RingTail > RingSize)
+		{
+			RingFull++;
+			return false;
+		}
+		RingHead = Start + Count;
+
+		const UINT TableIndex = (UINT)(Start % RingSize);
+		D3D12_CPU_DESCRIPTOR_HANDLE Dst = GPUHeap.CPUStart;
+		Dst.ptr += (SIZE_T)TableIndex * DescriptorSize;
+
+		D3D12_CPU_DESCRIPTOR_HANDLE RunStarts[MaxCopyRanges];
+		UINT RunSizes[MaxCopyRanges];
+		UINT NumRuns = 0;
+		UINT BatchCount = 0;
+		UINT RunStart = 0;
+		for (UINT i = 1; i <= Count; i++)
+		{
+			if (i < Count && Slots[i] == Slots[i - 1] + 1)
+			{
+				continue;
+			}
+
+			RunStarts[NumRuns] = GetStagingHandle(Slots[RunStart]);
+			RunSizes[NumRuns] = i - RunStart;
+			BatchCount += RunSizes[NumRuns];
+			NumRuns++;
+			RunStart = i;
+
+			if (NumRuns == MaxCopyRanges || i == Count)
+			{
+				if (NumRuns == 1)
+				{
+					Device->CopyDescriptorsSimple(BatchCount, Dst, RunStarts[0], D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+				}
+				else
+				{
+					Device->CopyDescriptors(1, &Dst, &BatchCount, NumRuns, RunStarts, RunSizes, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+				}
+				CopyCalls++;
+				Dst.ptr += (SIZE_T)BatchCount * DescriptorSize;
+				NumRuns = 0;
+				BatchCount = 0;
+			}
+		}
+
+		TablesAllocated++;
+		DescriptorsCopied += Count;
+
+		*OutTable = GPUHeap.GPUStart;
+		OutTable->ptr += (UINT64)TableIndex * DescriptorSize;
+		return true;
+	}
+
+	// Where a table starts in the shader-visible heap, for shaders that index the heap themselves
+	UINT GetHeapIndex(D3D12_GPU_DESCRIPTOR_HANDLE Table) const
+	{
+		return (UINT)((Table.ptr - GPUHeap.GPUStart.ptr) / DescriptorSize);
+	}
+
+	// Every table allocated since the last call is read by work that signals FenceValue
+	void Retire(uint64_t FenceValue)
+	{
+		if (RingHead != RetiredHead)
+		{
+			Retired.push_back({ FenceValue, RingHead });
+			RetiredHead = RingHead;
+		}
+	}
+
+	void Reclaim(uint64_t CompletedFenceValue)
+	{
+		while (!Retired.empty() && Retired.front().FenceValue <= CompletedFenceValue)
+		{
+			RingTail = Retired.front().Head;
+			Retired.pop_front();
+		}
+	}
+
+	void LogStats() const
+	{
+		LOG("Descriptors: %d tables, %d descriptors copied in %d calls, %d ring full, %d of %d staging slots in use",
+			TablesAllocated, DescriptorsCopied, CopyCalls, RingFull, (int)StagingSlots.UsedBytes, (int)StagingSlots.Size);
+	}
+};
+
+D3D12_SHADER_RESOURCE_VIEW_DESC GetTextureSRVDesc()
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	return srvDesc;
+}
+
+D3D12_UNORDERED_ACCESS_VIEW_DESC GetTextureUAVDesc()
+{
+	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+	UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	UAVDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	UAVDesc.Texture2D.MipSlice = 0;
+	return UAVDesc;
+}
+
+// Raw views of a whole buffer, as the buffer copy shader's ByteAddressBuffers
+D3D12_SHADER_RESOURCE_VIEW_DESC GetRawBufferSRVDesc(int BufferSize)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.NumElements = BufferSize / 4;
+	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+	return srvDesc;
+}
+
+D3D12_UNORDERED_ACCESS_VIEW_DESC GetRawBufferUAVDesc(int BufferSize)
+{
+	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
+	UAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	UAVDesc.Buffer.NumElements = BufferSize / 4;
+	UAVDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+	return UAVDesc;
+}
+
+// The pixel shader copy's table: one SRV. Returns the staging slot.
+UINT CreateTextureSRV(DescriptorAllocator& Descriptors, ID3D12Resource* Texture)
+{
+	UINT Slot = Descriptors.AllocateViews(1);
+	ASSERT(Slot != DescriptorAllocator::InvalidSlot);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = GetTextureSRVDesc();
+	Descriptors.Device->CreateShaderResourceView(Texture, &srvDesc, Descriptors.GetStagingHandle(Slot));
+	return Slot;
+}
+
+// The compute shader copy's tables: the SRV, then the UAV in the next slot. Returns the first staging slot.
+UINT CreateTextureSRVUAV(DescriptorAllocator& Descriptors, ID3D12Resource* SRVTexture, ID3D12Resource* UAVTexture)
+{
+	UINT Slot = Descriptors.AllocateViews(2);
+	ASSERT(Slot != DescriptorAllocator::InvalidSlot);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = GetTextureSRVDesc();
+	Descriptors.Device->CreateShaderResourceView(SRVTexture, &srvDesc, Descriptors.GetStagingHandle(Slot));
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = GetTextureUAVDesc();
+	Descriptors.Device->CreateUnorderedAccessView(UAVTexture, nullptr, &UAVDesc, Descriptors.GetStagingHandle(Slot + 1));
+	return Slot;
+}
+
+// The buffer copy's tables, laid out like CreateTextureSRVUAV's
+UINT CreateBufferSRVUAV(DescriptorAllocator& Descriptors, ID3D12Resource* SRVBuffer, ID3D12Resource* UAVBuffer, int BufferSize)
+{
+	UINT Slot = Descriptors.AllocateViews(2);
+	ASSERT(Slot != DescriptorAllocator::InvalidSlot);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = GetRawBufferSRVDesc(BufferSize);
+	Descriptors.Device->CreateShaderResourceView(SRVBuffer, &srvDesc, Descriptors.GetStagingHandle(Slot));
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = GetRawBufferUAVDesc(BufferSize);
+	Descriptors.Device->CreateUnorderedAccessView(UAVBuffer, nullptr, &UAVDesc, Descriptors.GetStagingHandle(Slot + 1));
+	return Slot;
+}
+
+// A shader-visible heap holding just SRVTexture's SRV and UAVTexture's UAV, the way the copy tests used to
+// bind their textures. Kept as the baseline the descriptor benchmarks compare the shared heap against.
+DescriptorDeviceHeap CreateSRVUAVHeapForTextures(DescriptorDevice& Device, ID3D12Resource* SRVTexture, ID3D12Resource* UAVTexture)
+{
+	DescriptorDeviceHeap TextureUAVHeap = Device.CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2, true);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = GetTextureSRVDesc();
+	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = GetTextureUAVDesc();
+
+	D3D12_CPU_DESCRIPTOR_HANDLE CPUHandle = TextureUAVHeap.CPUStart;
+	Device.CreateShaderResourceView(SRVTexture, &srvDesc, CPUHandle);
+
+	CPUHandle.ptr += Device.GetDescriptorSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	Device.CreateUnorderedAccessView(UAVTexture, nullptr, &UAVDesc, CPUHandle);
+
+	return TextureUAVHeap;
+}
+
+ID3D12RootSignature* GetPixelRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+	RootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+
+
+	D3D12_DESCRIPTOR_RANGE DescriptorRange = {};
+	DescriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	DescriptorRange.BaseShaderRegister = 0;
+	DescriptorRange.NumDescriptors = 1;
+	DescriptorRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+	D3D12_ROOT_PARAMETER RootParam = {};
+	RootParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	RootParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParam.DescriptorTable.NumDescriptorRanges = 1;
+	RootParam.DescriptorTable.pDescriptorRanges = &DescriptorRange;
+
+	RootSigDesc.NumParameters = 1;
+	RootSigDesc.pParameters = &RootParam;
+
+	D3D12_STATIC_SAMPLER_DESC SamplerDesc = {};
+
+	SamplerDesc.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+	SamplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	SamplerDesc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	SamplerDesc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	SamplerDesc.MipLODBias = 0;
+	SamplerDesc.MaxAnisotropy = 0;
+	SamplerDesc.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+	SamplerDesc.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
+	SamplerDesc.MinLOD = 0.0f;
+	SamplerDesc.MaxLOD = D3D12_FLOAT32_MAX;
+	SamplerDesc.ShaderRegister = 0;
+	SamplerDesc.RegisterSpace = 0;
+
+	RootSigDesc.NumStaticSamplers = 1;
+	RootSigDesc.pStaticSamplers = &SamplerDesc;
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+ID3D12PipelineState* GetPixelPSO(PipelineCache& Cache, ID3D12RootSignature* RootSig, DXGI_FORMAT OutputFormat, ID3DBlob* VSByteCode, ID3DBlob* PSByteCode)
+{
+	D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	D3D12_SHADER_BYTECODE VertexShaderByteCode;
+	VertexShaderByteCode.pShaderBytecode = VSByteCode->GetBufferPointer();
+	VertexShaderByteCode.BytecodeLength = VSByteCode->GetBufferSize();
+
+	D3D12_SHADER_BYTECODE PixelShaderByteCode;
+	PixelShaderByteCode.pShaderBytecode = PSByteCode->GetBufferPointer();
+	PixelShaderByteCode.BytecodeLength = PSByteCode->GetBufferSize();
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC PSODesc = {};
+	PSODesc.InputLayout = { inputElementDescs, (sizeof(inputElementDescs) / sizeof(inputElementDescs[0])) };
+	PSODesc.pRootSignature = RootSig;
+	PSODesc.VS = VertexShaderByteCode;
+	PSODesc.PS = PixelShaderByteCode;
+	PSODesc.RasterizerState = GetDefaultRasterizerDesc();
+	PSODesc.BlendState = GetDefaultBlendStateDesc();
+	PSODesc.DepthStencilState.DepthEnable = FALSE;
+	PSODesc.DepthStencilState.StencilEnable = FALSE;
+	PSODesc.SampleMask = UINT_MAX;
+	PSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	PSODesc.NumRenderTargets = 1;
+	PSODesc.RTVFormats[0] = OutputFormat;
+	PSODesc.SampleDesc.Count = 1;
+
+	return Cache.GetGraphicsPipelineState(PSODesc);
+}
+
+ID3D12RootSignature* GetComputeRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+
+
+	D3D12_DESCRIPTOR_RANGE DescriptorRanges[2] = {};
+	DescriptorRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	DescriptorRanges[0].BaseShaderRegister = 0;
+	DescriptorRanges[0].NumDescriptors = 1;
+	DescriptorRanges[0].OffsetInDescriptorsFromTableStart = 0;
+
+	DescriptorRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	DescriptorRanges[1].BaseShaderRegister = 0;
+	DescriptorRanges[1].NumDescriptors = 1;
+	DescriptorRanges[1].OffsetInDescriptorsFromTableStart = 0;
+
+	D3D12_ROOT_PARAMETER RootParams[2] = {};
+	RootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParams[0].DescriptorTable.NumDescriptorRanges = 1;
+	RootParams[0].DescriptorTable.pDescriptorRanges = &DescriptorRanges[0];
+
+	RootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParams[1].DescriptorTable.NumDescriptorRanges = 1;
+	RootParams[1].DescriptorTable.pDescriptorRanges = &DescriptorRanges[1];
+
+	RootSigDesc.NumParameters = 2;
+	RootSigDesc.pParameters = &RootParams[0];
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+// The same SRV and UAV as GetComputeRootSig, in one table: the SRV first, the UAV after it
+ID3D12RootSignature* GetComputeCombinedTableRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+
+	D3D12_DESCRIPTOR_RANGE DescriptorRanges[2] = {};
+	DescriptorRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	DescriptorRanges[0].BaseShaderRegister = 0;
+	DescriptorRanges[0].NumDescriptors = 1;
+	DescriptorRanges[0].OffsetInDescriptorsFromTableStart = 0;
+
+	DescriptorRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	DescriptorRanges[1].BaseShaderRegister = 0;
+	DescriptorRanges[1].NumDescriptors = 1;
+	DescriptorRanges[1].OffsetInDescriptorsFromTableStart = 1;
+
+	D3D12_ROOT_PARAMETER RootParam = {};
+	RootParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParam.DescriptorTable.NumDescriptorRanges = 2;
+	RootParam.DescriptorTable.pDescriptorRanges = &DescriptorRanges[0];
+
+	RootSigDesc.NumParameters = 1;
+	RootSigDesc.pParameters = &RootParam;
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+// For ComputeShaderCodeBindless: the SRV and UAV indices as two root constants, then the whole heap as
+// unbounded SRV and UAV tables, both set to the start of the heap
+ID3D12RootSignature* GetComputeBindlessRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+
+	D3D12_DESCRIPTOR_RANGE DescriptorRanges[2] = {};
+	DescriptorRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	DescriptorRanges[0].BaseShaderRegister = 0;
+	DescriptorRanges[0].RegisterSpace = 1;
+	DescriptorRanges[0].NumDescriptors = UINT_MAX;
+	DescriptorRanges[0].OffsetInDescriptorsFromTableStart = 0;
+
+	DescriptorRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	DescriptorRanges[1].BaseShaderRegister = 0;
+	DescriptorRanges[1].RegisterSpace = 2;
+	DescriptorRanges[1].NumDescriptors = UINT_MAX;
+	DescriptorRanges[1].OffsetInDescriptorsFromTableStart = 0;
+
+	D3D12_ROOT_PARAMETER RootParams[3] = {};
+	RootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	RootParams[0].Constants.ShaderRegister = 0;
+	RootParams[0].Constants.Num32BitValues = 2;
+
+	RootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParams[1].DescriptorTable.NumDescriptorRanges = 1;
+	RootParams[1].DescriptorTable.pDescriptorRanges = &DescriptorRanges[0];
+
+	RootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParams[2].DescriptorTable.NumDescriptorRanges = 1;
+	RootParams[2].DescriptorTable.pDescriptorRanges = &DescriptorRanges[1];
+
+	RootSigDesc.NumParameters = 3;
+	RootSigDesc.pParameters = &RootParams[0];
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+// For ComputeShaderCodeDescriptorHeap: just the SRV and UAV indices as two root constants. The shader
+// reaches the views through the bound heap itself.
+ID3D12RootSignature* GetComputeDescriptorHeapRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+
+	D3D12_ROOT_PARAMETER RootParam = {};
+	RootParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	RootParam.Constants.ShaderRegister = 0;
+	RootParam.Constants.Num32BitValues = 2;
+
+	RootSigDesc.NumParameters = 1;
+	RootSigDesc.pParameters = &RootParam;
+	RootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED;
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+// For ComputeShaderCodeBufferCopy: both buffers as root descriptors, so binding them needs no descriptors
+ID3D12RootSignature* GetBufferCopyRootDescriptorRootSig(PipelineCache& Cache)
+{
+	D3D12_ROOT_SIGNATURE_DESC RootSigDesc = {};
+
+	D3D12_ROOT_PARAMETER RootParams[2] = {};
+	RootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	RootParams[0].Descriptor.ShaderRegister = 0;
+
+	RootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	RootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+	RootParams[1].Descriptor.ShaderRegister = 0;
+
+	RootSigDesc.NumParameters = 2;
+	RootSigDesc.pParameters = &RootParams[0];
+
+	return Cache.GetRootSignature(RootSigDesc);
+}
+
+ID3D12PipelineState* GetComputePSO(PipelineCache& Cache, ID3D12RootSignature* RootSig, ID3DBlob* CSByteCode)
+{
+	D3D12_SHADER_BYTECODE ComputeShaderByteCode;
+	ComputeShaderByteCode.pShaderBytecode = CSByteCode->GetBufferPointer();
+	ComputeShaderByteCode.BytecodeLength = CSByteCode->GetBufferSize();
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC PSODesc = {};
+	PSODesc.CS = ComputeShaderByteCode;
+	PSODesc.pRootSignature = RootSig;
+
+	return Cache.GetComputePipelineState(PSODesc);
+}
+
+ShaderCompileRequest GetRemapCopyShaderRequest(const CSDispatch& Dispatch)
+{
+	ASSERT(Dispatch.NumThreads[0] == Dispatch.NumThreads[1] && Dispatch.GroupCount[2] == 1);
+
+	ShaderCompileRequest Request = { "<CS_REMAP_SOURCE>", ComputeShaderCodeRemap, "CSMain", "cs_5_0" };
+	Request.Defines = GetRemapCopyShaderDefines(Dispatch);
+	return Request;
+}
+
+// Set by --cache-l1, --cache-l2 and --cache-cus
+CacheSimConfig DefaultCacheSimConfig;
+
+struct GPUTimer
+{
+	ID3D12QueryHeap* QueryHeap = nullptr;
+
+	ID3D12Resource* TimestampReadback = nullptr;
+
+	void Init(ID3D12Device* Device)
+	{
+		D3D12_QUERY_HEAP_DESC QueryHeapDesc = {};
+		QueryHeapDesc.Count = 1024;
+		QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		HRESULT hr = Device->CreateQueryHeap(&QueryHeapDesc, IID_PPV_ARGS(&QueryHeap));
+		ASSERT(SUCCEEDED(hr));
+
+		D3D12_RESOURCE_DESC Desc = CD3DX12_RESOURCE_DESC::Buffer(QueryHeapDesc.Count * sizeof(uint64_t));
+
+		D3D12_HEAP_PROPERTIES Props = {};
+		Props.Type = D3D12_HEAP_TYPE_READBACK;
+
+		hr = Device->CreateCommittedResource(&Props, D3D12_HEAP_FLAG_NONE, &Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&TimestampReadback));
+		ASSERT(SUCCEEDED(hr));
+	}
+
+	void StartTiming(ID3D12GraphicsCommandList* CommandList)
+	{
+		CommandList->EndQuery(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0);
+	}
+
+	void EndTiming(ID3D12GraphicsCommandList* CommandList)
+	{
+		CommandList->EndQuery(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 1);
+		CommandList->ResolveQueryData(QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, TimestampReadback, 0);
+	}
+
+	void Release()
+	{
+		QueryHeap->Release();
+		TimestampReadback->Release();
+	}
+
+	void GetTiming(uint64_t* OutStart, uint64_t* OutEnd)
+	{
+		void* pPixelData = nullptr;
+		HRESULT hr = TimestampReadback->Map(0, nullptr, &pPixelData);
+		ASSERT(SUCCEEDED(hr));
+
+		*OutStart = ((uint64_t*)pPixelData)[0];
+		*OutEnd = ((uint64_t*)pPixelData)[1];
+
+		TimestampReadback->Unmap(0, nullptr);
+	}
+};
+
+// stbi write callback that appends to the std::vector<uint8_t> in Context
+void AppendToEncoded(void* Context, void* Data, int Size)
+{
+	std::vector<uint8_t>* Out = (std::vector<uint8_t>*)Context;
+	Out->insert(Out->end(), (uint8_t*)Data, (uint8_t*)Data + Size);
+}
+
+// Filter-only and full-encode throughput for every PNG filter mode and SIMD level. Compression level 1
+// keeps deflate cheap, which is where filter selection dominates the dump time.
+void RunPNGFilterBenchmark()
+{
+	const int Width = 4096;
+	const int Height = 2048;
+	const int Comp = 4;
+	const int Iters = 3;
+
+	std::vector<uint8_t> Pixels = MakeSyntheticImage(Width, Height);
+
+	const double ImageMB = (double)Pixels.size() / (1024.0 * 1024.0);
+	std::vector<uint8_t> Filtered((size_t)(Width * Comp + 1) * Height);
+
+	const char* FilterNames[] = { "adaptive", "none", "sub", "up", "avg", "paeth" };
+	const char* SimdNames[] = { "scalar", "SSE2/NEON", "AVX2" };
+
+	int SavedCompressionLevel = stbi_write_png_compression_level;
+	int SavedForceFilter = stbi_write_force_png_filter;
+	int SavedMaxSimd = stbi_write_png_max_simd;
+	stbi_write_png_compression_level = 1;
+
+	for (int SimdLevel = 0; SimdLevel <= 2; SimdLevel++)
+	{
+		stbi_write_png_max_simd = SimdLevel;
+		for (int Filter = -1; Filter < 5; Filter++)
+		{
+			stbi_write_force_png_filter = Filter;
+
+			double BestFilterSec = 1e30;
+			double BestEncodeSec = 1e30;
+			int EncodedLen = 0;
+			for (int Iter = 0; Iter < Iters; Iter++)
+			{
+				auto Start = std::chrono::high_resolution_clock::now();
+				stbiw__png_filter_rows(Pixels.data(), Width * Comp, Width, Height, Comp, Filter, 0, Height, Filtered.data());
+				double FilterSec = GetElapsedSeconds(Start);
+				BestFilterSec = FilterSec < BestFilterSec ? FilterSec : BestFilterSec;
+
+				Start = std::chrono::high_resolution_clock::now();
+				unsigned char* Encoded = stbi_write_png_to_mem(Pixels.data(), Width * Comp, Width, Height, Comp, &EncodedLen);
+				double EncodeSec = GetElapsedSeconds(Start);
+				BestEncodeSec = EncodeSec < BestEncodeSec ? EncodeSec : BestEncodeSec;
+				STBIW_FREE(Encoded);
+			}
+
+			LOG("PNG filter %-9s %-8s: filter %8.1f MB/s (1 thread), encode %7.1f MB/s, %5.1f%% of raw size",
+				SimdNames[SimdLevel], FilterNames[Filter + 1], ImageMB / BestFilterSec, ImageMB / BestEncodeSec, 100.0 * EncodedLen / Pixels.size());
+		}
+	}
+
+	stbi_write_png_compression_level = SavedCompressionLevel;
+	stbi_write_force_png_filter = SavedForceFilter;
+	stbi_write_png_max_simd = SavedMaxSimd;
+}
+
+// Deflate throughput and ratio per quality level on PNG-filtered image data, i.e. exactly what the
+// writer hands to stbi_zlib_compress
+void RunDeflateBenchmark()
+{
+	const int Width = 4096;
+	const int Height = 2048;
+	const int Comp = 4;
+	const int Iters = 3;
+
+	std::vector<uint8_t> Pixels = MakeSyntheticImage(Width, Height);
+
+	std::vector<uint8_t> Filtered((size_t)(Width * Comp + 1) * Height);
+	stbiw__png_filter_rows(Pixels.data(), Width * Comp, Width, Height, Comp, -1, 0, Height, Filtered.data());
+	const double FilteredMB = (double)Filtered.size() / (1024.0 * 1024.0);
+
+	const int Qualities[] = { 1, 5, 8, 16, 32, 64 };
+	for (int Quality : Qualities)
+	{
+		double BestSec = 1e30;
+		int CompressedLen = 0;
+		for (int Iter = 0; Iter < Iters; Iter++)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			unsigned char* Compressed = stbi_zlib_compress(Filtered.data(), (int)Filtered.size(), &CompressedLen, Quality);
+			double Sec = GetElapsedSeconds(Start);
+			BestSec = Sec < BestSec ? Sec : BestSec;
+			STBIW_FREE(Compressed);
+		}
+
+		LOG("Deflate quality %2d: %7.1f MB/s (1 thread), %5.1f%% of filtered size", Quality, FilteredMB / BestSec, 100.0 * CompressedLen / Filtered.size());
+	}
+}
+
+// Encode throughput and size of each dump format on a 4K frame, PNG at several compression levels
+void RunDumpFormatBenchmark()
+{
+	const int Width = 3840;
+	const int Height = 2160;
+	const int Comp = 4;
+	const int Iters = 3;
+
+	std::vector<uint8_t> Pixels = MakeSyntheticImage(Width, Height);
+	const double ImageMB = (double)Pixels.size() / (1024.0 * 1024.0);
+
+	struct Variant
+	{
+		const char* Name;
+		DumpFormat Format;
+		int PNGLevel;
+		bool bStreamed;
+	};
+	const Variant Variants[] =
+	{
+		{ "raw", DumpFormat::Raw, 0, false },
+		{ "QOI", DumpFormat::QOI, 0, false },
+		{ "PNG level 1", DumpFormat::PNG, 1, false },
+		{ "PNG level 4", DumpFormat::PNG, 4, false },
+		{ "PNG level 8", DumpFormat::PNG, 8, false },
+		{ "PNG level 16", DumpFormat::PNG, 16, false },
+		{ "PNG 8 stream", DumpFormat::PNG, 8, true },
+	};
+
+	// Encode to memory so disk speed doesn't enter into it
+	std::vector<uint8_t> Encoded;
+	Encoded.reserve(Pixels.size() + 8192);
+
+	int SavedCompressionLevel = stbi_write_png_compression_level;
+	for (const Variant& V : Variants)
+	{
+		stbi_write_png_compression_level = V.PNGLevel;
+
+		double BestSec = 1e30;
+		for (int Iter = 0; Iter < Iters; Iter++)
+		{
+			Encoded.clear();
+			auto Start = std::chrono::high_resolution_clock::now();
+			switch (V.Format)
+			{
+			case DumpFormat::Raw:
+				stbi_write_raw_to_func(AppendToEncoded, &Encoded, Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM, Comp, Pixels.data(), 0);
+				break;
+			case DumpFormat::QOI:
+				stbi_write_qoi_to_func(AppendToEncoded, &Encoded, Width, Height, Comp, Pixels.data(), 0);
+				break;
+			default:
+				if (V.bStreamed)
+				{
+					// 64 rows at a time, as if they were arriving from a readback
+					stbi_png_stream* Stream = stbi_write_png_stream_begin(AppendToEncoded, &Encoded, Width, Height, Comp);
+					for (int y = 0; y < Height; y += 64)
+					{
+						int NumRows = Height - y < 64 ? Height - y : 64;
+						stbi_write_png_stream_rows(Stream, &Pixels[(size_t)y * Width * Comp], NumRows, 0);
+					}
+					stbi_write_png_stream_end(Stream);
+				}
+				else
+				{
+					stbi_write_png_to_func(AppendToEncoded, &Encoded, Width, Height, Comp, Pixels.data(), 0);
+				}
+				break;
+			}
+			double Sec = GetElapsedSeconds(Start);
+			BestSec = Sec < BestSec ? Sec : BestSec;
+		}
+
+		LOG("Dump %-12s: %8.1f MB/s, %5.1f%% of raw size", V.Name, ImageMB / BestSec, 100.0 * Encoded.size() / Pixels.size());
+	}
+	stbi_write_png_compression_level = SavedCompressionLevel;
+
+	// The same frame as an RGBA32F readback written as Radiance HDR, with and without the SIMD RGBE path.
+	// Throughput is per 8 bit frame like the rows above, so they compare per pixel.
+	std::vector<float> FloatPixels(Pixels.size());
+	for (size_t i = 0; i < Pixels.size(); i++)
+	{
+		FloatPixels[i] = Pixels[i] * (4.0f / 255.0f);
+	}
+
+	int SavedHDRSimd = stbi_write_hdr_max_simd;
+	for (int Simd = 0; Simd <= 1; Simd++)
+	{
+		stbi_write_hdr_max_simd = Simd;
+
+		double BestSec = 1e30;
+		for (int Iter = 0; Iter < Iters; Iter++)
+		{
+			Encoded.clear();
+			auto Start = std::chrono::high_resolution_clock::now();
+			stbi_write_hdr_to_func(AppendToEncoded, &Encoded, Width, Height, Comp, FloatPixels.data());
+			double Sec = GetElapsedSeconds(Start);
+			BestSec = Sec < BestSec ? Sec : BestSec;
+		}
+
+		LOG("Dump %-12s: %8.1f MB/s, %5.1f%% of float size", Simd ? "HDR SIMD" : "HDR scalar", ImageMB / BestSec, 100.0 * Encoded.size() / (FloatPixels.size() * sizeof(float)));
+	}
+	stbi_write_hdr_max_simd = SavedHDRSimd;
+}
+
+// CRC32 and Adler-32 throughput for each kernel this CPU can run, over a buffer the size of a large IDAT
+void RunChecksumBenchmark()
+{
+	const size_t Size = 64 * 1024 * 1024;
+	const int Iters = 5;
+
+	std::vector<uint8_t> Data(Size);
+	for (size_t i = 0; i < Size; i++)
+	{
+		Data[i] = (uint8_t)rand();
+	}
+
+	struct ChecksumKernel
+	{
+		const char* Name;
+		ChecksumFunc Func;
+		uint32_t Initial;
+		bool Supported;
+	};
+
+	const CPUFeatures& Features = GetCPUFeatures();
+	(void)Features;
+	const ChecksumKernel Kernels[] =
+	{
+		{ "CRC32 bytewise", Crc32Bytewise, ~0u, true },
+		{ "CRC32 slice-by-8", Crc32Slice8, ~0u, true },
+#if CPU_X86
+		{ "CRC32 PCLMULQDQ", Crc32Pclmul, ~0u, Features.PCLMUL && Features.SSE41 },
+#elif CPU_ARM64
+		{ "CRC32 ARMv8", Crc32Arm, ~0u, Features.ARMCRC32 },
+#endif
+		{ "Adler-32 scalar", Adler32Scalar, 1, true },
+#if CPU_X86
+		{ "Adler-32 SSSE3", Adler32SSSE3, 1, Features.SSSE3 },
+#elif CPU_ARM64
+		{ "Adler-32 NEON", Adler32Neon, 1, true },
+#endif
+	};
+
+	const double SizeMB = (double)Size / (1024.0 * 1024.0);
+	uint32_t Reference = 0;
+	for (const ChecksumKernel& Kernel : Kernels)
+	{
+		if (!Kernel.Supported)
+		{
+			LOG("%-18s: not supported on this CPU", Kernel.Name);
+			continue;
+		}
+
+		// The scalar kernels come first in each family and provide the expected value
+		if (Kernel.Func == Crc32Bytewise || Kernel.Func == Adler32Scalar)
+		{
+			Reference = Kernel.Func(Kernel.Initial, Data.data(), Size);
+		}
+
+		double BestSec = 1e30;
+		uint32_t Result = 0;
+		for (int Iter = 0; Iter < Iters; Iter++)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			Result = Kernel.Func(Kernel.Initial, Data.data(), Size);
+			double Sec = GetElapsedSeconds(Start);
+			BestSec = Sec < BestSec ? Sec : BestSec;
+		}
+
+		LOG("%-18s: %8.1f MB/s%s", Kernel.Name, SizeMB / BestSec, Result == Reference ? "" : " MISMATCH");
+	}
+}
+
+// Dump conversion throughput for each source format at each SIMD level, on a 4K frame with a padded pitch
+void RunConvertBenchmark()
+{
+	const int Width = 3840;
+	const int Height = 2160;
+	const int Iters = 5;
+	const char* LevelNames[] = { "scalar", "SSE/NEON", "AVX2" };
+
+	struct SourceFormat
+	{
+		const char* Name;
+		DXGI_FORMAT Format;
+	};
+	const SourceFormat Formats[] =
+	{
+		{ "B8G8R8A8", DXGI_FORMAT_B8G8R8A8_UNORM },
+		{ "R8G8B8A8", DXGI_FORMAT_R8G8B8A8_UNORM },
+		{ "R10G10B10A2", DXGI_FORMAT_R10G10B10A2_UNORM },
+		{ "R16G16B16A16F", DXGI_FORMAT_R16G16B16A16_FLOAT },
+		{ "R32G32B32A32F", DXGI_FORMAT_R32G32B32A32_FLOAT },
+	};
+
+	std::vector<uint8_t> Reference((size_t)Width * Height * 4);
+	std::vector<uint8_t> Output((size_t)Width * Height * 4);
+	const double OutputMB = (double)Output.size() / (1024.0 * 1024.0);
+
+	for (const SourceFormat& Source : Formats)
+	{
+		// Random bits cover the awkward float inputs too: denormals, infinities and NaNs
+		const int Pitch = ((Width * GetBytesPerPixel(Source.Format) + 255) & ~255) + 256;
+		std::vector<uint8_t> Pixels((size_t)Pitch * Height);
+		for (size_t i = 0; i < Pixels.size(); i++)
+		{
+			Pixels[i] = (uint8_t)rand();
+		}
+
+		RowConvertFunc PreviousConverter = nullptr;
+		for (int Level = 0; Level < 3; Level++)
+		{
+			RowConvertFunc ConvertRow = SelectRowConverter(GetConvertFormat(Source.Format), Level);
+			if (ConvertRow == PreviousConverter)
+			{
+				continue;
+			}
+			PreviousConverter = ConvertRow;
+
+			double BestSec = 1e30;
+			for (int Iter = 0; Iter < Iters; Iter++)
+			{
+				auto Start = std::chrono::high_resolution_clock::now();
+				for (int y = 0; y < Height; y++)
+				{
+					ConvertRow(&Pixels[(size_t)y * Pitch], &Output[(size_t)y * Width * 4], Width);
+				}
+				double Sec = GetElapsedSeconds(Start);
+				BestSec = Sec < BestSec ? Sec : BestSec;
+			}
+
+			if (Level == 0)
+			{
+				Reference = Output;
+			}
+			LOG("Convert %-13s %-8s: %8.1f MB/s written%s", Source.Name, LevelNames[Level], OutputMB / BestSec, Output == Reference ? "" : " MISMATCH");
+		}
+	}
+}
+
+// JPEG encode throughput and size at several qualities, for each DCT kernel level (0 scalar, 1 SSE2/NEON, 2 AVX2).
+// All levels produce the same bytes, which is checked against the scalar encode.
+void RunJpegBenchmark()
+{
+	const int Width = 3840;
+	const int Height = 2160;
+	const int Comp = 4;
+	const int Iters = 3;
+
+	std::vector<uint8_t> Pixels = MakeSyntheticImage(Width, Height);
+	const double ImageMB = (double)Pixels.size() / (1024.0 * 1024.0);
+
+	const int Qualities[] = { 50, 75, 90, 95 };
+	const char* LevelNames[] = { "scalar", "SSE2/NEON", "AVX2" };
+	int SavedSimd = stbi_write_jpg_max_simd;
+	std::vector<uint8_t> Reference, Encoded;
+	for (int Quality : Qualities)
+	{
+		for (int Level = 0; Level < 3; Level++)
+		{
+			stbi_write_jpg_max_simd = Level;
+
+			double BestSec = 1e30;
+			for (int Iter = 0; Iter < Iters; Iter++)
+			{
+				Encoded.clear();
+				auto Start = std::chrono::high_resolution_clock::now();
+				stbi_write_jpg_to_func(AppendToEncoded, &Encoded, Width, Height, Comp, Pixels.data(), Quality);
+				double Sec = GetElapsedSeconds(Start);
+				BestSec = Sec < BestSec ? Sec : BestSec;
+			}
+
+			if (Level == 0)
+			{
+				Reference = Encoded;
+			}
+			LOG("JPEG quality %3d %-9s: %7.1f MB/s, %5.2f%% of raw size%s", Quality, LevelNames[Level], ImageMB / BestSec,
+				100.0 * Encoded.size() / Pixels.size(), Encoded == Reference ? "" : " MISMATCH");
+		}
+	}
+	stbi_write_jpg_max_simd = SavedSimd;
+}
+
+// CPU copy engine throughput: GB/s of data copied for each kernel and thread count, at several copy
+// sizes, for CopyResource of a 4 byte per pixel texture. Also checks a subresource region copy.
+void RunCPUCopyBenchmark()
+{
+	const int MaxThreads = GetMaxThreads();
+	const int Sizes[] = { 256, 1024, 4096 };	// texture width and height
+	const std::vector<CopyKernelInfo> Kernels = GetCopyKernels();
+
+	const std::vector<int> ThreadCounts = GetThreadCountSweep();
+
+	LOG("CPU copy engine: %d NUMA node(s) with processors, %d hardware threads", (int)GetNumaTopology().Nodes.size(), MaxThreads);
+
+	for (int Size : Sizes)
+	{
+		CPUTexture Src, Dst;
+		Src.Init(Size, Size, 1, 1, 4);
+		Dst.Init(Size, Size, 1, 1, 4);
+		for (size_t i = 0; i < Src.Memory.Size; i++)
+		{
+			Src.Memory.Data[i] = (uint8_t)rand();
+		}
+
+		const double CopyGB = (double)Src.Memory.Size / (1024.0 * 1024.0 * 1024.0);
+		const int Iters = (int)(256 * 1024 * 1024 / Src.Memory.Size) + 4;
+
+		char Header[256] = {};
+		int HeaderLen = snprintf(Header, sizeof(Header), "CopyResource %4d x %4d (%6.2f MB) GB/s:", Size, Size, Src.Memory.Size / (1024.0 * 1024.0));
+		for (int Threads : ThreadCounts)
+		{
+			HeaderLen += snprintf(Header + HeaderLen, sizeof(Header) - HeaderLen, " %6d thr", Threads);
+		}
+		LOG("%s", Header);
+
+		for (const CopyKernelInfo& Info : Kernels)
+		{
+			if (!Info.Supported)
+			{
+				LOG("  %-10s: not supported on this CPU", Info.Name);
+				continue;
+			}
+
+			char Row[256] = {};
+			int RowLen = snprintf(Row, sizeof(Row), "  %-10s:", Info.Name);
+			bool bMatches = true;
+			for (int Threads : ThreadCounts)
+			{
+				CPUCopyEngine Engine;
+				Engine.Kernel = Info.Func;
+				Engine.Start(Threads);
+
+				memset(Dst.Memory.Data, 0, Dst.Memory.Size);
+				Engine.CopyResource(Dst, Src);
+				bMatches = bMatches && memcmp(Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size) == 0;
+
+				double BestSec = 1e30;
+				for (int Iter = 0; Iter < Iters; Iter++)
+				{
+					auto Start = std::chrono::high_resolution_clock::now();
+					Engine.CopyResource(Dst, Src);
+					double Sec = GetElapsedSeconds(Start);
+					BestSec = Sec < BestSec ? Sec : BestSec;
+				}
+				Engine.Shutdown();
+
+				RowLen += snprintf(Row + RowLen, sizeof(Row) - RowLen, " %10.2f", CopyGB / BestSec);
+			}
+			LOG("%s%s", Row, bMatches ? "" : " MISMATCH");
+		}
+	}
+
+	// A region of one mip/slice into another texture with a different layout, checked texel by texel
+	{
+		CPUTexture Src, Dst;
+		Src.Init(1000, 600, 2, 3, 4);
+		Dst.Init(700, 700, 1, 1, 4);
+		for (size_t i = 0; i < Src.Memory.Size; i++)
+		{
+			Src.Memory.Data[i] = (uint8_t)rand();
+		}
+
+		CPUCopyEngine Engine;
+		Engine.Start(MaxThreads);
+		const int SrcSubresource = 1 * Src.MipLevels + 1;	// mip 1 of slice 1, 500 x 300
+		const CopyBox Box = { 17, 3, 493, 299 };
+		Engine.CopySubresourceRegion(Dst, 0, 101, 202, Src, SrcSubresource, &Box);
+		Engine.Shutdown();
+
+		bool bMatches = true;
+		for (int y = Box.Top; y < Box.Bottom; y++)
+		{
+			bMatches = bMatches && memcmp(Dst.GetTexel(0, 101, 202 + y - Box.Top), Src.GetTexel(SrcSubresource, Box.Left, y), (size_t)(Box.Right - Box.Left) * 4) == 0;
+		}
+		LOG("CopySubresourceRegion check: %s", bMatches ? "ok" : "MISMATCH");
+	}
+}
+
+// The CS copy group size sweep, on the CPU dispatch emulator. Every group size runs with scalar threads
+// and with SIMD lanes, in each dispatch order, on all hardware threads.
+void RunCSEmulatorBenchmark()
+{
+	const int MaxThreads = GetMaxThreads();
+	const int32 RTWidth = 1024;
+	const int32 RTHeight = 1024;
+	const int CSCopyIters = 64;
+
+	struct KernelInfo
+	{
+		const char* Name;
+		CSGroupKernel Kernel;
+	};
+	const KernelInfo Kernels[] = { { "scalar", CSCopyKernelScalar }, { "lanes", CSCopyKernelLanes } };
+
+	struct OrderInfo
+	{
+		const char* Name;
+		CSDispatchOrder Order;
+	};
+	const OrderInfo Orders[] = { { "row", CSDispatchOrder::RowMajor }, { "column", CSDispatchOrder::ColumnMajor }, { "morton", CSDispatchOrder::Morton }, { "tiled", CSDispatchOrder::ColumnTiled } };
+
+	CPUTexture Src, Dst;
+	Src.Init(RTWidth, RTHeight, 1, 1, 4);
+	Dst.Init(RTWidth, RTHeight, 1, 1, 4);
+	for (size_t i = 0; i < Src.Memory.Size; i++)
+	{
+		Src.Memory.Data[i] = (uint8_t)rand();
+	}
+	CSCopyContext Copy = { Src.Memory.Data, Dst.Memory.Data, RTWidth, RTHeight, Src.Subresources[0].RowPitch };
+
+	WorkStealingScheduler Scheduler;
+	Scheduler.Start(MaxThreads);
+	LOG("CS dispatch emulator: %d worker threads", MaxThreads);
+
+	const int GroupSizes[] = { 1, 2, 4, 8, 16 };
+	for (int GroupSize : GroupSizes)
+	{
+		for (const KernelInfo& Kernel : Kernels)
+		{
+			for (const OrderInfo& Order : Orders)
+			{
+				CSDispatch Dispatch;
+				Dispatch.NumThreads[0] = GroupSize;
+				Dispatch.NumThreads[1] = GroupSize;
+				Dispatch.GroupCount[0] = (RTWidth + GroupSize - 1) / GroupSize;
+				Dispatch.GroupCount[1] = (RTHeight + GroupSize - 1) / GroupSize;
+				Dispatch.Order = Order.Order;
+
+				memset(Dst.Memory.Data, 0, Dst.Memory.Size);
+				DispatchCPU(Scheduler, Dispatch, Kernel.Kernel, &Copy);
+				const bool bMatches = memcmp(Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size) == 0;
+
+				double TotalSec = 0.0;
+				uint32_t TotalSteals = 0;
+				for (int Iter = 0; Iter < CSCopyIters; Iter++)
+				{
+					auto Start = std::chrono::high_resolution_clock::now();
+					DispatchCPU(Scheduler, Dispatch, Kernel.Kernel, &Copy);
+					TotalSec += GetElapsedSeconds(Start);
+					TotalSteals += Scheduler.StealCount;
+				}
+
+				LOG("CPU CS Copy (%2dx%2d) %-6s %-6s of %4d x %4d texture: avg %8.1f usec, %5.1f steals (%d iters)%s",
+					GroupSize, GroupSize, Kernel.Name, Order.Name, RTWidth, RTHeight, TotalSec * 1000000.0 / CSCopyIters,
+					(double)TotalSteals / CSCopyIters, CSCopyIters, bMatches ? "" : " MISMATCH");
+			}
+		}
+	}
+
+	// The groupshared, wave and byte address buffer copies, each checked against the source
+	struct AdvancedKernelInfo
+	{
+		const char* Name;
+		CSGroupKernel Kernel;
+		void* Context;
+		CSDispatch Dispatch;
+		uint8_t* Dst;
+		const uint8_t* Src;
+		size_t Size;
+	};
+	std::vector<AdvancedKernelInfo> AdvancedKernels;
+
+	CSDispatch TileDispatch;
+	TileDispatch.NumThreads[0] = 16;
+	TileDispatch.NumThreads[1] = 16;
+	TileDispatch.GroupCount[0] = (RTWidth + 31) / 32;
+	TileDispatch.GroupCount[1] = (RTHeight + 31) / 32;
+	AdvancedKernels.push_back({ "groupshared 32x32 tile", CSCopyKernelGroupShared, &Copy, TileDispatch, Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size });
+
+	// 128 lanes is wider than the 64 thread group, so that wave runs partly empty
+	const uint32_t LaneCounts[] = { 32, 64, 128 };
+	CSWaveCopyContext WaveCopies[3];
+	const char* WaveNames[] = { "wave rows (32 lanes)", "wave rows (64 lanes)", "wave rows (128 lanes)" };
+	for (int i = 0; i < 3; i++)
+	{
+		WaveCopies[i] = { Copy, LaneCounts[i], 256 };
+		CSDispatch WaveDispatch;
+		WaveDispatch.NumThreads[0] = 64;
+		WaveDispatch.GroupCount[0] = (RTWidth + 255) / 256;
+		WaveDispatch.GroupCount[1] = RTHeight;
+		AdvancedKernels.push_back({ WaveNames[i], CSCopyKernelWaveRows, &WaveCopies[i], WaveDispatch, Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size });
+	}
+
+	// The buffer kernels copy the texture's bytes as one flat buffer
+	const size_t BufferSize = Src.Memory.Size & ~(size_t)15;
+	CSBufferCopyContext BufferCopies[2] = { { Src.Memory.Data, Dst.Memory.Data, BufferSize, 1 }, { Src.Memory.Data, Dst.Memory.Data, BufferSize, 4 } };
+	const char* BufferNames[] = { "buffer 128-bit", "buffer 128-bit x4" };
+	for (int i = 0; i < 2; i++)
+	{
+		const size_t BytesPerGroup = 64 * 16 * BufferCopies[i].LoadsPerThread;
+		CSDispatch BufferDispatch;
+		BufferDispatch.NumThreads[0] = 64;
+		BufferDispatch.GroupCount[0] = (uint32_t)((BufferSize + BytesPerGroup - 1) / BytesPerGroup);
+		AdvancedKernels.push_back({ BufferNames[i], CSCopyKernelByteAddress, &BufferCopies[i], BufferDispatch, Dst.Memory.Data, Src.Memory.Data, BufferSize });
+	}
+
+	for (const AdvancedKernelInfo& Kernel : AdvancedKernels)
+	{
+		memset(Kernel.Dst, 0, Kernel.Size);
+		DispatchCPU(Scheduler, Kernel.Dispatch, Kernel.Kernel, Kernel.Context);
+		const bool bMatches = memcmp(Kernel.Dst, Kernel.Src, Kernel.Size) == 0;
+
+		double TotalSec = 0.0;
+		for (int Iter = 0; Iter < CSCopyIters; Iter++)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			DispatchCPU(Scheduler, Kernel.Dispatch, Kernel.Kernel, Kernel.Context);
+			TotalSec += GetElapsedSeconds(Start);
+		}
+
+		LOG("CPU CS Copy %-22s of %4d x %4d texture: avg %8.1f usec, %6.2f GB/s (%d iters)%s",
+			Kernel.Name, RTWidth, RTHeight, TotalSec * 1000000.0 / CSCopyIters,
+			(double)Kernel.Size * CSCopyIters / TotalSec / 1e9, CSCopyIters, bMatches ? "" : " MISMATCH");
+	}
+
+	Scheduler.Shutdown();
+}
+
+// The pixel shader copy on the software rasterizer, checked against a CPU copy of the texture, for each
+// span shader over a range of thread counts
+void RunSWRasterizerBenchmark()
+{
+	const int32 RTWidth = 1024;
+	const int32 RTHeight = 1024;
+	const int PSCopyIters = 64;
+
+	const std::vector<int> ThreadCounts = GetThreadCountSweep();
+
+	CPUTexture Src, Dst, Reference;
+	Src.Init(RTWidth, RTHeight, 1, 1, 4);
+	Dst.Init(RTWidth, RTHeight, 1, 1, 4);
+	Reference.Init(RTWidth, RTHeight, 1, 1, 4);
+	for (size_t i = 0; i < Src.Memory.Size; i++)
+	{
+		Src.Memory.Data[i] = (uint8_t)rand();
+	}
+	{
+		CPUCopyEngine Engine;
+		Engine.Start(1);
+		Engine.CopyResource(Reference, Src);
+		Engine.Shutdown();
+	}
+
+	const SWShadeState State = { Src.Memory.Data, RTWidth, RTHeight, Src.Subresources[0].RowPitch,
+		Dst.Memory.Data, RTWidth, RTHeight, Dst.Subresources[0].RowPitch };
+
+	const SWViewport Viewport = { 0.0f, 0.0f, (float)RTWidth, (float)RTHeight };
+	const SWRect ScissorRect = { 0, 0, RTWidth, RTHeight };
+
+	char Header[256] = {};
+	int HeaderLen = snprintf(Header, sizeof(Header), "SW raster PS Copy of %4d x %4d texture (%dx%d tiles), avg usec:", RTWidth, RTHeight, SWRasterizer::TileSize, SWRasterizer::TileSize);
+	for (int Threads : ThreadCounts)
+	{
+		HeaderLen += snprintf(Header + HeaderLen, sizeof(Header) - HeaderLen, " %6d thr", Threads);
+	}
+	LOG("%s", Header);
+
+	const char* LevelNames[] = { "scalar", "SSE2/NEON", "AVX2" };
+	const int Levels[] = { 0, 2 };
+	for (int Level : Levels)
+	{
+		const SWSpanShader Shader = SelectSWSpanShader(Level);
+		if (Level > 0 && Shader == SWShadeSpanScalar)
+		{
+			LOG("  %-10s: not supported on this CPU", LevelNames[Level]);
+			continue;
+		}
+
+		char Row[256] = {};
+		int RowLen = snprintf(Row, sizeof(Row), "  %-10s:", LevelNames[Level]);
+		bool bMatches = true;
+		for (int Threads : ThreadCounts)
+		{
+			WorkStealingScheduler Scheduler;
+			Scheduler.Start(Threads);
+
+			SWRasterizer Raster;
+			Raster.Scheduler = &Scheduler;
+			Raster.Shader = Shader;
+
+			memset(Dst.Memory.Data, 0, Dst.Memory.Size);
+			Raster.DrawTriangleStrip(PSCopyQuadVertices, 4, Viewport, ScissorRect, State);
+			bMatches = bMatches && memcmp(Dst.Memory.Data, Reference.Memory.Data, Reference.Memory.Size) == 0;
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (int Iter = 0; Iter < PSCopyIters; Iter++)
+			{
+				Raster.DrawTriangleStrip(PSCopyQuadVertices, 4, Viewport, ScissorRect, State);
+			}
+			double AvgUsec = GetElapsedSeconds(Start) * 1000.0 * 1000.0 / PSCopyIters;
+			Scheduler.Shutdown();
+
+			RowLen += snprintf(Row + RowLen, sizeof(Row) - RowLen, " %10.1f", AvgUsec);
+		}
+		LOG("%s%s", Row, bMatches ? "" : " MISMATCH");
+	}
+}
+
+// The group remaps of the GPU large texture copies, on the CPU emulator: coverage checks over grids that
+// don't divide evenly into Morton squares or tile strips, then the 4096 x 4096 copy in each order
+void RunCSRemapBenchmark()
+{
+	const int MaxThreads = GetMaxThreads();
+	const int LargeSize = 4096;
+	const int GroupSize = 8;
+	const int CSCopyIters = 16;
+
+	struct RemapInfo
+	{
+		CSDispatchOrder Order;
+		uint32_t TileWidth;
+	};
+	const RemapInfo Remaps[] =
+	{
+		{ CSDispatchOrder::RowMajor, 0 },
+		{ CSDispatchOrder::ColumnMajor, 0 },
+		{ CSDispatchOrder::Morton, 0 },
+		{ CSDispatchOrder::ColumnTiled, 4 },
+		{ CSDispatchOrder::ColumnTiled, 16 },
+	};
+
+	// Group grid sizes: square, wide, tall, and not multiples of the tile widths
+	const int Grids[][2] = { { 64, 64 }, { 100, 37 }, { 13, 90 }, { 1, 1 } };
+	bool bAllCovered = true;
+	for (const RemapInfo& Remap : Remaps)
+	{
+		for (const int* Grid : Grids)
+		{
+			CSDispatch Dispatch;
+			Dispatch.NumThreads[0] = GroupSize;
+			Dispatch.NumThreads[1] = GroupSize;
+			Dispatch.GroupCount[0] = Grid[0];
+			Dispatch.GroupCount[1] = Grid[1];
+			Dispatch.Order = Remap.Order;
+			Dispatch.TileWidth = Remap.TileWidth;
+			if (!CheckDispatchCoverage(Dispatch, Grid[0] * GroupSize, Grid[1] * GroupSize))
+			{
+				LOG("Remap %s %u of %d x %d groups: MISMATCH", GetDispatchOrderName(Remap.Order), Remap.TileWidth, Grid[0], Grid[1]);
+				bAllCovered = false;
+			}
+		}
+	}
+	LOG("Group remap coverage check: %s", bAllCovered ? "ok" : "MISMATCH");
+
+	CPUTexture Src, Dst;
+	Src.Init(LargeSize, LargeSize, 1, 1, 4);
+	Dst.Init(LargeSize, LargeSize, 1, 1, 4);
+	for (size_t i = 0; i < Src.Memory.Size; i++)
+	{
+		Src.Memory.Data[i] = (uint8_t)rand();
+	}
+	CSCopyContext Copy = { Src.Memory.Data, Dst.Memory.Data, LargeSize, LargeSize, Src.Subresources[0].RowPitch };
+
+	WorkStealingScheduler Scheduler;
+	Scheduler.Start(MaxThreads);
+
+	for (const RemapInfo& Remap : Remaps)
+	{
+		CSDispatch Dispatch;
+		Dispatch.NumThreads[0] = GroupSize;
+		Dispatch.NumThreads[1] = GroupSize;
+		Dispatch.GroupCount[0] = LargeSize / GroupSize;
+		Dispatch.GroupCount[1] = LargeSize / GroupSize;
+		Dispatch.Order = Remap.Order;
+		Dispatch.TileWidth = Remap.TileWidth;
+
+		memset(Dst.Memory.Data, 0, Dst.Memory.Size);
+		DispatchCPU(Scheduler, Dispatch, CSCopyKernelLanes, &Copy);
+		const bool bMatches = memcmp(Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size) == 0;
+
+		double BestSec = 1e30;
+		for (int Iter = 0; Iter < CSCopyIters; Iter++)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			DispatchCPU(Scheduler, Dispatch, CSCopyKernelLanes, &Copy);
+			double Sec = GetElapsedSeconds(Start);
+			BestSec = Sec < BestSec ? Sec : BestSec;
+		}
+
+		char OrderName[32] = {};
+		snprintf(OrderName, sizeof(OrderName), Remap.TileWidth ? "%s %-2u" : "%s", GetDispatchOrderName(Remap.Order), Remap.TileWidth);
+		LOG("CPU CS Copy (%2dx%2d) %-9s of %4d x %4d texture: best %8.1f usec, %6.2f GB/s (%d threads)%s", GroupSize, GroupSize, OrderName,
+			LargeSize, LargeSize, BestSec * 1000000.0, 2.0 * Src.Memory.Size / (BestSec * 1e9), MaxThreads, bMatches ? "" : " MISMATCH");
+	}
+
+	Scheduler.Shutdown();
+}
+
+// Cache model results for every copy method the GPU tests time, in both layouts: the 1024 x 1024 group size
+// sweep, then the 4096 x 4096 remapped 8x8 copies
+void RunCacheSimBenchmark(const CacheSimConfig& Config)
+{
+	LOG("Cache sim: %d CUs with %d KB L1 (%d B lines, %d way), %d KB L2 (%d B lines, %d way), %d wide waves",
+		Config.NumCUs, Config.L1.SizeKB, Config.L1.LineSize, Config.L1.Ways, Config.L2.SizeKB, Config.L2.LineSize, Config.L2.Ways, Config.WaveSize);
+
+	struct MethodInfo
+	{
+		char Name[32];
+		int Size;
+		int GroupSize;			// 0 for the pixel shader copy, -1 for CopyResource
+		CSDispatchOrder Order;
+		uint32_t TileWidth;
+	};
+	std::vector<MethodInfo> Methods;
+	Methods.push_back({ "PS Copy", 1024, 0 });
+	for (int GroupSize : { 1, 2, 4, 8, 16 })
+	{
+		MethodInfo Method = { "", 1024, GroupSize, CSDispatchOrder::RowMajor, 0 };
+		snprintf(Method.Name, sizeof(Method.Name), "CS Copy (%2dx%2d)", GroupSize, GroupSize);
+		Methods.push_back(Method);
+	}
+	Methods.push_back({ "CopyResource", 1024, -1 });
+	Methods.push_back({ "CS Copy ( 8x 8) row", 4096, 8, CSDispatchOrder::RowMajor, 0 });
+	Methods.push_back({ "CS Copy ( 8x 8) morton", 4096, 8, CSDispatchOrder::Morton, 0 });
+	Methods.push_back({ "CS Copy ( 8x 8) tiled 4", 4096, 8, CSDispatchOrder::ColumnTiled, 4 });
+	Methods.push_back({ "CS Copy ( 8x 8) tiled 16", 4096, 8, CSDispatchOrder::ColumnTiled, 16 });
+	Methods.push_back({ "CopyResource", 4096, -1 });
+
+	LOG("%-26s %-11s %-6s %9s %9s %8s %8s %10s %8s", "Method", "Texture", "Layout", "lanes/req", "lines/req", "L1 hit", "L2 hit", "DRAM MB", "x ideal");
+	for (const MethodInfo& Method : Methods)
+	{
+		for (SimLayout Layout : { SimLayout::Linear, SimLayout::Tiled, SimLayout::StandardSwizzle })
+		{
+			SimStream Stream;
+			if (Method.GroupSize > 0)
+			{
+				CSDispatch Dispatch;
+				Dispatch.NumThreads[0] = Method.GroupSize;
+				Dispatch.NumThreads[1] = Method.GroupSize;
+				Dispatch.GroupCount[0] = (Method.Size + Method.GroupSize - 1) / Method.GroupSize;
+				Dispatch.GroupCount[1] = (Method.Size + Method.GroupSize - 1) / Method.GroupSize;
+				Dispatch.Order = Method.Order;
+				Dispatch.TileWidth = Method.TileWidth;
+				BuildCSCopyStream(Dispatch, Method.Size, Method.Size, Config, Stream);
+			}
+			else if (Method.GroupSize == 0)
+			{
+				BuildPSCopyStream(Method.Size, Method.Size, Config, Stream);
+			}
+			else
+			{
+				BuildCopyResourceStream(Layout, Method.Size, Method.Size, Config, Stream);
+			}
+
+			const CacheSimResult Result = SimulateCopy(Stream, Layout, Method.Size, Method.Size, Config);
+			const double IdealBytes = 2.0 * Method.Size * Method.Size * 4;	// read the source and write the destination once
+			const double DRAMBytes = (double)(Result.DRAMReadBytes + Result.DRAMWriteBytes);
+
+			char Texture[16] = {};
+			snprintf(Texture, sizeof(Texture), "%d x %d", Method.Size, Method.Size);
+			LOG("%-26s %-11s %-6s %9.1f %9.2f %7.1f%% %7.1f%% %10.1f %8.2f", Method.Name, Texture, GetSimLayoutName(Layout),
+				(double)Result.Lanes / Result.Requests, (double)Result.Transactions / Result.Requests,
+				Result.L1Accesses ? 100.0 * Result.L1Hits / Result.L1Accesses : 0.0,
+				Result.L2Accesses ? 100.0 * Result.L2Hits / Result.L2Accesses : 0.0,
+				DRAMBytes / (1024.0 * 1024.0), DRAMBytes / IdealBytes);
+		}
+	}
+}
+
+// Linear to tiled and back for each layout and SIMD level, checked texel by texel against
+// GetSwizzledTexelOffset, on a size with ragged edges and on a large texture
+void RunSwizzleBenchmark()
+{
+	const SwizzleLayout* Layouts[] = { &StandardSwizzle64KB, &MortonSwizzle4KB, &RowTiled64KB };
+	const char* LevelNames[] = { "scalar", "SSE2/NEON", "AVX2" };
+	const int Sizes[][2] = { { 1000, 701 }, { 4096, 4096 } };
+
+	// The standard swizzle has to match the hardware layout, not just round trip
+	const int NumKnown = sizeof(StandardSwizzle64KBKnownOffsets) / sizeof(StandardSwizzle64KBKnownOffsets[0]);
+	int KnownMismatches = 0;
+	for (const SwizzleKnownOffset& Known : StandardSwizzle64KBKnownOffsets)
+	{
+		const size_t Offset = GetSwizzledTexelOffset(StandardSwizzle64KB, StandardSwizzle64KB.TileWidth, Known.X, Known.Y);
+		if (Offset != Known.Offset)
+		{
+			LOG("Swizzle %s texel (%d, %d) at byte %zu, expected %u MISMATCH", StandardSwizzle64KB.Name, Known.X, Known.Y, Offset, Known.Offset);
+			KnownMismatches++;
+		}
+	}
+	LOG("Swizzle %s known texel offsets: %d of %d match", StandardSwizzle64KB.Name, NumKnown - KnownMismatches, NumKnown);
+
+	for (const int* Size : Sizes)
+	{
+		const int Width = Size[0];
+		const int Height = Size[1];
+		const int Pitch = (Width * 4 + 255) & ~255;
+		const double TextureGB = (double)Width * Height * 4 / (1024.0 * 1024.0 * 1024.0);
+		const int Iters = (int)(256 * 1024 * 1024 / ((size_t)Width * Height * 4)) + 4;
+
+		std::vector<uint8_t> Linear((size_t)Pitch * Height), RoundTrip((size_t)Pitch * Height);
+		for (uint8_t& Byte : Linear)
+		{
+			Byte = (uint8_t)rand();
+		}
+
+		LOG("Swizzle %4d x %4d texture, GB/s:        to tiled  to linear", Width, Height);
+		for (const SwizzleLayout* Layout : Layouts)
+		{
+			std::vector<uint8_t> Tiled(GetSwizzledSize(*Layout, Width, Height));
+			for (int Level = 0; Level < 3; Level++)
+			{
+				if (Level == 2 && !GetCPUFeatures().AVX2)
+				{
+					continue;
+				}
+
+				ConvertSwizzle(*Layout, Linear.data(), Pitch, Width, Height, Tiled.data(), true, Level);
+				memset(RoundTrip.data(), 0, RoundTrip.size());
+				ConvertSwizzle(*Layout, RoundTrip.data(), Pitch, Width, Height, Tiled.data(), false, Level);
+
+				bool bMatches = true;
+				for (int y = 0; y < Height && bMatches; y++)
+				{
+					bMatches = memcmp(Linear.data() + (size_t)y * Pitch, RoundTrip.data() + (size_t)y * Pitch, (size_t)Width * 4) == 0;
+					for (int x = 0; x < Width && bMatches; x += 7)
+					{
+						bMatches = memcmp(Tiled.data() + GetSwizzledTexelOffset(*Layout, Width, x, y), Linear.data() + (size_t)y * Pitch + x * 4, 4) == 0;
+					}
+				}
+
+				double BestSec[2] = { 1e30, 1e30 };
+				for (int Iter = 0; Iter < Iters; Iter++)
+				{
+					for (int Direction = 0; Direction < 2; Direction++)
+					{
+						uint8_t* LinearData = Direction == 0 ? Linear.data() : RoundTrip.data();
+						auto Start = std::chrono::high_resolution_clock::now();
+						ConvertSwizzle(*Layout, LinearData, Pitch, Width, Height, Tiled.data(), Direction == 0, Level);
+						double Sec = GetElapsedSeconds(Start);
+						BestSec[Direction] = Sec < BestSec[Direction] ? Sec : BestSec[Direction];
+					}
+				}
+
+				LOG("  %-14s %-10s:      %8.2f   %8.2f%s", Layout->Name, LevelNames[Level], TextureGB / BestSec[0], TextureGB / BestSec[1], bMatches ? "" : " MISMATCH");
+			}
+		}
+	}
+}
+
+// Random allocate and free traffic against the buddy allocator, in the sizes and alignment classes of transient
+// copy targets. Checks the allocator's structure and that live allocations never overlap, then times it.
+void RunHeapAllocatorBenchmark()
+{
+	const uint64_t HeapSize = PlacedResourceAllocator::HeapSize;
+	const uint64_t Alignments[] = { D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT };
+
+	struct LiveAllocation
+	{
+		uint64_t Offset;
+		uint64_t Bytes;
+	};
+
+	uint32_t Seed = 0x9e3779b9u;
+	auto NextRandom = [&Seed]() { return NextXorShift32(Seed); };
+
+	// Sizes spread evenly over powers of two from 256 bytes to 16MB, mostly at the default alignment
+	auto RandomRequest = [&](uint64_t* Bytes, uint64_t* Alignment)
+	{
+		const uint32_t Class = NextRandom() % 16;
+		*Alignment = Alignments[Class < 3 ? 0 : (Class < 15 ? 1 : 2)];
+		const uint64_t Base = 1ull << (8 + NextRandom() % 17);
+		*Bytes = Base + NextRandom() % Base;
+	};
+
+	BuddyAllocator Allocator;
+	Allocator.Init(HeapSize, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT);
+
+	{
+		const int FuzzOps = 200 * 1000;
+		bool bValid = true;
+		int NumAllocations = 0;
+		int Failures = 0;
+		int FragmentationFailures = 0;
+		uint64_t RequestedBytes = 0;
+		uint64_t GrantedBytes = 0;
+		std::vector<LiveAllocation> Live;
+
+		for (int Op = 0; Op < FuzzOps && bValid; Op++)
+		{
+			if (Live.empty() || NextRandom() % 100 < 55)
+			{
+				uint64_t Bytes, Alignment;
+				RandomRequest(&Bytes, &Alignment);
+				const uint64_t Offset = Allocator.Allocate(Bytes, Alignment);
+				if (Offset == BuddyAllocator::InvalidOffset)
+				{
+					Failures++;
+					uint64_t Rounded = Allocator.MinBlockSize;
+					while (Rounded < Bytes || Rounded < Alignment)
+					{
+						Rounded <<= 1;
+					}
+					FragmentationFailures += (HeapSize - Allocator.UsedBytes >= Rounded) ? 1 : 0;
+				}
+				else
+				{
+					bValid = Offset % Alignment == 0 && Offset + Bytes <= HeapSize && Allocator.GetAllocationSize(Offset) >= Bytes;
+					NumAllocations++;
+					RequestedBytes += Bytes;
+					GrantedBytes += Allocator.GetAllocationSize(Offset);
+					Live.push_back({ Offset, Bytes });
+				}
+			}
+			else
+			{
+				const size_t Index = NextRandom() % Live.size();
+				Allocator.Free(Live[Index].Offset);
+				Live[Index] = Live.back();
+				Live.pop_back();
+			}
+
+			if (Op % 1024 == 0)
+			{
+				std::vector<LiveAllocation> Sorted = Live;
+				std::sort(Sorted.begin(), Sorted.end(), [](const LiveAllocation& A, const LiveAllocation& B) { return A.Offset < B.Offset; });
+				for (size_t i = 1; i < Sorted.size() && bValid; i++)
+				{
+					bValid = Sorted[i - 1].Offset + Allocator.GetAllocationSize(Sorted[i - 1].Offset) <= Sorted[i].Offset;
+				}
+				bValid = bValid && Allocator.Validate();
+			}
+		}
+
+		for (const LiveAllocation& Allocation : Live)
+		{
+			Allocator.Free(Allocation.Offset);
+		}
+		bValid = bValid && Allocator.Validate() && Allocator.UsedBytes == 0 && Allocator.GetLargestFreeBlock() == HeapSize;
+
+		LOG("Buddy allocator fuzz: %d ops, %d allocations, %d failed (%d for fragmentation), %.1f%% rounding waste%s",
+			FuzzOps, NumAllocations, Failures, FragmentationFailures, 100.0 * (GrantedBytes - RequestedBytes) / (double)GrantedBytes, bValid ? "" : " MISMATCH");
+	}
+
+	// Steady state: a pool of live transient targets, each op freeing one and allocating a replacement
+	{
+		const int NumLive = 64;
+		const int TimedOps = 1000 * 1000;
+		struct Request
+		{
+			uint64_t Bytes;
+			uint64_t Alignment;
+		};
+
+		// A sixteenth of the fuzz sizes, so the pool fits in the heap
+		std::vector<Request> Requests(4096);
+		for (Request& Req : Requests)
+		{
+			RandomRequest(&Req.Bytes, &Req.Alignment);
+			Req.Bytes /= 16;
+		}
+
+		std::vector<uint64_t> Live(NumLive, BuddyAllocator::InvalidOffset);
+		int Failures = 0;
+		auto Start = std::chrono::high_resolution_clock::now();
+		for (int Op = 0; Op < TimedOps; Op++)
+		{
+			uint64_t& Offset = Live[Op % NumLive];
+			if (Offset != BuddyAllocator::InvalidOffset)
+			{
+				Allocator.Free(Offset);
+			}
+			const Request& Req = Requests[Op % Requests.size()];
+			Offset = Allocator.Allocate(Req.Bytes, Req.Alignment);
+			Failures += Offset == BuddyAllocator::InvalidOffset ? 1 : 0;
+		}
+		const double Seconds = GetElapsedSeconds(Start);
+
+		LOG("Buddy allocator: %.1f ns per free + allocate (%d live, %d failed)", Seconds * 1e9 / TimedOps, NumLive, Failures);
+	}
+}
+
+// The shaders main needs before the first test, in the order it reads them back
+std::vector<ShaderCompileRequest> GetStartupShaderRequests()
+{
+	return
+	{
+		{ "<VS_SOURCE>", VertexShaderCode, "VSMain", "vs_5_0" },
+		{ "<PS_SOURCE>", PixelShaderCode, "PSMain", "ps_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCode1x1, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCode2x2, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCode4x4, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCode8x8, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCode16x16, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCodeBindless, "CSMain", "cs_5_1" },
+		{ "<CS_SOURCE>", ComputeShaderCodeBufferCopy, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCodeBufferCopyWide, "CSMain", "cs_5_0" },
+		{ "<CS_SOURCE>", ComputeShaderCodeTileCopy, "CSMain", "cs_5_0" },
+	};
+}
+
+// Stands in for the compiler when checking the cache: the bytecode is a function of the request and every
+// call is counted, so the check knows exactly which requests missed
+struct StubShaderCompiler
+{
+	static std::atomic<int> NumCompiles;
+
+	static HRESULT Compile(const ShaderCompileRequest& Request, ID3DBlob** ByteCode, ID3DBlob** ErrorMsg)
+	{
+		NumCompiles++;
+		*ErrorMsg = nullptr;
+		uint64_t Words[4] = { ShaderCache::GetKey(Request), 0, 0, 0 };
+		for (int i = 1; i < 4; i++)
+		{
+			Words[i] = HashBytes(&Words[i - 1], sizeof(Words[i - 1]), Words[i - 1]);
+		}
+		HRESULT hr = D3DCreateBlob(sizeof(Words), ByteCode);
+		if (SUCCEEDED(hr))
+		{
+			memcpy((*ByteCode)->GetBufferPointer(), Words, sizeof(Words));
+		}
+		return hr;
+	}
+};
+
+std::atomic<int> StubShaderCompiler::NumCompiles;
+
+void RunShaderCacheBenchmark()
+{
+	auto ReleaseAll = [](std::vector<ShaderCompileRequest>& Requests)
+	{
+		for (ShaderCompileRequest& Request : Requests)
+		{
+			if (Request.ByteCode)
+			{
+				Request.ByteCode->Release();
+				Request.ByteCode = nullptr;
+			}
+		}
+	};
+
+	auto CountFromCache = [](const std::vector<ShaderCompileRequest>& Requests)
+	{
+		int Count = 0;
+		for (const ShaderCompileRequest& Request : Requests)
+		{
+			Count += Request.bFromCache ? 1 : 0;
+		}
+		return Count;
+	};
+
+	auto RemoveCacheFiles = [](const ShaderCache& Cache, const std::vector<ShaderCompileRequest>& Requests)
+	{
+		for (const ShaderCompileRequest& Request : Requests)
+		{
+			remove(Cache.GetPath(ShaderCache::GetKey(Request)).c_str());
+		}
+	};
+
+	// Every remap variant the copy tests could ask for, on top of the startup set
+	std::vector<ShaderCompileRequest> Requests = GetStartupShaderRequests();
+	const CSDispatchOrder Orders[] = { CSDispatchOrder::RowMajor, CSDispatchOrder::ColumnMajor, CSDispatchOrder::Morton, CSDispatchOrder::ColumnTiled };
+	for (uint32_t GroupSize : { 4u, 8u, 16u })
+	{
+		for (CSDispatchOrder Order : Orders)
+		{
+			for (uint32_t TileWidth : { 4u, 16u })
+			{
+				if (Order != CSDispatchOrder::ColumnTiled && TileWidth != 4)
+				{
+					continue;
+				}
+				CSDispatch Dispatch;
+				Dispatch.NumThreads[0] = GroupSize;
+				Dispatch.NumThreads[1] = GroupSize;
+				Dispatch.GroupCount[0] = 4096 / GroupSize;
+				Dispatch.GroupCount[1] = 4096 / GroupSize;
+				Dispatch.Order = Order;
+				Dispatch.TileWidth = Order == CSDispatchOrder::ColumnTiled ? TileWidth : 0;
+				Requests.push_back(GetRemapCopyShaderRequest(Dispatch));
+			}
+		}
+	}
+	const int NumRequests = (int)Requests.size();
+
+	std::string Directory = ShaderCacheDirectory[0] ? ShaderCacheDirectory : "shader_cache";
+	ShaderCache Cache;
+	Cache.Init(Directory.c_str());
+	Cache.bUseEmbedded = false;
+
+	// The cache logic against the stub compiler: misses, hits, a corrupt entry and an edited request
+	{
+		ShaderCache StubCache = Cache;
+		StubCache.Compile = StubShaderCompiler::Compile;
+		RemoveCacheFiles(StubCache, Requests);
+
+		// The stub's keys are the real compiler's keys, so its entries are cleared again before the timing below
+		std::vector<ShaderCompileRequest> Cold = Requests;
+		StubShaderCompiler::NumCompiles = 0;
+		bool bColdOk = StubCache.GetAll(Cold.data(), NumRequests);
+		const int ColdCompiles = StubShaderCompiler::NumCompiles;
+
+		std::vector<ShaderCompileRequest> Warm = Requests;
+		StubShaderCompiler::NumCompiles = 0;
+		bool bWarmOk = StubCache.GetAll(Warm.data(), NumRequests);
+		const int WarmCompiles = StubShaderCompiler::NumCompiles;
+
+		bool bSame = bColdOk && bWarmOk;
+		for (int i = 0; bSame && i < NumRequests; i++)
+		{
+			bSame = Cold[i].ByteCode->GetBufferSize() == Warm[i].ByteCode->GetBufferSize() &&
+				memcmp(Cold[i].ByteCode->GetBufferPointer(), Warm[i].ByteCode->GetBufferPointer(), Cold[i].ByteCode->GetBufferSize()) == 0;
+		}
+
+		// Flip a byte in the middle of one entry, which must then recompile rather than load
+		std::string CorruptPath = StubCache.GetPath(ShaderCache::GetKey(Requests[0]));
+		FILE* File = nullptr;
+		if (fopen_s(&File, CorruptPath.c_str(), "r+b") == 0 && File)
+		{
+			fseek(File, -4, SEEK_END);
+			fputc(0xA5, File);
+			fclose(File);
+		}
+		ShaderCompileRequest Corrupt = Requests[0];
+		StubShaderCompiler::NumCompiles = 0;
+		StubCache.Get(Corrupt);
+		const int CorruptCompiles = StubShaderCompiler::NumCompiles;
+
+		// Any change to a define is a different key
+		ShaderCompileRequest Edited = Requests[NumRequests - 1];
+		Edited.Defines.back().second += "0";
+		const bool bEditedKeyDiffers = ShaderCache::GetKey(Edited) != ShaderCache::GetKey(Requests[NumRequests - 1]);
+
+		const bool bPassed = bSame && ColdCompiles == NumRequests && WarmCompiles == 0 && CountFromCache(Warm) == NumRequests &&
+			CorruptCompiles == 1 && !Corrupt.bFromCache && bEditedKeyDiffers;
+		LOG("Shader cache check: %d cold compiles, %d warm compiles, %d after corruption%s", ColdCompiles, WarmCompiles, CorruptCompiles, bPassed ? "" : " MISMATCH");
+
+		if (Corrupt.ByteCode)
+		{
+			Corrupt.ByteCode->Release();
+		}
+		ReleaseAll(Cold);
+		ReleaseAll(Warm);
+		RemoveCacheFiles(StubCache, Requests);
+	}
+
+	// Real compiles: one thread with no cache, all threads with no cache, then all hits
+	std::vector<ShaderCompileRequest> Serial = Requests;
+	auto Start = std::chrono::high_resolution_clock::now();
+	bool bSerialOk = true;
+	for (ShaderCompileRequest& Request : Serial)
+	{
+		bSerialOk = Cache.Get(Request) && bSerialOk;
+	}
+	const double SerialSeconds = GetElapsedSeconds(Start);
+	RemoveCacheFiles(Cache, Requests);
+
+	std::vector<ShaderCompileRequest> Cold = Requests;
+	Start = std::chrono::high_resolution_clock::now();
+	bool bColdOk = Cache.GetAll(Cold.data(), NumRequests);
+	const double ColdSeconds = GetElapsedSeconds(Start);
+
+	std::vector<ShaderCompileRequest> Warm = Requests;
+	Start = std::chrono::high_resolution_clock::now();
+	bool bWarmOk = Cache.GetAll(Warm.data(), NumRequests);
+	const double WarmSeconds = GetElapsedSeconds(Start);
+
+	bool bSame = bSerialOk && bColdOk && bWarmOk && CountFromCache(Cold) == 0 && CountFromCache(Warm) == NumRequests;
+	for (int i = 0; bSame && i < NumRequests; i++)
+	{
+		bSame = Cold[i].ByteCode->GetBufferSize() == Warm[i].ByteCode->GetBufferSize() &&
+			memcmp(Cold[i].ByteCode->GetBufferPointer(), Warm[i].ByteCode->GetBufferPointer(), Cold[i].ByteCode->GetBufferSize()) == 0 &&
+			Serial[i].ByteCode->GetBufferSize() == Cold[i].ByteCode->GetBufferSize() &&
+			memcmp(Serial[i].ByteCode->GetBufferPointer(), Cold[i].ByteCode->GetBufferPointer(), Cold[i].ByteCode->GetBufferSize()) == 0;
+	}
+
+	LOG("%d shaders in %s", NumRequests, Directory.c_str());
+	LOG("  Cold, 1 thread:    %8.2f ms", SerialSeconds * 1000.0);
+	LOG("  Cold, %2d threads:  %8.2f ms", GetMaxThreads(), ColdSeconds * 1000.0);
+	LOG("  Warm:              %8.2f ms (%.1fx faster than cold)%s", WarmSeconds * 1000.0, ColdSeconds / WarmSeconds, bSame ? "" : " MISMATCH");
+
+	ReleaseAll(Serial);
+	ReleaseAll(Cold);
+	ReleaseAll(Warm);
+}
+
+// Checks the desc hashing and the pipeline library file format without a device, and times the hashing,
+// which is what every cache hit costs
+void RunPipelineCacheBenchmark()
+{
+	bool bPassed = true;
+	auto Expect = [&bPassed](bool bCondition, const char* What)
+	{
+		if (!bCondition)
+		{
+			LOG("Pipeline cache check failed: %s", What);
+			bPassed = false;
+		}
+	};
+
+	// Root signatures: the same desc built twice in different memory, then one field changed at a time
+	{
+		auto BuildAndHash = [](UINT NumDescriptors, D3D12_FILTER Filter)
+		{
+			std::vector<D3D12_DESCRIPTOR_RANGE> Ranges(2);
+			Ranges[0] = { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, NumDescriptors, 0, 0, 0 };
+			Ranges[1] = { D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0, 0 };
+
+			std::vector<D3D12_ROOT_PARAMETER> Params(2);
+			for (int i = 0; i < 2; i++)
+			{
+				Params[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+				Params[i].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+				Params[i].DescriptorTable.NumDescriptorRanges = 1;
+				Params[i].DescriptorTable.pDescriptorRanges = &Ranges[i];
+			}
+
+			D3D12_STATIC_SAMPLER_DESC Sampler = {};
+			Sampler.Filter = Filter;
+			Sampler.MaxLOD = D3D12_FLOAT32_MAX;
+
+			D3D12_ROOT_SIGNATURE_DESC Desc = {};
+			Desc.NumParameters = 2;
+			Desc.pParameters = Params.data();
+			Desc.NumStaticSamplers = 1;
+			Desc.pStaticSamplers = &Sampler;
+			return HashRootSignatureDesc(Desc);
+		};
+
+		const uint64_t Key = BuildAndHash(1, D3D12_FILTER_MIN_MAG_MIP_POINT);
+		Expect(Key == BuildAndHash(1, D3D12_FILTER_MIN_MAG_MIP_POINT), "equal root signatures hash differently");
+		Expect(Key != BuildAndHash(2, D3D12_FILTER_MIN_MAG_MIP_POINT), "descriptor count not hashed");
+		Expect(Key != BuildAndHash(1, D3D12_FILTER_MIN_MAG_MIP_LINEAR), "static sampler not hashed");
+	}
+
+	// PSOs: bytecode is hashed by content, states by value
+	std::vector<uint8_t> ByteCodeA(4096), ByteCodeB;
+	for (size_t i = 0; i < ByteCodeA.size(); i++)
+	{
+		ByteCodeA[i] = (uint8_t)(i * 37 + (i >> 7));
+	}
+	ByteCodeB = ByteCodeA;
+
+	const D3D12_INPUT_ELEMENT_DESC Elements[] = { { "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 } };
+	auto GetGraphicsDesc = [&](const std::vector<uint8_t>& ByteCode)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = {};
+		Desc.InputLayout = { Elements, 1 };
+		Desc.VS = { ByteCode.data(), ByteCode.size() };
+		Desc.PS = { ByteCode.data(), ByteCode.size() };
+		Desc.RasterizerState = GetDefaultRasterizerDesc();
+		Desc.BlendState = GetDefaultBlendStateDesc();
+		Desc.SampleMask = UINT_MAX;
+		Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		Desc.NumRenderTargets = 1;
+		Desc.RTVFormats[0] = DXGI_FORMAT_B8G8R8A8_UNORM;
+		Desc.SampleDesc.Count = 1;
+		return Desc;
+	};
+
+	{
+		const uint64_t Key = HashGraphicsPSODesc(GetGraphicsDesc(ByteCodeA), 1);
+		Expect(Key == HashGraphicsPSODesc(GetGraphicsDesc(ByteCodeB), 1), "equal bytecode at another address hashes differently");
+		Expect(Key != HashGraphicsPSODesc(GetGraphicsDesc(ByteCodeA), 2), "root signature not hashed");
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Changed = GetGraphicsDesc(ByteCodeA);
+		Changed.BlendState.RenderTarget[0].RenderTargetWriteMask = 0x7;
+		Expect(Key != HashGraphicsPSODesc(Changed, 1), "blend state not hashed");
+
+		Changed = GetGraphicsDesc(ByteCodeA);
+		Changed.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+		Expect(Key != HashGraphicsPSODesc(Changed, 1), "render target format not hashed");
+
+		const D3D12_INPUT_ELEMENT_DESC Renamed[] = { { "TEXCOORD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 } };
+		Changed = GetGraphicsDesc(ByteCodeA);
+		Changed.InputLayout = { Renamed, 1 };
+		Expect(Key != HashGraphicsPSODesc(Changed, 1), "semantic name not hashed");
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC Compute = {};
+		Compute.CS = { ByteCodeA.data(), ByteCodeA.size() };
+		const uint64_t ComputeKey = HashComputePSODesc(Compute, 1);
+		ByteCodeB[ByteCodeB.size() / 2] ^= 1;
+		Compute.CS = { ByteCodeB.data(), ByteCodeB.size() };
+		Expect(ComputeKey != HashComputePSODesc(Compute, 1), "bytecode content not hashed");
+	}
+
+	// The file: a round trip, then another adapter, a flipped payload byte and a truncated file
+	{
+		DXGI_ADAPTER_DESC AdapterDesc = {};
+		AdapterDesc.VendorId = 0x10DE;
+		AdapterDesc.DeviceId = 0x2684;
+		const PipelineCacheFileHeader Identity = GetPipelineCacheIdentity(AdapterDesc);
+		AdapterDesc.DeviceId++;
+		const PipelineCacheFileHeader OtherIdentity = GetPipelineCacheIdentity(AdapterDesc);
+
+		const std::string Path = "pipeline_cache_check.bin";
+		std::vector<uint8_t> Data;
+		Expect(WritePipelineCacheFile(Path, Identity, ByteCodeA.data(), ByteCodeA.size()), "writing the file");
+		Expect(ReadPipelineCacheFile(Path, Identity, Data) && Data == ByteCodeA, "round trip");
+		Expect(!ReadPipelineCacheFile(Path, OtherIdentity, Data) && Data.empty(), "file for another adapter accepted");
+
+		auto PatchFile = [&Path](long Offset, int Value, bool bTruncate)
+		{
+			std::vector<uint8_t> Contents;
+			FILE* File = nullptr;
+			if (fopen_s(&File, Path.c_str(), "rb") == 0 && File)
+			{
+				uint8_t Buffer[4096];
+				size_t Read = 0;
+				while ((Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+				{
+					Contents.insert(Contents.end(), Buffer, Buffer + Read);
+				}
+				fclose(File);
+			}
+			if (bTruncate)
+			{
+				Contents.resize(Contents.size() - Offset);
+			}
+			else
+			{
+				Contents[Contents.size() - Offset] ^= (uint8_t)Value;
+			}
+			if (fopen_s(&File, Path.c_str(), "wb") == 0 && File)
+			{
+				fwrite(Contents.data(), 1, Contents.size(), File);
+				fclose(File);
+			}
+		};
+
+		PatchFile(100, 0x10, false);
+		Expect(!ReadPipelineCacheFile(Path, Identity, Data), "corrupt payload accepted");
+		PatchFile(100, 0x10, false);
+		Expect(ReadPipelineCacheFile(Path, Identity, Data), "restored file rejected");
+		PatchFile(1, 0, true);
+		Expect(!ReadPipelineCacheFile(Path, Identity, Data), "truncated file accepted");
+		remove(Path.c_str());
+	}
+
+	// What a hit costs: hashing a graphics desc with 4KB shaders, and a compute desc
+	{
+		const int Iters = 100 * 1000;
+		const D3D12_GRAPHICS_PIPELINE_STATE_DESC Graphics = GetGraphicsDesc(ByteCodeA);
+		D3D12_COMPUTE_PIPELINE_STATE_DESC Compute = {};
+		Compute.CS = { ByteCodeA.data(), ByteCodeA.size() };
+
+		uint64_t Sum = 0;
+		auto Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < Iters; i++)
+		{
+			Sum += HashGraphicsPSODesc(Graphics, i);
+		}
+		const double GraphicsSeconds = GetElapsedSeconds(Start);
+
+		Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < Iters; i++)
+		{
+			Sum += HashComputePSODesc(Compute, i);
+		}
+		const double ComputeSeconds = GetElapsedSeconds(Start);
+
+		LOG("PSO desc hash: graphics %.2f usec, compute %.2f usec (%llx)", GraphicsSeconds * 1e6 / Iters, ComputeSeconds * 1e6 / Iters, (unsigned long long)(Sum & 0xff));
+	}
+
+	LOG("Pipeline cache check: %s", bPassed ? "ok" : "MISMATCH");
+}
+
+// View creation rates, descriptor copy throughput by batch size and source layout, and the cost of a
+// DescriptorAllocator table. The textures only need to be valid for their view type: SRVTexture for an
+// SRV, UAVTexture for a UAV, RTTexture for an RTV. On the software device every copy is also checked.
+void RunDescriptorBenchmark(DescriptorDevice& Device, ID3D12Resource* SRVTexture, ID3D12Resource* UAVTexture, ID3D12Resource* RTTexture)
+{
+	const UINT HeapSize = 4096;
+	const D3D12_DESCRIPTOR_HEAP_TYPE ViewType = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	const UINT DescriptorSize = Device.GetDescriptorSize(ViewType);
+	bool bPassed = true;
+
+	LOG("Descriptor benchmark on the %s device, %d byte descriptors", Device.IsSoftware() ? "software" : "D3D12", DescriptorSize);
+
+	uint32_t Seed = 0x9e3779b9u;
+	auto NextRandom = [&Seed]() { return NextXorShift32(Seed); };
+
+	auto Offset = [](D3D12_CPU_DESCRIPTOR_HANDLE Handle, UINT Index, UINT Size)
+	{
+		Handle.ptr += (SIZE_T)Index * Size;
+		return Handle;
+	};
+
+	// Creation: each view type written round the heap, the way streaming creates views for new textures
+	{
+		const int Iters = 64 * 1024;
+		DescriptorDeviceHeap ViewHeap = Device.CreateHeap(ViewType, HeapSize, false);
+		DescriptorDeviceHeap RTVHeap = Device.CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, HeapSize, false);
+		const UINT RTVSize = Device.GetDescriptorSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+		const D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = GetTextureSRVDesc();
+		const D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = GetTextureUAVDesc();
+		D3D12_RENDER_TARGET_VIEW_DESC RTVDesc = {};
+		RTVDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		RTVDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
+
+		auto Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < Iters; i++)
+		{
+			Device.CreateShaderResourceView(SRVTexture, &SRVDesc, Offset(ViewHeap.CPUStart, i % HeapSize, DescriptorSize));
+		}
+		const double SRVSeconds = GetElapsedSeconds(Start);
+
+		Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < Iters; i++)
+		{
+			Device.CreateUnorderedAccessView(UAVTexture, nullptr, &UAVDesc, Offset(ViewHeap.CPUStart, i % HeapSize, DescriptorSize));
+		}
+		const double UAVSeconds = GetElapsedSeconds(Start);
+
+		Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < Iters; i++)
+		{
+			Device.CreateRenderTargetView(RTTexture, &RTVDesc, Offset(RTVHeap.CPUStart, i % HeapSize, RTVSize));
+		}
+		const double RTVSeconds = GetElapsedSeconds(Start);
+
+		// The baseline: a two descriptor shader-visible heap per texture pair
+		const int HeapIters = 1024;
+		std::vector<DescriptorDeviceHeap> PairHeaps(HeapIters);
+		Start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < HeapIters; i++)
+		{
+			PairHeaps[i] = CreateSRVUAVHeapForTextures(Device, SRVTexture, UAVTexture);
+		}
+		const double PairHeapSeconds = GetElapsedSeconds(Start);
+		for (DescriptorDeviceHeap& Heap : PairHeaps)
+		{
+			Device.DestroyHeap(Heap);
+		}
+
+		LOG("View creation: SRV %6.1f ns, UAV %6.1f ns, RTV %6.1f ns, SRV+UAV in its own heap %8.1f ns",
+			SRVSeconds * 1e9 / Iters, UAVSeconds * 1e9 / Iters, RTVSeconds * 1e9 / Iters, PairHeapSeconds * 1e9 / HeapIters);
+
+		Device.DestroyHeap(ViewHeap);
+		Device.DestroyHeap(RTVHeap);
+	}
+
+	// The staging heap, with every descriptor distinct so the software device can check where copies land
+	DescriptorDeviceHeap Staging = Device.CreateHeap(ViewType, HeapSize, false);
+	{
+		const D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = GetTextureSRVDesc();
+		for (UINT i = 0; i < HeapSize; i++)
+		{
+			D3D12_SHADER_RESOURCE_VIEW_DESC Desc = SRVDesc;
+			Desc.Texture2D.MostDetailedMip = Device.IsSoftware() ? i : 0;
+			Device.CreateShaderResourceView(SRVTexture, &Desc, Offset(Staging.CPUStart, i, DescriptorSize));
+		}
+	}
+
+	auto CheckTable = [&](D3D12_CPU_DESCRIPTOR_HANDLE Table, const UINT* Slots, UINT Count)
+	{
+		for (UINT i = 0; i < Count; i++)
+		{
+			if (memcmp((const void*)(Table.ptr + (SIZE_T)i * DescriptorSize), (const void*)(Staging.CPUStart.ptr + (SIZE_T)Slots[i] * DescriptorSize), DescriptorSize) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	enum class SourceLayout
+	{
+		Contiguous,	// One run of consecutive slots
+		Runs,		// Runs of four, with gaps between
+		Scattered,	// Random slots
+	};
+	const char* LayoutNames[] = { "contiguous", "runs of 4", "scattered" };
+	const SourceLayout Layouts[] = { SourceLayout::Contiguous, SourceLayout::Runs, SourceLayout::Scattered };
+
+	// Source slots for NumTables tables of BatchSize descriptors each
+	auto BuildSlots = [&](SourceLayout Layout, UINT BatchSize, UINT NumTables)
+	{
+		std::vector<UINT> Slots(BatchSize * NumTables);
+		for (UINT Table = 0; Table < NumTables; Table++)
+		{
+			UINT* TableSlots = &Slots[Table * BatchSize];
+			const UINT Span = (Layout == SourceLayout::Runs) ? BatchSize * 2 : BatchSize;
+			const UINT Base = NextRandom() % (HeapSize - Span + 1);
+			for (UINT i = 0; i < BatchSize; i++)
+			{
+				switch (Layout)
+				{
+				case SourceLayout::Contiguous:
+					TableSlots[i] = Base + i;
+					break;
+				case SourceLayout::Runs:
+					TableSlots[i] = Base + (i / 4) * 8 + i % 4;
+					break;
+				case SourceLayout::Scattered:
+					TableSlots[i] = NextRandom() % HeapSize;
+					break;
+				}
+			}
+		}
+		return Slots;
+	};
+
+	// Copies: each table copied three ways into a shader-visible heap, at about the same number of
+	// descriptors per batch size. Times are per descriptor.
+	{
+		const UINT BatchSizes[] = { 1, 4, 16, 64, 256 };
+		const UINT DescriptorsPerTest = 64 * 1024;
+		DescriptorDeviceHeap Dst = Device.CreateHeap(ViewType, HeapSize, true);
+
+		LOG("Descriptor copies, ns per descriptor:   per descriptor   per run   one CopyDescriptors");
+		for (SourceLayout Layout : Layouts)
+		{
+			for (UINT BatchSize : BatchSizes)
+			{
+				const UINT NumTables = DescriptorsPerTest / BatchSize;
+				const std::vector<UINT> Slots = BuildSlots(Layout, BatchSize, NumTables);
+
+				// Source ranges for each table, with where each table's ranges start
+				std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> RangeStarts;
+				std::vector<UINT> RangeSizes;
+				std::vector<UINT> TableRanges(NumTables + 1, 0);
+				for (UINT Table = 0; Table < NumTables; Table++)
+				{
+					const UINT* TableSlots = &Slots[Table * BatchSize];
+					UINT RunStart = 0;
+					for (UINT i = 1; i <= BatchSize; i++)
+					{
+						if (i == BatchSize || TableSlots[i] != TableSlots[i - 1] + 1)
+						{
+							RangeStarts.push_back(Offset(Staging.CPUStart, TableSlots[RunStart], DescriptorSize));
+							RangeSizes.push_back(i - RunStart);
+							RunStart = i;
+						}
+					}
+					TableRanges[Table + 1] = (UINT)RangeStarts.size();
+				}
+
+				double Seconds[3] = {};
+				for (int Method = 0; Method < 3; Method++)
+				{
+					bool bCorrect = true;
+					auto Start = std::chrono::high_resolution_clock::now();
+					for (UINT Table = 0; Table < NumTables; Table++)
+					{
+						D3D12_CPU_DESCRIPTOR_HANDLE TableStart = Offset(Dst.CPUStart, (Table * BatchSize) % HeapSize, DescriptorSize);
+						const UINT* TableSlots = &Slots[Table * BatchSize];
+						if (Method == 0)
+						{
+							for (UINT i = 0; i < BatchSize; i++)
+							{
+								Device.CopyDescriptorsSimple(1, Offset(TableStart, i, DescriptorSize), Offset(Staging.CPUStart, TableSlots[i], DescriptorSize), ViewType);
+							}
+						}
+						else if (Method == 1)
+						{
+							D3D12_CPU_DESCRIPTOR_HANDLE RunDst = TableStart;
+							for (UINT Range = TableRanges[Table]; Range < TableRanges[Table + 1]; Range++)
+							{
+								Device.CopyDescriptorsSimple(RangeSizes[Range], RunDst, RangeStarts[Range], ViewType);
+								RunDst.ptr += (SIZE_T)RangeSizes[Range] * DescriptorSize;
+							}
+						}
+						else
+						{
+							const UINT First = TableRanges[Table];
+							Device.CopyDescriptors(1, &TableStart, &BatchSize, TableRanges[Table + 1] - First, &RangeStarts[First], &RangeSizes[First], ViewType);
+						}
+
+						if (Device.IsSoftware() && Table == NumTables - 1)
+						{
+							bCorrect = CheckTable(TableStart, TableSlots, BatchSize);
+						}
+					}
+					Seconds[Method] = GetElapsedSeconds(Start);
+
+					if (!bCorrect)
+					{
+						LOG("Descriptor copy MISMATCH: %s, batch of %d, method %d", LayoutNames[(int)Layout], BatchSize, Method);
+						bPassed = false;
+					}
+				}
+
+				LOG("  %-10s batch %3d (%5.1f runs):   %8.2f   %8.2f   %8.2f", LayoutNames[(int)Layout], BatchSize,
+					(double)RangeSizes.size() / NumTables, Seconds[0] * 1e9 / DescriptorsPerTest, Seconds[1] * 1e9 / DescriptorsPerTest, Seconds[2] * 1e9 / DescriptorsPerTest);
+			}
+		}
+
+		Device.DestroyHeap(Dst);
+	}
+	Device.DestroyHeap(Staging);
+
+	// DescriptorAllocator tables, retired and reclaimed against a fence that completes straight away
+	{
+		const UINT TableSizes[] = { 1, 2, 4, 8, 16 };
+		const UINT NumTables = 32 * 1024;
+		const UINT TablesPerFence = 256;
+
+		DescriptorAllocator Allocator;
+		Allocator.Init(&Device, HeapSize, 16 * 1024);
+		const UINT ViewsBase = Allocator.AllocateViews(HeapSize);
+		ASSERT(ViewsBase != DescriptorAllocator::InvalidSlot);
+		{
+			const D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = GetTextureSRVDesc();
+			for (UINT i = 0; i < HeapSize; i++)
+			{
+				D3D12_SHADER_RESOURCE_VIEW_DESC Desc = SRVDesc;
+				Desc.Texture2D.MostDetailedMip = Device.IsSoftware() ? i : 0;
+				Device.CreateShaderResourceView(SRVTexture, &Desc, Allocator.GetStagingHandle(ViewsBase + i));
+			}
+		}
+
+		LOG("Descriptor tables, ns per table:    contiguous   runs of 4   scattered");
+		uint64_t FenceValue = 1;
+		for (UINT TableSize : TableSizes)
+		{
+			double Seconds[3] = {};
+			for (SourceLayout Layout : Layouts)
+			{
+				std::vector<UINT> Slots = BuildSlots(Layout, TableSize, NumTables);
+				for (UINT& Slot : Slots)
+				{
+					Slot += ViewsBase;
+				}
+
+				bool bCorrect = true;
+				auto Start = std::chrono::high_resolution_clock::now();
+				for (UINT Table = 0; Table < NumTables; Table++)
+				{
+					D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = {};
+					bool bAllocated = Allocator.AllocateTable(&Slots[Table * TableSize], TableSize, &GPUHandle);
+					ASSERT(bAllocated);
+
+					if (Device.IsSoftware() && Table % TablesPerFence == 0)
+					{
+						// The software device's GPU handles are the descriptors' addresses
+						D3D12_CPU_DESCRIPTOR_HANDLE TableStart = { (SIZE_T)GPUHandle.ptr };
+						D3D12_CPU_DESCRIPTOR_HANDLE StagingStart = Allocator.GetStagingHandle(0);
+						for (UINT i = 0; i < TableSize && bCorrect; i++)
+						{
+							bCorrect = memcmp((const void*)(TableStart.ptr + (SIZE_T)i * DescriptorSize), (const void*)(StagingStart.ptr + (SIZE_T)Slots[Table * TableSize + i] * DescriptorSize), DescriptorSize) == 0;
+						}
+					}
+
+					if (Table % TablesPerFence == TablesPerFence - 1)
+					{
+						Allocator.Retire(FenceValue);
+						Allocator.Reclaim(FenceValue);
+						FenceValue++;
+					}
+				}
+				Seconds[(int)Layout] = GetElapsedSeconds(Start);
+
+				if (!bCorrect)
+				{
+					LOG("Descriptor table MISMATCH: %s, %d descriptors", LayoutNames[(int)Layout], TableSize);
+					bPassed = false;
+				}
+			}
+
+			LOG("  %2d descriptors:                  %8.1f    %8.1f    %8.1f", TableSize, Seconds[0] * 1e9 / NumTables, Seconds[1] * 1e9 / NumTables, Seconds[2] * 1e9 / NumTables);
+		}
+
+		Allocator.LogStats();
+		Allocator.FreeViews(ViewsBase);
+		Allocator.Shutdown();
+	}
+
+	if (Device.IsSoftware())
+	{
+		LOG("Descriptor check: %s", bPassed ? "ok" : "MISMATCH");
+	}
+}
+
+int main(int argc, char** argv) {
+
+	// Options, and the CPU-only benchmarks, which run and exit before a device is created
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--png-filter-bench") == 0)
+		{
+			RunPNGFilterBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--dump-format-bench") == 0)
+		{
+			RunDumpFormatBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--dump-format=png") == 0)
+		{
+			DefaultDumpFormat = DumpFormat::PNG;
+		}
+		if (strcmp(argv[i], "--dump-format=qoi") == 0)
+		{
+			DefaultDumpFormat = DumpFormat::QOI;
+		}
+		if (strcmp(argv[i], "--dump-format=raw") == 0)
+		{
+			DefaultDumpFormat = DumpFormat::Raw;
+		}
+		if (strcmp(argv[i], "--deflate-bench") == 0)
+		{
+			RunDeflateBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--checksum-bench") == 0)
+		{
+			RunChecksumBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--convert-bench") == 0)
+		{
+			RunConvertBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--jpeg-bench") == 0)
+		{
+			RunJpegBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--cpu-copy-bench") == 0)
+		{
+			RunCPUCopyBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--cs-emu-bench") == 0)
+		{
+			RunCSEmulatorBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--sw-raster-bench") == 0)
+		{
+			RunSWRasterizerBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--cs-remap-bench") == 0)
+		{
+			RunCSRemapBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--swizzle-bench") == 0)
+		{
+			RunSwizzleBenchmark();
+			return 0;
+		}
+		if (strncmp(argv[i], "--pool-budget-mb=", 17) == 0)
+		{
+			ResourcePoolBudgetMB = atoi(argv[i] + 17);
+		}
+		if (strcmp(argv[i], "--heap-alloc-bench") == 0)
+		{
+			RunHeapAllocatorBenchmark();
+			return 0;
+		}
+		// An empty directory, --shader-cache=, compiles everything at startup without touching the disk
+		if (strncmp(argv[i], "--shader-cache=", 15) == 0)
+		{
+			ShaderCacheDirectory = argv[i] + 15;
+		}
+		// Compiles at runtime even when shaders/ShaderBlobs.h was built in
+		if (strcmp(argv[i], "--no-embedded-shaders") == 0)
+		{
+			bUseEmbeddedShaders = false;
+		}
+		if (strcmp(argv[i], "--shader-cache-bench") == 0)
+		{
+			RunShaderCacheBenchmark();
+			return 0;
+		}
+		if (strcmp(argv[i], "--pipeline-cache-bench") == 0)
+		{
+			RunPipelineCacheBenchmark();
+			return 0;
+		}
+		// The software descriptor device; the GPU run measures the real one after the copy tests
+		if (strcmp(argv[i], "--descriptor-bench") == 0)
+		{
+			DescriptorDevice SoftwareDevice;
+			SoftwareDevice.Init(nullptr);
+
+			// The software device only records these addresses, so any distinct ones will do
+			static uint8_t StandInTextures[3];
+			RunDescriptorBenchmark(SoftwareDevice, (ID3D12Resource*)&StandInTextures[0], (ID3D12Resource*)&StandInTextures[1], (ID3D12Resource*)&StandInTextures[2]);
+			return 0;
+		}
+		// Cache sizes as KB,line bytes,ways, e.g. --cache-l1=16,128,4; these go before --cache-sim
+		if (strncmp(argv[i], "--cache-l1=", 11) == 0)
+		{
+			CacheLevelConfig& L1 = DefaultCacheSimConfig.L1;
+			sscanf(argv[i] + 11, "%d,%d,%d", &L1.SizeKB, &L1.LineSize, &L1.Ways);
+		}
+		if (strncmp(argv[i], "--cache-l2=", 11) == 0)
+		{
+			CacheLevelConfig& L2 = DefaultCacheSimConfig.L2;
+			sscanf(argv[i] + 11, "%d,%d,%d", &L2.SizeKB, &L2.LineSize, &L2.Ways);
+		}
+		if (strncmp(argv[i], "--cache-cus=", 12) == 0)
+		{
+			DefaultCacheSimConfig.NumCUs = atoi(argv[i] + 12);
+		}
+		if (strcmp(argv[i], "--cache-sim") == 0)
+		{
+			RunCacheSimBenchmark(DefaultCacheSimConfig);
+			return 0;
+		}
+	}
+
+	//ID3D12Debug1* D3D12DebugLayer = nullptr;
+	//D3D12GetDebugInterface(IID_PPV_ARGS(&D3D12DebugLayer));
+	//D3D12DebugLayer->EnableDebugLayer();
+
+
+	IDXGIFactory2* DXGIFactory = nullptr;
+
+	HRESULT hr = CreateDXGIFactory(IID_PPV_ARGS(&DXGIFactory));
+	ASSERT(SUCCEEDED(hr));
+
+	IDXGIAdapter* ChosenAdapter = nullptr;
+
+	{
+		IDXGIAdapter* Adapter = nullptr;
+		for (int AdapterIndex = 0; true; AdapterIndex++) {
+			hr = DXGIFactory->EnumAdapters(AdapterIndex, &Adapter);
+			if (!SUCCEEDED(hr)) {
+				break;
+			}
+
+			DXGI_ADAPTER_DESC AdapterDesc = {};
+			Adapter->GetDesc(&AdapterDesc);
+
+			// Avoid the WARP adapter or Intel (which will likely be integrated)
+			if (AdapterDesc.VendorId != 0x1414 && AdapterDesc.VendorId != 0x8086) {
+				ChosenAdapter = Adapter;
+			}
+
+			OutputDebugStringW(L"\nAdapter: ");
+			OutputDebugStringW(AdapterDesc.Description);
+
+			LOG("\nvendor = %X device = %X\nDedicated vid mem: %lld  Dedicated system mem: %lld  Shared system mem: %lld\n",
+				AdapterDesc.VendorId, AdapterDesc.DeviceId,
+				AdapterDesc.DedicatedVideoMemory, AdapterDesc.DedicatedSystemMemory, AdapterDesc.SharedSystemMemory);
+		}
+	}
+
+	// Headless servers have no usable GPU, so run the CPU equivalents of the copy tests instead
+	if (ChosenAdapter == nullptr)
+	{
+		LOG("No suitable adapter, running the CPU copy tests instead");
+		RunSWRasterizerBenchmark();
+		RunCSEmulatorBenchmark();
+		RunCSRemapBenchmark();
+		RunCPUCopyBenchmark();
+		return 0;
+	}
+
+	DXGI_ADAPTER_DESC ChosenAdapterDesc = {};
+	ChosenAdapter->GetDesc(&ChosenAdapterDesc);
+
+	OutputDebugStringW(L"\nChosen Adapter: ");
+	OutputDebugStringW(ChosenAdapterDesc.Description);
+	OutputDebugStringW(L"\n");
+
+	ID3D12Device* Device = nullptr;
+	hr = SUCCEEDED(D3D12CreateDevice(ChosenAdapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&Device)));
+	ASSERT(hr);
+
+
+	// NOTE: Requires Developer Mode
+	Device->SetStablePowerState(true);
+
+	{
+		int NumDumpWorkers = GetMaxThreads() / 2;
+		NumDumpWorkers = NumDumpWorkers < 1 ? 1 : (NumDumpWorkers > 4 ? 4 : NumDumpWorkers);
+		DumpQueue.Start(NumDumpWorkers, 64 * 1024 * 1024);
+	}
+
+
+	// The embedded table is DXIL, which a driver without shader model 6.0 can't create pipelines from. Its
+	// descriptor heap copy also needs 6.6. A runtime that doesn't know 6.6 fails the query, so ask again for 6.0.
+	bool bShaderModel6 = false;
+	bool bShaderModel66 = false;
+	{
+		D3D12_FEATURE_DATA_SHADER_MODEL ShaderModel = { D3D_SHADER_MODEL_6_6 };
+		hr = Device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &ShaderModel, sizeof(ShaderModel));
+		if (FAILED(hr))
+		{
+			ShaderModel.HighestShaderModel = D3D_SHADER_MODEL_6_0;
+			hr = Device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &ShaderModel, sizeof(ShaderModel));
+		}
+		bShaderModel6 = SUCCEEDED(hr) && ShaderModel.HighestShaderModel >= D3D_SHADER_MODEL_6_0;
+		bShaderModel66 = SUCCEEDED(hr) && ShaderModel.HighestShaderModel >= D3D_SHADER_MODEL_6_6;
+	}
+
+	ShaderCache Shaders;
+	Shaders.Init(ShaderCacheDirectory);
+	Shaders.bUseEmbedded = bUseEmbeddedShaders && bShaderModel6;
+	if (bUseEmbeddedShaders && !bShaderModel6)
+	{
+		LOG("Shader model 6.0 not supported, compiling shaders instead of using the embedded DXIL");
+	}
+
+	std::vector<ShaderCompileRequest> StartupShaders = GetStartupShaderRequests();
+	const int NumStartupShaders = (int)StartupShaders.size();
+
+	{
+		auto CompileStart = std::chrono::high_resolution_clock::now();
+		bool bCompiled = Shaders.GetAll(StartupShaders.data(), NumStartupShaders);
+		ASSERT(bCompiled);
+
+		int NumFromCache = 0;
+		int NumEmbedded = 0;
+		for (const ShaderCompileRequest& Request : StartupShaders)
+		{
+			NumFromCache += Request.bFromCache ? 1 : 0;
+			NumEmbedded += Request.bEmbedded ? 1 : 0;
+		}
+		LOG("Shaders: %d in %.2f ms (%d embedded, %d compiled, %d from cache%s)", NumStartupShaders, GetElapsedSeconds(CompileStart) * 1000.0,
+			NumEmbedded, NumStartupShaders - NumFromCache - NumEmbedded, NumFromCache, Shaders.Directory.empty() ? ", cache disabled" : "");
+		for (const ShaderCompileRequest& Request : StartupShaders)
+		{
+			LogEmbeddedShaderStats(Request);
+		}
+	}
+
+	ID3DBlob* VSByteCode = StartupShaders[0].ByteCode;
+	ID3DBlob* PSByteCode = StartupShaders[1].ByteCode;
+	ID3DBlob* CSByteCode1x1 = StartupShaders[2].ByteCode;
+	ID3DBlob* CSByteCode2x2 = StartupShaders[3].ByteCode;
+	ID3DBlob* CSByteCode4x4 = StartupShaders[4].ByteCode;
+	ID3DBlob* CSByteCode8x8 = StartupShaders[5].ByteCode;
+	ID3DBlob* CSByteCode16x16 = StartupShaders[6].ByteCode;
+	ID3DBlob* CSByteCodeBindless = StartupShaders[7].ByteCode;
+	ID3DBlob* CSByteCodeBufferCopy = StartupShaders[8].ByteCode;
+	ID3DBlob* CSByteCodeBufferCopyWide = StartupShaders[9].ByteCode;
+	ID3DBlob* CSByteCodeTileCopy = StartupShaders[10].ByteCode;
+
+	PipelineCache Pipelines;
+	Pipelines.Init(Device, ChosenAdapterDesc, ShaderCacheDirectory);
+
+	ID3D12CommandQueue* CommandQueue = nullptr;
+
+	D3D12_COMMAND_QUEUE_DESC CmdQueueDesc = {};
+	CmdQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+	hr = Device->CreateCommandQueue(&CmdQueueDesc, IID_PPV_ARGS(&CommandQueue));
+	ASSERT(SUCCEEDED(hr));
+
+	uint64_t TimestampFreq = 0;
+	CommandQueue->GetTimestampFrequency(&TimestampFreq);
+
+	{
+		ID3D12CommandAllocator* CommandAllocator = nullptr;
+		hr = Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocator));
+		ASSERT(SUCCEEDED(hr));
+
+		ID3D12GraphicsCommandList* CommandList = nullptr;
+		hr = Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CommandAllocator, 0, IID_PPV_ARGS(&CommandList));
+		ASSERT(SUCCEEDED(hr));
+
+		const int32 RTWidth = 1024;
+		const int32 RTHeight = 1024;
+
+		ID3D12Fence* ExecFence = nullptr;
+		ASSERT(SUCCEEDED(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&ExecFence))));
+		uint64_t NextValueToSignal = 1;
+
+		GPUTimer Timer;
+
+		Timer.Init(Device);
+
+		GPUResourcePool Pool;
+		Pool.Init(Device, (uint64_t)ResourcePoolBudgetMB * 1024 * 1024);
+
+		DescriptorDevice DescriptorsDevice;
+		DescriptorsDevice.Init(Device);
+
+		DescriptorAllocator Descriptors;
+		Descriptors.Init(&DescriptorsDevice, 16 * 1024, 16 * 1024);
+
+
+		// Pixel Shader Copy
+		{
+			double TotalPSCopyTimeUsec = 0.0;
+			const int PSCopyIters = 16*1024;
+
+			ID3D12RootSignature* PixelRootSig = GetPixelRootSig(Pipelines);
+			ID3D12PipelineState* PixelPSO = GetPixelPSO(Pipelines, PixelRootSig, DXGI_FORMAT_B8G8R8A8_UNORM, VSByteCode, PSByteCode);
+
+			PooledResource DestResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET), D3D12_RESOURCE_STATE_RENDER_TARGET);
+			PooledResource SrcResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+			int bpp = 4;
+			int TexBufferSize = RTWidth * RTHeight * bpp;
+			PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
+
+			PooledResource ReadbackRT = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
+
+			SetTextureUploadRandomBytes("pixel_shader_source.png", UploadSource, TexBufferSize, RTWidth, RTHeight, RTWidth* bpp);
+			UploadTextureResource(CommandList, UploadSource, SrcResource, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+			D3D12_DESCRIPTOR_HEAP_DESC DescriptorHeapDesc = {};
+			DescriptorHeapDesc.NumDescriptors = 1;
+			DescriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+
+			ID3D12DescriptorHeap* DescriptorHeap = nullptr;
+			Device->CreateDescriptorHeap(&DescriptorHeapDesc, IID_PPV_ARGS(&DescriptorHeap));
+
+			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+			Device->CreateRenderTargetView(DestResource, nullptr, rtvHandle);
+
+			UINT SrcSRV = CreateTextureSRV(Descriptors, SrcResource);
+
+			// TODO: Copy vertex buffer to GPU
+			int32 VertexCount = 4;
+			int32 VertexBufferSize = VertexCount * 16;
+			ID3D12Resource* VertexBufferRes = AllocateVertexBuffer(Device, VertexBufferSize);
+
+			D3D12_VIEWPORT Viewport = {};
+			Viewport.MinDepth = 0;
+			Viewport.MaxDepth = 1;
+			Viewport.TopLeftX = 0;
+			Viewport.TopLeftY = 0;
+			Viewport.Width = RTWidth;
+			Viewport.Height = RTHeight;
+
+			D3D12_RECT ScissorRect = {};
+			ScissorRect.left = 0;
+			ScissorRect.right = RTWidth;
+			ScissorRect.top = 0;
+			ScissorRect.bottom = RTHeight;
+
+			// CommandList State
+
+			for (int iter = 0; iter < PSCopyIters; iter++)
+			{
+				CommandList->SetPipelineState(PixelPSO);
+				CommandList->SetGraphicsRootSignature(PixelRootSig);
+
+				CommandList->RSSetViewports(1, &Viewport);
+				CommandList->RSSetScissorRects(1, &ScissorRect);
+				CommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+
+				D3D12_GPU_DESCRIPTOR_HANDLE SrcTable = {};
+				bool bAllocated = Descriptors.AllocateTable(&SrcSRV, 1, &SrcTable);
+				ASSERT(bAllocated);
+				Descriptors.Bind(CommandList);
+				CommandList->SetGraphicsRootDescriptorTable(0, SrcTable);
+
+				{
+					D3D12_VERTEX_BUFFER_VIEW vtbView = {};
+					vtbView.BufferLocation = VertexBufferRes->GetGPUVirtualAddress();
+					vtbView.SizeInBytes = VertexBufferSize;
+					vtbView.StrideInBytes = 16;
+
+					CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+					CommandList->IASetVertexBuffers(0, 1, &vtbView);
+				}
+
+				Timer.StartTiming(CommandList);
+
+				CommandList->DrawInstanced(VertexCount, 1, 0, 0);
+
+				Timer.EndTiming(CommandList);
+
+				// Copy render target data to readback texture
+				//CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+				CommandList->Close();
+
+				ID3D12CommandList* CommandLists[] = { CommandList };
+				CommandQueue->ExecuteCommandLists(1, CommandLists);
+
+				CommandQueue->Signal(ExecFence, NextValueToSignal);
+				Descriptors.Retire(NextValueToSignal);
+
+				HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+				ExecFence->SetEventOnCompletion(NextValueToSignal, hEvent);
+				WaitForSingleObject(hEvent, INFINITE);
+				CloseHandle(hEvent);
+				Descriptors.Reclaim(ExecFence->GetCompletedValue());
+
+				NextValueToSignal++;
+
+				//WriteReadbackToFile("pixel_shader_dest.png", ReadbackRT, RTWidth, RTHeight);
+
+				uint64_t StartTS = 0;
+				uint64_t EndTS = 0;
+				Timer.GetTiming(&StartTS, &EndTS);
+
+				uint64_t TotalTS = EndTS - StartTS;
+				double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
+				//LOG("Took %5.1f usec (%llu ticks) for pixel shader copy (%4d x %4d)", TotalUsec, TotalTS, RTWidth, RTHeight);
+
+				TotalPSCopyTimeUsec += TotalUsec;
+
+				CommandList->Reset(CommandAllocator, nullptr);
+			}
+
+			VertexBufferRes->Release();
+			Descriptors.FreeViews(SrcSRV);
+			DescriptorHeap->Release();
+			double AvgPSCopyTimeUsec = TotalPSCopyTimeUsec / PSCopyIters;
+			LOG("PS Copy of %4d x %4d texture: avg %6.1f usec (%d iters)", RTWidth, RTHeight, AvgPSCopyTimeUsec, PSCopyIters);
+		}
+
+		// The same draw on the software rasterizer, for comparison
+		{
+			const int SWCopyIters = 256;
+			const int NumThreads = GetMaxThreads();
+
+			CPUTexture Src, Dst;
+			Src.Init(RTWidth, RTHeight, 1, 1, 4);
+			Dst.Init(RTWidth, RTHeight, 1, 1, 4);
+
+			WorkStealingScheduler Scheduler;
+			Scheduler.Start(NumThreads);
+
+			SWRasterizer Raster;
+			Raster.Scheduler = &Scheduler;
+			Raster.Shader = SelectSWSpanShader();
+
+			const SWViewport Viewport = { 0.0f, 0.0f, (float)RTWidth, (float)RTHeight };
+			const SWRect ScissorRect = { 0, 0, RTWidth, RTHeight };
+
+			const SWShadeState State = { Src.Memory.Data, RTWidth, RTHeight, Src.Subresources[0].RowPitch,
+				Dst.Memory.Data, RTWidth, RTHeight, Dst.Subresources[0].RowPitch };
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (int iter = 0; iter < SWCopyIters; iter++)
+			{
+				Raster.DrawTriangleStrip(PSCopyQuadVertices, 4, Viewport, ScissorRect, State);
+			}
+			double AvgSWCopyTimeUsec = GetElapsedSeconds(Start) * 1000.0 * 1000.0 / SWCopyIters;
+			Scheduler.Shutdown();
+
+			LOG("SW raster PS Copy of %4d x %4d texture: avg %6.1f usec (%d threads, %d iters)", RTWidth, RTHeight, AvgSWCopyTimeUsec, NumThreads, SWCopyIters);
+		}
+
+		// Copies a TexWidth x TexHeight texture with a Dispatch(DispatchX, DispatchY, 1) of GroupX x GroupY groups.
+		// Unless Iters is given, iterations scale down with the texture size, so the large texture runs take about
+		// as long as the 1024 x 1024 ones. Given a WaveLaneCount, the shader is ComputeShaderCodeWaveRowCopy and the last
+		// readback is checked against CSCopyKernelWaveRows at that wave size.
+		auto DoCSCopyTest = [&](int GroupX, int GroupY, ID3DBlob* CSByteCode, int TexWidth, int TexHeight, uint32_t DispatchX, uint32_t DispatchY, const char* OrderName, int Iters = 0, uint32_t WaveLaneCount = 0)
+		{
+			double TotalCSCopyTimeUsec = 0.0;
+			const int CSCopyIters = Iters > 0 ? Iters : (int)std::max<int64_t>(16, 16 * 1024 * (int64_t)RTWidth * RTHeight / ((int64_t)TexWidth * TexHeight));
+
+			// Compute shader copy
+			{
+				ID3D12RootSignature* RootSig = GetComputeRootSig(Pipelines);
+
+				ID3D12PipelineState* PSO1x1 = GetComputePSO(Pipelines, RootSig, CSByteCode);
+
+				PooledResource DestResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(TexWidth, TexHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_COPY_DEST);
+				PooledResource SrcResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(TexWidth, TexHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_GENERIC_READ);
+
+				int bpp = 4;
+				int TexBufferSize = TexWidth * TexHeight * bpp;
+				PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
+
+				PooledResource ReadbackRT = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
+
+				SetTextureUploadRandomBytes("compute_shader_source.png", UploadSource, TexBufferSize, TexWidth, TexHeight, TexWidth * bpp);
+				UploadTextureResource(CommandList, UploadSource, SrcResource, TexWidth, TexHeight, TexWidth * bpp, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+				const UINT FirstView = CreateTextureSRVUAV(Descriptors, SrcResource, DestResource);
+				const UINT Views[2] = { FirstView, FirstView + 1 };
+
+				for (int iter = 0; iter < CSCopyIters; iter++)
+				{
+
+					CommandList->SetPipelineState(PSO1x1);
+					CommandList->SetComputeRootSignature(RootSig);
+
+					D3D12_GPU_DESCRIPTOR_HANDLE Table = {};
+					bool bAllocated = Descriptors.AllocateTable(Views, 2, &Table);
+					ASSERT(bAllocated);
+					Descriptors.Bind(CommandList);
+					CommandList->SetComputeRootDescriptorTable(0, Table);
+
+					D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = Table;
+					GPUHandle.ptr += Descriptors.DescriptorSize;
+					CommandList->SetComputeRootDescriptorTable(1, GPUHandle);
+
+					Timer.StartTiming(CommandList);
+
+					CommandList->Dispatch(DispatchX, DispatchY, 1);
+
+					Timer.EndTiming(CommandList);
+
+					CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, TexWidth, TexHeight, TexWidth * bpp, D3D12_RESOURCE_STATE_COPY_DEST);
+
+					CommandList->Close();
+
+					ID3D12CommandList* CommandLists[] = { CommandList };
+					CommandQueue->ExecuteCommandLists(1, CommandLists);
+
+					CommandQueue->Signal(ExecFence, NextValueToSignal);
+					Descriptors.Retire(NextValueToSignal);
+
+					HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+					ExecFence->SetEventOnCompletion(NextValueToSignal, hEvent);
+					WaitForSingleObject(hEvent, INFINITE);
+					CloseHandle(hEvent);
+					Descriptors.Reclaim(ExecFence->GetCompletedValue());
+
+					NextValueToSignal++;
+
+					//WriteReadbackToFile("compute_shader_dest.png", ReadbackRT, RTWidth, RTHeight);
+
+					uint64_t StartTS = 0;
+					uint64_t EndTS = 0;
+					Timer.GetTiming(&StartTS, &EndTS);
+
+					uint64_t TotalTS = EndTS - StartTS;
+					double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
+					//LOG("Took %5.1f usec (%llu ticks) for compute shader copy (%dx%d) (%4d x %4d)", TotalUsec, TotalTS, GroupSize, GroupSize RTWidth, RTHeight);
+
+					TotalCSCopyTimeUsec += TotalUsec;
+
+					CommandList->Reset(CommandAllocator, nullptr);
+				}
+
+				Descriptors.FreeViews(FirstView);
+
+				if (WaveLaneCount > 0)
+				{
+					// The upload heap is write-combined, so read the source back through the copy engine instead
+					PooledResource SourceReadback = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
+					CopyRenderTargetDataToReadback(CommandList, SrcResource, SourceReadback, TexWidth, TexHeight, TexWidth * bpp, D3D12_RESOURCE_STATE_GENERIC_READ);
+					CommandList->Close();
+					ID3D12CommandList* CommandLists[] = { CommandList };
+					CommandQueue->ExecuteCommandLists(1, CommandLists);
+					CommandQueue->Signal(ExecFence, NextValueToSignal);
+					HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+					ExecFence->SetEventOnCompletion(NextValueToSignal, hEvent);
+					WaitForSingleObject(hEvent, INFINITE);
+					CloseHandle(hEvent);
+					NextValueToSignal++;
+					CommandList->Reset(CommandAllocator, nullptr);
+
+					D3D12_RANGE ReadRange = { 0, (SIZE_T)TexBufferSize };
+					D3D12_RANGE WriteRange = { 0, 0 };
+					void* pSourceData = nullptr;
+					void* pReadbackData = nullptr;
+					hr = SourceReadback->Map(0, &ReadRange, &pSourceData);
+					ASSERT(SUCCEEDED(hr));
+					hr = ReadbackRT->Map(0, &ReadRange, &pReadbackData);
+					ASSERT(SUCCEEDED(hr));
+
+					// The reference writes over the GPU's result, so any texel it covers that the GPU missed or
+					// copied from the wrong place shows up as a difference
+					std::vector<uint8_t> Expected((uint8_t*)pReadbackData, (uint8_t*)pReadbackData + TexBufferSize);
+					CSWaveCopyContext Wave = { { (const uint8_t*)pSourceData, Expected.data(), TexWidth, TexHeight, TexWidth * bpp }, WaveLaneCount, 256 };
+					CSDispatch Dispatch;
+					Dispatch.NumThreads[0] = GroupX;
+					Dispatch.NumThreads[1] = GroupY;
+					Dispatch.GroupCount[0] = DispatchX;
+					Dispatch.GroupCount[1] = DispatchY;
+					WorkStealingScheduler Inline;
+					DispatchCPU(Inline, Dispatch, CSCopyKernelWaveRows, &Wave);
+
+					if (memcmp(pReadbackData, Expected.data(), TexBufferSize) != 0)
+					{
+						LOG("CS Copy (%2dx%2d)%s%s of %4d x %4d texture: readback MISMATCH against the CPU reference", GroupX, GroupY, *OrderName ? " " : "", OrderName, TexWidth, TexHeight);
+					}
+					ReadbackRT->Unmap(0, &WriteRange);
+					SourceReadback->Unmap(0, &WriteRange);
+				}
+			}
+
+			double AvgCSCopyTimeUsec = TotalCSCopyTimeUsec / CSCopyIters;
+			double CopyGBPerSec = 2.0 * TexWidth * TexHeight * 4 / (AvgCSCopyTimeUsec * 1000.0);	// read + write
+			LOG("CS Copy (%2dx%2d)%s%s of %4d x %4d texture: avg %6.1f usec, %6.1f GB/s (%d iters)", GroupX, GroupY, *OrderName ? " " : "", OrderName,
+				TexWidth, TexHeight, AvgCSCopyTimeUsec, CopyGBPerSec, CSCopyIters);
+		};
+
+		DoCSCopyTest(1,  1,  CSByteCode1x1, RTWidth, RTHeight, RTWidth / 1, RTHeight / 1, "");
+		DoCSCopyTest(2,  2,  CSByteCode2x2, RTWidth, RTHeight, RTWidth / 2, RTHeight / 2, "");
+		DoCSCopyTest(4,  4,  CSByteCode4x4, RTWidth, RTHeight, RTWidth / 4, RTHeight / 4, "");
+		DoCSCopyTest(8,  8,  CSByteCode8x8, RTWidth, RTHeight, RTWidth / 8, RTHeight / 8, "");
+		DoCSCopyTest(16, 16, CSByteCode16x16, RTWidth, RTHeight, RTWidth / 16, RTHeight / 16, "");
+
+		// Large texture copies with SV_GroupID remapped. Each remap is checked on the CPU emulator to write
+		// every texel exactly once before it runs on the GPU.
+		{
+			const int LargeSize = 4096;
+			const int GroupSize = 8;
+
+			struct RemapInfo
+			{
+				CSDispatchOrder Order;
+				uint32_t TileWidth;
+			};
+			const RemapInfo Remaps[] =
+			{
+				{ CSDispatchOrder::RowMajor, 0 },
+				{ CSDispatchOrder::ColumnMajor, 0 },
+				{ CSDispatchOrder::Morton, 0 },
+				{ CSDispatchOrder::ColumnTiled, 4 },
+				{ CSDispatchOrder::ColumnTiled, 16 },
+			};
+
+			// Every variant is compiled up front, so cache misses build in parallel
+			const int NumRemaps = sizeof(Remaps) / sizeof(Remaps[0]);
+			CSDispatch Dispatches[NumRemaps];
+			std::vector<ShaderCompileRequest> RemapShaders;
+			for (int i = 0; i < NumRemaps; i++)
+			{
+				CSDispatch& Dispatch = Dispatches[i];
+				Dispatch.NumThreads[0] = GroupSize;
+				Dispatch.NumThreads[1] = GroupSize;
+				Dispatch.GroupCount[0] = LargeSize / GroupSize;
+				Dispatch.GroupCount[1] = LargeSize / GroupSize;
+				Dispatch.Order = Remaps[i].Order;
+				Dispatch.TileWidth = Remaps[i].TileWidth;
+
+				bool bCovered = CheckDispatchCoverage(Dispatch, LargeSize, LargeSize);
+				ASSERT(bCovered);
+
+				RemapShaders.push_back(GetRemapCopyShaderRequest(Dispatch));
+			}
+
+			bool bCompiled = Shaders.GetAll(RemapShaders.data(), (int)RemapShaders.size());
+			ASSERT(bCompiled);
+
+			for (int i = 0; i < NumRemaps; i++)
+			{
+				const RemapInfo& Remap = Remaps[i];
+
+				char OrderName[32] = {};
+				snprintf(OrderName, sizeof(OrderName), Remap.TileWidth ? "%s %-2u" : "%s", GetDispatchOrderName(Remap.Order), Remap.TileWidth);
+
+				uint32_t DispatchX = 0, DispatchY = 0;
+				GetRemapDispatchSize(Dispatches[i], DispatchX, DispatchY);
+				LogEmbeddedShaderStats(RemapShaders[i]);
+				DoCSCopyTest(GroupSize, GroupSize, RemapShaders[i].ByteCode, LargeSize, LargeSize, DispatchX, DispatchY, OrderName);
+				RemapShaders[i].ByteCode->Release();
+			}
+		}
+
+		// Thousands of small copies, each with its own descriptor table: a shader-visible heap per copy, the
+		// way the copy tests used to bind, against tables from the shared ring. Setup is creating the heaps
+		// or views, record is building the command list.
+		{
+			const int NumCopies = 2048;
+			const int SmallSize = 64;
+			const int GroupSize = 8;
+
+			std::vector<PooledResource> Srcs;
+			std::vector<PooledResource> Dsts;
+			for (int i = 0; i < NumCopies; i++)
+			{
+				Srcs.push_back(Pool.Acquire(CommandList, ResourcePoolKey::Texture(SmallSize, SmallSize, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+				Dsts.push_back(Pool.Acquire(CommandList, ResourcePoolKey::Texture(SmallSize, SmallSize, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+			}
+			PooledResource RTTexture = Pool.Acquire(CommandList, ResourcePoolKey::Texture(SmallSize, SmallSize, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET), D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+			ID3D12RootSignature* RootSig = GetComputeRootSig(Pipelines);
+			ID3D12PipelineState* PSO = GetComputePSO(Pipelines, RootSig, CSByteCode8x8);
+
+			auto SubmitAndWait = [&]()
+			{
+				CommandList->Close();
+
+				ID3D12CommandList* CommandLists[] = { CommandList };
+				CommandQueue->ExecuteCommandLists(1, CommandLists);
+
+				CommandQueue->Signal(ExecFence, NextValueToSignal);
+				Descriptors.Retire(NextValueToSignal);
+
+				HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+				ExecFence->SetEventOnCompletion(NextValueToSignal, hEvent);
+				WaitForSingleObject(hEvent, INFINITE);
+				CloseHandle(hEvent);
+				Descriptors.Reclaim(ExecFence->GetCompletedValue());
+
+				NextValueToSignal++;
+
+				uint64_t StartTS = 0;
+				uint64_t EndTS = 0;
+				Timer.GetTiming(&StartTS, &EndTS);
+
+				CommandList->Reset(CommandAllocator, nullptr);
+				return ((double)(EndTS - StartTS)) / TimestampFreq * (1000.0 * 1000.0);
+			};
+
+			// The acquires may have recorded transitions
+			SubmitAndWait();
+
+			double HeapSetupMs = 0.0, HeapRecordMs = 0.0, HeapGPUUsec = 0.0;
+			{
+				auto Start = std::chrono::high_resolution_clock::now();
+				std::vector<DescriptorDeviceHeap> Heaps(NumCopies);
+				for (int i = 0; i < NumCopies; i++)
+				{
+					Heaps[i] = CreateSRVUAVHeapForTextures(DescriptorsDevice, Srcs[i], Dsts[i]);
+				}
+				HeapSetupMs = GetElapsedSeconds(Start) * 1000.0;
+
+				Start = std::chrono::high_resolution_clock::now();
+				CommandList->SetPipelineState(PSO);
+				CommandList->SetComputeRootSignature(RootSig);
+				Timer.StartTiming(CommandList);
+				for (int i = 0; i < NumCopies; i++)
+				{
+					CommandList->SetDescriptorHeaps(1, &Heaps[i].Heap);
+
+					D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = Heaps[i].GPUStart;
+					CommandList->SetComputeRootDescriptorTable(0, GPUHandle);
+					GPUHandle.ptr += Descriptors.DescriptorSize;
+					CommandList->SetComputeRootDescriptorTable(1, GPUHandle);
+
+					CommandList->Dispatch(SmallSize / GroupSize, SmallSize / GroupSize, 1);
+				}
+				Timer.EndTiming(CommandList);
+				HeapRecordMs = GetElapsedSeconds(Start) * 1000.0;
+
+				HeapGPUUsec = SubmitAndWait();
+
+				for (DescriptorDeviceHeap& Heap : Heaps)
+				{
+					DescriptorsDevice.DestroyHeap(Heap);
+				}
+			}
+
+			double SharedSetupMs = 0.0, SharedRecordMs = 0.0, SharedGPUUsec = 0.0;
+			{
+				auto Start = std::chrono::high_resolution_clock::now();
+				std::vector<UINT> Views(NumCopies);
+				for (int i = 0; i < NumCopies; i++)
+				{
+					Views[i] = CreateTextureSRVUAV(Descriptors, Srcs[i], Dsts[i]);
+				}
+				SharedSetupMs = GetElapsedSeconds(Start) * 1000.0;
+
+				Start = std::chrono::high_resolution_clock::now();
+				Descriptors.Bind(CommandList);
+				CommandList->SetPipelineState(PSO);
+				CommandList->SetComputeRootSignature(RootSig);
+				Timer.StartTiming(CommandList);
+				for (int i = 0; i < NumCopies; i++)
+				{
+					const UINT Table[2] = { Views[i], Views[i] + 1 };
+					D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = {};
+					bool bAllocated = Descriptors.AllocateTable(Table, 2, &GPUHandle);
+					ASSERT(bAllocated);
+
+					CommandList->SetComputeRootDescriptorTable(0, GPUHandle);
+					GPUHandle.ptr += Descriptors.DescriptorSize;
+					CommandList->SetComputeRootDescriptorTable(1, GPUHandle);
+
+					CommandList->Dispatch(SmallSize / GroupSize, SmallSize / GroupSize, 1);
+				}
+				Timer.EndTiming(CommandList);
+				SharedRecordMs = GetElapsedSeconds(Start) * 1000.0;
+
+				SharedGPUUsec = SubmitAndWait();
+
+				for (UINT View : Views)
+				{
+					Descriptors.FreeViews(View);
+				}
+			}
+
+			LOG("Descriptors for %d copies of %d x %d: heap per copy setup %6.2f ms, record %6.2f ms, GPU %7.1f usec", NumCopies, SmallSize, SmallSize, HeapSetupMs, HeapRecordMs, HeapGPUUsec);
+			LOG("Descriptors for %d copies of %d x %d: shared heap   setup %6.2f ms, record %6.2f ms, GPU %7.1f usec", NumCopies, SmallSize, SmallSize, SharedSetupMs, SharedRecordMs, SharedGPUUsec);
+
+			RunDescriptorBenchmark(DescriptorsDevice, Srcs[0], Dsts[0], RTTexture);
+
+			// Binding models for the same small copies, each timed for the CPU cost of binding and recording
+			// and for the GPU time of the copies. Tables come from the ring as they would per copy; the bindless
+			// copies index views written once up front, so only their two root constants are set per copy.
+			{
+				enum class BindingModel
+				{
+					TwoTables,			// GetComputeRootSig: an SRV table and a UAV table
+					CombinedTable,		// One table holding the SRV then the UAV
+					Bindless,			// Root constants indexing the whole heap, directly with SM 6.6 or else through SM 5.1 tables
+					BufferTwoTables,	// Buffer copies through the two tables
+					BufferRootDescriptors,	// Buffer copies with the buffers' addresses in the root signature
+				};
+				const char* ModelNames[] = { "two tables", "combined table", "bindless", "buffer, two tables", "buffer, root descriptors" };
+				const BindingModel Models[] = { BindingModel::TwoTables, BindingModel::CombinedTable, BindingModel::Bindless, BindingModel::BufferTwoTables, BindingModel::BufferRootDescriptors };
+
+				// The buffers hold as many bytes as the textures
+				const int BufferSize = SmallSize * SmallSize * 4;
+				const UINT BufferGroupSize = 64 * 16;
+				std::vector<PooledResource> SrcBuffers;
+				std::vector<PooledResource> DstBuffers;
+				for (int i = 0; i < NumCopies; i++)
+				{
+					SrcBuffers.push_back(Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_DEFAULT), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+					DstBuffers.push_back(Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+				}
+				SubmitAndWait();
+
+				// Either bindless variant needs resource binding tier 3: ResourceDescriptorHeap always, and the SM 5.1
+				// root signature's unbounded ranges for the UAVs
+				D3D12_FEATURE_DATA_D3D12_OPTIONS Options = {};
+				HRESULT hr = Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &Options, sizeof(Options));
+				const bool bBindlessSupported = SUCCEEDED(hr) && Options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_3;
+
+				// The SM 6.6 kernel only comes from the DXIL table
+				ShaderCompileRequest DescriptorHeapRequest = { "<CS_SOURCE>", ComputeShaderCodeDescriptorHeap, "CSMain", "cs_6_6" };
+				const bool bDescriptorHeap = bBindlessSupported && bShaderModel66 && Shaders.bUseEmbedded && FindEmbeddedShader(DescriptorHeapRequest) != nullptr &&
+					Shaders.Get(DescriptorHeapRequest);
+				if (bDescriptorHeap)
+				{
+					LogEmbeddedShaderStats(DescriptorHeapRequest);
+				}
+				else if (bBindlessSupported)
+				{
+					LOG("Binding model %-24s: %s, using SM 5.1 unbounded tables", ModelNames[(int)BindingModel::Bindless],
+						bShaderModel66 ? "no DXIL table from shaders/build_shaders.py" : "shader model 6.6 not supported");
+				}
+
+				std::vector<UINT> TextureViews(NumCopies);
+				std::vector<UINT> BufferViews(NumCopies);
+				for (int i = 0; i < NumCopies; i++)
+				{
+					TextureViews[i] = CreateTextureSRVUAV(Descriptors, Srcs[i], Dsts[i]);
+					BufferViews[i] = CreateBufferSRVUAV(Descriptors, SrcBuffers[i], DstBuffers[i], BufferSize);
+				}
 
-	hr = D3DCompile(ComputeShaderCode16x16, strlen(ComputeShaderCode16x16), "<CS_SOURCE>", nullptr, nullptr, "CSMain", "cs_5_0", CompilerFlags, 0, &CSByteCode16x16, &ErrorMsg);
-	if (ErrorMsg)
-	{
-		const char* ErrMsgStr = (const char*)ErrorMsg->GetBufferPointer();
-		OutputDebugStringA(ErrMsgStr);
-	}
-	ASSERT(SUCCEEDED(hr));
+				for (BindingModel Model : Models)
+				{
+					if (Model == BindingModel::Bindless && !bBindlessSupported)
+					{
+						LOG("Binding model %-24s: resource binding tier 3 not supported, skipping", ModelNames[(int)Model]);
+						continue;
+					}
+
+					const bool bBuffer = Model == BindingModel::BufferTwoTables || Model == BindingModel::BufferRootDescriptors;
+					ID3D12RootSignature* ModelRootSig = RootSig;
+					ID3D12PipelineState* ModelPSO = PSO;
+					if (Model == BindingModel::CombinedTable)
+					{
+						ModelRootSig = GetComputeCombinedTableRootSig(Pipelines);
+						ModelPSO = GetComputePSO(Pipelines, ModelRootSig, CSByteCode8x8);
+					}
+					else if (Model == BindingModel::Bindless && bDescriptorHeap)
+					{
+						ModelRootSig = GetComputeDescriptorHeapRootSig(Pipelines);
+						ModelPSO = GetComputePSO(Pipelines, ModelRootSig, DescriptorHeapRequest.ByteCode);
+					}
+					else if (Model == BindingModel::Bindless)
+					{
+						ModelRootSig = GetComputeBindlessRootSig(Pipelines);
+						ModelPSO = GetComputePSO(Pipelines, ModelRootSig, CSByteCodeBindless);
+					}
+					else if (Model == BindingModel::BufferTwoTables)
+					{
+						ModelPSO = GetComputePSO(Pipelines, RootSig, CSByteCodeBufferCopy);
+					}
+					else if (Model == BindingModel::BufferRootDescriptors)
+					{
+						ModelRootSig = GetBufferCopyRootDescriptorRootSig(Pipelines);
+						ModelPSO = GetComputePSO(Pipelines, ModelRootSig, CSByteCodeBufferCopy);
+					}
+
+					// Each bindless copy's views in the shader-visible heap, live until this submit retires them
+					std::vector<UINT> HeapIndices;
+					if (Model == BindingModel::Bindless)
+					{
+						HeapIndices.resize(NumCopies);
+						for (int i = 0; i < NumCopies; i++)
+						{
+							const UINT Table[2] = { TextureViews[i], TextureViews[i] + 1 };
+							D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = {};
+							bool bAllocated = Descriptors.AllocateTable(Table, 2, &GPUHandle);
+							ASSERT(bAllocated);
+							HeapIndices[i] = Descriptors.GetHeapIndex(GPUHandle);
+						}
+					}
+
+					auto Start = std::chrono::high_resolution_clock::now();
+					if (Model != BindingModel::BufferRootDescriptors)
+					{
+						Descriptors.Bind(CommandList);
+					}
+					CommandList->SetPipelineState(ModelPSO);
+					CommandList->SetComputeRootSignature(ModelRootSig);
+					if (Model == BindingModel::Bindless && !bDescriptorHeap)
+					{
+						CommandList->SetComputeRootDescriptorTable(1, Descriptors.GPUHeap.GPUStart);
+						CommandList->SetComputeRootDescriptorTable(2, Descriptors.GPUHeap.GPUStart);
+					}
+					Timer.StartTiming(CommandList);
+					for (int i = 0; i < NumCopies; i++)
+					{
+						const UINT* Views = bBuffer ? &BufferViews[i] : &TextureViews[i];
+						const UINT Table[2] = { *Views, *Views + 1 };
+						D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = {};
+						switch (Model)
+						{
+						case BindingModel::TwoTables:
+						case BindingModel::BufferTwoTables:
+						{
+							bool bAllocated = Descriptors.AllocateTable(Table, 2, &GPUHandle);
+							ASSERT(bAllocated);
+							CommandList->SetComputeRootDescriptorTable(0, GPUHandle);
+							GPUHandle.ptr += Descriptors.DescriptorSize;
+							CommandList->SetComputeRootDescriptorTable(1, GPUHandle);
+							break;
+						}
+						case BindingModel::CombinedTable:
+						{
+							bool bAllocated = Descriptors.AllocateTable(Table, 2, &GPUHandle);
+							ASSERT(bAllocated);
+							CommandList->SetComputeRootDescriptorTable(0, GPUHandle);
+							break;
+						}
+						case BindingModel::Bindless:
+						{
+							const UINT Indices[2] = { HeapIndices[i], HeapIndices[i] + 1 };
+							CommandList->SetComputeRoot32BitConstants(0, 2, Indices, 0);
+							break;
+						}
+						case BindingModel::BufferRootDescriptors:
+							CommandList->SetComputeRootShaderResourceView(0, SrcBuffers[i]->GetGPUVirtualAddress());
+							CommandList->SetComputeRootUnorderedAccessView(1, DstBuffers[i]->GetGPUVirtualAddress());
+							break;
+						}
+
+						if (bBuffer)
+						{
+							CommandList->Dispatch(BufferSize / BufferGroupSize, 1, 1);
+						}
+						else
+						{
+							CommandList->Dispatch(SmallSize / GroupSize, SmallSize / GroupSize, 1);
+						}
+					}
+					Timer.EndTiming(CommandList);
+					const double RecordSeconds = GetElapsedSeconds(Start);
 
-	ID3D12CommandQueue* CommandQueue = nullptr;
+					const double GPUUsec = SubmitAndWait();
+					const char* ModelName = Model != BindingModel::Bindless ? ModelNames[(int)Model] : bDescriptorHeap ? "bindless, SM 6.6 heap" : "bindless, SM 5.1 tables";
+					LOG("Binding model %-24s: %6.1f ns per copy to bind and record, GPU %7.1f usec for %d copies", ModelName, RecordSeconds * 1e9 / NumCopies, GPUUsec, NumCopies);
+				}
 
-	D3D12_COMMAND_QUEUE_DESC CmdQueueDesc = {};
-	CmdQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-	hr = Device->CreateCommandQueue(&CmdQueueDesc, IID_PPV_ARGS(&CommandQueue));
-	ASSERT(SUCCEEDED(hr));
+				for (int i = 0; i < NumCopies; i++)
+				{
+					Descriptors.FreeViews(TextureViews[i]);
+					Descriptors.FreeViews(BufferViews[i]);
+				}
 
-	uint64_t TimestampFreq = 0;
-	CommandQueue->GetTimestampFrequency(&TimestampFreq);
+				if (bDescriptorHeap)
+				{
+					DescriptorHeapRequest.ByteCode->Release();
+				}
+			}
+		}
 
-	{
-		ID3D12CommandAllocator* CommandAllocator = nullptr;
-		hr = Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocator));
-		ASSERT(SUCCEEDED(hr));
+		// Resource Copy of a TexWidth x TexHeight texture
+		auto DoCopyResourceTest = [&](int TexWidth, int TexHeight, int ResCopyIters)
+		{
+			double TotalResCopyTimeUsec = 0.0;
 
-		ID3D12GraphicsCommandList* CommandList = nullptr;
-		hr = Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CommandAllocator, 0, IID_PPV_ARGS(&CommandList));
-		ASSERT(SUCCEEDED(hr));
+			PooledResource DestResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(TexWidth, TexHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET), D3D12_RESOURCE_STATE_COPY_DEST);
+			PooledResource SrcResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(TexWidth, TexHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_COPY_SOURCE);
 
-		const int32 RTWidth = 1024;
-		const int32 RTHeight = 1024;
+			int bpp = 4;
+			int TexBufferSize = TexWidth * TexHeight * bpp;
+			PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
 
-		ID3D12Fence* ExecFence = nullptr;
-		ASSERT(SUCCEEDED(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&ExecFence))));
-		uint64_t NextValueToSignal = 1;
+			PooledResource ReadbackRT = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
 
-		GPUTimer Timer;
+			SetTextureUploadRandomBytes("resrouce_copy_source.png", UploadSource, TexBufferSize, TexWidth, TexHeight, TexWidth * bpp);
+			UploadTextureResource(CommandList, UploadSource, SrcResource, TexWidth, TexHeight, TexWidth * bpp, D3D12_RESOURCE_STATE_COPY_SOURCE);
 
-		Timer.Init(Device);
+			// CommandList State
+			for (int iter = 0; iter < ResCopyIters; iter++)
+			{
+				Timer.StartTiming(CommandList);
 
+				CommandList->CopyResource(DestResource, SrcResource);
 
-		// Pixel Shader Copy
-		{
-			double TotalPSCopyTimeUsec = 0.0;
-			const int PSCopyIters = 16*1024;
+				Timer.EndTiming(CommandList);
 
-			ID3D12RootSignature* PixelRootSig = CreatePixelRootSig(Device);
-			ID3D12PipelineState* PixelPSO = CreatePixelPSO(Device, PixelRootSig, DXGI_FORMAT_B8G8R8A8_UNORM, VSByteCode, PSByteCode);
+				CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, TexWidth, TexHeight, TexWidth * bpp, D3D12_RESOURCE_STATE_COPY_DEST);
 
-			ID3D12Resource* DestResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			ID3D12Resource* SrcResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				CommandList->Close();
 
-			int bpp = 4;
-			int TexBufferSize = RTWidth * RTHeight * bpp;
-			ID3D12Resource* UploadSource = AllocateUploadTexture(Device, TexBufferSize);
+				ID3D12CommandList* CommandLists[] = { CommandList };
+				CommandQueue->ExecuteCommandLists(1, CommandLists);
 
-			ID3D12Resource* ReadbackRT = AllocateReadbackTexture(Device, TexBufferSize);
+				CommandQueue->Signal(ExecFence, NextValueToSignal);
 
-			SetTextureUploadRandomBytes("pixel_shader_source.png", UploadSource, TexBufferSize, RTWidth, RTHeight, RTWidth* bpp);
-			UploadTextureResource(CommandList, UploadSource, SrcResource, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+				ExecFence->SetEventOnCompletion(NextValueToSignal, hEvent);
+				WaitForSingleObject(hEvent, INFINITE);
+				CloseHandle(hEvent);
 
-			D3D12_DESCRIPTOR_HEAP_DESC DescriptorHeapDesc = {};
-			DescriptorHeapDesc.NumDescriptors = 1;
-			DescriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+				NextValueToSignal++;
 
-			ID3D12DescriptorHeap* DescriptorHeap = nullptr;
-			Device->CreateDescriptorHeap(&DescriptorHeapDesc, IID_PPV_ARGS(&DescriptorHeap));
+				//WriteReadbackToFile("resrouce_copy_dest.png", ReadbackRT, TexWidth, TexHeight);
 
-			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-			Device->CreateRenderTargetView(DestResource, nullptr, rtvHandle);
+				uint64_t StartTS = 0;
+				uint64_t EndTS = 0;
+				Timer.GetTiming(&StartTS, &EndTS);
 
-			ID3D12DescriptorHeap* SrcSRV = GetSRVHeapForTexture(Device, SrcResource);
+				uint64_t TotalTS = EndTS - StartTS;
+				double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
+				//LOG("Took %5.1f usec (%llu ticks) for pixel shader copy (%4d x %4d)", TotalUsec, TotalTS, TexWidth, TexHeight);
 
-			// TODO: Copy vertex buffer to GPU
-			int32 VertexCount = 4;
-			int32 VertexBufferSize = VertexCount * 16;
-			ID3D12Resource* VertexBufferRes = AllocateVertexBuffer(Device, VertexBufferSize);
+				TotalResCopyTimeUsec += TotalUsec;
 
-			D3D12_VIEWPORT Viewport = {};
-			Viewport.MinDepth = 0;
-			Viewport.MaxDepth = 1;
-			Viewport.TopLeftX = 0;
-			Viewport.TopLeftY = 0;
-			Viewport.Width = RTWidth;
-			Viewport.Height = RTHeight;
+				CommandList->Reset(CommandAllocator, nullptr);
+			}
 
-			D3D12_RECT ScissorRect = {};
-			ScissorRect.left = 0;
-			ScissorRect.right = RTWidth;
-			ScissorRect.top = 0;
-			ScissorRect.bottom = RTHeight;
+			double AvgResCopyTimeUsec = TotalResCopyTimeUsec / ResCopyIters;
+			double CopyGBPerSec = 2.0 * TexWidth * TexHeight * 4 / (AvgResCopyTimeUsec * 1000.0);	// read + write
+			LOG("Resource Copy of %4d x %4d texture: avg %6.1f usec, %6.1f GB/s (%d iters)", TexWidth, TexHeight, AvgResCopyTimeUsec, CopyGBPerSec, ResCopyIters);
+		};
 
-			// CommandList State
+		DoCopyResourceTest(RTWidth, RTHeight, 16 * 1024);
 
-			for (int iter = 0; iter < PSCopyIters; iter++)
-			{
-				CommandList->SetPipelineState(PixelPSO);
-				CommandList->SetGraphicsRootSignature(PixelRootSig);
+		// Copies the bytes of a TexWidth x TexHeight texture between two buffers, with the buffer copy shader
+		// CSByteCode moving BytesPerGroup per group, or with CopyBufferRegion when CSByteCode is null
+		auto DoBufferCopyTest = [&](const char* Name, ID3DBlob* CSByteCode, int BytesPerGroup, int TexWidth, int TexHeight, int BufCopyIters)
+		{
+			double TotalBufCopyTimeUsec = 0.0;
+			const int BufferSize = TexWidth * TexHeight * 4;
+			const D3D12_RESOURCE_STATES SrcState = CSByteCode ? D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_COPY_SOURCE;
+			const D3D12_RESOURCE_STATES DestState = CSByteCode ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_COPY_DEST;
 
-				CommandList->RSSetViewports(1, &Viewport);
-				CommandList->RSSetScissorRects(1, &ScissorRect);
-				CommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+			ID3D12RootSignature* RootSig = GetBufferCopyRootDescriptorRootSig(Pipelines);
+			ID3D12PipelineState* PSO = CSByteCode ? GetComputePSO(Pipelines, RootSig, CSByteCode) : nullptr;
 
-				CommandList->SetDescriptorHeaps(1, &SrcSRV);
-				CommandList->SetGraphicsRootDescriptorTable(0, SrcSRV->GetGPUDescriptorHandleForHeapStart());
+			PooledResource DestResource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), DestState);
+			PooledResource SrcResource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_DEFAULT), SrcState);
+			PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
+			PooledResource Readback = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(BufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
 
-				{
-					D3D12_VERTEX_BUFFER_VIEW vtbView = {};
-					vtbView.BufferLocation = VertexBufferRes->GetGPUVirtualAddress();
-					vtbView.SizeInBytes = VertexBufferSize;
-					vtbView.StrideInBytes = 16;
+			SetBufferUploadRandomBytes(UploadSource, BufferSize);
+			UploadBufferResource(CommandList, UploadSource, SrcResource, BufferSize, SrcState);
 
-					CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-					CommandList->IASetVertexBuffers(0, 1, &vtbView);
+			for (int iter = 0; iter < BufCopyIters; iter++)
+			{
+				if (CSByteCode)
+				{
+					CommandList->SetPipelineState(PSO);
+					CommandList->SetComputeRootSignature(RootSig);
+					CommandList->SetComputeRootShaderResourceView(0, SrcResource->GetGPUVirtualAddress());
+					CommandList->SetComputeRootUnorderedAccessView(1, DestResource->GetGPUVirtualAddress());
 				}
 
 				Timer.StartTiming(CommandList);
 
-				CommandList->DrawInstanced(VertexCount, 1, 0, 0);
+				if (CSByteCode)
+				{
+					CommandList->Dispatch((BufferSize + BytesPerGroup - 1) / BytesPerGroup, 1, 1);
+				}
+				else
+				{
+					CommandList->CopyBufferRegion(DestResource, 0, SrcResource, 0, BufferSize);
+				}
 
 				Timer.EndTiming(CommandList);
 
-				// Copy render target data to readback texture
-				//CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_RENDER_TARGET);
+				CopyBufferToReadback(CommandList, DestResource, Readback, BufferSize, DestState);
 
 				CommandList->Close();
 
@@ -969,76 +5709,132 @@ int main(int argc, char** argv) {
 
 				NextValueToSignal++;
 
-				//WriteReadbackToFile("pixel_shader_dest.png", ReadbackRT, RTWidth, RTHeight);
-
 				uint64_t StartTS = 0;
 				uint64_t EndTS = 0;
 				Timer.GetTiming(&StartTS, &EndTS);
 
 				uint64_t TotalTS = EndTS - StartTS;
-				double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
-				//LOG("Took %5.1f usec (%llu ticks) for pixel shader copy (%4d x %4d)", TotalUsec, TotalTS, RTWidth, RTHeight);
-
-				TotalPSCopyTimeUsec += TotalUsec;
+				TotalBufCopyTimeUsec += ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
 
 				CommandList->Reset(CommandAllocator, nullptr);
 			}
 
-			DestResource->Release();
-			SrcResource->Release();
-			ReadbackRT->Release();
-			UploadSource->Release();
-
-			double AvgPSCopyTimeUsec = TotalPSCopyTimeUsec / PSCopyIters;
-			LOG("PS Copy of %4d x %4d texture: avg %6.1f usec (%d iters)", RTWidth, RTHeight, AvgPSCopyTimeUsec, PSCopyIters);
-		}
+			double AvgBufCopyTimeUsec = TotalBufCopyTimeUsec / BufCopyIters;
+			double CopyGBPerSec = 2.0 * BufferSize / (AvgBufCopyTimeUsec * 1000.0);	// read + write
+			LOG("%s of %4d x %4d texture's bytes: avg %6.1f usec, %6.1f GB/s (%d iters)", Name, TexWidth, TexHeight, AvgBufCopyTimeUsec, CopyGBPerSec, BufCopyIters);
+		};
 
-		auto DoCSCopyTest = [&](int GroupSize, ID3DBlob* CSByteCode)
+		// Mid-size copies: the plain CS copy, the groupshared tile and wave row kernels, and buffer copies
+		// with 128-bit loads, each against CopyResource and CopyBufferRegion at the same size
 		{
-			double TotalCSCopyTimeUsec = 0.0;
-			const int CSCopyIters = 16 * 1024;
-
-			// Compute shader copy
+			const int MidSizes[] = { 256, 512, 1024, 2048 };
+			const int MidCopyIters = 1024;
+
+			// Wave intrinsics need SM 6.0, on the device and in the bytecode, which only the DXIL table has: FXC
+			// can't compile them
+			ShaderCompileRequest WaveRowRequest = { "<CS_SOURCE>", ComputeShaderCodeWaveRowCopy, "CSMain", "cs_6_0" };
+			bool bWaveRows = bShaderModel6 && Shaders.bUseEmbedded && FindEmbeddedShader(WaveRowRequest) != nullptr && Shaders.Get(WaveRowRequest);
+			uint32_t WaveLaneCount = 64;
+			if (bWaveRows)
 			{
-				ID3D12RootSignature* RootSig = CreateComputeRootSig(Device);
-
-				ID3D12PipelineState* PSO1x1 = CreateComputePSO(Device, RootSig, CSByteCode);
+				LogEmbeddedShaderStats(WaveRowRequest);
 
-				ID3D12Resource* DestResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
-				ID3D12Resource* SrcResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+				// The smallest wave the driver runs; the readback check holds at any size the shader handles
+				D3D12_FEATURE_DATA_D3D12_OPTIONS1 Options1 = {};
+				if (SUCCEEDED(Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS1, &Options1, sizeof(Options1))) && Options1.WaveOps)
+				{
+					WaveLaneCount = Options1.WaveLaneCountMin;
+				}
+			}
+			else if (!bShaderModel6)
+			{
+				LOG("Skipping wave row copies: shader model 6.0 not supported");
+			}
+			else
+			{
+				LOG("Skipping wave row copies: they need the DXIL table from shaders/build_shaders.py");
+			}
 
-				int bpp = 4;
-				int TexBufferSize = RTWidth * RTHeight * bpp;
-				ID3D12Resource* UploadSource = AllocateUploadTexture(Device, TexBufferSize);
+			for (int Size : MidSizes)
+			{
+				DoCSCopyTest(8, 8, CSByteCode8x8, Size, Size, Size / 8, Size / 8, "", MidCopyIters);
+				DoCSCopyTest(16, 16, CSByteCodeTileCopy, Size, Size, Size / 32, Size / 32, "groupshared 32x32 tile", MidCopyIters);
+				if (bWaveRows)
+				{
+					DoCSCopyTest(64, 1, WaveRowRequest.ByteCode, Size, Size, Size / 256, Size, "wave rows", MidCopyIters, WaveLaneCount);
+				}
+				DoBufferCopyTest("Buffer Copy 128-bit   ", CSByteCodeBufferCopy, 64 * 16, Size, Size, MidCopyIters);
+				DoBufferCopyTest("Buffer Copy 128-bit x4", CSByteCodeBufferCopyWide, 64 * 16 * 4, Size, Size, MidCopyIters);
+				DoBufferCopyTest("CopyBufferRegion      ", nullptr, 0, Size, Size, MidCopyIters);
+				DoCopyResourceTest(Size, Size, MidCopyIters);
+			}
 
-				ID3D12Resource* ReadbackRT = AllocateReadbackTexture(Device, TexBufferSize);
+			if (bWaveRows)
+			{
+				WaveRowRequest.ByteCode->Release();
+			}
+		}
 
-				SetTextureUploadRandomBytes("compute_shader_source.png", UploadSource, TexBufferSize, RTWidth, RTHeight, RTWidth * bpp);
-				UploadTextureResource(CommandList, UploadSource, SrcResource, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_GENERIC_READ);
 
-				ID3D12DescriptorHeap* DescriptorHeap = GetSRVUAVHeapForTextures(Device, SrcResource, DestResource);
+		// The same copy on the CPU, for comparison
+		{
+			const int CPUCopyIters = 1024;
+			const int NumThreads = GetMaxThreads();
 
-				for (int iter = 0; iter < CSCopyIters; iter++)
-				{
+			CPUTexture Src, Dst;
+			Src.Init(RTWidth, RTHeight, 1, 1, 4);
+			Dst.Init(RTWidth, RTHeight, 1, 1, 4);
 
-					CommandList->SetPipelineState(PSO1x1);
-					CommandList->SetComputeRootSignature(RootSig);
+			CPUCopyEngine Engine;
+			Engine.Kernel = SelectCopyKernel(Src.Memory.Size);
+			Engine.Start(NumThreads);
 
-					CommandList->SetDescriptorHeaps(1, &DescriptorHeap);
-					CommandList->SetComputeRootDescriptorTable(0, DescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (int iter = 0; iter < CPUCopyIters; iter++)
+			{
+				Engine.CopyResource(Dst, Src);
+			}
+			double AvgCPUCopyTimeUsec = GetElapsedSeconds(Start) * 1000.0 * 1000.0 / CPUCopyIters;
+			Engine.Shutdown();
 
-					D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = DescriptorHeap->GetGPUDescriptorHandleForHeapStart();
-					GPUHandle.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-					CommandList->SetComputeRootDescriptorTable(1, GPUHandle);
+			LOG("CPU Resource Copy of %4d x %4d texture: avg %6.1f usec (%d threads, %d iters)", RTWidth, RTHeight, AvgCPUCopyTimeUsec, NumThreads, CPUCopyIters);
+		}
 
-					Timer.StartTiming(CommandList);
+		// Uploads into a 64KB standard swizzle texture: the copy engine swizzling a linear buffer, against the
+		// CPU writing the tiles itself into a mapped texture that the GPU then copies as is
+		{
+			D3D12_FEATURE_DATA_D3D12_OPTIONS Options = {};
+			HRESULT hr = Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &Options, sizeof(Options));
+			if (FAILED(hr) || !Options.StandardSwizzle64KBSupported)
+			{
+				LOG("Standard swizzle uploads: 64KB standard swizzle not supported, skipping");
+			}
+			else
+			{
+				const int SwizzleIters = 256;
+				const int bpp = 4;
+				const int TexBufferSize = RTWidth * RTHeight * bpp;
 
-					CommandList->Dispatch(RTWidth / GroupSize, RTHeight / GroupSize, 1);
+				std::vector<uint8_t> PixelData(TexBufferSize);
+				for (int i = 0; i < TexBufferSize; i++)
+				{
+					PixelData[i] = (uint8_t)(rand() % 256);
+				}
 
-					Timer.EndTiming(CommandList);
+				PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
+				PooledResource ReadbackRT = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
+				PooledResource LinearDest = Pool.Acquire(CommandList, ResourcePoolKey::Texture(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				PooledResource SwizzledDest = Pool.Acquire(CommandList, ResourcePoolKey::Texture(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_64KB_STANDARD_SWIZZLE), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				ID3D12Resource* SwizzledStaging = AllocateCPUVisibleTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM);
 
-					CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_COPY_DEST);
+				void* pUploadData = nullptr;
+				hr = UploadSource->Map(0, nullptr, &pUploadData);
+				ASSERT(SUCCEEDED(hr));
+				memcpy(pUploadData, PixelData.data(), TexBufferSize);
+				UploadSource->Unmap(0, nullptr);
 
+				auto ExecuteAndWait = [&]()
+				{
 					CommandList->Close();
 
 					ID3D12CommandList* CommandLists[] = { CommandList };
@@ -1052,69 +5848,151 @@ int main(int argc, char** argv) {
 					CloseHandle(hEvent);
 
 					NextValueToSignal++;
+				};
 
-					//WriteReadbackToFile("compute_shader_dest.png", ReadbackRT, RTWidth, RTHeight);
-
+				auto GetTimingUsec = [&]()
+				{
 					uint64_t StartTS = 0;
 					uint64_t EndTS = 0;
 					Timer.GetTiming(&StartTS, &EndTS);
+					return ((double)(EndTS - StartTS)) / TimestampFreq * (1000.0 * 1000.0);
+				};
 
-					uint64_t TotalTS = EndTS - StartTS;
-					double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
-					//LOG("Took %5.1f usec (%llu ticks) for compute shader copy (%dx%d) (%4d x %4d)", TotalUsec, TotalTS, GroupSize, GroupSize RTWidth, RTHeight);
+				// Reads the texture back through a linear footprint, which also checks our swizzle against the driver's
+				auto VerifyTexture = [&](ID3D12Resource* Texture, const char* Name)
+				{
+					CopyRenderTargetDataToReadback(CommandList, Texture, ReadbackRT, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+					ExecuteAndWait();
+					CommandList->Reset(CommandAllocator, nullptr);
 
-					TotalCSCopyTimeUsec += TotalUsec;
+					void* pReadbackData = nullptr;
+					D3D12_RANGE ReadRange = { 0, (SIZE_T)TexBufferSize };
+					HRESULT hr = ReadbackRT->Map(0, &ReadRange, &pReadbackData);
+					ASSERT(SUCCEEDED(hr));
+					if (memcmp(pReadbackData, PixelData.data(), TexBufferSize) != 0)
+					{
+						LOG("Standard swizzle uploads: %s MISMATCH", Name);
+					}
+					D3D12_RANGE WriteRange = { 0, 0 };
+					ReadbackRT->Unmap(0, &WriteRange);
+				};
+
+				// Linear buffer to the driver's own layout, as a baseline, then to the standard swizzle
+				ID3D12Resource* CopyEngineDests[] = { LinearDest.Get(), SwizzledDest.Get() };
+				const char* CopyEngineNames[] = { "copy engine -> unknown layout", "copy engine -> standard swizzle" };
+				for (int d = 0; d < 2; d++)
+				{
+					double TotalUploadTimeUsec = 0.0;
+					for (int iter = 0; iter < SwizzleIters; iter++)
+					{
+						Timer.StartTiming(CommandList);
+						UploadTextureResource(CommandList, UploadSource, CopyEngineDests[d], RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+						Timer.EndTiming(CommandList);
+
+						ExecuteAndWait();
+						TotalUploadTimeUsec += GetTimingUsec();
+						CommandList->Reset(CommandAllocator, nullptr);
+					}
+
+					VerifyTexture(CopyEngineDests[d], CopyEngineNames[d]);
+					LOG("Upload %-32s of %4d x %4d texture: avg %6.1f usec GPU (%d iters)", CopyEngineNames[d], RTWidth, RTHeight, TotalUploadTimeUsec / SwizzleIters, SwizzleIters);
+				}
 
-					CommandList->Reset(CommandAllocator, nullptr);
+				// CPU pre-swizzle into the mapped texture, then a tiled to tiled copy that needs no address translation
+				{
+					double TotalCPUTimeUsec = 0.0;
+					double TotalGPUTimeUsec = 0.0;
+					for (int iter = 0; iter < SwizzleIters; iter++)
+					{
+						void* pTiledData = nullptr;
+						hr = SwizzledStaging->Map(0, nullptr, &pTiledData);
+						ASSERT(SUCCEEDED(hr));
+
+						auto Start = std::chrono::high_resolution_clock::now();
+						ConvertSwizzle(StandardSwizzle64KB, PixelData.data(), RTWidth * bpp, RTWidth, RTHeight, (uint8_t*)pTiledData, true);
+						TotalCPUTimeUsec += GetElapsedSeconds(Start) * 1000.0 * 1000.0;
+
+						SwizzledStaging->Unmap(0, nullptr);
+
+						D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
+						CopyLocSrc.pResource = SwizzledStaging;
+						CopyLocSrc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+						CopyLocSrc.SubresourceIndex = 0;
+						CopyLocDst.pResource = SwizzledDest;
+						CopyLocDst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+						CopyLocDst.SubresourceIndex = 0;
+
+						{
+							D3D12_RESOURCE_BARRIER Barrier = {};
+							Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+							Barrier.Transition.pResource = SwizzledDest;
+							Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+							Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+							Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+
+							CommandList->ResourceBarrier(1, &Barrier);
+						}
+
+						// The staging texture is promoted from COMMON to COPY_SOURCE, and decays back once executed
+						Timer.StartTiming(CommandList);
+						CommandList->CopyTextureRegion(&CopyLocDst, 0, 0, 0, &CopyLocSrc, nullptr);
+						Timer.EndTiming(CommandList);
+
+						{
+							D3D12_RESOURCE_BARRIER Barrier = {};
+							Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+							Barrier.Transition.pResource = SwizzledDest;
+							Barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+							Barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+							Barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+							CommandList->ResourceBarrier(1, &Barrier);
+						}
+
+						ExecuteAndWait();
+						TotalGPUTimeUsec += GetTimingUsec();
+						CommandList->Reset(CommandAllocator, nullptr);
+					}
+
+					VerifyTexture(SwizzledDest, "CPU swizzle -> standard swizzle");
+					LOG("Upload %-32s of %4d x %4d texture: avg %6.1f usec CPU + %6.1f usec GPU (%d iters)", "CPU swizzle -> standard swizzle", RTWidth, RTHeight,
+						TotalCPUTimeUsec / SwizzleIters, TotalGPUTimeUsec / SwizzleIters, SwizzleIters);
 				}
 
-				DestResource->Release();
-				SrcResource->Release();
-				ReadbackRT->Release();
-				UploadSource->Release();
+				SwizzledStaging->Release();
 			}
+		}
 
-			double AvgCSCopyTimeUsec = TotalCSCopyTimeUsec / CSCopyIters;
-			LOG("CS Copy (%2dx%2d) of %4d x %4d texture: avg %6.1f usec (%d iters)", GroupSize, GroupSize, RTWidth, RTHeight, AvgCSCopyTimeUsec, CSCopyIters);
-		};
-
-		DoCSCopyTest(1,  CSByteCode1x1);
-		DoCSCopyTest(2,  CSByteCode2x2);
-		DoCSCopyTest(4,  CSByteCode4x4);
-		DoCSCopyTest(8,  CSByteCode8x8);
-		DoCSCopyTest(16, CSByteCode16x16);
-
-		// Resource Copy
+		// Creating a transient copy target and copying into it, committed against placed in a sub-allocated heap,
+		// and then two placed targets aliasing the same memory
 		{
-			double TotalResCopyTimeUsec = 0.0;
-			const int ResCopyIters = 16 * 1024;
+			const int AllocIters = 256;
+			const int bpp = 4;
+			const int TexBufferSize = RTWidth * RTHeight * bpp;
 
-			ID3D12RootSignature* PixelRootSig = CreatePixelRootSig(Device);
-			ID3D12PipelineState* PixelPSO = CreatePixelPSO(Device, PixelRootSig, DXGI_FORMAT_B8G8R8A8_UNORM, VSByteCode, PSByteCode);
+			PooledResource SrcResource = Pool.Acquire(CommandList, ResourcePoolKey::Texture(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE), D3D12_RESOURCE_STATE_COPY_SOURCE);
+			PooledResource UploadSource = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_UPLOAD), D3D12_RESOURCE_STATE_GENERIC_READ);
+			PooledResource ReadbackRT = Pool.Acquire(CommandList, ResourcePoolKey::Buffer(TexBufferSize, D3D12_HEAP_TYPE_READBACK), D3D12_RESOURCE_STATE_COPY_DEST);
 
-			ID3D12Resource* DestResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST);
-			ID3D12Resource* SrcResource = AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_SOURCE);
-
-			int bpp = 4;
-			int TexBufferSize = RTWidth * RTHeight * bpp;
-			ID3D12Resource* UploadSource = AllocateUploadTexture(Device, TexBufferSize);
-
-			ID3D12Resource* ReadbackRT = AllocateReadbackTexture(Device, TexBufferSize);
-
-			SetTextureUploadRandomBytes("resrouce_copy_source.png", UploadSource, TexBufferSize, RTWidth, RTHeight, RTWidth * bpp);
-			UploadTextureResource(CommandList, UploadSource, SrcResource, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_COPY_SOURCE);
-
-			// CommandList State
-			for (int iter = 0; iter < ResCopyIters; iter++)
+			std::vector<uint8_t> PixelData(TexBufferSize);
+			for (int i = 0; i < TexBufferSize; i++)
 			{
-				Timer.StartTiming(CommandList);
+				PixelData[i] = (uint8_t)(rand() % 256);
+			}
 
-				CommandList->CopyResource(DestResource, SrcResource);
+			void* pUploadData = nullptr;
+			HRESULT hr = UploadSource->Map(0, nullptr, &pUploadData);
+			ASSERT(SUCCEEDED(hr));
+			memcpy(pUploadData, PixelData.data(), TexBufferSize);
+			UploadSource->Unmap(0, nullptr);
 
-				Timer.EndTiming(CommandList);
+			UploadTextureResource(CommandList, UploadSource, SrcResource, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_COPY_SOURCE);
 
-				CopyRenderTargetDataToReadback(CommandList, DestResource, ReadbackRT, RTWidth, RTHeight, RTWidth* bpp, D3D12_RESOURCE_STATE_COPY_DEST);
+			PlacedResourceAllocator Allocator;
+			Allocator.Init(Device);
 
+			auto ExecuteAndWait = [&]()
+			{
 				CommandList->Close();
 
 				ID3D12CommandList* CommandLists[] = { CommandList };
@@ -1128,32 +6006,151 @@ int main(int argc, char** argv) {
 				CloseHandle(hEvent);
 
 				NextValueToSignal++;
+			};
 
-				//WriteReadbackToFile("resrouce_copy_dest.png", ReadbackRT, RTWidth, RTHeight);
-
+			auto GetTimingUsec = [&]()
+			{
 				uint64_t StartTS = 0;
 				uint64_t EndTS = 0;
 				Timer.GetTiming(&StartTS, &EndTS);
+				return ((double)(EndTS - StartTS)) / TimestampFreq * (1000.0 * 1000.0);
+			};
 
-				uint64_t TotalTS = EndTS - StartTS;
-				double TotalUsec = ((double)TotalTS) / TimestampFreq * (1000.0 * 1000.0);
-				//LOG("Took %5.1f usec (%llu ticks) for pixel shader copy (%4d x %4d)", TotalUsec, TotalTS, RTWidth, RTHeight);
+			auto VerifyTexture = [&](ID3D12Resource* Texture, const char* Name)
+			{
+				CopyRenderTargetDataToReadback(CommandList, Texture, ReadbackRT, RTWidth, RTHeight, RTWidth * bpp, D3D12_RESOURCE_STATE_COPY_DEST);
+				ExecuteAndWait();
+				CommandList->Reset(CommandAllocator, nullptr);
 
-				TotalResCopyTimeUsec += TotalUsec;
+				void* pReadbackData = nullptr;
+				D3D12_RANGE ReadRange = { 0, (SIZE_T)TexBufferSize };
+				HRESULT hr = ReadbackRT->Map(0, &ReadRange, &pReadbackData);
+				ASSERT(SUCCEEDED(hr));
+				if (memcmp(pReadbackData, PixelData.data(), TexBufferSize) != 0)
+				{
+					LOG("Transient copy target: %s MISMATCH", Name);
+				}
+				D3D12_RANGE WriteRange = { 0, 0 };
+				ReadbackRT->Unmap(0, &WriteRange);
+			};
 
-				CommandList->Reset(CommandAllocator, nullptr);
+			ExecuteAndWait();
+			CommandList->Reset(CommandAllocator, nullptr);
+
+			// Create, copy into and wait for a fresh target each iteration; the copy also initializes it
+			const char* TargetNames[] = { "committed", "placed" };
+			for (int bPlaced = 0; bPlaced < 2; bPlaced++)
+			{
+				double TotalCreateUsec = 0.0;
+				double TotalCopyUsec = 0.0;
+				double TotalLatencyUsec = 0.0;
+				for (int iter = 0; iter < AllocIters; iter++)
+				{
+					auto Start = std::chrono::high_resolution_clock::now();
+
+					PlacedAllocation Allocation;
+					ID3D12Resource* DestResource = bPlaced
+						? AllocatePlacedTexture(Allocator, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST, &Allocation)
+						: AllocateTexture(Device, RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+					ASSERT(DestResource != nullptr);
+					TotalCreateUsec += GetElapsedSeconds(Start) * 1000.0 * 1000.0;
+
+					Timer.StartTiming(CommandList);
+					CommandList->CopyResource(DestResource, SrcResource);
+					Timer.EndTiming(CommandList);
+
+					ExecuteAndWait();
+					TotalLatencyUsec += GetElapsedSeconds(Start) * 1000.0 * 1000.0;
+					TotalCopyUsec += GetTimingUsec();
+					CommandList->Reset(CommandAllocator, nullptr);
+
+					if (iter == AllocIters - 1)
+					{
+						VerifyTexture(DestResource, TargetNames[bPlaced]);
+					}
+
+					DestResource->Release();
+					if (bPlaced)
+					{
+						Allocator.Free(Allocation);
+					}
+				}
+
+				LOG("Transient %-9s target %4d x %4d: create %7.1f usec, first copy %6.1f usec GPU, create to copy done %7.1f usec (%d iters)",
+					TargetNames[bPlaced], RTWidth, RTHeight, TotalCreateUsec / AllocIters, TotalCopyUsec / AllocIters, TotalLatencyUsec / AllocIters, AllocIters);
 			}
 
-			DestResource->Release();
-			SrcResource->Release();
-			ReadbackRT->Release();
-			UploadSource->Release();
+			// Two targets placed over one allocation, taking turns with an aliasing barrier before each copy
+			{
+				D3D12_RESOURCE_DESC Desc = GetTextureDesc(RTWidth, RTHeight, DXGI_FORMAT_B8G8R8A8_UNORM, D3D12_RESOURCE_FLAG_NONE);
+				const D3D12_RESOURCE_ALLOCATION_INFO Info = Allocator.GetAllocationInfo(Desc);
+
+				PlacedAllocation Allocation;
+				bool bAllocated = Allocator.Allocate(Info, PlacedResourceAllocator::GetHeapKind(Desc), &Allocation);
+				ASSERT(bAllocated);
 
-			double AvgResCopyTimeUsec = TotalResCopyTimeUsec / ResCopyIters;
-			LOG("Resource Copy of %4d x %4d texture: avg %6.1f usec (%d iters)", RTWidth, RTHeight, AvgResCopyTimeUsec, ResCopyIters);
+				ID3D12Resource* Aliases[2] =
+				{
+					Allocator.CreateResource(Allocation, Desc, D3D12_RESOURCE_STATE_COPY_DEST),
+					Allocator.CreateResource(Allocation, Desc, D3D12_RESOURCE_STATE_COPY_DEST),
+				};
+
+				double TotalCopyUsec = 0.0;
+				for (int iter = 0; iter < AllocIters; iter++)
+				{
+					D3D12_RESOURCE_BARRIER Barrier = {};
+					Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+					Barrier.Aliasing.pResourceBefore = Aliases[(iter + 1) % 2];
+					Barrier.Aliasing.pResourceAfter = Aliases[iter % 2];
+					CommandList->ResourceBarrier(1, &Barrier);
+
+					Timer.StartTiming(CommandList);
+					CommandList->CopyResource(Aliases[iter % 2], SrcResource);
+					Timer.EndTiming(CommandList);
+
+					ExecuteAndWait();
+					TotalCopyUsec += GetTimingUsec();
+					CommandList->Reset(CommandAllocator, nullptr);
+				}
+
+				VerifyTexture(Aliases[(AllocIters - 1) % 2], "aliased");
+				LOG("Transient aliased   target %4d x %4d: %6.1f usec GPU per copy, 2 targets in %llu KB (%d iters)",
+					RTWidth, RTHeight, TotalCopyUsec / AllocIters, (unsigned long long)(Allocation.Size / 1024), AllocIters);
+
+				Aliases[0]->Release();
+				Aliases[1]->Release();
+				Allocator.Free(Allocation);
+			}
+
+			Allocator.Shutdown();
 		}
+
+		Descriptors.LogStats();
+		Descriptors.Shutdown();
+
+		Pool.LogStats();
+		Pool.Shutdown();
+
+		Timer.Release();
+		ExecFence->Release();
+		CommandList->Release();
+		CommandAllocator->Release();
+	}
+
+	CommandQueue->Release();
+
+	Pipelines.LogStats();
+	Pipelines.Shutdown();
+
+	for (ShaderCompileRequest& Request : StartupShaders)
+	{
+		Request.ByteCode->Release();
 	}
 
+	Device->Release();
+
+	DumpQueue.Flush();
+	DumpQueue.Shutdown();
 
 	return 0;
 }
\ No newline at end of file
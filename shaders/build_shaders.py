@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+"""Compiles the copy kernels to DXIL with DXC and embeds them in shaders/ShaderBlobs.h.
+
+The HLSL stays in main.cpp, where the runtime compile path reads it, and this script pulls the same
+string literals out of it. Each shader below is one ShaderCompileRequest main.cpp makes. The blob table is
+keyed by the hash main.cpp's GetEmbeddedShaderKey computes for that request, so an edited kernel misses and
+falls back to the runtime compile until this is run again. main.cpp picks the table up through
+__has_include.
+
+Next to each blob in shaders/build/ go the DXIL itself (.dxil), its disassembly (.txt) and what the
+disassembly says about the kernel (.json): instructions, dx.op intrinsics, resources, groupshared bytes and
+thread group size. The same numbers go in the table, and main logs them beside the copy times. DXIL has no
+register allocation, so there is no register count to report. That is decided by the driver's compiler.
+
+Needs dxc on PATH, or --dxc, from a DirectXShaderCompiler release. The release includes libdxil.so, which
+signs the output; D3D12 rejects unsigned DXIL, so unsigned blobs fail the build.
+
+    python3 shaders/build_shaders.py            # build everything
+    python3 shaders/build_shaders.py --list     # the requests and their keys, without compiling
+    python3 shaders/build_shaders.py --check    # those keys against the C++ ones, without dxc
+
+--check builds a small program with a C++ compiler (--cxx) from Core/Hashing.h, Core/CSEmulator.h and the
+source literals as written in main.cpp, so the C++ compiler decodes them, and fails if any key differs from
+the one computed here. The CMake build runs it as a test.
+"""
+
+import argparse
+import concurrent.futures
+import json
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+MAIN_CPP = os.path.join(ROOT, "main.cpp")
+OUTPUT_HEADER = os.path.join(ROOT, "shaders", "ShaderBlobs.h")
+BUILD_DIR = os.path.join(ROOT, "shaders", "build")
+
+# CSDispatchOrder in main.cpp
+ROW_MAJOR, COLUMN_MAJOR, MORTON, COLUMN_TILED = range(4)
+ORDER_NAMES = {ROW_MAJOR: "row", COLUMN_MAJOR: "column", MORTON: "morton", COLUMN_TILED: "tiled"}
+
+
+class Shader:
+    """One request: the main.cpp variable holding the source, then what GetEmbeddedShaderKey hashes."""
+
+    def __init__(self, name, source_var, entry_point, profile, defines=(), args=()):
+        self.name = name
+        self.source_var = source_var
+        self.entry_point = entry_point
+        self.profile = profile
+        self.defines = list(defines)
+        self.args = list(args)
+        self.dispatch = None
+        self.source = None
+        self.key = None
+
+
+def remap_shader(group_size, texture_size, order, tile_width):
+    """Mirrors GetRemapCopyShaderRequest for a square dispatch covering the texture."""
+    groups = texture_size // group_size
+    dispatch_x = groups
+    if order == MORTON:
+        dispatch_x = 1
+        while dispatch_x < groups:
+            dispatch_x *= 2
+    name = "cs_remap_%d_%s" % (group_size, ORDER_NAMES[order])
+    if order == COLUMN_TILED:
+        name += "_%d" % tile_width
+    shader = Shader(name, "ComputeShaderCodeRemap", "CSMain", "cs_6_0", [
+        ("GROUP_SIZE", str(group_size)),
+        ("GROUPS_X", str(groups)),
+        ("GROUPS_Y", str(groups)),
+        ("DISPATCH_X", str(dispatch_x)),
+        ("TILE_WIDTH", str(tile_width)),
+        ("REMAP_ORDER", str(order)),
+    ])
+    # The CSDispatch --check passes to GetRemapCopyShaderDefines for the same request
+    shader.dispatch = (group_size, groups, order, tile_width)
+    return shader
+
+
+def get_shaders():
+    """GetStartupShaderRequests, the descriptor heap copy and the wave row copy, then the remap variants
+    RunShaderCacheBenchmark covers, which include the ones the copy tests use."""
+    shaders = [
+        Shader("vs_copy", "VertexShaderCode", "VSMain", "vs_6_0"),
+        Shader("ps_copy", "PixelShaderCode", "PSMain", "ps_6_0"),
+        Shader("cs_copy_1x1", "ComputeShaderCode1x1", "CSMain", "cs_6_0"),
+        Shader("cs_copy_2x2", "ComputeShaderCode2x2", "CSMain", "cs_6_0"),
+        Shader("cs_copy_4x4", "ComputeShaderCode4x4", "CSMain", "cs_6_0"),
+        Shader("cs_copy_8x8", "ComputeShaderCode8x8", "CSMain", "cs_6_0"),
+        Shader("cs_copy_16x16", "ComputeShaderCode16x16", "CSMain", "cs_6_0"),
+        Shader("cs_copy_bindless", "ComputeShaderCodeBindless", "CSMain", "cs_6_0"),
+        # ResourceDescriptorHeap: SM 6.6, and only ever runs from this table
+        Shader("cs_copy_descriptor_heap", "ComputeShaderCodeDescriptorHeap", "CSMain", "cs_6_6"),
+        Shader("cs_buffer_copy", "ComputeShaderCodeBufferCopy", "CSMain", "cs_6_0"),
+        Shader("cs_buffer_copy_wide", "ComputeShaderCodeBufferCopyWide", "CSMain", "cs_6_0"),
+        Shader("cs_tile_copy", "ComputeShaderCodeTileCopy", "CSMain", "cs_6_0"),
+        # Wave intrinsics: only ever runs from this table, as FXC can't compile it
+        Shader("cs_wave_row_copy", "ComputeShaderCodeWaveRowCopy", "CSMain", "cs_6_0"),
+    ]
+    for group_size in (4, 8, 16):
+        for order in (ROW_MAJOR, COLUMN_MAJOR, MORTON, COLUMN_TILED):
+            for tile_width in ((4, 16) if order == COLUMN_TILED else (0,)):
+                shaders.append(remap_shader(group_size, 4096, order, tile_width))
+    return shaders
+
+
+def hash_bytes(data, h=0xcbf29ce484222325):
+    """Core/Hashing.h's HashBytes: FNV-1a a little-endian word at a time, then the remaining bytes."""
+    mask = (1 << 64) - 1
+    prime = 0x100000001b3
+    whole = len(data) // 8 * 8
+    for (word,) in struct.iter_unpack("<Q", data[:whole]):
+        h = ((h ^ word) * prime) & mask
+    for byte in data[whole:]:
+        h = ((h ^ byte) * prime) & mask
+    return h
+
+
+def get_key(shader):
+    """GetShaderSourceKey: every string with its terminator."""
+    h = hash_bytes(shader.source + b"\0")
+    h = hash_bytes(shader.entry_point.encode() + b"\0", h)
+    for name, value in shader.defines:
+        h = hash_bytes(name.encode() + b"\0", h)
+        h = hash_bytes(value.encode() + b"\0", h)
+    return h
+
+
+C_ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "\\": "\\", "\"": "\"", "'": "'", "0": "\0"}
+
+
+def read_literals(path):
+    """Every `const char* Name = "..." "...";` at file scope, as the string literals written in the file."""
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    return {match.group(1): match.group(2).strip()
+            for match in re.finditer(r'^const char\* (\w+) =\s*((?:"(?:[^"\\\n]|\\.)*"\s*)+);', text, re.MULTILINE)}
+
+
+def read_sources(path):
+    """read_literals, as the bytes the compiler sees."""
+    sources = {}
+    for name, literals in read_literals(path).items():
+        pieces = re.findall(r'"((?:[^"\\\n]|\\.)*)"', literals)
+        literal = "".join(pieces)
+        source = re.sub(r"\\(.)", lambda m: C_ESCAPES[m.group(1)], literal)
+        sources[name] = source.encode()
+    return sources
+
+
+def type_size(t):
+    """Bytes in a DXIL groupshared type such as [64 x float] or [4 x [16 x i32]]."""
+    t = t.strip()
+    array = re.fullmatch(r"\[(\d+) x (.+)\]", t) or re.fullmatch(r"<(\d+) x (.+)>", t)
+    if array:
+        return int(array.group(1)) * type_size(array.group(2))
+    scalars = {"i1": 4, "i8": 1, "i16": 2, "i32": 4, "i64": 8, "half": 2, "float": 4, "double": 8}
+    return scalars.get(t, 0)
+
+
+def leading_type(text):
+    """The type at the start of text, with any nested brackets, e.g. "[4 x [16 x i32]], align 4"."""
+    if text[:1] not in "[<":
+        return text.split()[0].rstrip(",")
+    depth = 0
+    for i, c in enumerate(text):
+        depth += c in "[<"
+        depth -= c in "]>"
+        if depth == 0:
+            return text[:i + 1]
+    return text
+
+
+def get_stats(disassembly, entry_point):
+    stats = {"instructions": 0, "intrinsics": 0, "resources": 0, "groupshared_bytes": 0, "num_threads": [0, 0, 0]}
+
+    in_entry = False
+    for line in disassembly.splitlines():
+        stripped = line.strip()
+        if stripped.startswith("define ") and "@%s(" % entry_point in stripped:
+            in_entry = True
+            continue
+        if in_entry:
+            if stripped == "}":
+                in_entry = False
+            elif stripped and not stripped.startswith(";") and not re.fullmatch(r"[\w.]+:.*", stripped):
+                stats["instructions"] += 1
+                if re.search(r"call .*@dx\.op\.", stripped):
+                    stats["intrinsics"] += 1
+
+    # The table under "; Resource Bindings:" has a dashed rule under its header and ends at an empty comment
+    bindings = re.search(r"; Resource Bindings:\n;\n;.*\n; -+[ -]*\n((?:; .+\n)*)", disassembly)
+    if bindings:
+        stats["resources"] = len(bindings.group(1).splitlines())
+
+    for match in re.finditer(r"^@\S+ = (?:\w+ )*addrspace\(3\) global (.+)$", disassembly, re.MULTILINE):
+        stats["groupshared_bytes"] += type_size(leading_type(match.group(1)))
+
+    # The entry point's last operand is its properties, where tag 4 is the thread group size
+    def node(index):
+        found = re.search(r"^!%s = !\{(.*)\}$" % index, disassembly, re.MULTILINE)
+        return found.group(1) if found else ""
+
+    entry = re.search(r"^!dx\.entryPoints = !\{!(\d+)", disassembly, re.MULTILINE)
+    properties = re.search(r", !(\d+)$", node(entry.group(1))) if entry else None
+    num_threads = re.search(r"\bi32 4, !(\d+)", node(properties.group(1))) if properties else None
+    if num_threads:
+        size = re.fullmatch(r"i32 (\d+), i32 (\d+), i32 (\d+)", node(num_threads.group(1)))
+        if size:
+            stats["num_threads"] = [int(v) for v in size.groups()]
+    return stats
+
+
+def check_container(blob, name):
+    """A DXBC container with a DXIL part, signed by the validator."""
+    if len(blob) < 32 or blob[:4] != b"DXBC":
+        raise RuntimeError("%s: dxc did not write a DXBC container" % name)
+    if blob[4:20] == b"\0" * 16:
+        raise RuntimeError("%s: the DXIL is unsigned; dxc needs libdxil.so next to it to sign shaders" % name)
+    part_count = struct.unpack_from("<I", blob, 28)[0]
+    parts = [blob[offset:offset + 4] for (offset,) in struct.iter_unpack("<I", blob[32:32 + 4 * part_count])]
+    if b"DXIL" not in parts:
+        raise RuntimeError("%s: the container has no DXIL part" % name)
+
+
+def compile_shader(dxc, shader):
+    base = os.path.join(BUILD_DIR, shader.name)
+    with open(base + ".hlsl", "wb") as f:
+        f.write(shader.source)
+
+    command = [dxc, "-nologo", "-T", shader.profile, "-E", shader.entry_point, "-O3", "-Qstrip_reflect", "-Qstrip_debug",
+               "-Fo", base + ".dxil", "-Fc", base + ".txt"]
+    for name, value in shader.defines:
+        command += ["-D", "%s=%s" % (name, value)]
+    command += shader.args + [base + ".hlsl"]
+
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError("%s:\n%s%s" % (shader.name, result.stdout, result.stderr))
+
+    with open(base + ".dxil", "rb") as f:
+        blob = f.read()
+    check_container(blob, shader.name)
+    with open(base + ".txt", encoding="utf-8", errors="replace") as f:
+        stats = get_stats(f.read(), shader.entry_point)
+
+    with open(base + ".json", "w") as f:
+        json.dump(dict(name=shader.name, key="%016x" % shader.key, profile=shader.profile, bytes=len(blob), **stats), f, indent=4)
+        f.write("\n")
+    return blob, stats
+
+
+def write_header(path, results):
+    lines = [
+        "// Generated by shaders/build_shaders.py from the shader sources in main.cpp. Do not edit.",
+        "#pragma once",
+        "",
+    ]
+    for i, (shader, blob, _) in enumerate(results):
+        lines.append("// %s" % shader.name)
+        lines.append("static const uint8_t EmbeddedShaderByteCode%d[] =" % i)
+        lines.append("{")
+        for offset in range(0, len(blob), 16):
+            lines.append("\t" + " ".join("0x%02x," % b for b in blob[offset:offset + 16]))
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const EmbeddedShader EmbeddedShaders[] =")
+    lines.append("{")
+    for i, (shader, _, stats) in enumerate(results):
+        lines.append("\t{ 0x%016xull, \"%s\", \"%s\", EmbeddedShaderByteCode%d, sizeof(EmbeddedShaderByteCode%d), %d, %d, %d, %d, { %d, %d, %d } }," % (
+            shader.key, shader.name, shader.profile, i, i, stats["instructions"], stats["intrinsics"], stats["resources"],
+            stats["groupshared_bytes"], *stats["num_threads"]))
+    lines.append("};")
+    lines.append("static const int NumEmbeddedShaders = sizeof(EmbeddedShaders) / sizeof(EmbeddedShaders[0]);")
+    lines.append("")
+
+    with open(path, "w", newline="\n") as f:
+        f.write("\n".join(lines))
+
+
+def check_keys(cxx, shaders):
+    """Builds and runs a program printing the C++ key of each request, one per line, and compares them."""
+    literals = read_literals(MAIN_CPP)
+    lines = [
+        '#include "Core/CSEmulator.h"',
+        '#include "Core/Hashing.h"',
+        "",
+    ]
+    for name in sorted({shader.source_var for shader in shaders}):
+        lines.append("static const char* %s =\n%s;" % (name, literals[name]))
+    lines += ["", "int main()", "{", "\tstd::vector<std::pair<std::string, std::string>> Defines;"]
+    for shader in shaders:
+        if shader.dispatch:
+            group_size, groups, order, tile_width = shader.dispatch
+            lines += [
+                "\t{",
+                "\t\tCSDispatch Dispatch;",
+                "\t\tDispatch.NumThreads[0] = Dispatch.NumThreads[1] = %d;" % group_size,
+                "\t\tDispatch.GroupCount[0] = Dispatch.GroupCount[1] = %d;" % groups,
+                "\t\tDispatch.Order = (CSDispatchOrder)%d;" % order,
+                "\t\tDispatch.TileWidth = %d;" % tile_width,
+                "\t\tDefines = GetRemapCopyShaderDefines(Dispatch);",
+                "\t}",
+            ]
+        else:
+            lines.append("\tDefines.clear();")
+        lines.append('\tprintf("%%016llx\\n", (unsigned long long)GetShaderSourceKey(%s, "%s", Defines));' % (shader.source_var, shader.entry_point))
+    lines += ["\treturn 0;", "}", ""]
+
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "shader_keys.cpp")
+        program = os.path.join(directory, "shader_keys")
+        with open(source, "w", newline="\n") as f:
+            f.write("\n".join(lines))
+        result = subprocess.run([cxx, "-std=c++14", "-I", ROOT, "-o", program, source, "-pthread"], capture_output=True, text=True)
+        if result.returncode != 0:
+            sys.exit("%s could not build the key check:\n%s%s" % (cxx, result.stdout, result.stderr))
+        result = subprocess.run([program], capture_output=True, text=True)
+        if result.returncode != 0:
+            sys.exit("the key check failed to run")
+
+    cpp_keys = result.stdout.split()
+    mismatches = 0
+    for shader, cpp_key in zip(shaders, cpp_keys):
+        if cpp_key != "%016x" % shader.key:
+            print("%-24s C++ %s, Python %016x" % (shader.name, cpp_key, shader.key))
+            mismatches += 1
+    if len(cpp_keys) != len(shaders) or mismatches:
+        sys.exit("%d of %d keys differ from the C++ ones" % (max(mismatches, abs(len(cpp_keys) - len(shaders))), len(shaders)))
+    print("All %d keys match the C++ ones" % len(shaders))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--dxc", default=shutil.which("dxc") or "dxc", help="the dxc executable")
+    parser.add_argument("--list", action="store_true", help="print each request's key and stop")
+    parser.add_argument("--check", action="store_true", help="compare each request's key with the C++ one and stop")
+    parser.add_argument("--cxx", default=os.environ.get("CXX") or shutil.which("c++") or "c++", help="the C++ compiler for --check")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="parallel compiles")
+    options = parser.parse_args()
+
+    sources = read_sources(MAIN_CPP)
+    shaders = get_shaders()
+    for shader in shaders:
+        if shader.source_var not in sources:
+            sys.exit("main.cpp has no shader source named %s" % shader.source_var)
+        shader.source = sources[shader.source_var]
+        shader.key = get_key(shader)
+
+    keys = [shader.key for shader in shaders]
+    if len(set(keys)) != len(keys):
+        sys.exit("two requests have the same key")
+
+    if options.list:
+        for shader in shaders:
+            print("%016x %-24s %s %s" % (shader.key, shader.name, shader.profile, " ".join("%s=%s" % d for d in shader.defines)))
+        return
+
+    if options.check:
+        check_keys(options.cxx, shaders)
+        return
+
+    os.makedirs(BUILD_DIR, exist_ok=True)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=options.jobs) as pool:
+        futures = [pool.submit(compile_shader, options.dxc, shader) for shader in shaders]
+        try:
+            results = [(shader, *future.result()) for shader, future in zip(shaders, futures)]
+        except (RuntimeError, OSError) as error:
+            sys.exit(str(error))
+
+    write_header(OUTPUT_HEADER, results)
+    for shader, blob, stats in results:
+        print("%-24s %-6s %6d bytes %5d instructions %4d intrinsics" % (shader.name, shader.profile, len(blob), stats["instructions"], stats["intrinsics"]))
+    print("Wrote %d shaders to %s" % (len(results), os.path.relpath(OUTPUT_HEADER, ROOT)))
+
+
+if __name__ == "__main__":
+    main()
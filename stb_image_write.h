@@ -31,6 +31,16 @@ BUILDING:
    unsigned char * my_compress(unsigned char *data, int data_len, int *out_len, int quality);
    The returned data will be freed with STBIW_FREE() (free() by default),
    so it must be heap allocated with STBIW_MALLOC() (malloc() by default),
+   You can #define STBIW_PARALLEL_FOR(count, func, context) to let the PNG writer
+   filter bands of rows and deflate chunks of the image concurrently. It must call
+   func(context, i) for every i in [0, count), in any order and on any thread, and
+   return only once all of the calls have finished. func has the signature
+   void func(void *context, int index);
+   The output is still a single valid PNG.
+   You can #define STBIW_CRC32(buffer, len) and STBIW_ADLER32(data, len) to replace
+   the checksums used for PNG chunks and the zlib stream, e.g. with hardware
+   accelerated versions. Both take (unsigned char *, int) and return the finished
+   unsigned int checksum of the whole buffer.
 
 UNICODE:
 
@@ -42,17 +52,19 @@ UNICODE:
 
 USAGE:
 
-   There are five functions, one for each image file format:
+   There are seven functions, one for each image file format:
 
 	 int stbi_write_png(char const *filename, int w, int h, int comp, const void *data, int stride_in_bytes);
 	 int stbi_write_bmp(char const *filename, int w, int h, int comp, const void *data);
 	 int stbi_write_tga(char const *filename, int w, int h, int comp, const void *data);
 	 int stbi_write_jpg(char const *filename, int w, int h, int comp, const void *data, int quality);
 	 int stbi_write_hdr(char const *filename, int w, int h, int comp, const float *data);
+	 int stbi_write_qoi(char const *filename, int w, int h, int comp, const void *data, int stride_in_bytes);
+	 int stbi_write_raw(char const *filename, int w, int h, unsigned int format, int bytes_per_pixel, const void *data, int stride_in_bytes);
 
 	 void stbi_flip_vertically_on_write(int flag); // flag is non-zero to flip data vertically
 
-   There are also five equivalent functions that use an arbitrary write function. You are
+   There are also seven equivalent functions that use an arbitrary write function. You are
    expected to open/close your file-equivalent before and after calling these:
 
 	 int stbi_write_png_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data, int stride_in_bytes);
@@ -60,14 +72,32 @@ USAGE:
 	 int stbi_write_tga_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void  *data);
 	 int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const float *data);
 	 int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int quality);
+	 int stbi_write_qoi_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const void *data, int stride_in_bytes);
+	 int stbi_write_raw_to_func(stbi_write_func *func, void *context, int w, int h, unsigned int format, int bytes_per_pixel, const void *data, int stride_in_bytes);
 
    where the callback is:
 	  void stbi_write_func(void *context, void *data, int size);
 
+   PNG can also be written a few rows at a time, e.g. straight out of a mapped buffer,
+   without ever holding the whole image or its compressed form in memory. IDAT chunks
+   go to the callback as they fill up, and memory use stays at a few rows plus the
+   deflate window:
+
+	 stbi_png_stream *stbi_write_png_stream_begin(stbi_write_func *func, void *context, int w, int h, int comp);
+	 int stbi_write_png_stream_rows(stbi_png_stream *stream, const void *rows, int num_rows, int stride_in_bytes);
+	 int stbi_write_png_stream_end(stbi_png_stream *stream);
+
+   Rows are supplied top to bottom (stbi_flip_vertically_on_write doesn't apply) and
+   end returns 0 unless all h rows were written. end always frees the stream. Streaming
+   needs the builtin compressor, so begin returns NULL if STBIW_ZLIB_COMPRESS is defined.
+
    You can configure it with these global variables:
 	  int stbi_write_tga_with_rle;             // defaults to true; set to 0 to disable RLE
 	  int stbi_write_png_compression_level;    // defaults to 8; set to higher for more compression
 	  int stbi_write_force_png_filter;         // defaults to -1; set to 0..5 to force a filter mode
+	  int stbi_write_png_max_simd;             // defaults to 2; 0 = scalar PNG filters, 1 = SSE2/NEON, 2 = also AVX2
+	  int stbi_write_hdr_max_simd;             // defaults to 1; 0 = scalar RGBE conversion and RLE run search, 1 = SSE2/NEON
+	  int stbi_write_jpg_max_simd;             // defaults to 2; 0 = scalar JPEG DCT, 1 = SSE2/NEON, 2 = also AVX2
 
 
    You can define STBI_WRITE_NO_STDIO to disable the file variant of these
@@ -89,8 +119,8 @@ USAGE:
    The BMP format expands Y to RGB in the file format and does not
    output alpha.
 
-   PNG supports writing rectangles of data even when the bytes storing rows of
-   data are not consecutive in memory (e.g. sub-rectangles of a larger image),
+   PNG, QOI and RAW support writing rectangles of data even when the bytes storing
+   rows of data are not consecutive in memory (e.g. sub-rectangles of a larger image),
    by supplying the stride between the beginning of adjacent rows. The other
    formats do not. (Thus you cannot write a native-format BMP through the BMP
    writer, both because it is in BGR order and because it may have padding
@@ -101,11 +131,23 @@ USAGE:
 
    HDR expects linear float data. Since the format is always 32-bit rgb(e)
    data, alpha (if provided) is discarded, and for monochrome data it is
-   replicated across all three channels.
+   replicated across all three channels. Values RGBE can't store are clamped:
+   negatives and NaN become 0, and anything from 2^127 up (including infinity)
+   becomes the largest representable value.
 
    TGA supports RLE or non-RLE compressed data. To use non-RLE-compressed
    data, set the global variable 'stbi_write_tga_with_rle' to 0.
 
+   QOI is lossless like PNG, but encodes many times faster at a somewhat larger
+   size. Y and YA input is expanded to RGB and RGBA, since QOI only stores 3 or 4
+   channels.
+
+   RAW writes the pixels uncompressed behind a small header and does not look at
+   them at all, so 'format' and 'bytes_per_pixel' can describe any pixel layout
+   (e.g. a DXGI_FORMAT). The pixel data starts 4096 bytes into the file and keeps
+   the row stride, so tools can map the file and use it in place. The header
+   layout is described next to stbi_write_raw_core below.
+
    JPEG does ignore alpha channels in input data; quality is between 1 and 100.
    Higher quality looks better but results in a bigger image.
    JPEG baseline (no JPEG progressive).
@@ -169,6 +211,9 @@ LICENSE
 extern int stbi_write_tga_with_rle;
 extern int stbi_write_png_compression_level;
 extern int stbi_write_force_png_filter;
+extern int stbi_write_png_max_simd;
+extern int stbi_write_hdr_max_simd;
+extern int stbi_write_jpg_max_simd;
 #endif
 
 #ifndef STBI_WRITE_NO_STDIO
@@ -177,6 +222,8 @@ STBIWDEF int stbi_write_bmp(char const* filename, int w, int h, int comp, const
 STBIWDEF int stbi_write_tga(char const* filename, int w, int h, int comp, const void* data);
 STBIWDEF int stbi_write_hdr(char const* filename, int w, int h, int comp, const float* data);
 STBIWDEF int stbi_write_jpg(char const* filename, int x, int y, int comp, const void* data, int quality);
+STBIWDEF int stbi_write_qoi(char const* filename, int w, int h, int comp, const void* data, int stride_in_bytes);
+STBIWDEF int stbi_write_raw(char const* filename, int w, int h, unsigned int format, int bytes_per_pixel, const void* data, int stride_in_bytes);
 
 #ifdef STBI_WINDOWS_UTF8
 STBIWDEF int stbiw_convert_wchar_to_utf8(char* buffer, size_t bufferlen, const wchar_t* input);
@@ -190,6 +237,14 @@ STBIWDEF int stbi_write_bmp_to_func(stbi_write_func* func, void* context, int w,
 STBIWDEF int stbi_write_tga_to_func(stbi_write_func* func, void* context, int w, int h, int comp, const void* data);
 STBIWDEF int stbi_write_hdr_to_func(stbi_write_func* func, void* context, int w, int h, int comp, const float* data);
 STBIWDEF int stbi_write_jpg_to_func(stbi_write_func* func, void* context, int x, int y, int comp, const void* data, int quality);
+STBIWDEF int stbi_write_qoi_to_func(stbi_write_func* func, void* context, int w, int h, int comp, const void* data, int stride_in_bytes);
+STBIWDEF int stbi_write_raw_to_func(stbi_write_func* func, void* context, int w, int h, unsigned int format, int bytes_per_pixel, const void* data, int stride_in_bytes);
+
+typedef struct stbi_png_stream stbi_png_stream;
+
+STBIWDEF stbi_png_stream* stbi_write_png_stream_begin(stbi_write_func* func, void* context, int w, int h, int comp);
+STBIWDEF int stbi_write_png_stream_rows(stbi_png_stream* stream, const void* rows, int num_rows, int stride_in_bytes);
+STBIWDEF int stbi_write_png_stream_end(stbi_png_stream* stream);
 
 STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
@@ -215,6 +270,31 @@ STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 #include <string.h>
 #include <math.h>
 
+#if !defined(STBIW_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STBIW_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+// AVX2 kernels are compiled for the target and only used if the CPU reports support at runtime
+#define STBIW_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STBIW__AVX2_TARGET
+#else
+#define STBIW__AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+#if !defined(STBIW_NO_SIMD) && !defined(STBIW_SSE2) && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+#define STBIW_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanForward, _BitScanReverse
+#endif
+
 #if defined(STBIW_MALLOC) && defined(STBIW_FREE) && (defined(STBIW_REALLOC) || defined(STBIW_REALLOC_SIZED))
 // ok
 #elif !defined(STBIW_MALLOC) && !defined(STBIW_FREE) && !defined(STBIW_REALLOC) && !defined(STBIW_REALLOC_SIZED)
@@ -250,10 +330,16 @@ STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 static int stbi_write_png_compression_level = 8;
 static int stbi_write_tga_with_rle = 1;
 static int stbi_write_force_png_filter = -1;
+static int stbi_write_png_max_simd = 2;
+static int stbi_write_hdr_max_simd = 1;
+static int stbi_write_jpg_max_simd = 2;
 #else
 int stbi_write_png_compression_level = 8;
 int stbi_write_tga_with_rle = 1;
 int stbi_write_force_png_filter = -1;
+int stbi_write_png_max_simd = 2;
+int stbi_write_hdr_max_simd = 1;
+int stbi_write_jpg_max_simd = 2;
 #endif
 
 static int stbi__flip_vertically_on_write = 0;
@@ -520,6 +606,240 @@ STBIWDEF int stbi_write_bmp(char const* filename, int x, int y, int comp, const
 }
 #endif //!STBI_WRITE_NO_STDIO
 
+/* ***************************************************************************
+ *
+ * QOI writer
+ *
+ * "Quite OK Image" format, see https://qoiformat.org/qoi-specification.pdf
+ */
+
+#define stbiw__QOI_OP_INDEX  0x00
+#define stbiw__QOI_OP_DIFF   0x40
+#define stbiw__QOI_OP_LUMA   0x80
+#define stbiw__QOI_OP_RUN    0xc0
+#define stbiw__QOI_OP_RGB    0xfe
+#define stbiw__QOI_OP_RGBA   0xff
+
+static int stbi_write_qoi_core(stbi__write_context* s, int x, int y, int comp, const void* data, int stride_bytes)
+{
+	static const unsigned char end_marker[8] = { 0,0,0,0,0,0,0,1 };
+	stbiw_uint32 index[64];
+	stbiw_uint32 prev = 0xff000000u;
+	unsigned char out[4096];
+	int channels = (comp == 2 || comp == 4) ? 4 : 3;
+	int i, j, run = 0, used = 0;
+
+	if (x <= 0 || y <= 0 || comp < 1 || comp > 4)
+		return 0;
+	if (stride_bytes == 0)
+		stride_bytes = x * comp;
+
+	stbiw__writef(s, "1111", 'q', 'o', 'i', 'f');
+	stbiw__writef(s, "1111", x >> 24, x >> 16, x >> 8, x);
+	stbiw__writef(s, "1111", y >> 24, y >> 16, y >> 8, y);
+	stbiw__writef(s, "11", channels, 0);  // sRGB with linear alpha
+
+	memset(index, 0, sizeof(index));
+	for (j = 0; j < y; ++j) {
+		const unsigned char* row = (const unsigned char*)data + (size_t)(stbi__flip_vertically_on_write ? y - 1 - j : j) * stride_bytes;
+		for (i = 0; i < x; ++i) {
+			const unsigned char* d = row + i * comp;
+			unsigned char r, g, b, a;
+			stbiw_uint32 px;
+			switch (comp) {
+			case 1:  r = g = b = d[0]; a = 255; break;
+			case 2:  r = g = b = d[0]; a = d[1]; break;
+			case 3:  r = d[0]; g = d[1]; b = d[2]; a = 255; break;
+			default: r = d[0]; g = d[1]; b = d[2]; a = d[3]; break;
+			}
+			px = r | (g << 8) | (b << 16) | ((stbiw_uint32)a << 24);
+
+			if (used > (int)sizeof(out) - 8) {
+				s->func(s->context, out, used);
+				used = 0;
+			}
+
+			if (px == prev) {
+				if (++run == 62) {
+					out[used++] = (unsigned char)(stbiw__QOI_OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				out[used++] = (unsigned char)(stbiw__QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+
+			{
+				int h = (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+				if (index[h] == px) {
+					out[used++] = (unsigned char)(stbiw__QOI_OP_INDEX | h);
+				}
+				else {
+					index[h] = px;
+					if ((prev >> 24) == a) {
+						signed char vr = (signed char)(r - (prev & 0xff));
+						signed char vg = (signed char)(g - ((prev >> 8) & 0xff));
+						signed char vb = (signed char)(b - ((prev >> 16) & 0xff));
+						signed char vg_r = (signed char)(vr - vg);
+						signed char vg_b = (signed char)(vb - vg);
+						if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+							out[used++] = (unsigned char)(stbiw__QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+						}
+						else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+							out[used++] = (unsigned char)(stbiw__QOI_OP_LUMA | (vg + 32));
+							out[used++] = (unsigned char)((vg_r + 8) << 4 | (vg_b + 8));
+						}
+						else {
+							out[used++] = stbiw__QOI_OP_RGB;
+							out[used++] = r;
+							out[used++] = g;
+							out[used++] = b;
+						}
+					}
+					else {
+						out[used++] = stbiw__QOI_OP_RGBA;
+						out[used++] = r;
+						out[used++] = g;
+						out[used++] = b;
+						out[used++] = a;
+					}
+				}
+			}
+			prev = px;
+		}
+	}
+	if (used > (int)sizeof(out) - 9) {
+		s->func(s->context, out, used);
+		used = 0;
+	}
+	if (run > 0)
+		out[used++] = (unsigned char)(stbiw__QOI_OP_RUN | (run - 1));
+	memcpy(out + used, end_marker, sizeof(end_marker));
+	used += sizeof(end_marker);
+	s->func(s->context, out, used);
+	return 1;
+}
+
+STBIWDEF int stbi_write_qoi_to_func(stbi_write_func* func, void* context, int x, int y, int comp, const void* data, int stride_bytes)
+{
+	stbi__write_context s = { 0 };
+	stbi__start_write_callbacks(&s, func, context);
+	return stbi_write_qoi_core(&s, x, y, comp, data, stride_bytes);
+}
+
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_qoi(char const* filename, int x, int y, int comp, const void* data, int stride_bytes)
+{
+	stbi__write_context s = { 0 };
+	if (stbi__start_write_file(&s, filename)) {
+		int r = stbi_write_qoi_core(&s, x, y, comp, data, stride_bytes);
+		stbi__end_write_file(&s);
+		return r;
+	}
+	else
+		return 0;
+}
+#endif //!STBI_WRITE_NO_STDIO
+
+/* ***************************************************************************
+ *
+ * RAW writer
+ *
+ * Uncompressed pixels behind a fixed header. All header fields are little endian
+ * and the rest of the first 4096 bytes is zero:
+ *
+ *    offset  size  field
+ *         0     4  magic 'S' 'R' 'A' 'W'
+ *         4     4  header version, 1
+ *         8     4  pixel format, as passed by the caller
+ *        12     4  width
+ *        16     4  height
+ *        20     4  bytes per pixel
+ *        24     4  pitch, bytes from the start of one row to the next
+ *        28     4  offset of the first row from the start of the file, 4096
+ *        32     8  size of the pixel data, pitch * height
+ *
+ * The pitch is the stride the image was written with, and whatever the caller's
+ * memory holds between rows is written as-is.
+ */
+
+#define stbiw__RAW_DATA_OFFSET 4096
+
+static void stbiw__write_bytes(stbi__write_context* s, const unsigned char* data, size_t len)
+{
+	// the callback takes an int size
+	while (len > 0) {
+		int n = len > (1u << 30) ? (1 << 30) : (int)len;
+		s->func(s->context, (void*)data, n);
+		data += n;
+		len -= n;
+	}
+}
+
+static void stbiw__write_zeros(stbi__write_context* s, size_t len)
+{
+	static const unsigned char zeros[256] = { 0 };
+	while (len > 0) {
+		size_t n = len > sizeof(zeros) ? sizeof(zeros) : len;
+		stbiw__write_bytes(s, zeros, n);
+		len -= n;
+	}
+}
+
+static int stbi_write_raw_core(stbi__write_context* s, int x, int y, unsigned int format, int bpp, const void* data, int stride_bytes)
+{
+	int row_bytes = x * bpp, j;
+	size_t size;
+
+	if (x <= 0 || y <= 0 || bpp <= 0)
+		return 0;
+	if (stride_bytes == 0)
+		stride_bytes = row_bytes;
+	if (stride_bytes < row_bytes)
+		return 0;
+
+	size = (size_t)stride_bytes * y;
+	stbiw__writef(s, "1111 4 4 444 4 4 44", 'S', 'R', 'A', 'W', 1, format, x, y, bpp, stride_bytes,
+		stbiw__RAW_DATA_OFFSET, (int)(size & 0xffffffffu), (int)((unsigned long long)size >> 32));
+	stbiw__write_zeros(s, stbiw__RAW_DATA_OFFSET - 40);
+
+	if (!stbi__flip_vertically_on_write) {
+		// rows are already at the file pitch, so everything up to the end of the last row goes out in one write
+		stbiw__write_bytes(s, (const unsigned char*)data, size - (stride_bytes - row_bytes));
+		stbiw__write_zeros(s, stride_bytes - row_bytes);
+	}
+	else {
+		for (j = y - 1; j >= 0; --j) {
+			stbiw__write_bytes(s, (const unsigned char*)data + (size_t)j * stride_bytes, row_bytes);
+			stbiw__write_zeros(s, stride_bytes - row_bytes);
+		}
+	}
+	return 1;
+}
+
+STBIWDEF int stbi_write_raw_to_func(stbi_write_func* func, void* context, int x, int y, unsigned int format, int bytes_per_pixel, const void* data, int stride_bytes)
+{
+	stbi__write_context s = { 0 };
+	stbi__start_write_callbacks(&s, func, context);
+	return stbi_write_raw_core(&s, x, y, format, bytes_per_pixel, data, stride_bytes);
+}
+
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_raw(char const* filename, int x, int y, unsigned int format, int bytes_per_pixel, const void* data, int stride_bytes)
+{
+	stbi__write_context s = { 0 };
+	if (stbi__start_write_file(&s, filename)) {
+		int r = stbi_write_raw_core(&s, x, y, format, bytes_per_pixel, data, stride_bytes);
+		stbi__end_write_file(&s);
+		return r;
+	}
+	else
+		return 0;
+}
+#endif //!STBI_WRITE_NO_STDIO
+
 static int stbi_write_tga_core(stbi__write_context* s, int x, int y, int comp, void* data)
 {
 	int has_alpha = (comp == 2 || comp == 4);
@@ -632,22 +952,292 @@ STBIWDEF int stbi_write_tga(char const* filename, int x, int y, int comp, const
 
 #define stbiw__max(a, b)  ((a) > (b) ? (a) : (b))
 
+// Bit scans, mask must be non-zero
+static int stbiw__ctz(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static int stbiw__ctz64(unsigned long long mask)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (int)index;
+#elif defined(_MSC_VER)
+	return (unsigned int)mask ? stbiw__ctz((unsigned int)mask) : 32 + stbiw__ctz((unsigned int)(mask >> 32));
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+// Number of bits needed to hold v, i.e. the position of the highest set bit plus one
+static int stbiw__bit_length(unsigned int v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, v);
+	return (int)index + 1;
+#else
+	return 32 - __builtin_clz(v);
+#endif
+}
+
+// Largest float below 2^127; bigger values would need an exponent byte of 256
+#define stbiw__RGBE_MAX_FLOAT 1.70141173e+38f
+
+static unsigned int stbiw__float_bits(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, 4);
+	return bits;
+}
+
+static float stbiw__bits_float(unsigned int bits)
+{
+	float f;
+	memcpy(&f, &bits, 4);
+	return f;
+}
+
+// RGBE can't store negative, NaN or infinite values, so clamp them to the representable range
+static float stbiw__rgbe_clamp(float f)
+{
+	f = f > 0.0f ? f : 0.0f;
+	return f < stbiw__RGBE_MAX_FLOAT ? f : stbiw__RGBE_MAX_FLOAT;
+}
+
 static void stbiw__linear_to_rgbe(unsigned char* rgbe, float* linear)
 {
-	int exponent;
-	float maxcomp = stbiw__max(linear[0], stbiw__max(linear[1], linear[2]));
+	float r = stbiw__rgbe_clamp(linear[0]), g = stbiw__rgbe_clamp(linear[1]), b = stbiw__rgbe_clamp(linear[2]);
+	float maxcomp = stbiw__max(r, stbiw__max(g, b));
 
 	if (maxcomp < 1e-32f) {
 		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
 	}
 	else {
-		float normalize = (float)frexp(maxcomp, &exponent) * 256.0f / maxcomp;
+		// frexp(maxcomp) = m * 2^e with e = biased exponent - 126, and the scale that
+		// maps [0, 2^e) onto [0, 256) is exactly 2^(8-e): build both from the float's bits
+		unsigned int biased = stbiw__float_bits(maxcomp) >> 23;
+		float normalize = stbiw__bits_float((261 - biased) << 23);
+
+		rgbe[0] = (unsigned char)(int)(r * normalize);
+		rgbe[1] = (unsigned char)(int)(g * normalize);
+		rgbe[2] = (unsigned char)(int)(b * normalize);
+		rgbe[3] = (unsigned char)(biased + 2);
+	}
+}
+
+#if defined(STBIW_SSE2)
+// 4 pixels of clamped linear r, g, b in, one int32 lane per pixel for each RGBE byte out
+static void stbiw__linear_to_rgbe_sse2(__m128 r, __m128 g, __m128 b, __m128i out[4])
+{
+	const __m128 zero = _mm_setzero_ps(), cap = _mm_set1_ps(stbiw__RGBE_MAX_FLOAT);
+	__m128 maxcomp, normalize, visible;
+	__m128i biased;
+	r = _mm_min_ps(_mm_max_ps(r, zero), cap);
+	g = _mm_min_ps(_mm_max_ps(g, zero), cap);
+	b = _mm_min_ps(_mm_max_ps(b, zero), cap);
+	maxcomp = _mm_max_ps(r, _mm_max_ps(g, b));
+	visible = _mm_cmpge_ps(maxcomp, _mm_set1_ps(1e-32f));
+	biased = _mm_srli_epi32(_mm_castps_si128(maxcomp), 23);
+	normalize = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(261), biased), 23));
+	out[0] = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(r, normalize)), _mm_castps_si128(visible));
+	out[1] = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(g, normalize)), _mm_castps_si128(visible));
+	out[2] = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(b, normalize)), _mm_castps_si128(visible));
+	out[3] = _mm_and_si128(_mm_add_epi32(biased, _mm_set1_epi32(2)), _mm_castps_si128(visible));
+}
+
+// 16 pixels from x into the four component planes
+static void stbiw__hdr_planes_sse2(unsigned char* planes, int width, int x, int ncomp, const float* scanline)
+{
+	__m128i lanes[4][4];
+	int i, c;
+	for (i = 0; i < 4; ++i) {
+		const float* p = scanline + (x + i * 4) * ncomp;
+		__m128 r, g, b;
+		if (ncomp >= 3) {
+			// the 4th load of a 3 component row reads one float of the next pixel, which the caller guarantees exists
+			__m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + ncomp), p2 = _mm_loadu_ps(p + ncomp * 2), p3 = _mm_loadu_ps(p + ncomp * 3);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			r = p0; g = p1; b = p2;
+		}
+		else if (ncomp == 2) {
+			__m128 lo = _mm_loadu_ps(p), hi = _mm_loadu_ps(p + 4);
+			r = g = b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		}
+		else {
+			r = g = b = _mm_loadu_ps(p);
+		}
+		stbiw__linear_to_rgbe_sse2(r, g, b, lanes[i]);
+	}
+	for (c = 0; c < 4; ++c) {
+		__m128i lo = _mm_packs_epi32(lanes[0][c], lanes[1][c]);
+		__m128i hi = _mm_packs_epi32(lanes[2][c], lanes[3][c]);
+		_mm_storeu_si128((__m128i*)(planes + width * c + x), _mm_packus_epi16(lo, hi));
+	}
+}
+#elif defined(STBIW_NEON)
+static void stbiw__linear_to_rgbe_neon(float32x4_t r, float32x4_t g, float32x4_t b, uint32x4_t out[4])
+{
+	const float32x4_t zero = vdupq_n_f32(0.0f), cap = vdupq_n_f32(stbiw__RGBE_MAX_FLOAT);
+	float32x4_t maxcomp, normalize;
+	uint32x4_t visible, biased;
+	// select rather than max so NaN clamps to 0 like the scalar path
+	r = vminq_f32(vbslq_f32(vcgtq_f32(r, zero), r, zero), cap);
+	g = vminq_f32(vbslq_f32(vcgtq_f32(g, zero), g, zero), cap);
+	b = vminq_f32(vbslq_f32(vcgtq_f32(b, zero), b, zero), cap);
+	maxcomp = vmaxq_f32(r, vmaxq_f32(g, b));
+	visible = vcgeq_f32(maxcomp, vdupq_n_f32(1e-32f));
+	biased = vshrq_n_u32(vreinterpretq_u32_f32(maxcomp), 23);
+	normalize = vreinterpretq_f32_u32(vshlq_n_u32(vsubq_u32(vdupq_n_u32(261), biased), 23));
+	out[0] = vandq_u32(vcvtq_u32_f32(vmulq_f32(r, normalize)), visible);
+	out[1] = vandq_u32(vcvtq_u32_f32(vmulq_f32(g, normalize)), visible);
+	out[2] = vandq_u32(vcvtq_u32_f32(vmulq_f32(b, normalize)), visible);
+	out[3] = vandq_u32(vaddq_u32(biased, vdupq_n_u32(2)), visible);
+}
+
+static void stbiw__hdr_planes_neon(unsigned char* planes, int width, int x, int ncomp, const float* scanline)
+{
+	uint32x4_t lanes[4][4];
+	int i, c;
+	for (i = 0; i < 4; ++i) {
+		const float* p = scanline + (x + i * 4) * ncomp;
+		float32x4_t r, g, b;
+		if (ncomp == 4) {
+			float32x4x4_t px = vld4q_f32(p);
+			r = px.val[0]; g = px.val[1]; b = px.val[2];
+		}
+		else if (ncomp == 3) {
+			float32x4x3_t px = vld3q_f32(p);
+			r = px.val[0]; g = px.val[1]; b = px.val[2];
+		}
+		else if (ncomp == 2) {
+			r = g = b = vld2q_f32(p).val[0];
+		}
+		else {
+			r = g = b = vld1q_f32(p);
+		}
+		stbiw__linear_to_rgbe_neon(r, g, b, lanes[i]);
+	}
+	for (c = 0; c < 4; ++c) {
+		uint16x8_t lo = vcombine_u16(vmovn_u32(lanes[0][c]), vmovn_u32(lanes[1][c]));
+		uint16x8_t hi = vcombine_u16(vmovn_u32(lanes[2][c]), vmovn_u32(lanes[3][c]));
+		vst1q_u8(planes + width * c + x, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+	}
+}
+
+// one nibble per byte lane, so the index of the first set lane is ctz / 4
+static unsigned long long stbiw__neon_nibble_mask(uint8x16_t eq)
+{
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+}
+#endif
+
+// Converts a scanline to RGBE, stored as four planes of width bytes (r, g, b, e) for the RLE
+static void stbiw__hdr_scanline_planes(unsigned char* planes, int width, int ncomp, const float* scanline)
+{
+	float linear[3];
+	unsigned char rgbe[4];
+	int x = 0;
+
+#if defined(STBIW_SSE2)
+	if (stbi_write_hdr_max_simd >= 1) {
+		// 3 component rows over-read one float in the last group, so keep it off the end of the row
+		int over = (ncomp == 3) ? 1 : 0;
+		for (; x + 16 + over <= width; x += 16)
+			stbiw__hdr_planes_sse2(planes, width, x, ncomp, scanline);
+	}
+#elif defined(STBIW_NEON)
+	if (stbi_write_hdr_max_simd >= 1) {
+		for (; x + 16 <= width; x += 16)
+			stbiw__hdr_planes_neon(planes, width, x, ncomp, scanline);
+	}
+#endif
+
+	for (; x < width; x++) {
+		switch (ncomp) {
+		case 4: /* fallthrough */
+		case 3: linear[2] = scanline[x * ncomp + 2];
+			linear[1] = scanline[x * ncomp + 1];
+			linear[0] = scanline[x * ncomp + 0];
+			break;
+		default:
+			linear[0] = linear[1] = linear[2] = scanline[x * ncomp + 0];
+			break;
+		}
+		stbiw__linear_to_rgbe(rgbe, linear);
+		planes[x + width * 0] = rgbe[0];
+		planes[x + width * 1] = rgbe[1];
+		planes[x + width * 2] = rgbe[2];
+		planes[x + width * 3] = rgbe[3];
+	}
+}
+
+// First r >= x that starts a run of 3 equal bytes, or width if there isn't one
+static int stbiw__find_hdr_run(const unsigned char* comp, int x, int width)
+{
+	int r = x;
+#if defined(STBIW_SSE2)
+	if (stbi_write_hdr_max_simd >= 1) {
+		for (; r + 18 <= width; r += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(comp + r));
+			__m128i b = _mm_loadu_si128((const __m128i*)(comp + r + 1));
+			__m128i c = _mm_loadu_si128((const __m128i*)(comp + r + 2));
+			int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(a, c)));
+			if (mask)
+				return r + stbiw__ctz((unsigned int)mask);
+		}
+	}
+#elif defined(STBIW_NEON)
+	if (stbi_write_hdr_max_simd >= 1) {
+		for (; r + 18 <= width; r += 16) {
+			uint8x16_t a = vld1q_u8(comp + r), b = vld1q_u8(comp + r + 1), c = vld1q_u8(comp + r + 2);
+			unsigned long long mask = stbiw__neon_nibble_mask(vandq_u8(vceqq_u8(a, b), vceqq_u8(a, c)));
+			if (mask)
+				return r + stbiw__ctz64(mask) / 4;
+		}
+	}
+#endif
+	while (r + 2 < width) {
+		if (comp[r] == comp[r + 1] && comp[r] == comp[r + 2])
+			return r;
+		++r;
+	}
+	return width;
+}
 
-		rgbe[0] = (unsigned char)(linear[0] * normalize);
-		rgbe[1] = (unsigned char)(linear[1] * normalize);
-		rgbe[2] = (unsigned char)(linear[2] * normalize);
-		rgbe[3] = (unsigned char)(exponent + 128);
+// First r >= x where comp[r] differs from value, or width
+static int stbiw__find_hdr_run_end(const unsigned char* comp, int r, int width, unsigned char value)
+{
+#if defined(STBIW_SSE2)
+	if (stbi_write_hdr_max_simd >= 1) {
+		__m128i v = _mm_set1_epi8((char)value);
+		for (; r + 16 <= width; r += 16) {
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(comp + r)), v)) ^ 0xffff;
+			if (mask)
+				return r + stbiw__ctz((unsigned int)mask);
+		}
+	}
+#elif defined(STBIW_NEON)
+	if (stbi_write_hdr_max_simd >= 1) {
+		uint8x16_t v = vdupq_n_u8(value);
+		for (; r + 16 <= width; r += 16) {
+			unsigned long long mask = stbiw__neon_nibble_mask(vmvnq_u8(vceqq_u8(vld1q_u8(comp + r), v)));
+			if (mask)
+				return r + stbiw__ctz64(mask) / 4;
+		}
 	}
+#endif
+	while (r < width && comp[r] == value)
+		++r;
+	return r;
 }
 
 static void stbiw__write_run_data(stbi__write_context* s, int length, unsigned char databyte)
@@ -669,51 +1259,27 @@ static void stbiw__write_dump_data(stbi__write_context* s, int length, unsigned
 static void stbiw__write_hdr_scanline(stbi__write_context* s, int width, int ncomp, unsigned char* scratch, float* scanline)
 {
 	unsigned char scanlineheader[4] = { 2, 2, 0, 0 };
-	unsigned char rgbe[4];
-	float linear[3];
 	int x;
 
 	scanlineheader[2] = (width & 0xff00) >> 8;
 	scanlineheader[3] = (width & 0x00ff);
 
+	/* encode into scratch buffer */
+	stbiw__hdr_scanline_planes(scratch, width, ncomp, scanline);
+
 	/* skip RLE for images too small or large */
 	if (width < 8 || width >= 32768) {
 		for (x = 0; x < width; x++) {
-			switch (ncomp) {
-			case 4: /* fallthrough */
-			case 3: linear[2] = scanline[x * ncomp + 2];
-				linear[1] = scanline[x * ncomp + 1];
-				linear[0] = scanline[x * ncomp + 0];
-				break;
-			default:
-				linear[0] = linear[1] = linear[2] = scanline[x * ncomp + 0];
-				break;
-			}
-			stbiw__linear_to_rgbe(rgbe, linear);
+			unsigned char rgbe[4];
+			rgbe[0] = scratch[x + width * 0];
+			rgbe[1] = scratch[x + width * 1];
+			rgbe[2] = scratch[x + width * 2];
+			rgbe[3] = scratch[x + width * 3];
 			s->func(s->context, rgbe, 4);
 		}
 	}
 	else {
 		int c, r;
-		/* encode into scratch buffer */
-		for (x = 0; x < width; x++) {
-			switch (ncomp) {
-			case 4: /* fallthrough */
-			case 3: linear[2] = scanline[x * ncomp + 2];
-				linear[1] = scanline[x * ncomp + 1];
-				linear[0] = scanline[x * ncomp + 0];
-				break;
-			default:
-				linear[0] = linear[1] = linear[2] = scanline[x * ncomp + 0];
-				break;
-			}
-			stbiw__linear_to_rgbe(rgbe, linear);
-			scratch[x + width * 0] = rgbe[0];
-			scratch[x + width * 1] = rgbe[1];
-			scratch[x + width * 2] = rgbe[2];
-			scratch[x + width * 3] = rgbe[3];
-		}
-
 		s->func(s->context, scanlineheader, 4);
 
 		/* RLE each component separately */
@@ -723,14 +1289,7 @@ static void stbiw__write_hdr_scanline(stbi__write_context* s, int width, int nco
 			x = 0;
 			while (x < width) {
 				// find first run
-				r = x;
-				while (r + 2 < width) {
-					if (comp[r] == comp[r + 1] && comp[r] == comp[r + 2])
-						break;
-					++r;
-				}
-				if (r + 2 >= width)
-					r = width;
+				r = stbiw__find_hdr_run(comp, x, width);
 				// dump up to first run
 				while (x < r) {
 					int len = r - x;
@@ -739,10 +1298,9 @@ static void stbiw__write_hdr_scanline(stbi__write_context* s, int width, int nco
 					x += len;
 				}
 				// if there's a run, output it
-				if (r + 2 < width) { // same test as what we break out of in search loop, so only true if we break'd
-				   // find next byte after run
-					while (r < width && comp[r] == comp[x])
-						++r;
+				if (r < width) {
+					// find next byte after run
+					r = stbiw__find_hdr_run_end(comp, r, width, comp[x]);
 					// output run up to r
 					while (x < r) {
 						int len = r - x;
@@ -889,73 +1447,95 @@ static unsigned int stbiw__zhash(unsigned char* data)
 #define stbiw__zlib_huffb(n) ((n) <= 143 ? stbiw__zlib_huff1(n) : stbiw__zlib_huff2(n))
 
 #define stbiw__ZHASH   16384
+#define stbiw__ZWINDOW  32768
+
+// Hash chains live in two flat arrays, zlib style: head[h] is the newest position with hash h and
+// prev[pos % window] links each position to the previous one with the same hash. Positions are
+// offsets from the start of the dictionary. A link is only followed while it is inside the
+// window, and anything inside the window can't have been overwritten yet, so prev never needs
+// clearing. count[h] is how many of the newest entries of chain h a search may use: it drops
+// back to quality whenever it reaches 2*quality, exactly as the original per-bucket lists lost
+// their older half, so every search sees the same candidates and the output is unchanged.
+static void stbiw__zlib_insert(int* head, int* count, int* prev, unsigned char* base, int pos, int quality)
+{
+	int h = stbiw__zhash(base + pos) & (stbiw__ZHASH - 1);
+	if (count[h] == 2 * quality) count[h] = quality;
+	++count[h];
+	prev[pos & (stbiw__ZWINDOW - 1)] = head[h];
+	head[h] = pos;
+}
 
-#endif // STBIW_ZLIB_COMPRESS
+// Walks the usable entries of the chain for pos, newest first, and returns the length of the
+// longest match of at least min_len bytes (0 if there is none). Ties keep the nearest match.
+static int stbiw__zlib_find_match(int* head, int* count, int* prev, unsigned char* base, int pos, int limit, int min_len, int* match_pos)
+{
+	int h = stbiw__zhash(base + pos) & (stbiw__ZHASH - 1);
+	int p = head[h], max_chain = count[h];
+	int best = 0, need = min_len - 1;
+	if (limit > 258) limit = 258;
+	if (need >= limit) return 0;
+	while (p >= 0 && pos - p < stbiw__ZWINDOW && max_chain-- > 0) {
+		// a candidate can only win if it also matches the byte just past the current best
+		if (base[p + need] == base[pos + need]) {
+			int d = stbiw__zlib_countm(base + p, base + pos, limit);
+			if (d > need) {
+				best = d;
+				need = d;
+				*match_pos = p;
+				if (d >= limit) break;
+			}
+		}
+		p = prev[p & (stbiw__ZWINDOW - 1)];
+	}
+	return best;
+}
 
-STBIWDEF unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality)
+// Emits one fixed-huffman deflate block for data[0..data_len). The dict_len bytes preceding
+// data may be referenced by matches, which lets independently compressed chunks of one
+// buffer keep (nearly) the same ratio as a single pass.
+static unsigned char* stbiw__zlib_compress_block(unsigned char* out, unsigned int* bitbuf_io, int* bitcount_io, unsigned char* data, int dict_len, int data_len, int quality, int final)
 {
-#ifdef STBIW_ZLIB_COMPRESS
-	// user provided a zlib compress implementation, use that
-	return STBIW_ZLIB_COMPRESS(data, data_len, out_len, quality);
-#else // use builtin
 	static unsigned short lengthc[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
 	static unsigned char  lengtheb[] = { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
 	static unsigned short distc[] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
 	static unsigned char  disteb[] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
-	unsigned int bitbuf = 0;
-	int i, j, bitcount = 0;
-	unsigned char* out = NULL;
-	unsigned char*** hash_table = (unsigned char***)STBIW_MALLOC(stbiw__ZHASH * sizeof(unsigned char**));
-	if (hash_table == NULL)
+	unsigned int bitbuf = *bitbuf_io;
+	int i, j, bitcount = *bitcount_io;
+	unsigned char* base;
+	int *count, *prev;
+	int* head = (int*)STBIW_MALLOC((2 * stbiw__ZHASH + stbiw__ZWINDOW) * sizeof(int));
+	if (head == NULL)
 		return NULL;
+	count = head + stbiw__ZHASH;
+	prev = count + stbiw__ZHASH;
 	if (quality < 5) quality = 5;
 
-	stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
-	stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
-	stbiw__zlib_add(1, 1);  // BFINAL = 1
+	stbiw__zlib_add(final ? 1 : 0, 1);  // BFINAL
 	stbiw__zlib_add(1, 2);  // BTYPE = 1 -- fixed huffman
 
-	for (i = 0; i < stbiw__ZHASH; ++i)
-		hash_table[i] = NULL;
+	for (i = 0; i < stbiw__ZHASH; ++i) {
+		head[i] = -1;
+		count[i] = 0;
+	}
+
+	// prime the hash chains with the tail of the dictionary
+	if (dict_len > 32768) dict_len = 32768;
+	base = data - dict_len;
+	for (i = -dict_len; i < 0 && i + 3 <= data_len; ++i)
+		stbiw__zlib_insert(head, count, prev, base, dict_len + i, quality);
 
 	i = 0;
 	while (i < data_len - 3) {
-		// hash next 3 bytes of data to be compressed
-		int h = stbiw__zhash(data + i) & (stbiw__ZHASH - 1), best = 3;
-		unsigned char* bestloc = 0;
-		unsigned char** hlist = hash_table[h];
-		int n = stbiw__sbcount(hlist);
-		for (j = 0; j < n; ++j) {
-			if (hlist[j] - data > i - 32768) { // if entry lies within window
-				int d = stbiw__zlib_countm(hlist[j], data + i, data_len - i);
-				if (d >= best) { best = d; bestloc = hlist[j]; }
-			}
-		}
-		// when hash table entry is too long, delete half the entries
-		if (hash_table[h] && stbiw__sbn(hash_table[h]) == 2 * quality) {
-			STBIW_MEMMOVE(hash_table[h], hash_table[h] + quality, sizeof(hash_table[h][0]) * quality);
-			stbiw__sbn(hash_table[h]) = quality;
-		}
-		stbiw__sbpush(hash_table[h], data + i);
-
-		if (bestloc) {
-			// "lazy matching" - check match at *next* byte, and if it's better, do cur byte as literal
-			h = stbiw__zhash(data + i + 1) & (stbiw__ZHASH - 1);
-			hlist = hash_table[h];
-			n = stbiw__sbcount(hlist);
-			for (j = 0; j < n; ++j) {
-				if (hlist[j] - data > i - 32767) {
-					int e = stbiw__zlib_countm(hlist[j], data + i + 1, data_len - i - 1);
-					if (e > best) { // if next match is better, bail on current match
-						bestloc = NULL;
-						break;
-					}
-				}
-			}
-		}
+		int pos = dict_len + i, match = 0, next_match;
+		int best = stbiw__zlib_find_match(head, count, prev, base, pos, data_len - i, 3, &match);
+		stbiw__zlib_insert(head, count, prev, base, pos, quality);
 
-		if (bestloc) {
-			int d = (int)(data + i - bestloc); // distance back
+		// "lazy matching" - check match at *next* byte, and if it's better, do cur byte as literal
+		if (best && stbiw__zlib_find_match(head, count, prev, base, pos + 1, data_len - i - 1, best + 1, &next_match))
+			best = 0;
+
+		if (best) {
+			int d = pos - match; // distance back
 			STBIW_ASSERT(d <= 32767 && best <= 258);
 			for (j = 0; best > lengthc[j + 1] - 1; ++j);
 			stbiw__zlib_huff(j + 257);
@@ -974,46 +1554,194 @@ STBIWDEF unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, in
 	for (; i < data_len; ++i)
 		stbiw__zlib_huffb(data[i]);
 	stbiw__zlib_huff(256); // end of block
-	// pad with 0 bits to byte boundary
-	while (bitcount)
-		stbiw__zlib_add(0, 1);
 
-	for (i = 0; i < stbiw__ZHASH; ++i)
-		(void)stbiw__sbfree(hash_table[i]);
-	STBIW_FREE(hash_table);
+	STBIW_FREE(head);
 
-	{
-		// compute adler32 on input
-		unsigned int s1 = 1, s2 = 0;
-		int blocklen = (int)(data_len % 5552);
-		j = 0;
-		while (j < data_len) {
-			for (i = 0; i < blocklen; ++i) { s1 += data[j + i]; s2 += s1; }
-			s1 %= 65521; s2 %= 65521;
-			j += blocklen;
-			blocklen = 5552;
-		}
-		stbiw__sbpush(out, STBIW_UCHAR(s2 >> 8));
-		stbiw__sbpush(out, STBIW_UCHAR(s2));
-		stbiw__sbpush(out, STBIW_UCHAR(s1 >> 8));
-		stbiw__sbpush(out, STBIW_UCHAR(s1));
-	}
-	*out_len = stbiw__sbn(out);
-	// make returned pointer freeable
-	STBIW_MEMMOVE(stbiw__sbraw(out), out, *out_len);
-	return (unsigned char*)stbiw__sbraw(out);
-#endif // STBIW_ZLIB_COMPRESS
+	*bitbuf_io = bitbuf;
+	*bitcount_io = bitcount;
+	return out;
 }
 
-static unsigned int stbiw__crc32(unsigned char* buffer, int len)
+static unsigned int stbiw__adler32(unsigned char* data, int data_len)
 {
-#ifdef STBIW_CRC32
-	return STBIW_CRC32(buffer, len);
+#ifdef STBIW_ADLER32
+	return STBIW_ADLER32(data, data_len);
 #else
-	static unsigned int crc_table[256] =
-	{
-	   0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
-	   0x0eDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+	unsigned int s1 = 1, s2 = 0;
+	int i, j = 0;
+	int blocklen = (int)(data_len % 5552);
+	while (j < data_len) {
+		for (i = 0; i < blocklen; ++i) { s1 += data[j + i]; s2 += s1; }
+		s1 %= 65521; s2 %= 65521;
+		j += blocklen;
+		blocklen = 5552;
+	}
+	return (s2 << 16) | s1;
+#endif
+}
+
+// adler32 of A followed by B, given the adler32 of each and the length of B (same math as zlib's adler32_combine)
+static unsigned int stbiw__adler32_combine(unsigned int adler1, unsigned int adler2, unsigned int len2)
+{
+	unsigned int rem = len2 % 65521;
+	unsigned int sum1 = adler1 & 0xffff;
+	unsigned int sum2 = (rem * sum1) % 65521;
+	sum1 += (adler2 & 0xffff) + 65521 - 1;
+	sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + 65521 - rem;
+	if (sum1 >= 65521) sum1 -= 65521;
+	if (sum1 >= 65521) sum1 -= 65521;
+	if (sum2 >= (65521u << 1)) sum2 -= (65521u << 1);
+	if (sum2 >= 65521) sum2 -= 65521;
+	return sum1 | (sum2 << 16);
+}
+#endif // STBIW_ZLIB_COMPRESS
+
+STBIWDEF unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality)
+{
+#ifdef STBIW_ZLIB_COMPRESS
+	// user provided a zlib compress implementation, use that
+	return STBIW_ZLIB_COMPRESS(data, data_len, out_len, quality);
+#else // use builtin
+	unsigned int bitbuf = 0, adler;
+	int bitcount = 0;
+	unsigned char* out = NULL;
+
+	stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
+	stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
+
+	{
+		unsigned char* block_out = stbiw__zlib_compress_block(out, &bitbuf, &bitcount, data, 0, data_len, quality, 1);
+		if (block_out == NULL) {
+			(void)stbiw__sbfree(out);
+			return NULL;
+		}
+		out = block_out;
+	}
+	// pad with 0 bits to byte boundary
+	while (bitcount)
+		stbiw__zlib_add(0, 1);
+
+	adler = stbiw__adler32(data, data_len);
+	stbiw__sbpush(out, STBIW_UCHAR(adler >> 24));
+	stbiw__sbpush(out, STBIW_UCHAR(adler >> 16));
+	stbiw__sbpush(out, STBIW_UCHAR(adler >> 8));
+	stbiw__sbpush(out, STBIW_UCHAR(adler));
+	*out_len = stbiw__sbn(out);
+	// make returned pointer freeable
+	STBIW_MEMMOVE(stbiw__sbraw(out), out, *out_len);
+	return (unsigned char*)stbiw__sbraw(out);
+#endif // STBIW_ZLIB_COMPRESS
+}
+
+#if defined(STBIW_PARALLEL_FOR) && !defined(STBIW_ZLIB_COMPRESS)
+// pigz-style parallel deflate: the input is cut into chunks that are compressed independently
+// (each may still match into the previous 32K), every chunk but the last ends with a full flush
+// so the pieces concatenate into one valid stream, and the per-chunk adler32s are combined.
+#define stbiw__ZCHUNK  (256 * 1024)
+
+typedef struct
+{
+	unsigned char* data;
+	int data_len;
+	int quality;
+	unsigned char** chunk_out;
+	int* chunk_out_len;
+	unsigned int* chunk_adler;
+} stbiw__zchunk_job;
+
+static void stbiw__zlib_compress_chunk(void* context, int index)
+{
+	stbiw__zchunk_job* job = (stbiw__zchunk_job*)context;
+	int start = index * stbiw__ZCHUNK;
+	int len = job->data_len - start < stbiw__ZCHUNK ? job->data_len - start : stbiw__ZCHUNK;
+	int final = start + len == job->data_len;
+	unsigned int bitbuf = 0;
+	int bitcount = 0;
+	unsigned char* out = NULL;
+
+	out = stbiw__zlib_compress_block(out, &bitbuf, &bitcount, job->data + start, start, len, job->quality, final);
+	if (out) {
+		if (!final) {
+			// full flush: empty stored block, byte aligned, so the next chunk starts on a byte boundary
+			stbiw__zlib_add(0, 1);
+			stbiw__zlib_add(0, 2);
+			while (bitcount)
+				stbiw__zlib_add(0, 1);
+			stbiw__sbpush(out, 0x00);
+			stbiw__sbpush(out, 0x00);
+			stbiw__sbpush(out, 0xff);
+			stbiw__sbpush(out, 0xff);
+		}
+		else {
+			while (bitcount)
+				stbiw__zlib_add(0, 1);
+		}
+		job->chunk_out_len[index] = stbiw__sbn(out);
+	}
+	job->chunk_out[index] = out;
+	job->chunk_adler[index] = stbiw__adler32(job->data + start, len);
+}
+
+static unsigned char* stbiw__zlib_compress_parallel(unsigned char* data, int data_len, int* out_len, int quality)
+{
+	int i, total, nchunks = data_len > 0 ? (data_len + stbiw__ZCHUNK - 1) / stbiw__ZCHUNK : 1;
+	unsigned int adler = 1;
+	unsigned char* out, * o;
+	stbiw__zchunk_job job;
+
+	if (nchunks == 1)
+		return stbi_zlib_compress(data, data_len, out_len, quality);
+
+	job.data = data;
+	job.data_len = data_len;
+	job.quality = quality;
+	job.chunk_out = (unsigned char**)STBIW_MALLOC(nchunks * (sizeof(unsigned char*) + sizeof(int) + sizeof(unsigned int)));
+	if (!job.chunk_out) return NULL;
+	job.chunk_out_len = (int*)(job.chunk_out + nchunks);
+	job.chunk_adler = (unsigned int*)(job.chunk_out_len + nchunks);
+
+	STBIW_PARALLEL_FOR(nchunks, stbiw__zlib_compress_chunk, &job);
+
+	total = 2 + 4;
+	for (i = 0; i < nchunks; ++i) {
+		if (!job.chunk_out[i]) total = -1;
+		if (total >= 0) total += job.chunk_out_len[i];
+	}
+
+	out = total >= 0 ? (unsigned char*)STBIW_MALLOC(total) : NULL;
+	if (out) {
+		o = out;
+		*o++ = 0x78;   // DEFLATE 32K window
+		*o++ = 0x5e;   // FLEVEL = 1
+		for (i = 0; i < nchunks; ++i) {
+			int len = data_len - i * stbiw__ZCHUNK < stbiw__ZCHUNK ? data_len - i * stbiw__ZCHUNK : stbiw__ZCHUNK;
+			STBIW_MEMMOVE(o, job.chunk_out[i], job.chunk_out_len[i]);
+			o += job.chunk_out_len[i];
+			adler = stbiw__adler32_combine(adler, job.chunk_adler[i], len);
+		}
+		*o++ = STBIW_UCHAR(adler >> 24);
+		*o++ = STBIW_UCHAR(adler >> 16);
+		*o++ = STBIW_UCHAR(adler >> 8);
+		*o++ = STBIW_UCHAR(adler);
+		*out_len = total;
+	}
+
+	for (i = 0; i < nchunks; ++i)
+		(void)stbiw__sbfree(job.chunk_out[i]);
+	STBIW_FREE(job.chunk_out);
+	return out;
+}
+#endif // STBIW_PARALLEL_FOR
+
+static unsigned int stbiw__crc32(unsigned char* buffer, int len)
+{
+#ifdef STBIW_CRC32
+	return STBIW_CRC32(buffer, len);
+#else
+	static unsigned int crc_table[256] =
+	{
+	   0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+	   0x0eDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
 	   0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
 	   0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
 	   0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
@@ -1072,6 +1800,198 @@ static unsigned char stbiw__paeth(int a, int b, int c)
 	return STBIW_UCHAR(c);
 }
 
+// PNG row filter kernels. Each one filters len bytes of row z against the previous row up
+// (n bytes per pixel) into out, and returns the sum of the output taken as signed bytes, which
+// is the heuristic used to pick a filter per row. Type is 0..4 (none, sub, up, avg, paeth).
+typedef int stbiw__png_filter_kernel(int type, const unsigned char* z, const unsigned char* up, int len, int n, signed char* out);
+
+static int stbiw__png_filter_tail(int type, const unsigned char* z, const unsigned char* up, int i, int len, int n, signed char* out)
+{
+	int est = 0;
+	for (; i < len; ++i) {
+		int a = i >= n ? z[i - n] : 0, b = up[i], c = i >= n ? up[i - n] : 0;
+		switch (type) {
+		case 0: out[i] = (signed char)z[i]; break;
+		case 1: out[i] = (signed char)(z[i] - a); break;
+		case 2: out[i] = (signed char)(z[i] - b); break;
+		case 3: out[i] = (signed char)(z[i] - ((a + b) >> 1)); break;
+		case 4: out[i] = (signed char)(z[i] - stbiw__paeth(a, b, c)); break;
+		}
+		est += abs(out[i]);
+	}
+	return est;
+}
+
+static int stbiw__png_filter_scalar(int type, const unsigned char* z, const unsigned char* up, int len, int n, signed char* out)
+{
+	return stbiw__png_filter_tail(type, z, up, 0, len, n, out);
+}
+
+#ifdef STBIW_SSE2
+static __m128i stbiw__paeth_sse2(__m128i a, __m128i b, __m128i c)
+{
+	// 16-bit lanes: p-a = b-c, p-b = a-c, p-c = a+b-2c
+	__m128i zero = _mm_setzero_si128();
+	__m128i da = _mm_sub_epi16(b, c), db = _mm_sub_epi16(a, c), dc = _mm_add_epi16(da, db);
+	__m128i pa = _mm_max_epi16(da, _mm_sub_epi16(zero, da));
+	__m128i pb = _mm_max_epi16(db, _mm_sub_epi16(zero, db));
+	__m128i pc = _mm_max_epi16(dc, _mm_sub_epi16(zero, dc));
+	__m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i not_b = _mm_cmpgt_epi16(pb, pc);
+	__m128i bc = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+	return _mm_or_si128(_mm_and_si128(not_a, bc), _mm_andnot_si128(not_a, a));
+}
+
+static int stbiw__png_filter_sse2(int type, const unsigned char* z, const unsigned char* up, int len, int n, signed char* out)
+{
+	__m128i zero = _mm_setzero_si128(), sad = _mm_setzero_si128();
+	int i, est = stbiw__png_filter_tail(type, z, up, 0, n < len ? n : len, n, out);
+	for (i = n; i + 16 <= len; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(z + i)), r, neg;
+		__m128i a = _mm_loadu_si128((const __m128i*)(z + i - n));
+		__m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+		switch (type) {
+		case 0: r = x; break;
+		case 1: r = _mm_sub_epi8(x, a); break;
+		case 2: r = _mm_sub_epi8(x, b); break;
+		case 3: // floor((a+b)/2) from the rounding-up average
+			r = _mm_sub_epi8(x, _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1))));
+			break;
+		default: {
+			__m128i c = _mm_loadu_si128((const __m128i*)(up + i - n));
+			__m128i lo = stbiw__paeth_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+			__m128i hi = stbiw__paeth_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+			r = _mm_sub_epi8(x, _mm_packus_epi16(lo, hi));
+		} break;
+		}
+		_mm_storeu_si128((__m128i*)(out + i), r);
+		// |r| as unsigned bytes (-128 becomes 128), then horizontal sums
+		neg = _mm_cmpgt_epi8(zero, r);
+		sad = _mm_add_epi64(sad, _mm_sad_epu8(_mm_sub_epi8(_mm_xor_si128(r, neg), neg), zero));
+	}
+	est += _mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sad, sad));
+	return est + stbiw__png_filter_tail(type, z, up, i > n ? i : (n < len ? n : len), len, n, out);
+}
+#endif // STBIW_SSE2
+
+#ifdef STBIW_AVX2
+static int stbiw__avx2_available(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return 0;
+	__cpuid(info, 1);
+	// OSXSAVE, and the OS saves YMM state
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+STBIW__AVX2_TARGET static __m256i stbiw__paeth_avx2(__m256i a, __m256i b, __m256i c)
+{
+	__m256i da = _mm256_sub_epi16(b, c), db = _mm256_sub_epi16(a, c), dc = _mm256_add_epi16(da, db);
+	__m256i pa = _mm256_abs_epi16(da), pb = _mm256_abs_epi16(db), pc = _mm256_abs_epi16(dc);
+	__m256i not_a = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+	__m256i not_b = _mm256_cmpgt_epi16(pb, pc);
+	return _mm256_blendv_epi8(a, _mm256_blendv_epi8(b, c, not_b), not_a);
+}
+
+STBIW__AVX2_TARGET static int stbiw__png_filter_avx2(int type, const unsigned char* z, const unsigned char* up, int len, int n, signed char* out)
+{
+	__m256i zero = _mm256_setzero_si256(), sad = _mm256_setzero_si256();
+	int i, est = stbiw__png_filter_tail(type, z, up, 0, n < len ? n : len, n, out);
+	for (i = n; i + 32 <= len; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(z + i)), r;
+		__m256i a = _mm256_loadu_si256((const __m256i*)(z + i - n));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(up + i));
+		switch (type) {
+		case 0: r = x; break;
+		case 1: r = _mm256_sub_epi8(x, a); break;
+		case 2: r = _mm256_sub_epi8(x, b); break;
+		case 3:
+			r = _mm256_sub_epi8(x, _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1))));
+			break;
+		default: {
+			const unsigned char* pc = up + i - n;
+			__m256i lo = stbiw__paeth_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(z + i - n))),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(up + i))), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)pc)));
+			__m256i hi = stbiw__paeth_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(z + i - n + 16))),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(up + i + 16))), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pc + 16))));
+			// packus works per 128-bit lane, so put the quadwords back in order
+			r = _mm256_sub_epi8(x, _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+		} break;
+		}
+		_mm256_storeu_si256((__m256i*)(out + i), r);
+		sad = _mm256_add_epi64(sad, _mm256_sad_epu8(_mm256_abs_epi8(r), zero));
+	}
+	{
+		__m128i s128 = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+		est += _mm_cvtsi128_si32(s128) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s128, s128));
+	}
+	return est + stbiw__png_filter_tail(type, z, up, i > n ? i : (n < len ? n : len), len, n, out);
+}
+#endif // STBIW_AVX2
+
+#ifdef STBIW_NEON
+static uint8x16_t stbiw__paeth_neon(uint8x16_t a, uint8x16_t b, uint8x16_t c)
+{
+	uint8x16_t pa8 = vabdq_u8(b, c), pb8 = vabdq_u8(a, c);
+	uint16x8_t pa_lo = vmovl_u8(vget_low_u8(pa8)), pa_hi = vmovl_u8(vget_high_u8(pa8));
+	uint16x8_t pb_lo = vmovl_u8(vget_low_u8(pb8)), pb_hi = vmovl_u8(vget_high_u8(pb8));
+	// |a+b-2c| needs 9 bits
+	uint16x8_t pc_lo = vabdq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)), vshll_n_u8(vget_low_u8(c), 1));
+	uint16x8_t pc_hi = vabdq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)), vshll_n_u8(vget_high_u8(c), 1));
+	uint8x16_t not_a = vcombine_u8(vmovn_u16(vorrq_u16(vcgtq_u16(pa_lo, pb_lo), vcgtq_u16(pa_lo, pc_lo))),
+		vmovn_u16(vorrq_u16(vcgtq_u16(pa_hi, pb_hi), vcgtq_u16(pa_hi, pc_hi))));
+	uint8x16_t not_b = vcombine_u8(vmovn_u16(vcgtq_u16(pb_lo, pc_lo)), vmovn_u16(vcgtq_u16(pb_hi, pc_hi)));
+	return vbslq_u8(not_a, vbslq_u8(not_b, c, b), a);
+}
+
+static int stbiw__png_filter_neon(int type, const unsigned char* z, const unsigned char* up, int len, int n, signed char* out)
+{
+	uint32x4_t sad = vdupq_n_u32(0);
+	int i, est = stbiw__png_filter_tail(type, z, up, 0, n < len ? n : len, n, out);
+	for (i = n; i + 16 <= len; i += 16) {
+		uint8x16_t x = vld1q_u8(z + i), r;
+		uint8x16_t a = vld1q_u8(z + i - n);
+		uint8x16_t b = vld1q_u8(up + i);
+		switch (type) {
+		case 0: r = x; break;
+		case 1: r = vsubq_u8(x, a); break;
+		case 2: r = vsubq_u8(x, b); break;
+		case 3: r = vsubq_u8(x, vhaddq_u8(a, b)); break;
+		default: r = vsubq_u8(x, stbiw__paeth_neon(a, b, vld1q_u8(up + i - n))); break;
+		}
+		vst1q_s8(out + i, vreinterpretq_s8_u8(r));
+		// non-saturating abs maps -128 to 0x80, which reads back as 128 unsigned
+		sad = vpadalq_u16(sad, vpaddlq_u8(vreinterpretq_u8_s8(vabsq_s8(vreinterpretq_s8_u8(r)))));
+	}
+	est += (int)(vgetq_lane_u32(sad, 0) + vgetq_lane_u32(sad, 1) + vgetq_lane_u32(sad, 2) + vgetq_lane_u32(sad, 3));
+	return est + stbiw__png_filter_tail(type, z, up, i > n ? i : (n < len ? n : len), len, n, out);
+}
+#endif // STBIW_NEON
+
+static stbiw__png_filter_kernel* stbiw__select_png_filter_kernel(void)
+{
+#ifdef STBIW_AVX2
+	if (stbi_write_png_max_simd >= 2 && stbiw__avx2_available())
+		return stbiw__png_filter_avx2;
+#endif
+#ifdef STBIW_SSE2
+	if (stbi_write_png_max_simd >= 1)
+		return stbiw__png_filter_sse2;
+#endif
+#ifdef STBIW_NEON
+	if (stbi_write_png_max_simd >= 1)
+		return stbiw__png_filter_neon;
+#endif
+	return stbiw__png_filter_scalar;
+}
+
 // @OPTIMIZE: provide an option that always forces left-predict or paeth predict
 static void stbiw__encode_png_line(unsigned char* pixels, int stride_bytes, int width, int height, int y, int n, int filter_type, signed char* line_buffer)
 {
@@ -1109,14 +2029,97 @@ static void stbiw__encode_png_line(unsigned char* pixels, int stride_bytes, int
 	}
 }
 
+// Filters one row of pixels z into filt_row: the filter type byte followed by x*n filtered bytes.
+// up is the row above, or NULL for the first row of the image.
+static void stbiw__png_filter_row(stbiw__png_filter_kernel* kernel, const unsigned char* z, const unsigned char* up, int x, int n, int force_filter, signed char* line_buffer, unsigned char* filt_row)
+{
+	int filter_type;
+	if (force_filter > -1) {
+		filter_type = force_filter;
+		if (up == NULL)
+			stbiw__encode_png_line((unsigned char*)z, 0, x, 1, 0, n, force_filter, line_buffer);
+		else
+			kernel(force_filter, z, up, x * n, n, line_buffer);
+	}
+	else { // Estimate the best filter by running through all of them:
+		int best_filter = 0, best_filter_val = 0x7fffffff, est, i;
+		for (filter_type = 0; filter_type < 5; filter_type++) {
+			// the first row has no row above, which the per-row encoder maps to other filter types
+			if (up == NULL) {
+				stbiw__encode_png_line((unsigned char*)z, 0, x, 1, 0, n, filter_type, line_buffer);
+
+				// Estimate the entropy of the line using this filter; the less, the better.
+				est = 0;
+				for (i = 0; i < x * n; ++i) {
+					est += abs((signed char)line_buffer[i]);
+				}
+			}
+			else {
+				est = kernel(filter_type, z, up, x * n, n, line_buffer);
+			}
+			if (est < best_filter_val) {
+				best_filter_val = est;
+				best_filter = filter_type;
+			}
+		}
+		if (filter_type != best_filter) {  // If the last iteration already got us the best filter, don't redo it
+			if (up == NULL)
+				stbiw__encode_png_line((unsigned char*)z, 0, x, 1, 0, n, best_filter, line_buffer);
+			else
+				kernel(best_filter, z, up, x * n, n, line_buffer);
+			filter_type = best_filter;
+		}
+	}
+	// when we get here, filter_type contains the filter type, and line_buffer contains the data
+	filt_row[0] = (unsigned char)filter_type;
+	STBIW_MEMMOVE(filt_row + 1, line_buffer, x * n);
+}
+
+// Filters rows [row_begin, row_end) into filt, which holds (x*n+1) bytes per row for the whole image
+static int stbiw__png_filter_rows(const unsigned char* pixels, int stride_bytes, int x, int y, int n, int force_filter, int row_begin, int row_end, unsigned char* filt)
+{
+	stbiw__png_filter_kernel* kernel = stbiw__select_png_filter_kernel();
+	signed char* line_buffer;
+	int j;
+
+	line_buffer = (signed char*)STBIW_MALLOC(x * n); if (!line_buffer) return 0;
+	for (j = row_begin; j < row_end; ++j) {
+		const unsigned char* z = pixels + stride_bytes * (stbi__flip_vertically_on_write ? y - 1 - j : j);
+		const unsigned char* up = j == 0 ? NULL : z - (stbi__flip_vertically_on_write ? -stride_bytes : stride_bytes);
+		stbiw__png_filter_row(kernel, z, up, x, n, force_filter, line_buffer, filt + j * (x * n + 1));
+	}
+	STBIW_FREE(line_buffer);
+	return 1;
+}
+
+#ifdef STBIW_PARALLEL_FOR
+#define stbiw__PNG_BAND_ROWS  32
+
+typedef struct
+{
+	const unsigned char* pixels;
+	int stride_bytes, x, y, n, force_filter;
+	unsigned char* filt;
+	int failed;
+} stbiw__png_filter_job;
+
+static void stbiw__png_filter_band(void* context, int index)
+{
+	stbiw__png_filter_job* job = (stbiw__png_filter_job*)context;
+	int row_begin = index * stbiw__PNG_BAND_ROWS;
+	int row_end = row_begin + stbiw__PNG_BAND_ROWS < job->y ? row_begin + stbiw__PNG_BAND_ROWS : job->y;
+	if (!stbiw__png_filter_rows(job->pixels, job->stride_bytes, job->x, job->y, job->n, job->force_filter, row_begin, row_end, job->filt))
+		job->failed = 1;
+}
+#endif // STBIW_PARALLEL_FOR
+
 STBIWDEF unsigned char* stbi_write_png_to_mem(const unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len)
 {
 	int force_filter = stbi_write_force_png_filter;
 	int ctype[5] = { -1, 0, 4, 2, 6 };
 	unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
 	unsigned char* out, * o, * filt, * zlib;
-	signed char* line_buffer;
-	int j, zlen;
+	int zlen;
 
 	if (stride_bytes == 0)
 		stride_bytes = x * n;
@@ -1126,39 +2129,28 @@ STBIWDEF unsigned char* stbi_write_png_to_mem(const unsigned char* pixels, int s
 	}
 
 	filt = (unsigned char*)STBIW_MALLOC((x * n + 1) * y); if (!filt) return 0;
-	line_buffer = (signed char*)STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
-	for (j = 0; j < y; ++j) {
-		int filter_type;
-		if (force_filter > -1) {
-			filter_type = force_filter;
-			stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, force_filter, line_buffer);
-		}
-		else { // Estimate the best filter by running through all of them:
-			int best_filter = 0, best_filter_val = 0x7fffffff, est, i;
-			for (filter_type = 0; filter_type < 5; filter_type++) {
-				stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, filter_type, line_buffer);
-
-				// Estimate the entropy of the line using this filter; the less, the better.
-				est = 0;
-				for (i = 0; i < x * n; ++i) {
-					est += abs((signed char)line_buffer[i]);
-				}
-				if (est < best_filter_val) {
-					best_filter_val = est;
-					best_filter = filter_type;
-				}
-			}
-			if (filter_type != best_filter) {  // If the last iteration already got us the best filter, don't redo it
-				stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, best_filter, line_buffer);
-				filter_type = best_filter;
-			}
-		}
-		// when we get here, filter_type contains the filter type, and line_buffer contains the data
-		filt[j * (x * n + 1)] = (unsigned char)filter_type;
-		STBIW_MEMMOVE(filt + j * (x * n + 1) + 1, line_buffer, x * n);
+#ifdef STBIW_PARALLEL_FOR
+	{
+		stbiw__png_filter_job job;
+		job.pixels = pixels;
+		job.stride_bytes = stride_bytes;
+		job.x = x;
+		job.y = y;
+		job.n = n;
+		job.force_filter = force_filter;
+		job.filt = filt;
+		job.failed = 0;
+		STBIW_PARALLEL_FOR((y + stbiw__PNG_BAND_ROWS - 1) / stbiw__PNG_BAND_ROWS, stbiw__png_filter_band, &job);
+		if (job.failed) { STBIW_FREE(filt); return 0; }
 	}
-	STBIW_FREE(line_buffer);
+#else
+	if (!stbiw__png_filter_rows(pixels, stride_bytes, x, y, n, force_filter, 0, y, filt)) { STBIW_FREE(filt); return 0; }
+#endif
+#if defined(STBIW_PARALLEL_FOR) && !defined(STBIW_ZLIB_COMPRESS)
+	zlib = stbiw__zlib_compress_parallel(filt, y * (x * n + 1), &zlen, stbi_write_png_compression_level);
+#else
 	zlib = stbi_zlib_compress(filt, y * (x * n + 1), &zlen, stbi_write_png_compression_level);
+#endif
 	STBIW_FREE(filt);
 	if (!zlib) return 0;
 
@@ -1223,6 +2215,204 @@ STBIWDEF int stbi_write_png_to_func(stbi_write_func* func, void* context, int x,
 	return 1;
 }
 
+#ifndef STBIW_ZLIB_COMPRESS
+// Filtered rows collect behind the last 32K of already compressed data (the match dictionary)
+// until there are this many bytes, then go out as one deflate block in one IDAT chunk.
+#define stbiw__PNG_STREAM_BLOCK  (256 * 1024)
+
+struct stbi_png_stream
+{
+	stbi_write_func* func;
+	void* context;
+	int x, y, n, force_filter, quality;
+	int rows_done;
+	stbiw__png_filter_kernel* kernel;
+	unsigned char* prev_row;     // the last row supplied, for the filters that look up
+	signed char* line_buffer;
+	unsigned char* window;       // dict_len bytes of dictionary, then pending_len bytes to compress
+	int dict_len, pending_len;
+	unsigned char* out;          // stretchy buffer the next IDAT chunk is built in, starting with its length and tag
+	unsigned int bitbuf, adler;
+	int bitcount;
+	int failed;
+};
+
+// Writes the chunk in stream->out if it has any data, and resets out for the next one
+static void stbiw__png_stream_emit_idat(stbi_png_stream* stream)
+{
+	unsigned char* o = stream->out;
+	int len = stbiw__sbn(stream->out) - 8;
+	unsigned int crc;
+	if (len <= 0)
+		return;
+	stbiw__wp32(o, len);
+	stbiw__wptag(o, "IDAT");
+	crc = stbiw__crc32(stream->out + 4, len + 4);
+	stbiw__sbpush(stream->out, STBIW_UCHAR(crc >> 24));
+	stbiw__sbpush(stream->out, STBIW_UCHAR(crc >> 16));
+	stbiw__sbpush(stream->out, STBIW_UCHAR(crc >> 8));
+	stbiw__sbpush(stream->out, STBIW_UCHAR(crc));
+	stream->func(stream->context, stream->out, stbiw__sbn(stream->out));
+	stbiw__sbn(stream->out) = 8;
+}
+
+// Compresses the pending data as one deflate block, writes it out and slides the window
+static int stbiw__png_stream_deflate(stbi_png_stream* stream, int final)
+{
+	unsigned char* data = stream->window + stream->dict_len;
+	unsigned char* out = stbiw__zlib_compress_block(stream->out, &stream->bitbuf, &stream->bitcount, data, stream->dict_len, stream->pending_len, stream->quality, final);
+	int keep;
+	if (out == NULL) {
+		stream->failed = 1;
+		return 0;
+	}
+	stream->adler = stbiw__adler32_combine(stream->adler, stbiw__adler32(data, stream->pending_len), stream->pending_len);
+
+	if (final) {
+		unsigned int bitbuf = stream->bitbuf;
+		int bitcount = stream->bitcount;
+		// pad with 0 bits to byte boundary
+		while (bitcount)
+			stbiw__zlib_add(0, 1);
+		stbiw__sbpush(out, STBIW_UCHAR(stream->adler >> 24));
+		stbiw__sbpush(out, STBIW_UCHAR(stream->adler >> 16));
+		stbiw__sbpush(out, STBIW_UCHAR(stream->adler >> 8));
+		stbiw__sbpush(out, STBIW_UCHAR(stream->adler));
+	}
+	stream->out = out;
+	stbiw__png_stream_emit_idat(stream);
+
+	keep = stream->dict_len + stream->pending_len < 32768 ? stream->dict_len + stream->pending_len : 32768;
+	STBIW_MEMMOVE(stream->window, data + stream->pending_len - keep, keep);
+	stream->dict_len = keep;
+	stream->pending_len = 0;
+	return 1;
+}
+
+STBIWDEF stbi_png_stream* stbi_write_png_stream_begin(stbi_write_func* func, void* context, int x, int y, int n)
+{
+	int ctype[5] = { -1, 0, 4, 2, 6 };
+	unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
+	unsigned char header[8 + 12 + 13], * o = header;
+	stbi_png_stream* stream;
+
+	if (x <= 0 || y <= 0 || n < 1 || n > 4)
+		return NULL;
+
+	stream = (stbi_png_stream*)STBIW_MALLOC(sizeof(stbi_png_stream));
+	if (!stream) return NULL;
+	memset(stream, 0, sizeof(*stream));
+	stream->func = func;
+	stream->context = context;
+	stream->x = x;
+	stream->y = y;
+	stream->n = n;
+	stream->force_filter = stbi_write_force_png_filter >= 5 ? -1 : stbi_write_force_png_filter;
+	stream->quality = stbi_write_png_compression_level;
+	stream->kernel = stbiw__select_png_filter_kernel();
+	stream->adler = 1;
+	stream->prev_row = (unsigned char*)STBIW_MALLOC(x * n);
+	stream->line_buffer = (signed char*)STBIW_MALLOC(x * n);
+	stream->window = (unsigned char*)STBIW_MALLOC(32768 + stbiw__PNG_STREAM_BLOCK + x * n + 1);
+	if (!stream->prev_row || !stream->line_buffer || !stream->window) {
+		stream->failed = 1;
+		stbi_write_png_stream_end(stream);
+		return NULL;
+	}
+
+	// room for the chunk length and tag, then the zlib header goes in the first IDAT
+	stbiw__sbgrow(stream->out, 8 + 2 + stbiw__PNG_STREAM_BLOCK / 2);
+	stbiw__sbn(stream->out) = 8;
+	stbiw__sbpush(stream->out, 0x78);   // DEFLATE 32K window
+	stbiw__sbpush(stream->out, 0x5e);   // FLEVEL = 1
+
+	STBIW_MEMMOVE(o, sig, 8); o += 8;
+	stbiw__wp32(o, 13); // header length
+	stbiw__wptag(o, "IHDR");
+	stbiw__wp32(o, x);
+	stbiw__wp32(o, y);
+	*o++ = 8;
+	*o++ = STBIW_UCHAR(ctype[n]);
+	*o++ = 0;
+	*o++ = 0;
+	*o++ = 0;
+	stbiw__wpcrc(&o, 13);
+	func(context, header, (int)(o - header));
+	return stream;
+}
+
+STBIWDEF int stbi_write_png_stream_rows(stbi_png_stream* stream, const void* rows, int num_rows, int stride_bytes)
+{
+	int row_bytes, j;
+	if (!stream || stream->failed)
+		return 0;
+	if (num_rows <= 0)
+		return 1;
+	if (num_rows > stream->y - stream->rows_done) {
+		stream->failed = 1;
+		return 0;
+	}
+
+	row_bytes = stream->x * stream->n;
+	if (stride_bytes == 0)
+		stride_bytes = row_bytes;
+
+	for (j = 0; j < num_rows; ++j) {
+		const unsigned char* z = (const unsigned char*)rows + (size_t)j * stride_bytes;
+		const unsigned char* up = j > 0 ? z - stride_bytes : stream->rows_done > 0 ? stream->prev_row : NULL;
+		if (stream->pending_len >= stbiw__PNG_STREAM_BLOCK && !stbiw__png_stream_deflate(stream, 0))
+			return 0;
+		stbiw__png_filter_row(stream->kernel, z, up, stream->x, stream->n, stream->force_filter, stream->line_buffer,
+			stream->window + stream->dict_len + stream->pending_len);
+		stream->pending_len += row_bytes + 1;
+		stream->rows_done++;
+	}
+	memcpy(stream->prev_row, (const unsigned char*)rows + (size_t)(num_rows - 1) * stride_bytes, row_bytes);
+	return 1;
+}
+
+STBIWDEF int stbi_write_png_stream_end(stbi_png_stream* stream)
+{
+	int ok;
+	if (!stream)
+		return 0;
+
+	ok = !stream->failed && stream->rows_done == stream->y && stbiw__png_stream_deflate(stream, 1);
+	if (ok) {
+		unsigned char iend[12], * o = iend;
+		stbiw__wp32(o, 0);
+		stbiw__wptag(o, "IEND");
+		stbiw__wpcrc(&o, 0);
+		stream->func(stream->context, iend, 12);
+	}
+
+	(void)stbiw__sbfree(stream->out);
+	STBIW_FREE(stream->window);
+	STBIW_FREE(stream->line_buffer);
+	STBIW_FREE(stream->prev_row);
+	STBIW_FREE(stream);
+	return ok;
+}
+#else
+STBIWDEF stbi_png_stream* stbi_write_png_stream_begin(stbi_write_func* func, void* context, int x, int y, int n)
+{
+	(void)func; (void)context; (void)x; (void)y; (void)n;
+	return NULL;
+}
+
+STBIWDEF int stbi_write_png_stream_rows(stbi_png_stream* stream, const void* rows, int num_rows, int stride_bytes)
+{
+	(void)stream; (void)rows; (void)num_rows; (void)stride_bytes;
+	return 0;
+}
+
+STBIWDEF int stbi_write_png_stream_end(stbi_png_stream* stream)
+{
+	(void)stream;
+	return 0;
+}
+#endif // STBIW_ZLIB_COMPRESS
+
 
 /* ***************************************************************************
  *
@@ -1235,21 +2425,74 @@ STBIWDEF int stbi_write_png_to_func(stbi_write_func* func, void* context, int x,
 static const unsigned char stbiw__jpg_ZigZag[] = { 0,1,5,6,14,15,27,28,2,4,7,13,16,26,29,42,3,8,12,17,25,30,41,43,9,11,18,
 	  24,31,40,44,53,10,19,23,32,39,45,52,54,20,22,33,38,46,51,55,60,21,34,37,47,50,56,59,61,35,36,48,49,57,58,62,63 };
 
-static void stbiw__jpg_writeBits(stbi__write_context* s, int* bitBufP, int* bitCntP, const unsigned short* bs) {
-	int bitBuf = *bitBufP, bitCnt = *bitCntP;
-	bitCnt += bs[1];
-	bitBuf |= bs[0] << (24 - bitCnt);
-	while (bitCnt >= 8) {
-		unsigned char c = (bitBuf >> 16) & 255;
-		stbiw__putc(s, c);
-		if (c == 255) {
-			stbiw__putc(s, 0);
-		}
-		bitBuf <<= 8;
-		bitCnt -= 8;
+// Entropy coded output: bits gather right-aligned in a 64-bit accumulator and go out 32 at a time,
+// byte stuffed, into a buffer that is handed to the write callback in large pieces
+typedef struct
+{
+	stbi__write_context* s;
+	unsigned long long acc;
+	int count;
+	int used;
+	unsigned char out[4096];
+} stbiw__jpg_bitwriter;
+
+static void stbiw__jpg_flush_out(stbiw__jpg_bitwriter* w)
+{
+	if (w->used) {
+		w->s->func(w->s->context, w->out, w->used);
+		w->used = 0;
+	}
+}
+
+static void stbiw__jpg_emit_bytes(stbiw__jpg_bitwriter* w, unsigned int bytes, int n)
+{
+	int i;
+	// worst case every byte is 0xFF and gets a stuffed 0 after it
+	if (w->used + 8 > (int)sizeof(w->out))
+		stbiw__jpg_flush_out(w);
+	if (n == 4 && ((bytes & 0x80808080u) & ((bytes & 0x7f7f7f7fu) + 0x01010101u)) == 0) {
+		// no 0xFF byte among the four, so no stuffing
+		w->out[w->used + 0] = (unsigned char)(bytes >> 24);
+		w->out[w->used + 1] = (unsigned char)(bytes >> 16);
+		w->out[w->used + 2] = (unsigned char)(bytes >> 8);
+		w->out[w->used + 3] = (unsigned char)bytes;
+		w->used += 4;
+		return;
 	}
-	*bitBufP = bitBuf;
-	*bitCntP = bitCnt;
+	for (i = n - 1; i >= 0; --i) {
+		unsigned char c = (unsigned char)(bytes >> (i * 8));
+		w->out[w->used++] = c;
+		if (c == 255)
+			w->out[w->used++] = 0;
+	}
+}
+
+// n <= 32; callers combine a Huffman code with its extra bits, which is at most 27 bits
+static void stbiw__jpg_put_bits(stbiw__jpg_bitwriter* w, unsigned int bits, int n)
+{
+	w->acc = (w->acc << n) | bits;
+	w->count += n;
+	if (w->count >= 32) {
+		w->count -= 32;
+		stbiw__jpg_emit_bytes(w, (unsigned int)(w->acc >> w->count), 4);
+	}
+}
+
+static void stbiw__jpg_put_code(stbiw__jpg_bitwriter* w, const unsigned short* code)
+{
+	stbiw__jpg_put_bits(w, code[0], code[1]);
+}
+
+// Pads the last byte with 1 bits and writes out everything
+static void stbiw__jpg_finish_bits(stbiw__jpg_bitwriter* w)
+{
+	int pad = (8 - (w->count & 7)) & 7;
+	w->acc = (w->acc << pad) | ((1u << pad) - 1);
+	w->count += pad;
+	if (w->count)
+		stbiw__jpg_emit_bytes(w, (unsigned int)(w->acc & (0xffffffffu >> (32 - w->count))), w->count / 8);
+	w->count = 0;
+	stbiw__jpg_flush_out(w);
 }
 
 static void stbiw__jpg_DCT(float* d0p, float* d1p, float* d2p, float* d3p, float* d4p, float* d5p, float* d6p, float* d7p) {
@@ -1300,21 +2543,13 @@ static void stbiw__jpg_DCT(float* d0p, float* d1p, float* d2p, float* d3p, float
 	*d0p = d0;  *d2p = d2;  *d4p = d4;  *d6p = d6;
 }
 
-static void stbiw__jpg_calcBits(int val, unsigned short bits[2]) {
-	int tmp1 = val < 0 ? -val : val;
-	val = val < 0 ? val - 1 : val;
-	bits[1] = 1;
-	while (tmp1 >>= 1) {
-		++bits[1];
-	}
-	bits[0] = val & ((1 << bits[1]) - 1);
-}
+// Forward DCT, quantization and zigzag of one 8x8 block read from CDU with row stride du_stride.
+// Every kernel does the same float operations in the same order, so they all produce identical coefficients.
+typedef void stbiw__jpg_fdct_kernel(float* CDU, int du_stride, const float* fdtbl, int* DU);
 
-static int stbiw__jpg_processDU(stbi__write_context* s, int* bitBuf, int* bitCnt, float* CDU, int du_stride, float* fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
-	const unsigned short EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
-	const unsigned short M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
-	int dataOff, i, j, n, diff, end0pos, x, y;
-	int DU[64];
+static void stbiw__jpg_fdct_scalar(float* CDU, int du_stride, const float* fdtbl, int* DU)
+{
+	int dataOff, n, i, j, x, y;
 
 	// DCT rows
 	for (dataOff = 0, n = du_stride * 8; dataOff < n; dataOff += du_stride) {
@@ -1336,47 +2571,304 @@ static int stbiw__jpg_processDU(stbi__write_context* s, int* bitBuf, int* bitCnt
 			DU[stbiw__jpg_ZigZag[j]] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
 		}
 	}
+}
+
+// The SIMD kernels run stbiw__jpg_DCT on whole vectors: the row pass works on the transposed
+// block so each vector holds one sample index of several rows, then the block is transposed
+// back for the column pass. Rounding adds +-0.5 by the sign bit, which matches v < 0 ? v - 0.5 : v + 0.5.
+#ifdef STBIW_SSE2
+static void stbiw__jpg_dct_sse2(__m128 d[8])
+{
+	const __m128 c4 = _mm_set1_ps(0.707106781f);
+	__m128 tmp0 = _mm_add_ps(d[0], d[7]), tmp7 = _mm_sub_ps(d[0], d[7]);
+	__m128 tmp1 = _mm_add_ps(d[1], d[6]), tmp6 = _mm_sub_ps(d[1], d[6]);
+	__m128 tmp2 = _mm_add_ps(d[2], d[5]), tmp5 = _mm_sub_ps(d[2], d[5]);
+	__m128 tmp3 = _mm_add_ps(d[3], d[4]), tmp4 = _mm_sub_ps(d[3], d[4]);
+	__m128 tmp10 = _mm_add_ps(tmp0, tmp3), tmp13 = _mm_sub_ps(tmp0, tmp3);
+	__m128 tmp11 = _mm_add_ps(tmp1, tmp2), tmp12 = _mm_sub_ps(tmp1, tmp2);
+	__m128 z1, z2, z3, z4, z5, z11, z13;
+
+	d[0] = _mm_add_ps(tmp10, tmp11);
+	d[4] = _mm_sub_ps(tmp10, tmp11);
+	z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), c4);
+	d[2] = _mm_add_ps(tmp13, z1);
+	d[6] = _mm_sub_ps(tmp13, z1);
+
+	tmp10 = _mm_add_ps(tmp4, tmp5);
+	tmp11 = _mm_add_ps(tmp5, tmp6);
+	tmp12 = _mm_add_ps(tmp6, tmp7);
+	z5 = _mm_mul_ps(_mm_sub_ps(tmp10, tmp12), _mm_set1_ps(0.382683433f));
+	z2 = _mm_add_ps(_mm_mul_ps(tmp10, _mm_set1_ps(0.541196100f)), z5);
+	z4 = _mm_add_ps(_mm_mul_ps(tmp12, _mm_set1_ps(1.306562965f)), z5);
+	z3 = _mm_mul_ps(tmp11, c4);
+	z11 = _mm_add_ps(tmp7, z3);
+	z13 = _mm_sub_ps(tmp7, z3);
+	d[5] = _mm_add_ps(z13, z2);
+	d[3] = _mm_sub_ps(z13, z2);
+	d[1] = _mm_add_ps(z11, z4);
+	d[7] = _mm_sub_ps(z11, z4);
+}
+
+static void stbiw__jpg_transpose4_sse2(const __m128* in, __m128* out)
+{
+	__m128 r0 = in[0], r1 = in[1], r2 = in[2], r3 = in[3];
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	out[0] = r0; out[1] = r1; out[2] = r2; out[3] = r3;
+}
+
+static void stbiw__jpg_quantize_sse2(const __m128* coef, const float* fdtbl, int* nat)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f), half = _mm_set1_ps(0.5f);
+	__m128 v = _mm_mul_ps(*coef, _mm_loadu_ps(fdtbl));
+	v = _mm_add_ps(v, _mm_or_ps(half, _mm_and_ps(v, sign)));
+	_mm_storeu_si128((__m128i*)nat, _mm_cvttps_epi32(v));
+}
+
+static void stbiw__jpg_fdct_sse2(float* CDU, int du_stride, const float* fdtbl, int* DU)
+{
+	// lo/hi: columns 0-3 / 4-7 of each row; ca/cb: one sample index across rows 0-3 / 4-7
+	__m128 lo[8], hi[8], ca[8], cb[8];
+	int nat[64];
+	int y, j;
+	for (y = 0; y < 8; ++y) {
+		lo[y] = _mm_loadu_ps(CDU + y * du_stride);
+		hi[y] = _mm_loadu_ps(CDU + y * du_stride + 4);
+	}
+	stbiw__jpg_transpose4_sse2(lo, ca);
+	stbiw__jpg_transpose4_sse2(hi, ca + 4);
+	stbiw__jpg_transpose4_sse2(lo + 4, cb);
+	stbiw__jpg_transpose4_sse2(hi + 4, cb + 4);
+	stbiw__jpg_dct_sse2(ca);
+	stbiw__jpg_dct_sse2(cb);
+	stbiw__jpg_transpose4_sse2(ca, lo);
+	stbiw__jpg_transpose4_sse2(ca + 4, hi);
+	stbiw__jpg_transpose4_sse2(cb, lo + 4);
+	stbiw__jpg_transpose4_sse2(cb + 4, hi + 4);
+	stbiw__jpg_dct_sse2(lo);
+	stbiw__jpg_dct_sse2(hi);
+	for (y = 0; y < 8; ++y) {
+		stbiw__jpg_quantize_sse2(&lo[y], fdtbl + y * 8, nat + y * 8);
+		stbiw__jpg_quantize_sse2(&hi[y], fdtbl + y * 8 + 4, nat + y * 8 + 4);
+	}
+	for (j = 0; j < 64; ++j)
+		DU[stbiw__jpg_ZigZag[j]] = nat[j];
+}
+#endif // STBIW_SSE2
+
+#ifdef STBIW_AVX2
+STBIW__AVX2_TARGET static void stbiw__jpg_dct_avx2(__m256 d[8])
+{
+	const __m256 c4 = _mm256_set1_ps(0.707106781f);
+	__m256 tmp0 = _mm256_add_ps(d[0], d[7]), tmp7 = _mm256_sub_ps(d[0], d[7]);
+	__m256 tmp1 = _mm256_add_ps(d[1], d[6]), tmp6 = _mm256_sub_ps(d[1], d[6]);
+	__m256 tmp2 = _mm256_add_ps(d[2], d[5]), tmp5 = _mm256_sub_ps(d[2], d[5]);
+	__m256 tmp3 = _mm256_add_ps(d[3], d[4]), tmp4 = _mm256_sub_ps(d[3], d[4]);
+	__m256 tmp10 = _mm256_add_ps(tmp0, tmp3), tmp13 = _mm256_sub_ps(tmp0, tmp3);
+	__m256 tmp11 = _mm256_add_ps(tmp1, tmp2), tmp12 = _mm256_sub_ps(tmp1, tmp2);
+	__m256 z1, z2, z3, z4, z5, z11, z13;
+
+	d[0] = _mm256_add_ps(tmp10, tmp11);
+	d[4] = _mm256_sub_ps(tmp10, tmp11);
+	z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), c4);
+	d[2] = _mm256_add_ps(tmp13, z1);
+	d[6] = _mm256_sub_ps(tmp13, z1);
+
+	tmp10 = _mm256_add_ps(tmp4, tmp5);
+	tmp11 = _mm256_add_ps(tmp5, tmp6);
+	tmp12 = _mm256_add_ps(tmp6, tmp7);
+	z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), _mm256_set1_ps(0.382683433f));
+	z2 = _mm256_add_ps(_mm256_mul_ps(tmp10, _mm256_set1_ps(0.541196100f)), z5);
+	z4 = _mm256_add_ps(_mm256_mul_ps(tmp12, _mm256_set1_ps(1.306562965f)), z5);
+	z3 = _mm256_mul_ps(tmp11, c4);
+	z11 = _mm256_add_ps(tmp7, z3);
+	z13 = _mm256_sub_ps(tmp7, z3);
+	d[5] = _mm256_add_ps(z13, z2);
+	d[3] = _mm256_sub_ps(z13, z2);
+	d[1] = _mm256_add_ps(z11, z4);
+	d[7] = _mm256_sub_ps(z11, z4);
+}
+
+STBIW__AVX2_TARGET static void stbiw__jpg_transpose8_avx2(__m256 r[8])
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+STBIW__AVX2_TARGET static void stbiw__jpg_fdct_avx2(float* CDU, int du_stride, const float* fdtbl, int* DU)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f), half = _mm256_set1_ps(0.5f);
+	__m256 r[8];
+	int nat[64];
+	int y, j;
+	for (y = 0; y < 8; ++y)
+		r[y] = _mm256_loadu_ps(CDU + y * du_stride);
+	stbiw__jpg_transpose8_avx2(r);
+	stbiw__jpg_dct_avx2(r);
+	stbiw__jpg_transpose8_avx2(r);
+	stbiw__jpg_dct_avx2(r);
+	for (y = 0; y < 8; ++y) {
+		__m256 v = _mm256_mul_ps(r[y], _mm256_loadu_ps(fdtbl + y * 8));
+		v = _mm256_add_ps(v, _mm256_or_ps(half, _mm256_and_ps(v, sign)));
+		_mm256_storeu_si256((__m256i*)(nat + y * 8), _mm256_cvttps_epi32(v));
+	}
+	for (j = 0; j < 64; ++j)
+		DU[stbiw__jpg_ZigZag[j]] = nat[j];
+}
+#endif // STBIW_AVX2
+
+#ifdef STBIW_NEON
+static void stbiw__jpg_dct_neon(float32x4_t d[8])
+{
+	float32x4_t tmp0 = vaddq_f32(d[0], d[7]), tmp7 = vsubq_f32(d[0], d[7]);
+	float32x4_t tmp1 = vaddq_f32(d[1], d[6]), tmp6 = vsubq_f32(d[1], d[6]);
+	float32x4_t tmp2 = vaddq_f32(d[2], d[5]), tmp5 = vsubq_f32(d[2], d[5]);
+	float32x4_t tmp3 = vaddq_f32(d[3], d[4]), tmp4 = vsubq_f32(d[3], d[4]);
+	float32x4_t tmp10 = vaddq_f32(tmp0, tmp3), tmp13 = vsubq_f32(tmp0, tmp3);
+	float32x4_t tmp11 = vaddq_f32(tmp1, tmp2), tmp12 = vsubq_f32(tmp1, tmp2);
+	float32x4_t z1, z2, z3, z4, z5, z11, z13;
+
+	// separate multiplies and adds (no vmla/vfma), so rounding matches the scalar code
+	d[0] = vaddq_f32(tmp10, tmp11);
+	d[4] = vsubq_f32(tmp10, tmp11);
+	z1 = vmulq_n_f32(vaddq_f32(tmp12, tmp13), 0.707106781f);
+	d[2] = vaddq_f32(tmp13, z1);
+	d[6] = vsubq_f32(tmp13, z1);
+
+	tmp10 = vaddq_f32(tmp4, tmp5);
+	tmp11 = vaddq_f32(tmp5, tmp6);
+	tmp12 = vaddq_f32(tmp6, tmp7);
+	z5 = vmulq_n_f32(vsubq_f32(tmp10, tmp12), 0.382683433f);
+	z2 = vaddq_f32(vmulq_n_f32(tmp10, 0.541196100f), z5);
+	z4 = vaddq_f32(vmulq_n_f32(tmp12, 1.306562965f), z5);
+	z3 = vmulq_n_f32(tmp11, 0.707106781f);
+	z11 = vaddq_f32(tmp7, z3);
+	z13 = vsubq_f32(tmp7, z3);
+	d[5] = vaddq_f32(z13, z2);
+	d[3] = vsubq_f32(z13, z2);
+	d[1] = vaddq_f32(z11, z4);
+	d[7] = vsubq_f32(z11, z4);
+}
+
+static void stbiw__jpg_transpose4_neon(const float32x4_t* in, float32x4_t* out)
+{
+	float32x4x2_t t01 = vtrnq_f32(in[0], in[1]), t23 = vtrnq_f32(in[2], in[3]);
+	out[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	out[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	out[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	out[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+static void stbiw__jpg_quantize_neon(float32x4_t coef, const float* fdtbl, int* nat)
+{
+	float32x4_t v = vmulq_f32(coef, vld1q_f32(fdtbl));
+	uint32x4_t half = vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000u)));
+	vst1q_s32(nat, vcvtq_s32_f32(vaddq_f32(v, vreinterpretq_f32_u32(half))));
+}
+
+static void stbiw__jpg_fdct_neon(float* CDU, int du_stride, const float* fdtbl, int* DU)
+{
+	float32x4_t lo[8], hi[8], ca[8], cb[8];
+	int nat[64];
+	int y, j;
+	for (y = 0; y < 8; ++y) {
+		lo[y] = vld1q_f32(CDU + y * du_stride);
+		hi[y] = vld1q_f32(CDU + y * du_stride + 4);
+	}
+	stbiw__jpg_transpose4_neon(lo, ca);
+	stbiw__jpg_transpose4_neon(hi, ca + 4);
+	stbiw__jpg_transpose4_neon(lo + 4, cb);
+	stbiw__jpg_transpose4_neon(hi + 4, cb + 4);
+	stbiw__jpg_dct_neon(ca);
+	stbiw__jpg_dct_neon(cb);
+	stbiw__jpg_transpose4_neon(ca, lo);
+	stbiw__jpg_transpose4_neon(ca + 4, hi);
+	stbiw__jpg_transpose4_neon(cb, lo + 4);
+	stbiw__jpg_transpose4_neon(cb + 4, hi + 4);
+	stbiw__jpg_dct_neon(lo);
+	stbiw__jpg_dct_neon(hi);
+	for (y = 0; y < 8; ++y) {
+		stbiw__jpg_quantize_neon(lo[y], fdtbl + y * 8, nat + y * 8);
+		stbiw__jpg_quantize_neon(hi[y], fdtbl + y * 8 + 4, nat + y * 8 + 4);
+	}
+	for (j = 0; j < 64; ++j)
+		DU[stbiw__jpg_ZigZag[j]] = nat[j];
+}
+#endif // STBIW_NEON
+
+static stbiw__jpg_fdct_kernel* stbiw__select_jpg_fdct_kernel(void)
+{
+#ifdef STBIW_AVX2
+	if (stbi_write_jpg_max_simd >= 2 && stbiw__avx2_available())
+		return stbiw__jpg_fdct_avx2;
+#endif
+#ifdef STBIW_SSE2
+	if (stbi_write_jpg_max_simd >= 1)
+		return stbiw__jpg_fdct_sse2;
+#endif
+#ifdef STBIW_NEON
+	if (stbi_write_jpg_max_simd >= 1)
+		return stbiw__jpg_fdct_neon;
+#endif
+	return stbiw__jpg_fdct_scalar;
+}
+
+// Magnitude category and extra bits of a coefficient, as a (bits, length) pair
+static void stbiw__jpg_calcBits(int val, unsigned short bits[2]) {
+	int tmp1 = val < 0 ? -val : val;
+	val = val < 0 ? val - 1 : val;
+	bits[1] = (unsigned short)stbiw__bit_length((unsigned int)tmp1);
+	bits[0] = val & ((1 << bits[1]) - 1);
+}
+
+static int stbiw__jpg_processDU(stbiw__jpg_bitwriter* w, stbiw__jpg_fdct_kernel* fdct, float* CDU, int du_stride, float* fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2]) {
+	const unsigned short EOB[2] = { HTAC[0x00][0], HTAC[0x00][1] };
+	const unsigned short M16zeroes[2] = { HTAC[0xF0][0], HTAC[0xF0][1] };
+	unsigned long long nonzero = 0;
+	int i, diff, last;
+	int DU[64];
+
+	fdct(CDU, du_stride, fdtbl, DU);
 
 	// Encode DC
 	diff = DU[0] - DC;
 	if (diff == 0) {
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, HTDC[0]);
+		stbiw__jpg_put_code(w, HTDC[0]);
 	}
 	else {
 		unsigned short bits[2];
 		stbiw__jpg_calcBits(diff, bits);
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, HTDC[bits[1]]);
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, bits);
+		stbiw__jpg_put_bits(w, ((unsigned int)HTDC[bits[1]][0] << bits[1]) | bits[0], HTDC[bits[1]][1] + bits[1]);
 	}
-	// Encode ACs
-	end0pos = 63;
-	for (; (end0pos > 0) && (DU[end0pos] == 0); --end0pos) {
-	}
-	// end0pos = first element in reverse order !=0
-	if (end0pos == 0) {
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, EOB);
-		return DU[0];
-	}
-	for (i = 1; i <= end0pos; ++i) {
-		int startpos = i;
-		int nrzeroes;
+
+	// Encode ACs, visiting only the non-zero ones
+	for (i = 1; i < 64; ++i)
+		nonzero |= (unsigned long long)(DU[i] != 0) << i;
+	for (last = 0; nonzero; nonzero &= nonzero - 1) {
+		int pos = stbiw__ctz64(nonzero);
+		int nrzeroes = pos - last - 1;
 		unsigned short bits[2];
-		for (; DU[i] == 0 && i <= end0pos; ++i) {
-		}
-		nrzeroes = i - startpos;
-		if (nrzeroes >= 16) {
-			int lng = nrzeroes >> 4;
-			int nrmarker;
-			for (nrmarker = 1; nrmarker <= lng; ++nrmarker)
-				stbiw__jpg_writeBits(s, bitBuf, bitCnt, M16zeroes);
-			nrzeroes &= 15;
-		}
-		stbiw__jpg_calcBits(DU[i], bits);
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, HTAC[(nrzeroes << 4) + bits[1]]);
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, bits);
+		for (; nrzeroes >= 16; nrzeroes -= 16)
+			stbiw__jpg_put_code(w, M16zeroes);
+		stbiw__jpg_calcBits(DU[pos], bits);
+		stbiw__jpg_put_bits(w, ((unsigned int)HTAC[(nrzeroes << 4) + bits[1]][0] << bits[1]) | bits[0], HTAC[(nrzeroes << 4) + bits[1]][1] + bits[1]);
+		last = pos;
 	}
-	if (end0pos != 63) {
-		stbiw__jpg_writeBits(s, bitBuf, bitCnt, EOB);
+	if (last != 63) {
+		stbiw__jpg_put_code(w, EOB);
 	}
 	return DU[0];
 }
@@ -1507,15 +2999,21 @@ static int stbi_write_jpg_core(stbi__write_context* s, int width, int height, in
 
 	// Encode 8x8 macroblocks
 	{
-		static const unsigned short fillBits[] = { 0x7F, 7 };
+		stbiw__jpg_fdct_kernel* fdct = stbiw__select_jpg_fdct_kernel();
+		stbiw__jpg_bitwriter* w = (stbiw__jpg_bitwriter*)STBIW_MALLOC(sizeof(stbiw__jpg_bitwriter));
 		int DCY = 0, DCU = 0, DCV = 0;
-		int bitBuf = 0, bitCnt = 0;
 		// comp == 2 is grey+alpha (alpha is ignored)
 		int ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 : 0;
 		const unsigned char* dataR = (const unsigned char*)data;
 		const unsigned char* dataG = dataR + ofsG;
 		const unsigned char* dataB = dataR + ofsB;
 		int x, y, pos;
+		if (!w)
+			return 0;
+		w->s = s;
+		w->acc = 0;
+		w->count = 0;
+		w->used = 0;
 		if (subsample) {
 			for (y = 0; y < height; y += 16) {
 				for (x = 0; x < width; x += 16) {
@@ -1533,10 +3031,10 @@ static int stbi_write_jpg_core(stbi__write_context* s, int width, int height, in
 							V[pos] = +0.50000f * r - 0.41869f * g - 0.08131f * b;
 						}
 					}
-					DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y + 0, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-					DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y + 8, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-					DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y + 128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-					DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y + 136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(w, fdct, Y + 0, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(w, fdct, Y + 8, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(w, fdct, Y + 128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCY = stbiw__jpg_processDU(w, fdct, Y + 136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
 
 					// subsample U,V
 					{
@@ -1549,8 +3047,8 @@ static int stbi_write_jpg_core(stbi__write_context* s, int width, int height, in
 								subV[pos] = (V[j + 0] + V[j + 1] + V[j + 16] + V[j + 17]) * 0.25f;
 							}
 						}
-						DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-						DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+						DCU = stbiw__jpg_processDU(w, fdct, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+						DCV = stbiw__jpg_processDU(w, fdct, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
 					}
 				}
 			}
@@ -1573,15 +3071,16 @@ static int stbi_write_jpg_core(stbi__write_context* s, int width, int height, in
 						}
 					}
 
-					DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y, 8, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-					DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, U, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-					DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, V, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+					DCY = stbiw__jpg_processDU(w, fdct, Y, 8, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+					DCU = stbiw__jpg_processDU(w, fdct, U, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+					DCV = stbiw__jpg_processDU(w, fdct, V, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
 				}
 			}
 		}
 
 		// Do the bit alignment of the EOI marker
-		stbiw__jpg_writeBits(s, &bitBuf, &bitCnt, fillBits);
+		stbiw__jpg_finish_bits(w);
+		STBIW_FREE(w);
 	}
 
 	// EOI
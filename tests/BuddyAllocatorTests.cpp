@@ -0,0 +1,139 @@
+#include "Core/BuddyAllocator.h"
+
+#include "TestCommon.h"
+
+static void TestSplitAndMerge()
+{
+	BuddyAllocator Allocator;
+	Allocator.Init(1024, 64);
+	CHECK_EQ(5, Allocator.NumLevels);
+	CHECK_EQ(1024, Allocator.GetLargestFreeBlock());
+
+	// Sizes round up to a block, and a split hands out its lower half
+	const uint64_t A = Allocator.Allocate(100);
+	CHECK_EQ(0, A);
+	CHECK_EQ(128, Allocator.GetAllocationSize(A));
+	const uint64_t B = Allocator.Allocate(1);
+	CHECK_EQ(128, B);
+	CHECK_EQ(64, Allocator.GetAllocationSize(B));
+	const uint64_t C = Allocator.Allocate(64);
+	CHECK_EQ(192, C);
+	const uint64_t D = Allocator.Allocate(512);
+	CHECK_EQ(512, D);
+	CHECK_EQ(128 + 64 + 64 + 512, Allocator.UsedBytes);
+	CHECK_EQ(4, Allocator.NumAllocations);
+	CHECK_EQ(256, Allocator.GetLargestFreeBlock());
+	CHECK(Allocator.Validate());
+
+	// Nothing big enough left
+	CHECK_EQ(BuddyAllocator::InvalidOffset, Allocator.Allocate(512));
+	CHECK_EQ(BuddyAllocator::InvalidOffset, Allocator.Allocate(2048));
+
+	// Freeing merges buddies back up, all the way to the whole heap
+	Allocator.Free(B);
+	CHECK(Allocator.Validate());
+	Allocator.Free(C);
+	CHECK(Allocator.Validate());
+	CHECK_EQ(256, Allocator.GetLargestFreeBlock());
+	Allocator.Free(A);
+	CHECK_EQ(512, Allocator.GetLargestFreeBlock());
+	Allocator.Free(D);
+	CHECK(Allocator.Validate());
+	CHECK_EQ(1024, Allocator.GetLargestFreeBlock());
+	CHECK_EQ(0, Allocator.UsedBytes);
+	CHECK_EQ(0, Allocator.NumAllocations);
+}
+
+static void TestAlignment()
+{
+	BuddyAllocator Allocator;
+	Allocator.Init(1 << 20, 256);
+
+	// A small allocation with a big alignment takes a block of the alignment's size
+	CHECK_EQ(0, Allocator.Allocate(256));
+	const uint64_t Aligned = Allocator.Allocate(300, 65536);
+	CHECK_EQ(0, Aligned % 65536);
+	CHECK_EQ(65536, Allocator.GetAllocationSize(Aligned));
+
+	// Every block starts on a multiple of its own size
+	for (int i = 0; i < 20; i++)
+	{
+		const uint64_t Bytes = 256ull << (i % 6);
+		const uint64_t Offset = Allocator.Allocate(Bytes);
+		CHECK(Offset != BuddyAllocator::InvalidOffset);
+		CHECK_EQ(0, Offset % Allocator.GetAllocationSize(Offset));
+	}
+	CHECK(Allocator.Validate());
+}
+
+// Random allocations and frees never overlap, and the structure stays consistent throughout
+static void TestRandomized()
+{
+	BuddyAllocator Allocator;
+	Allocator.Init(1 << 22, 64);
+
+	struct Block
+	{
+		uint64_t Offset;
+		uint64_t Size;
+	};
+	std::vector<Block> Live;
+	std::vector<uint8_t> Owner((1 << 22) / 64, 0);
+	uint32_t State = 7;
+	bool bNoOverlap = true;
+	bool bValid = true;
+	for (int Step = 0; Step < 20000; Step++)
+	{
+		State = State * 1664525u + 1013904223u;
+		if ((State >> 28) < 9 || Live.empty())
+		{
+			const uint64_t Bytes = 1 + ((State >> 8) % (1 << ((State >> 4) % 16)));
+			const uint64_t Offset = Allocator.Allocate(Bytes);
+			if (Offset == BuddyAllocator::InvalidOffset)
+			{
+				continue;
+			}
+			const uint64_t Size = Allocator.GetAllocationSize(Offset);
+			bNoOverlap &= Size >= Bytes && Offset + Size <= Allocator.Size;
+			for (uint64_t Slot = Offset / 64; Slot < (Offset + Size) / 64; Slot++)
+			{
+				bNoOverlap &= Owner[Slot] == 0;
+				Owner[Slot] = 1;
+			}
+			Live.push_back({ Offset, Size });
+		}
+		else
+		{
+			const size_t Index = (State >> 8) % Live.size();
+			const Block Freed = Live[Index];
+			Live[Index] = Live.back();
+			Live.pop_back();
+			for (uint64_t Slot = Freed.Offset / 64; Slot < (Freed.Offset + Freed.Size) / 64; Slot++)
+			{
+				Owner[Slot] = 0;
+			}
+			Allocator.Free(Freed.Offset);
+		}
+		if (Step % 500 == 0)
+		{
+			bValid &= Allocator.Validate();
+		}
+	}
+	CHECK(bNoOverlap);
+	CHECK(bValid);
+
+	for (const Block& B : Live)
+	{
+		Allocator.Free(B.Offset);
+	}
+	CHECK(Allocator.Validate());
+	CHECK_EQ(Allocator.Size, Allocator.GetLargestFreeBlock());
+}
+
+int main()
+{
+	TestSplitAndMerge();
+	TestAlignment();
+	TestRandomized();
+	return TestResult("BuddyAllocatorTests");
+}
@@ -0,0 +1,172 @@
+#include "Core/CPUCopyEngine.h"
+
+#include "TestCommon.h"
+
+static void FillPattern(uint8_t* Data, size_t Size, uint32_t Seed)
+{
+	uint32_t State = Seed | 1;
+	for (size_t i = 0; i < Size; i++)
+	{
+		Data[i] = (uint8_t)NextXorShift32(State);
+	}
+}
+
+// Every supported kernel against memcpy, at sizes around each kernel's block size and with the
+// destination and source misaligned independently, checking the guard bytes either side survive
+static void TestCopyKernels()
+{
+	const size_t Sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 127, 128, 129, 255, 256, 257, 1000, 4096, 65536 + 7 };
+	const size_t Guard = 64;
+	std::vector<uint8_t> Src(65536 + 256 + 2 * Guard);
+	std::vector<uint8_t> Dst(Src.size());
+	FillPattern(Src.data(), Src.size(), 1);
+
+	for (const CopyKernelInfo& Info : GetCopyKernels())
+	{
+		if (!Info.Supported)
+		{
+			continue;
+		}
+		for (size_t Size : Sizes)
+		{
+			for (size_t DstAlign = 0; DstAlign < 3; DstAlign++)
+			{
+				for (size_t SrcAlign = 0; SrcAlign < 3; SrcAlign++)
+				{
+					memset(Dst.data(), 0xcd, Dst.size());
+					uint8_t* DstStart = Dst.data() + Guard + DstAlign * 5;
+					const uint8_t* SrcStart = Src.data() + Guard + SrcAlign * 3;
+					Info.Func(DstStart, SrcStart, Size);
+
+					bool bMatch = memcmp(DstStart, SrcStart, Size) == 0;
+					bool bGuardsIntact = true;
+					for (uint8_t* p = Dst.data(); p < DstStart; p++)
+					{
+						bGuardsIntact &= *p == 0xcd;
+					}
+					for (uint8_t* p = DstStart + Size; p < Dst.data() + Dst.size(); p++)
+					{
+						bGuardsIntact &= *p == 0xcd;
+					}
+					if (!bMatch || !bGuardsIntact)
+					{
+						printf("%s: size %zu, dst +%zu, src +%zu\n", Info.Name, Size, DstAlign * 5, SrcAlign * 3);
+					}
+					CHECK(bMatch);
+					CHECK(bGuardsIntact);
+				}
+			}
+		}
+	}
+
+	CHECK(SelectCopyKernel(4096) == CopyKernelMemcpy);
+}
+
+// The GetCopyableFootprints placement: 256 byte row pitch, 512 byte subresource alignment
+static void TestTextureLayout()
+{
+	CPUTexture Texture;
+	Texture.Init(100, 30, 2, 3, 4);
+	CHECK_EQ(6, Texture.Subresources.size());
+
+	const CPUTexture::Subresource& Mip0 = Texture.Subresources[0];
+	CHECK_EQ(0, Mip0.Offset);
+	CHECK_EQ(100, Mip0.Width);
+	CHECK_EQ(512, Mip0.RowPitch);
+
+	const CPUTexture::Subresource& Mip2 = Texture.Subresources[2];
+	CHECK_EQ(25, Mip2.Width);
+	CHECK_EQ(7, Mip2.Height);
+	CHECK_EQ(256, Mip2.RowPitch);
+
+	for (size_t i = 1; i < Texture.Subresources.size(); i++)
+	{
+		const CPUTexture::Subresource& Previous = Texture.Subresources[i - 1];
+		CHECK_EQ(0, Texture.Subresources[i].Offset % 512);
+		CHECK(Texture.Subresources[i].Offset >= Previous.Offset + (size_t)Previous.RowPitch * Previous.Height);
+	}
+	CHECK(Texture.GetTexel(4, 3, 2) == Texture.Memory.Data + Texture.Subresources[4].Offset + 2 * 256 + 3 * 4);
+
+	// Allocation is zeroed, so the first timed copy doesn't pay for page faults
+	bool bZeroed = true;
+	for (size_t i = 0; i < Texture.Memory.Size; i++)
+	{
+		bZeroed &= Texture.Memory.Data[i] == 0;
+	}
+	CHECK(bZeroed);
+	CHECK_EQ(0, Texture.Memory.GetNode(Texture.Memory.Size - 1, 0));
+}
+
+static void TestCopyResource(int NumThreads)
+{
+	CPUCopyEngine Engine;
+	Engine.Start(NumThreads);
+
+	// Big enough for several chunks, so the pool is used
+	CPUTexture Src, Dst;
+	Src.Init(1024, 1024, 1, 1, 4);
+	Dst.Init(1024, 1024, 1, 1, 4);
+	FillPattern(Src.Memory.Data, Src.Memory.Size, 2);
+
+	for (const CopyKernelInfo& Info : GetCopyKernels())
+	{
+		if (Info.Supported)
+		{
+			memset(Dst.Memory.Data, 0, Dst.Memory.Size);
+			Engine.Kernel = Info.Func;
+			Engine.CopyResource(Dst, Src);
+			CHECK(memcmp(Dst.Memory.Data, Src.Memory.Data, Src.Memory.Size) == 0);
+		}
+	}
+
+	Engine.Shutdown();
+}
+
+static void TestCopySubresourceRegion(int NumThreads)
+{
+	CPUCopyEngine Engine;
+	Engine.Start(NumThreads);
+
+	CPUTexture Src, Dst;
+	Src.Init(300, 200, 1, 2, 4);
+	Dst.Init(512, 512, 1, 1, 4);
+	FillPattern(Src.Memory.Data, Src.Memory.Size, 3);
+
+	// A box out of mip 0 into the middle of the destination
+	CopyBox Box = { 10, 20, 250, 180 };
+	Engine.CopySubresourceRegion(Dst, 0, 33, 44, Src, 0, &Box);
+	bool bMatch = true;
+	for (int y = Box.Top; y < Box.Bottom; y++)
+	{
+		bMatch &= memcmp(Dst.GetTexel(0, 33, 44 + y - Box.Top), Src.GetTexel(0, Box.Left, y), (Box.Right - Box.Left) * 4) == 0;
+	}
+	CHECK(bMatch);
+
+	// Nothing outside the box was written
+	CHECK(*(uint32_t*)Dst.GetTexel(0, 32, 44) == 0);
+	CHECK(*(uint32_t*)Dst.GetTexel(0, 33 + Box.Right - Box.Left, 44) == 0);
+	CHECK(*(uint32_t*)Dst.GetTexel(0, 33, 43) == 0);
+	CHECK(*(uint32_t*)Dst.GetTexel(0, 33, 44 + Box.Bottom - Box.Top) == 0);
+
+	// The whole of mip 1 with no box
+	Engine.CopySubresourceRegion(Dst, 0, 0, 0, Src, 1, nullptr);
+	bMatch = true;
+	for (int y = 0; y < Src.Subresources[1].Height; y++)
+	{
+		bMatch &= memcmp(Dst.GetTexel(0, 0, y), Src.GetTexel(1, 0, y), Src.Subresources[1].Width * 4) == 0;
+	}
+	CHECK(bMatch);
+
+	Engine.Shutdown();
+}
+
+int main()
+{
+	TestCopyKernels();
+	TestTextureLayout();
+	TestCopyResource(0);
+	TestCopyResource(4);
+	TestCopySubresourceRegion(0);
+	TestCopySubresourceRegion(4);
+	return TestResult("CPUCopyEngineTests");
+}
@@ -0,0 +1,309 @@
+#include "Core/CSEmulator.h"
+
+#include "TestCommon.h"
+
+static const CSDispatchOrder AllOrders[] = { CSDispatchOrder::RowMajor, CSDispatchOrder::ColumnMajor, CSDispatchOrder::Morton, CSDispatchOrder::ColumnTiled };
+
+static CSDispatch MakeDispatch(uint32_t GroupSize, int Width, int Height, CSDispatchOrder Order, uint32_t TileWidth = 8)
+{
+	CSDispatch Dispatch;
+	Dispatch.NumThreads[0] = GroupSize;
+	Dispatch.NumThreads[1] = GroupSize;
+	Dispatch.GroupCount[0] = (Width + GroupSize - 1) / GroupSize;
+	Dispatch.GroupCount[1] = (Height + GroupSize - 1) / GroupSize;
+	Dispatch.Order = Order;
+	Dispatch.TileWidth = TileWidth;
+	return Dispatch;
+}
+
+static void TestCompactBits()
+{
+	CHECK_EQ(0, CompactBits(0));
+	CHECK_EQ(1, CompactBits(1));
+	CHECK_EQ(0, CompactBits(2));
+	CHECK_EQ(3, CompactBits(5));
+	CHECK_EQ(0xffff, CompactBits(0x55555555));
+	CHECK_EQ(0, CompactBits(0xaaaaaaaa));
+}
+
+static void TestMapDispatchIndex()
+{
+	CSDispatch Dispatch;
+	Dispatch.GroupCount[0] = 5;
+	Dispatch.GroupCount[1] = 3;
+	Dispatch.GroupCount[2] = 2;
+	uint32_t GroupID[3];
+
+	Dispatch.Order = CSDispatchOrder::RowMajor;
+	CHECK(MapDispatchIndex(Dispatch, 7, GroupID));
+	CHECK_EQ(2, GroupID[0]);
+	CHECK_EQ(1, GroupID[1]);
+	CHECK_EQ(0, GroupID[2]);
+
+	Dispatch.Order = CSDispatchOrder::ColumnMajor;
+	CHECK(MapDispatchIndex(Dispatch, 7, GroupID));
+	CHECK_EQ(2, GroupID[0]);
+	CHECK_EQ(1, GroupID[1]);
+	CHECK(MapDispatchIndex(Dispatch, 16, GroupID));
+	CHECK_EQ(0, GroupID[0]);
+	CHECK_EQ(1, GroupID[1]);
+	CHECK_EQ(1, GroupID[2]);
+
+	// Morton over the 8 x 8 square covering 5 x 3: index 3 is (1, 1), index 4 the next 2 x 2 block at (2, 0)
+	Dispatch.Order = CSDispatchOrder::Morton;
+	CHECK_EQ(8, GetMortonSide(Dispatch));
+	CHECK_EQ(128, GetDispatchIndexCount(Dispatch));
+	CHECK(MapDispatchIndex(Dispatch, 3, GroupID));
+	CHECK_EQ(1, GroupID[0]);
+	CHECK_EQ(1, GroupID[1]);
+	CHECK(MapDispatchIndex(Dispatch, 4, GroupID));
+	CHECK_EQ(2, GroupID[0]);
+	CHECK_EQ(0, GroupID[1]);
+	CHECK(!MapDispatchIndex(Dispatch, 10, GroupID));
+
+	// Strips 2 groups wide: the second strip starts at index 6, and the last strip is 1 wide
+	Dispatch.Order = CSDispatchOrder::ColumnTiled;
+	Dispatch.TileWidth = 2;
+	CHECK(MapDispatchIndex(Dispatch, 5, GroupID));
+	CHECK_EQ(1, GroupID[0]);
+	CHECK_EQ(2, GroupID[1]);
+	CHECK(MapDispatchIndex(Dispatch, 6, GroupID));
+	CHECK_EQ(2, GroupID[0]);
+	CHECK_EQ(0, GroupID[1]);
+	CHECK(MapDispatchIndex(Dispatch, 13, GroupID));
+	CHECK_EQ(4, GroupID[0]);
+	CHECK_EQ(1, GroupID[1]);
+}
+
+// Every order visits every group of the grid exactly once
+static void TestOrdersArePermutations()
+{
+	const uint32_t Sizes[][2] = { { 1, 1 }, { 5, 3 }, { 3, 5 }, { 16, 16 }, { 17, 9 } };
+	for (CSDispatchOrder Order : AllOrders)
+	{
+		for (const uint32_t* Size : Sizes)
+		{
+			CSDispatch Dispatch;
+			Dispatch.GroupCount[0] = Size[0];
+			Dispatch.GroupCount[1] = Size[1];
+			Dispatch.GroupCount[2] = 2;
+			Dispatch.Order = Order;
+			Dispatch.TileWidth = 4;
+
+			std::vector<int> Visits(Size[0] * Size[1] * 2, 0);
+			for (uint32_t Index = 0; Index < GetDispatchIndexCount(Dispatch); Index++)
+			{
+				uint32_t GroupID[3];
+				if (MapDispatchIndex(Dispatch, Index, GroupID))
+				{
+					Visits[(GroupID[2] * Size[1] + GroupID[1]) * Size[0] + GroupID[0]]++;
+				}
+			}
+			bool bOnce = true;
+			for (int Count : Visits)
+			{
+				bOnce &= Count == 1;
+			}
+			if (!bOnce)
+			{
+				printf("%s order, %u x %u groups\n", GetDispatchOrderName(Order), Size[0], Size[1]);
+			}
+			CHECK(bOnce);
+
+			uint32_t DispatchX = 0, DispatchY = 0;
+			GetRemapDispatchSize(Dispatch, DispatchX, DispatchY);
+			CHECK_EQ(GetDispatchIndexCount(Dispatch), DispatchX * DispatchY);
+		}
+	}
+}
+
+static void TestCoverage()
+{
+	for (CSDispatchOrder Order : AllOrders)
+	{
+		CHECK(CheckDispatchCoverage(MakeDispatch(8, 100, 37, Order, 3), 100, 37));
+		CHECK(CheckDispatchCoverage(MakeDispatch(16, 64, 64, Order), 64, 64));
+	}
+	// One group short in X leaves a column unwritten
+	CSDispatch Short = MakeDispatch(8, 100, 37, CSDispatchOrder::RowMajor);
+	Short.GroupCount[0]--;
+	CHECK(!CheckDispatchCoverage(Short, 100, 37));
+}
+
+// The copy kernels reproduce the source inside the texture and leave the pitch padding alone
+static void TestCopyKernels(int NumThreads)
+{
+	WorkStealingScheduler Scheduler;
+	Scheduler.Start(NumThreads);
+
+	const int Width = 203;
+	const int Height = 77;
+	const int Pitch = 1024;
+	std::vector<uint8_t> Src((size_t)Pitch * Height);
+	uint32_t State = 12345;
+	for (uint8_t& Byte : Src)
+	{
+		State = State * 1664525u + 1013904223u;
+		Byte = (uint8_t)(State >> 24);
+	}
+
+	const CSGroupKernel Kernels[] = { CSCopyKernelScalar, CSCopyKernelLanes };
+	const uint32_t GroupSizes[] = { 1, 3, 8, 13, 32 };
+	for (CSGroupKernel Kernel : Kernels)
+	{
+		for (uint32_t GroupSize : GroupSizes)
+		{
+			for (CSDispatchOrder Order : AllOrders)
+			{
+				std::vector<uint8_t> Dst(Src.size(), 0xcd);
+				CSCopyContext Copy = { Src.data(), Dst.data(), Width, Height, Pitch };
+				DispatchCPU(Scheduler, MakeDispatch(GroupSize, Width, Height, Order), Kernel, &Copy);
+
+				bool bCopied = true;
+				bool bPaddingIntact = true;
+				for (int y = 0; y < Height; y++)
+				{
+					bCopied &= memcmp(&Dst[(size_t)y * Pitch], &Src[(size_t)y * Pitch], Width * 4) == 0;
+					for (int x = Width * 4; x < Pitch; x++)
+					{
+						bPaddingIntact &= Dst[(size_t)y * Pitch + x] == 0xcd;
+					}
+				}
+				if (!bCopied || !bPaddingIntact)
+				{
+					printf("%s kernel, group %u, %s order\n", Kernel == CSCopyKernelScalar ? "scalar" : "lanes", GroupSize, GetDispatchOrderName(Order));
+				}
+				CHECK(bCopied);
+				CHECK(bPaddingIntact);
+			}
+		}
+	}
+
+	Scheduler.Shutdown();
+}
+
+static std::vector<uint8_t> MakeSource(size_t Size, uint32_t Seed)
+{
+	std::vector<uint8_t> Data(Size);
+	for (uint8_t& Byte : Data)
+	{
+		Seed = Seed * 1664525u + 1013904223u;
+		Byte = (uint8_t)(Seed >> 24);
+	}
+	return Data;
+}
+
+static bool RowsMatch(const std::vector<uint8_t>& Dst, const std::vector<uint8_t>& Src, int Width, int Height, int Pitch)
+{
+	bool bMatch = true;
+	for (int y = 0; y < Height; y++)
+	{
+		bMatch &= memcmp(&Dst[(size_t)y * Pitch], &Src[(size_t)y * Pitch], Width * 4) == 0;
+	}
+	return bMatch;
+}
+
+// Each group stages a tile twice its size in both directions, with the edge tiles partly outside the texture
+static void TestGroupSharedKernel(WorkStealingScheduler& Scheduler)
+{
+	const int Width = 203;
+	const int Height = 77;
+	const int Pitch = 1024;
+	const std::vector<uint8_t> Src = MakeSource((size_t)Pitch * Height, 1);
+
+	const uint32_t GroupSizes[][2] = { { 16, 16 }, { 8, 4 }, { 32, 32 } };
+	for (const uint32_t* GroupSize : GroupSizes)
+	{
+		CSDispatch Dispatch;
+		Dispatch.NumThreads[0] = GroupSize[0];
+		Dispatch.NumThreads[1] = GroupSize[1];
+		Dispatch.GroupCount[0] = (Width + GroupSize[0] * 2 - 1) / (GroupSize[0] * 2);
+		Dispatch.GroupCount[1] = (Height + GroupSize[1] * 2 - 1) / (GroupSize[1] * 2);
+
+		std::vector<uint8_t> Dst(Src.size(), 0);
+		CSCopyContext Copy = { Src.data(), Dst.data(), Width, Height, Pitch };
+		DispatchCPU(Scheduler, Dispatch, CSCopyKernelGroupShared, &Copy);
+		CHECK(RowsMatch(Dst, Src, Width, Height, Pitch));
+		CHECK_EQ(0, Dst[Width * 4]);
+	}
+}
+
+// One group per RowSpan texels of a row, at wave sizes that divide the group, leave its last wave
+// partly empty, and are wider than the whole group
+static void TestWaveRowsKernel(WorkStealingScheduler& Scheduler)
+{
+	const int Width = 1000;
+	const int Height = 9;
+	const int Pitch = 4096;
+	const std::vector<uint8_t> Src = MakeSource((size_t)Pitch * Height, 2);
+
+	const uint32_t GroupThreads[] = { 64, 48 };
+	const uint32_t LaneCounts[] = { 32, 64, 128 };
+	for (uint32_t Threads : GroupThreads)
+	{
+		for (uint32_t Lanes : LaneCounts)
+		{
+			CSDispatch Dispatch;
+			Dispatch.NumThreads[0] = Threads;
+			Dispatch.GroupCount[0] = (Width + 255) / 256;
+			Dispatch.GroupCount[1] = Height;
+
+			std::vector<uint8_t> Dst(Src.size(), 0);
+			CSWaveCopyContext Wave = { { Src.data(), Dst.data(), Width, Height, Pitch }, Lanes, 256 };
+			DispatchCPU(Scheduler, Dispatch, CSCopyKernelWaveRows, &Wave);
+			if (!RowsMatch(Dst, Src, Width, Height, Pitch))
+			{
+				printf("wave rows: %u threads, %u lanes\n", Threads, Lanes);
+			}
+			CHECK(RowsMatch(Dst, Src, Width, Height, Pitch));
+			CHECK_EQ(0, Dst[Width * 4]);
+		}
+	}
+}
+
+// Buffer copies of one and four uint4 loads per thread, over a size that ends partway into a group
+static void TestByteAddressKernel(WorkStealingScheduler& Scheduler)
+{
+	const size_t Size = 100000 * 16;
+	const std::vector<uint8_t> Src = MakeSource(Size + 64, 3);
+
+	const uint32_t LoadsPerThread[] = { 1, 4 };
+	for (uint32_t Loads : LoadsPerThread)
+	{
+		const size_t BytesPerGroup = 64 * 16 * Loads;
+		CSDispatch Dispatch;
+		Dispatch.NumThreads[0] = 64;
+		Dispatch.GroupCount[0] = (uint32_t)((Size + BytesPerGroup - 1) / BytesPerGroup);
+
+		std::vector<uint8_t> Dst(Src.size(), 0);
+		CSBufferCopyContext Copy = { Src.data(), Dst.data(), Size, Loads };
+		DispatchCPU(Scheduler, Dispatch, CSCopyKernelByteAddress, &Copy);
+		CHECK(memcmp(Dst.data(), Src.data(), Size) == 0);
+		bool bTailUntouched = true;
+		for (size_t i = Size; i < Dst.size(); i++)
+		{
+			bTailUntouched &= Dst[i] == 0;
+		}
+		CHECK(bTailUntouched);
+	}
+}
+
+int main()
+{
+	TestCompactBits();
+	TestMapDispatchIndex();
+	TestOrdersArePermutations();
+	TestCoverage();
+	TestCopyKernels(0);
+	TestCopyKernels(3);
+	for (int Threads = 0; Threads <= 3; Threads += 3)
+	{
+		WorkStealingScheduler Scheduler;
+		Scheduler.Start(Threads);
+		TestGroupSharedKernel(Scheduler);
+		TestWaveRowsKernel(Scheduler);
+		TestByteAddressKernel(Scheduler);
+		Scheduler.Shutdown();
+	}
+	return TestResult("CSEmulatorTests");
+}
@@ -0,0 +1,231 @@
+#include "Core/CacheFiles.h"
+
+#include "TestCommon.h"
+
+static const char* const TestDirectory = "CacheFilesTests.tmp";
+
+static std::vector<uint8_t> ReadWholeFile(const std::string& Path)
+{
+	std::vector<uint8_t> Data;
+	FILE* File = nullptr;
+	if (fopen_s(&File, Path.c_str(), "rb") == 0 && File)
+	{
+		uint8_t Buffer[4096];
+		size_t Read = 0;
+		while ((Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+		{
+			Data.insert(Data.end(), Buffer, Buffer + Read);
+		}
+		fclose(File);
+	}
+	return Data;
+}
+
+static void WriteWholeFile(const std::string& Path, const std::vector<uint8_t>& Data)
+{
+	FILE* File = nullptr;
+	if (fopen_s(&File, Path.c_str(), "wb") == 0 && File)
+	{
+		fwrite(Data.data(), 1, Data.size(), File);
+		fclose(File);
+	}
+}
+
+static void TestHashBytes()
+{
+	// Under a word it's plain FNV-1a
+	CHECK(HashBytes("", 0) == 0xcbf29ce484222325ull);
+	CHECK(HashBytes("a", 1) == 0xaf63dc4c8601ec8cull);
+	CHECK(HashBytes("foobar", 6) == 0x85944171f73967e8ull);
+
+	// Chaining continues from the previous hash
+	const char Text[] = "the quick brown fox jumps over the lazy dog";
+	CHECK(HashBytes(Text + 16, sizeof(Text) - 16, HashBytes(Text, 16)) == HashBytes(Text, sizeof(Text)));
+	CHECK(HashBytes(Text, sizeof(Text) - 1) != HashBytes(Text, sizeof(Text)));
+}
+
+static void TestPipelineDescHasher()
+{
+	PipelineDescHasher A, B;
+	A.Add(1u);
+	A.Add(2.5f);
+	A.AddString("POSITION");
+	B.Add(1u);
+	B.Add(2.5f);
+	B.AddString("POSITION");
+	CHECK(A.Hash == B.Hash);
+
+	// Width and order of fields both count
+	PipelineDescHasher Narrow, Swapped;
+	Narrow.Add((uint16_t)1);
+	Narrow.Add(2.5f);
+	Narrow.AddString("POSITION");
+	Swapped.Add(2.5f);
+	Swapped.Add(1u);
+	Swapped.AddString("POSITION");
+	CHECK(Narrow.Hash != A.Hash);
+	CHECK(Swapped.Hash != A.Hash);
+
+	// A null string isn't an empty one
+	PipelineDescHasher Null, Empty;
+	Null.AddString(nullptr);
+	Empty.AddString("");
+	CHECK(Null.Hash != Empty.Hash);
+
+	// Bytecode is hashed with its size, so two blobs can't trade bytes
+	const uint8_t Code[3] = { 1, 2, 3 };
+	PipelineDescHasher Split1, Split2;
+	Split1.AddByteCode(Code, 1);
+	Split1.AddByteCode(Code + 1, 2);
+	Split2.AddByteCode(Code, 2);
+	Split2.AddByteCode(Code + 2, 1);
+	CHECK(Split1.Hash != Split2.Hash);
+}
+
+static void TestShaderCacheKey()
+{
+	std::vector<std::pair<std::string, std::string>> Defines = { { "A", "1" } };
+	const uint64_t Key = GetShaderCacheKey("src", "main", "cs_5_0", 0, Defines);
+	CHECK(Key == GetShaderCacheKey("src", "main", "cs_5_0", 0, Defines));
+	CHECK(Key != GetShaderCacheKey("src", "main", "cs_5_1", 0, Defines));
+	CHECK(Key != GetShaderCacheKey("src", "main", "cs_5_0", 1, Defines));
+	CHECK(Key != GetShaderCacheKey("src", "main2", "cs_5_0", 0, Defines));
+	CHECK(Key != GetShaderCacheKey("src", "main", "cs_5_0", 0, {}));
+
+	// Terminators keep fields apart
+	CHECK(GetShaderCacheKey("ab", "c", "t", 0, {}) != GetShaderCacheKey("a", "bc", "t", 0, {}));
+	CHECK(GetShaderCacheKey("s", "e", "t", 0, { { "AB", "" } }) != GetShaderCacheKey("s", "e", "t", 0, { { "A", "B" } }));
+
+	CHECK(GetShaderCachePath("dir", 0x1234) == "dir/0000000000001234.cso");
+}
+
+static void TestShaderCacheFile()
+{
+	const uint64_t Key = 0x0123456789abcdefull;
+	const std::string Path = GetShaderCachePath(TestDirectory, Key);
+	std::vector<uint8_t> ByteCode(1000);
+	for (size_t i = 0; i < ByteCode.size(); i++)
+	{
+		ByteCode[i] = (uint8_t)(i * 7);
+	}
+
+	std::vector<uint8_t> Read;
+	remove(Path.c_str());
+	CHECK(!ReadShaderCacheFile(Path, Key, Read));
+
+	CHECK(WriteShaderCacheFile(Path, Key, ByteCode.data(), ByteCode.size()));
+	CHECK(ReadShaderCacheFile(Path, Key, Read));
+	CHECK(Read == ByteCode);
+
+	// Another key's file is a miss
+	CHECK(!ReadShaderCacheFile(Path, Key + 1, Read));
+	CHECK(Read.empty());
+
+	// Corrupt and truncated files are misses, and leave nothing behind in the output
+	const std::vector<uint8_t> Good = ReadWholeFile(Path);
+	CHECK_EQ(sizeof(ShaderCacheFileHeader) + ByteCode.size(), Good.size());
+
+	std::vector<uint8_t> Corrupt = Good;
+	Corrupt[sizeof(ShaderCacheFileHeader) + 500] ^= 1;
+	WriteWholeFile(Path, Corrupt);
+	CHECK(!ReadShaderCacheFile(Path, Key, Read));
+	CHECK(Read.empty());
+
+	std::vector<uint8_t> Truncated(Good.begin(), Good.end() - 1);
+	WriteWholeFile(Path, Truncated);
+	CHECK(!ReadShaderCacheFile(Path, Key, Read));
+
+	std::vector<uint8_t> HeaderOnly(Good.begin(), Good.begin() + 10);
+	WriteWholeFile(Path, HeaderOnly);
+	CHECK(!ReadShaderCacheFile(Path, Key, Read));
+
+	std::vector<uint8_t> WrongVersion = Good;
+	WrongVersion[4] ^= 0xff;
+	WriteWholeFile(Path, WrongVersion);
+	CHECK(!ReadShaderCacheFile(Path, Key, Read));
+
+	// Writing again replaces whatever is there
+	CHECK(WriteShaderCacheFile(Path, Key, ByteCode.data(), ByteCode.size()));
+	CHECK(ReadShaderCacheFile(Path, Key, Read));
+	CHECK(Read == ByteCode);
+	remove(Path.c_str());
+}
+
+static void TestPipelineCacheFile()
+{
+	const std::string Path = std::string(TestDirectory) + "/pipelines.bin";
+	PipelineCacheFileHeader Identity = {};
+	Identity.Magic = PipelineCacheMagic;
+	Identity.Version = PipelineCacheVersion;
+	Identity.VendorId = 0x10de;
+	Identity.DeviceId = 0x2204;
+	Identity.SubSysId = 1;
+	Identity.Revision = 2;
+
+	std::vector<uint8_t> Library(5000);
+	for (size_t i = 0; i < Library.size(); i++)
+	{
+		Library[i] = (uint8_t)(i ^ (i >> 8));
+	}
+
+	std::vector<uint8_t> Read;
+	CHECK(WritePipelineCacheFile(Path, Identity, Library.data(), Library.size()));
+	CHECK(ReadPipelineCacheFile(Path, Identity, Read));
+	CHECK(Read == Library);
+
+	// A file from another adapter, or another revision of the same one, is rejected
+	PipelineCacheFileHeader OtherDevice = Identity;
+	OtherDevice.DeviceId++;
+	CHECK(!ReadPipelineCacheFile(Path, OtherDevice, Read));
+	CHECK(Read.empty());
+	PipelineCacheFileHeader OtherRevision = Identity;
+	OtherRevision.Revision++;
+	CHECK(!ReadPipelineCacheFile(Path, OtherRevision, Read));
+
+	const std::vector<uint8_t> Good = ReadWholeFile(Path);
+	std::vector<uint8_t> Truncated(Good.begin(), Good.end() - 100);
+	WriteWholeFile(Path, Truncated);
+	CHECK(!ReadPipelineCacheFile(Path, Identity, Read));
+
+	std::vector<uint8_t> Corrupt = Good;
+	Corrupt.back() ^= 0x80;
+	WriteWholeFile(Path, Corrupt);
+	CHECK(!ReadPipelineCacheFile(Path, Identity, Read));
+	CHECK(Read.empty());
+
+	// An empty library is a valid file
+	CHECK(WritePipelineCacheFile(Path, Identity, nullptr, 0));
+	CHECK(ReadPipelineCacheFile(Path, Identity, Read));
+	CHECK(Read.empty());
+	remove(Path.c_str());
+}
+
+static void TestWriteFileReplacing()
+{
+	const std::string Path = std::string(TestDirectory) + "/replace.bin";
+	const uint32_t Header = 0xfeedface;
+	const char First[] = "first contents, longer than the second";
+	const char Second[] = "second";
+
+	CHECK(WriteFileReplacing(Path, &Header, sizeof(Header), First, sizeof(First)));
+	CHECK(WriteFileReplacing(Path, &Header, sizeof(Header), Second, sizeof(Second)));
+	const std::vector<uint8_t> Data = ReadWholeFile(Path);
+	CHECK_EQ(sizeof(Header) + sizeof(Second), Data.size());
+	CHECK(Data.size() == sizeof(Header) + sizeof(Second) && memcmp(Data.data() + sizeof(Header), Second, sizeof(Second)) == 0);
+
+	// A directory that doesn't exist fails cleanly
+	CHECK(!WriteFileReplacing(std::string(TestDirectory) + "/missing/file.bin", &Header, sizeof(Header), First, sizeof(First)));
+	remove(Path.c_str());
+}
+
+int main()
+{
+	PlatformCreateDirectory(TestDirectory);
+	TestHashBytes();
+	TestPipelineDescHasher();
+	TestShaderCacheKey();
+	TestShaderCacheFile();
+	TestPipelineCacheFile();
+	TestWriteFileReplacing();
+	return TestResult("CacheFilesTests");
+}
@@ -0,0 +1,146 @@
+#include "Core/CacheSim.h"
+
+#include "TestCommon.h"
+
+static void TestLRU()
+{
+	// 8 sets of 2 ways, so addresses 512 bytes apart share a set
+	CacheSim Cache;
+	Cache.Init({ 1, 64, 2 });
+	CHECK_EQ(8, Cache.NumSets);
+
+	CHECK(!Cache.Access(0, true));
+	CHECK(!Cache.Access(512, false));
+	CHECK(Cache.Access(32, false));			// Same line as 0
+	CHECK(!Cache.Access(1024, false));		// Evicts 512, the least recently used
+	CHECK(Cache.Access(0, false));
+	CHECK(!Cache.Access(512, false));		// Evicts 1024
+	CHECK(!Cache.Access(64, false));		// Another set
+	CHECK_EQ(0, Cache.Writebacks);
+	CHECK(!Cache.Access(1536, false));		// Evicts the dirty line at 0
+	CHECK_EQ(1, Cache.Writebacks);
+	CHECK_EQ(2, Cache.Hits);
+	CHECK_EQ(6, Cache.Misses);
+
+	CHECK(Cache.Access(64, true));
+	CHECK_EQ(1, Cache.Flush());
+	CHECK_EQ(0, Cache.Flush());
+	CHECK_EQ(2, Cache.Writebacks);
+}
+
+// Every texel of the texture appears in the stream exactly once, in waves no wider than the config's
+static bool CoversOnce(const SimStream& Stream, int Width, int Height, int WaveSize)
+{
+	std::vector<int> Counts((size_t)Width * Height, 0);
+	uint32_t Expected = 0;
+	bool bOk = true;
+	for (const SimWave& Wave : Stream.Waves)
+	{
+		bOk &= Wave.FirstTexel == Expected && Wave.NumTexels > 0 && Wave.NumTexels <= (uint32_t)WaveSize;
+		Expected += Wave.NumTexels;
+	}
+	bOk &= Expected == Stream.Texels.size();
+	for (uint32_t Texel : Stream.Texels)
+	{
+		Counts[(Texel >> 16) * Width + (Texel & 0xffff)]++;
+	}
+	for (int Count : Counts)
+	{
+		bOk &= Count == 1;
+	}
+	return bOk;
+}
+
+static void TestStreams()
+{
+	CacheSimConfig Config;
+	const int Width = 100;
+	const int Height = 70;
+
+	CSDispatch Dispatch;
+	Dispatch.NumThreads[0] = 8;
+	Dispatch.NumThreads[1] = 8;
+	Dispatch.GroupCount[0] = (Width + 7) / 8;
+	Dispatch.GroupCount[1] = (Height + 7) / 8;
+	const CSDispatchOrder Orders[] = { CSDispatchOrder::RowMajor, CSDispatchOrder::ColumnMajor, CSDispatchOrder::Morton, CSDispatchOrder::ColumnTiled };
+	for (CSDispatchOrder Order : Orders)
+	{
+		Dispatch.Order = Order;
+		SimStream Stream;
+		BuildCSCopyStream(Dispatch, Width, Height, Config, Stream);
+		CHECK(CoversOnce(Stream, Width, Height, Config.WaveSize));
+	}
+
+	// A 1x1 group is a wave of one live lane
+	CSDispatch Single;
+	Single.GroupCount[0] = 4;
+	Single.GroupCount[1] = 3;
+	SimStream SingleStream;
+	BuildCSCopyStream(Single, 4, 3, Config, SingleStream);
+	CHECK_EQ(12, SingleStream.Waves.size());
+	CHECK(CoversOnce(SingleStream, 4, 3, 1));
+
+	SimStream PSStream;
+	BuildPSCopyStream(Width, Height, Config, PSStream);
+	CHECK(CoversOnce(PSStream, Width, Height, Config.WaveSize));
+
+	const SimLayout Layouts[] = { SimLayout::Linear, SimLayout::Tiled, SimLayout::StandardSwizzle };
+	for (SimLayout Layout : Layouts)
+	{
+		SimStream CopyStream;
+		BuildCopyResourceStream(Layout, Width, Height, Config, CopyStream);
+		CHECK(CoversOnce(CopyStream, Width, Height, Config.WaveSize));
+		for (const SimWave& Wave : CopyStream.Waves)
+		{
+			CHECK_EQ(-1, Wave.CU);
+		}
+	}
+}
+
+// A texture that fits in the L2 is read from DRAM once and written back once, and a linear row-major
+// copy coalesces every wave of 32 texels into one 128 byte line
+static void TestSimulateCopy()
+{
+	CacheSimConfig Config;
+	const int Size = 256;
+	const uint64_t TextureBytes = (uint64_t)Size * Size * 4;
+
+	const SimLayout Layouts[] = { SimLayout::Linear, SimLayout::Tiled, SimLayout::StandardSwizzle };
+	for (SimLayout Layout : Layouts)
+	{
+		SimStream Stream;
+		BuildCopyResourceStream(Layout, Size, Size, Config, Stream);
+		const CacheSimResult Result = SimulateCopy(Stream, Layout, Size, Size, Config);
+		CHECK_EQ(TextureBytes, Result.DRAMReadBytes);
+		CHECK_EQ(TextureBytes, Result.DRAMWriteBytes);
+		CHECK_EQ(2 * Size * Size, Result.Lanes);
+		CHECK_EQ(0, Result.L1Accesses);
+	}
+
+	CSDispatch Dispatch;
+	Dispatch.NumThreads[0] = 32;
+	Dispatch.GroupCount[0] = Size / 32;
+	Dispatch.GroupCount[1] = Size;
+	SimStream Stream;
+	BuildCSCopyStream(Dispatch, Size, Size, Config, Stream);
+	const CacheSimResult Result = SimulateCopy(Stream, SimLayout::Linear, Size, Size, Config);
+	CHECK_EQ(Result.Requests, Result.Transactions);
+	CHECK_EQ(Result.Requests / 2, Result.L1Accesses);
+	CHECK_EQ(0, Result.L1Hits);
+	CHECK_EQ(TextureBytes, Result.DRAMReadBytes);
+	CHECK_EQ(TextureBytes, Result.DRAMWriteBytes);
+
+	// A row-major copy never comes back to a line, so even an L2 far smaller than the texture reads each once
+	CacheSimConfig Small = Config;
+	Small.L2 = { 16, 128, 4 };
+	const CacheSimResult SmallResult = SimulateCopy(Stream, SimLayout::Linear, Size, Size, Small);
+	CHECK_EQ(TextureBytes, SmallResult.DRAMReadBytes);
+}
+
+int main()
+{
+	TestLRU();
+	TestStreams();
+	TestSimulateCopy();
+	return TestResult("CacheSimTests");
+}
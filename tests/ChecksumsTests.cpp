@@ -0,0 +1,157 @@
+#include "Core/Checksums.h"
+
+#include "TestCommon.h"
+
+// Checksums a bit at a time, independent of the kernels' tables
+static uint32_t ReferenceCrc32State(uint32_t Crc, const uint8_t* Data, size_t Len)
+{
+	for (size_t i = 0; i < Len; i++)
+	{
+		Crc ^= Data[i];
+		for (int Bit = 0; Bit < 8; Bit++)
+		{
+			Crc = (Crc >> 1) ^ (0xedb88320u & (0u - (Crc & 1)));
+		}
+	}
+	return Crc;
+}
+
+static uint32_t ReferenceAdler32State(uint32_t Adler, const uint8_t* Data, size_t Len)
+{
+	uint32_t S1 = Adler & 0xffff;
+	uint32_t S2 = Adler >> 16;
+	for (size_t i = 0; i < Len; i++)
+	{
+		S1 = (S1 + Data[i]) % 65521;
+		S2 = (S2 + S1) % 65521;
+	}
+	return (S2 << 16) | S1;
+}
+
+struct ChecksumKernel
+{
+	const char* Name;
+	ChecksumFunc Func;
+	ChecksumFunc Reference;
+	uint32_t Initial;
+	bool Supported;
+};
+
+static std::vector<ChecksumKernel> GetKernels()
+{
+	const CPUFeatures& Features = GetCPUFeatures();
+	(void)Features;
+	return
+	{
+		{ "Crc32Bytewise", Crc32Bytewise, ReferenceCrc32State, ~0u, true },
+		{ "Crc32Slice8", Crc32Slice8, ReferenceCrc32State, ~0u, true },
+#if CPU_X86
+		{ "Crc32Pclmul", Crc32Pclmul, ReferenceCrc32State, ~0u, Features.PCLMUL && Features.SSE41 },
+#elif CPU_ARM64
+		{ "Crc32Arm", Crc32Arm, ReferenceCrc32State, ~0u, Features.ARMCRC32 },
+#endif
+		{ "Adler32Scalar", Adler32Scalar, ReferenceAdler32State, 1, true },
+#if CPU_X86
+		{ "Adler32SSSE3", Adler32SSSE3, ReferenceAdler32State, 1, Features.SSSE3 },
+#elif CPU_ARM64
+		{ "Adler32Neon", Adler32Neon, ReferenceAdler32State, 1, true },
+#endif
+	};
+}
+
+static std::vector<uint8_t> MakeRandomBytes(size_t Size, uint32_t Seed)
+{
+	std::vector<uint8_t> Bytes(Size);
+	uint32_t State = Seed | 1;
+	for (uint8_t& Byte : Bytes)
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		Byte = (uint8_t)State;
+	}
+	return Bytes;
+}
+
+static void TestKnownValues()
+{
+	// The check values from the CRC catalogue and the Adler-32 definition
+	unsigned char Digits[] = "123456789";
+	CHECK_EQ(0xcbf43926u, Crc32(Digits, 9));
+	unsigned char Word[] = "Wikipedia";
+	CHECK_EQ(0x11e60398u, Adler32(Word, 9));
+	CHECK_EQ(0u, Crc32(Digits, 0));
+	CHECK_EQ(1u, Adler32(Digits, 0));
+}
+
+// Every length up to a few vector blocks past each kernel's bulk loop, from every start offset within a
+// 16 byte line, so each head and tail split the SIMD kernels hand to the scalar ones gets covered
+static void TestAgainstReference()
+{
+	const size_t MaxLen = 300;
+	const size_t MaxOffset = 16;
+	const std::vector<uint8_t> Data = MakeRandomBytes(MaxLen + MaxOffset, 7);
+	for (const ChecksumKernel& Kernel : GetKernels())
+	{
+		if (!Kernel.Supported)
+		{
+			printf("%s: not supported on this CPU, skipped\n", Kernel.Name);
+			continue;
+		}
+
+		int Mismatches = 0;
+		for (size_t Offset = 0; Offset < MaxOffset; Offset++)
+		{
+			for (size_t Len = 0; Len <= MaxLen; Len++)
+			{
+				const uint8_t* Bytes = Data.data() + Offset;
+				if (Kernel.Func(Kernel.Initial, Bytes, Len) != Kernel.Reference(Kernel.Initial, Bytes, Len))
+				{
+					if (Mismatches++ == 0)
+					{
+						printf("%s: mismatch at offset %zu, length %zu\n", Kernel.Name, Offset, Len);
+					}
+				}
+			}
+		}
+		CHECK_EQ(0, Mismatches);
+	}
+}
+
+// Lengths past the point the Adler sums have to be reduced, with all-0xff bytes to push the sums to their
+// largest, and chained calls whose state crosses a misaligned split
+static void TestLongAndChained()
+{
+	const size_t Lengths[] = { 5551, 5552, 5553, 5552 * 3 + 31, 65536 + 17, 1 << 20 };
+	const std::vector<uint8_t> Random = MakeRandomBytes((1 << 20) + 16, 11);
+	const std::vector<uint8_t> Saturated((1 << 20) + 16, 0xff);
+	for (const ChecksumKernel& Kernel : GetKernels())
+	{
+		if (!Kernel.Supported)
+		{
+			continue;
+		}
+
+		for (const std::vector<uint8_t>* Data : { &Random, &Saturated })
+		{
+			for (size_t Len : Lengths)
+			{
+				const uint8_t* Bytes = Data->data() + 3;
+				const uint32_t Expected = Kernel.Reference(Kernel.Initial, Bytes, Len);
+				CHECK_EQ(Expected, Kernel.Func(Kernel.Initial, Bytes, Len));
+
+				const size_t Split = Len / 3 + 5;
+				const uint32_t Head = Kernel.Func(Kernel.Initial, Bytes, Split);
+				CHECK_EQ(Expected, Kernel.Func(Head, Bytes + Split, Len - Split));
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestKnownValues();
+	TestAgainstReference();
+	TestLongAndChained();
+	return TestResult("ChecksumsTests");
+}
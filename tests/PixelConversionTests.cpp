@@ -0,0 +1,196 @@
+#include "Core/PixelConversion.h"
+
+#include "TestCommon.h"
+
+static const ConvertFormat AllFormats[] =
+{
+	ConvertFormat::R8G8B8A8,
+	ConvertFormat::B8G8R8A8,
+	ConvertFormat::R10G10B10A2,
+	ConvertFormat::R16G16B16A16F,
+	ConvertFormat::R32G32B32A32F,
+};
+
+static const char* GetFormatName(ConvertFormat Format)
+{
+	const char* Names[] = { "R8G8B8A8", "B8G8R8A8", "R10G10B10A2", "R16G16B16A16F", "R32G32B32A32F" };
+	return Names[(int)Format];
+}
+
+static float BitsToFloat(uint32_t Bits)
+{
+	float Value;
+	memcpy(&Value, &Bits, 4);
+	return Value;
+}
+
+// Random texels with the awkward float values mixed in: NaNs of both signs, infinities, negatives, zeros of
+// both signs, denormals, the largest half, and alphas outside [0, 1]
+static std::vector<uint8_t> MakeSourceRow(ConvertFormat Format, int Width, uint32_t Seed)
+{
+	const int BytesPerPixel = GetConvertFormatBytesPerPixel(Format);
+	std::vector<uint8_t> Row((size_t)Width * BytesPerPixel);
+	uint32_t State = Seed | 1;
+	auto Next = [&State]()
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	};
+	for (uint8_t& Byte : Row)
+	{
+		Byte = (uint8_t)Next();
+	}
+
+	if (Format == ConvertFormat::R32G32B32A32F)
+	{
+		const float Specials[] = { NAN, -NAN, INFINITY, -INFINITY, -1.0f, -0.0f, 0.0f, BitsToFloat(1), 0.5f, 1.0f, 2.0f,
+			65504.0f, 65505.0f, 1e30f };
+		for (size_t i = 0; i < Row.size() / 4; i++)
+		{
+			if (Next() % 2 == 0)
+			{
+				const float Value = Specials[Next() % (sizeof(Specials) / sizeof(Specials[0]))];
+				memcpy(&Row[i * 4], &Value, 4);
+			}
+			else if (Next() % 2 == 0)
+			{
+				// Keep some ordinary values in the useful range as well as random bit patterns
+				const float Value = (float)(Next() % 4000) / 1000.0f - 1.0f;
+				memcpy(&Row[i * 4], &Value, 4);
+			}
+		}
+	}
+	else if (Format == ConvertFormat::R16G16B16A16F)
+	{
+		const uint16_t Specials[] = { 0x7e00, 0xfe00, 0x7c01, 0x7c00, 0xfc00, 0xbc00, 0x8000, 0x0000, 0x0001, 0x03ff,
+			0x3800, 0x3c00, 0x4000, 0x7bff };
+		for (size_t i = 0; i < Row.size() / 2; i++)
+		{
+			if (Next() % 2 == 0)
+			{
+				const uint16_t Value = Specials[Next() % (sizeof(Specials) / sizeof(Specials[0]))];
+				memcpy(&Row[i * 2], &Value, 2);
+			}
+		}
+	}
+	return Row;
+}
+
+// The scalar paths against hand-worked values, so the SIMD comparisons below are against something right
+static void TestScalarValues()
+{
+	CHECK(HalfToFloat(0x3c00) == 1.0f);
+	CHECK(HalfToFloat(0xc000) == -2.0f);
+	CHECK(HalfToFloat(0x7bff) == 65504.0f);
+	CHECK(HalfToFloat(0x0001) == BitsToFloat(0x33800000));
+	CHECK(HalfToFloat(0x7c00) == INFINITY);
+	CHECK(HalfToFloat(0x7e00) != HalfToFloat(0x7e00));
+
+	CHECK_EQ(0, ToneMapChannel(NAN));
+	CHECK_EQ(0, ToneMapChannel(-NAN));
+	CHECK_EQ(0, ToneMapChannel(-INFINITY));
+	CHECK_EQ(0, ToneMapChannel(-1.0f));
+	CHECK_EQ(255, ToneMapChannel(INFINITY));
+	CHECK_EQ(180, ToneMapChannel(1.0f));
+	CHECK_EQ(0, AlphaChannel(NAN));
+	CHECK_EQ(0, AlphaChannel(-1.0f));
+	CHECK_EQ(128, AlphaChannel(0.5f));
+	CHECK_EQ(255, AlphaChannel(INFINITY));
+
+	for (uint32_t Value = 0; Value < 1024; Value++)
+	{
+		CHECK_EQ((Value * 255 + 511) / 1023, Unorm10ToUnorm8(Value));
+	}
+
+	const uint8_t BGRA[] = { 1, 2, 3, 4 };
+	uint8_t RGBA[4] = {};
+	ConvertRowBGRA8Scalar(BGRA, RGBA, 1);
+	CHECK(RGBA[0] == 3 && RGBA[1] == 2 && RGBA[2] == 1 && RGBA[3] == 4);
+
+	const uint32_t Packed = 1023u | (512u << 10) | (0u << 20) | (2u << 30);
+	ConvertRowR10G10B10A2Scalar((const uint8_t*)&Packed, RGBA, 1);
+	CHECK(RGBA[0] == 255 && RGBA[1] == 128 && RGBA[2] == 0 && RGBA[3] == 170);
+}
+
+// Every SIMD level's converter against the scalar one, for widths that leave every possible tail after the
+// 4 and 16 texel loops, from a source and to a destination that are both one byte off alignment. The bytes
+// either side of the destination row have to be left alone.
+static void TestSimdMatchesScalar()
+{
+	const int Guard = 64;
+	for (ConvertFormat Format : AllFormats)
+	{
+		const RowConvertFunc Scalar = SelectRowConverter(Format, 0);
+		CHECK(Scalar != nullptr);
+		for (int Level = 1; Level <= 2; Level++)
+		{
+			const RowConvertFunc Converter = SelectRowConverter(Format, Level);
+			if (Converter == Scalar)
+			{
+				continue;
+			}
+
+			int Mismatches = 0;
+			for (int Width = 0; Width <= 70; Width++)
+			{
+				const std::vector<uint8_t> Row = MakeSourceRow(Format, Width, 17 + Width);
+				std::vector<uint8_t> Source(Row.size() + 1);
+				memcpy(Source.data() + 1, Row.data(), Row.size());
+
+				std::vector<uint8_t> Expected((size_t)Width * 4 + Guard * 2, 0xcd);
+				std::vector<uint8_t> Actual(Expected.size() + 1, 0xcd);
+				Scalar(Source.data() + 1, Expected.data() + Guard, Width);
+				Converter(Source.data() + 1, Actual.data() + 1 + Guard, Width);
+				if (memcmp(Expected.data(), Actual.data() + 1, Expected.size()) != 0)
+				{
+					if (Mismatches++ == 0)
+					{
+						printf("%s level %d: differs from scalar at width %d\n", GetFormatName(Format), Level, Width);
+					}
+				}
+			}
+			CHECK_EQ(0, Mismatches);
+		}
+	}
+}
+
+// A whole padded image through ConvertToRGBA8 matches converting its rows one at a time with the scalar kernels
+static void TestConvertImage()
+{
+	const int Width = 333;
+	const int Height = 7;
+	for (ConvertFormat Format : AllFormats)
+	{
+		const int RowBytes = Width * GetConvertFormatBytesPerPixel(Format);
+		for (int Pitch : { 0, RowBytes + 52 })
+		{
+			const int SourcePitch = Pitch != 0 ? Pitch : RowBytes;
+			std::vector<uint8_t> Source((size_t)SourcePitch * Height);
+			for (int y = 0; y < Height; y++)
+			{
+				const std::vector<uint8_t> Row = MakeSourceRow(Format, Width, 100 + y);
+				memcpy(&Source[(size_t)y * SourcePitch], Row.data(), Row.size());
+			}
+
+			std::vector<uint8_t> Expected((size_t)Width * Height * 4);
+			for (int y = 0; y < Height; y++)
+			{
+				SelectRowConverter(Format, 0)(&Source[(size_t)y * SourcePitch], &Expected[(size_t)y * Width * 4], Width);
+			}
+
+			std::vector<uint8_t> Actual(Expected.size());
+			ConvertToRGBA8(Source.data(), Pitch, Format, Width, Height, Actual.data());
+			CHECK(Actual == Expected);
+		}
+	}
+}
+
+int main()
+{
+	TestScalarValues();
+	TestSimdMatchesScalar();
+	TestConvertImage();
+	return TestResult("PixelConversionTests");
+}
@@ -0,0 +1,200 @@
+#include "Core/SWRasterizer.h"
+
+#include "TestCommon.h"
+
+static const int RTSize = 64;
+
+// Counts how many times each pixel is shaded, in place of the copy shader
+static void CountSpan(const SWShadeState& State, int Y, int X0, int X1)
+{
+	uint32_t* Row = (uint32_t*)(State.RenderTarget + (size_t)Y * State.RenderTargetPitch);
+	for (int X = X0; X < X1; X++)
+	{
+		Row[X]++;
+	}
+}
+
+// A strip over the pixel rectangle [Left, Right) x [Top, Bottom) in the same vertex order as the
+// pixel shader copy's quad, which winds counterclockwise on screen
+static void MakeQuad(float Left, float Top, float Right, float Bottom, float Positions[16])
+{
+	const float X[4] = { Left, Right, Left, Right };
+	const float Y[4] = { Bottom, Bottom, Top, Top };
+	for (int v = 0; v < 4; v++)
+	{
+		Positions[v * 4 + 0] = X[v] * 2.0f / RTSize - 1.0f;
+		Positions[v * 4 + 1] = 1.0f - Y[v] * 2.0f / RTSize;
+		Positions[v * 4 + 2] = 0.0f;
+		Positions[v * 4 + 3] = 1.0f;
+	}
+}
+
+struct CountTarget
+{
+	std::vector<uint32_t> Counts = std::vector<uint32_t>(RTSize * RTSize, 0);
+	SWShadeState State = { nullptr, 0, 0, 0, (uint8_t*)Counts.data(), RTSize, RTSize, RTSize * 4 };
+
+	int Total() const
+	{
+		int Sum = 0;
+		for (uint32_t Count : Counts)
+		{
+			Sum += (int)Count;
+		}
+		return Sum;
+	}
+};
+
+static const SWViewport FullViewport = { 0.0f, 0.0f, (float)RTSize, (float)RTSize };
+static const SWRect FullScissor = { 0, 0, RTSize, RTSize };
+
+// Edges through pixel centers: the top and left ones take the pixels on them, the bottom and right
+// ones don't, and the diagonal the two triangles share shades each of its pixels once
+static void TestTopLeftRule(WorkStealingScheduler& Scheduler)
+{
+	SWRasterizer Raster;
+	Raster.Scheduler = &Scheduler;
+	Raster.Shader = CountSpan;
+
+	float Quad[16];
+	MakeQuad(10.5f, 5.5f, 20.5f, 15.5f, Quad);
+	CountTarget Target;
+	Raster.DrawTriangleStrip(Quad, 4, FullViewport, FullScissor, Target.State);
+
+	bool bExact = true;
+	for (int Y = 0; Y < RTSize; Y++)
+	{
+		for (int X = 0; X < RTSize; X++)
+		{
+			const uint32_t Expected = X >= 10 && X < 20 && Y >= 5 && Y < 15 ? 1 : 0;
+			bExact &= Target.Counts[Y * RTSize + X] == Expected;
+		}
+	}
+	CHECK(bExact);
+
+	// Off-center edges: pixels whose centers are inside, each exactly once
+	MakeQuad(3.3f, 7.9f, 41.7f, 30.2f, Quad);
+	CountTarget Offset;
+	Raster.DrawTriangleStrip(Quad, 4, FullViewport, FullScissor, Offset.State);
+	CHECK_EQ(39 * 22, Offset.Total());
+	CHECK_EQ(1, Offset.Counts[8 * RTSize + 3]);
+	CHECK_EQ(0, Offset.Counts[8 * RTSize + 2]);
+	CHECK_EQ(0, Offset.Counts[7 * RTSize + 3]);
+	CHECK_EQ(1, Offset.Counts[29 * RTSize + 41]);
+	CHECK_EQ(0, Offset.Counts[30 * RTSize + 41]);
+	CHECK_EQ(0, Offset.Counts[29 * RTSize + 42]);
+}
+
+static void TestCulling(WorkStealingScheduler& Scheduler)
+{
+	float Quad[16];
+	MakeQuad(0.0f, 0.0f, 32.0f, 32.0f, Quad);
+
+	struct Case
+	{
+		SWCullMode CullMode;
+		bool bFrontCounterClockwise;
+		int Expected;
+	};
+	const Case Cases[] =
+	{
+		{ SWCullMode::None, false, 32 * 32 },
+		{ SWCullMode::Back, false, 0 },
+		{ SWCullMode::Back, true, 32 * 32 },
+		{ SWCullMode::Front, false, 32 * 32 },
+		{ SWCullMode::Front, true, 0 },
+	};
+	for (const Case& C : Cases)
+	{
+		SWRasterizer Raster;
+		Raster.Scheduler = &Scheduler;
+		Raster.Shader = CountSpan;
+		Raster.RasterizerState.CullMode = C.CullMode;
+		Raster.RasterizerState.bFrontCounterClockwise = C.bFrontCounterClockwise;
+		CountTarget Target;
+		Raster.DrawTriangleStrip(Quad, 4, FullViewport, FullScissor, Target.State);
+		CHECK_EQ(C.Expected, Target.Total());
+	}
+}
+
+static void TestScissorAndViewport(WorkStealingScheduler& Scheduler)
+{
+	SWRasterizer Raster;
+	Raster.Scheduler = &Scheduler;
+	Raster.Shader = CountSpan;
+
+	float Quad[16];
+	MakeQuad(0.0f, 0.0f, (float)RTSize, (float)RTSize, Quad);
+
+	const SWRect Scissor = { 5, 6, 40, 50 };
+	CountTarget Scissored;
+	Raster.DrawTriangleStrip(Quad, 4, FullViewport, Scissor, Scissored.State);
+	CHECK_EQ(35 * 44, Scissored.Total());
+	CHECK_EQ(1, Scissored.Counts[6 * RTSize + 5]);
+	CHECK_EQ(0, Scissored.Counts[6 * RTSize + 40]);
+
+	// The quad fills the viewport, which is then the clip rect
+	const SWViewport Viewport = { 8.0f, 4.0f, 16.0f, 20.0f };
+	CountTarget Viewported;
+	Raster.DrawTriangleStrip(Quad, 4, Viewport, FullScissor, Viewported.State);
+	CHECK_EQ(16 * 20, Viewported.Total());
+	CHECK_EQ(1, Viewported.Counts[4 * RTSize + 8]);
+	CHECK_EQ(0, Viewported.Counts[24 * RTSize + 8]);
+}
+
+// The copy shader reproduces the texture when texels and pixels line up, whichever span shader runs
+static void TestCopyShaders(WorkStealingScheduler& Scheduler)
+{
+	const int TextureSize = (int)PSCopyUVScale;
+	std::vector<uint32_t> Texture((size_t)TextureSize * TextureSize);
+	uint32_t Random = 99;
+	for (uint32_t& Texel : Texture)
+	{
+		Random = Random * 1664525u + 1013904223u;
+		Texel = Random;
+	}
+
+	float Quad[16];
+	MakeQuad(0.0f, 0.0f, (float)RTSize, (float)RTSize, Quad);
+
+	const int Levels[] = { 0, 2 };
+	for (int Level : Levels)
+	{
+		SWRasterizer Raster;
+		Raster.Scheduler = &Scheduler;
+		Raster.Shader = SelectSWSpanShader(Level);
+
+		std::vector<uint32_t> Target(RTSize * RTSize, 0);
+		const SWShadeState State = { (const uint8_t*)Texture.data(), TextureSize, TextureSize, TextureSize * 4, (uint8_t*)Target.data(), RTSize, RTSize, RTSize * 4 };
+		Raster.DrawTriangleStrip(Quad, 4, FullViewport, FullScissor, State);
+
+		bool bCopied = true;
+		for (int Y = 0; Y < RTSize; Y++)
+		{
+			bCopied &= memcmp(&Target[Y * RTSize], &Texture[(size_t)Y * TextureSize], RTSize * 4) == 0;
+		}
+		CHECK(bCopied);
+	}
+
+	// Wrap addressing
+	CHECK_EQ(0, WrapTexel(0.0f, 16));
+	CHECK_EQ(15, WrapTexel(0.999f, 16));
+	CHECK_EQ(4, WrapTexel(1.25f, 16));
+	CHECK_EQ(12, WrapTexel(-0.25f, 16));
+}
+
+int main()
+{
+	const int ThreadCounts[] = { 0, 3 };
+	for (int Threads : ThreadCounts)
+	{
+		WorkStealingScheduler Scheduler;
+		Scheduler.Start(Threads);
+		TestTopLeftRule(Scheduler);
+		TestCulling(Scheduler);
+		TestScissorAndViewport(Scheduler);
+		TestCopyShaders(Scheduler);
+		Scheduler.Shutdown();
+	}
+	return TestResult("SWRasterizerTests");
+}
@@ -0,0 +1,114 @@
+#include "Core/SoftwareDescriptors.h"
+
+#include "TestCommon.h"
+
+// Stands in for D3D12_CPU_DESCRIPTOR_HANDLE
+struct TestHandle
+{
+	size_t ptr;
+};
+
+static SoftwareDescriptor MakeDescriptor(uint32_t Index)
+{
+	return { 0x1000 + Index, 1 + Index % 3, Index * 7, 4, Index % 5, 0, 0 };
+}
+
+static bool SameDescriptor(const SoftwareDescriptor& A, const SoftwareDescriptor& B)
+{
+	return memcmp(&A, &B, sizeof(A)) == 0;
+}
+
+// Splits Total descriptors into ranges of random sizes scattered through Heap, returning
+// where each descriptor of the flat sequence ended up
+static std::vector<uint32_t> MakeRanges(uint32_t Total, uint32_t& State, SoftwareDescriptor* Heap, std::vector<TestHandle>& Starts, std::vector<uint32_t>& Sizes)
+{
+	std::vector<uint32_t> Slots;
+	uint32_t Next = 0;
+	while (Slots.size() < Total)
+	{
+		State = State * 1664525u + 1013904223u;
+		const uint32_t Size = std::min<uint32_t>(1 + (State >> 24) % 6, Total - (uint32_t)Slots.size());
+		Next += (State >> 16) % 3;	// Gaps between ranges
+		Starts.push_back({ (size_t)(Heap + Next) });
+		Sizes.push_back(Size);
+		for (uint32_t i = 0; i < Size; i++)
+		{
+			Slots.push_back(Next++);
+		}
+	}
+	return Slots;
+}
+
+// Any split of the same descriptors into source and destination ranges copies like one flat range
+static void TestMatchesFlatCopy()
+{
+	uint32_t State = 5;
+	for (int Trial = 0; Trial < 200; Trial++)
+	{
+		const uint32_t Total = 1 + Trial % 40;
+		std::vector<SoftwareDescriptor> Src(Total * 3), Dst(Total * 3);
+		for (uint32_t i = 0; i < Src.size(); i++)
+		{
+			Src[i] = MakeDescriptor(i);
+		}
+		memset(Dst.data(), 0xcd, Dst.size() * sizeof(SoftwareDescriptor));
+		const std::vector<SoftwareDescriptor> Untouched = Dst;
+
+		std::vector<TestHandle> SrcStarts, DstStarts;
+		std::vector<uint32_t> SrcSizes, DstSizes;
+		const std::vector<uint32_t> SrcSlots = MakeRanges(Total, State, Src.data(), SrcStarts, SrcSizes);
+		const std::vector<uint32_t> DstSlots = MakeRanges(Total, State, Dst.data(), DstStarts, DstSizes);
+
+		CopySoftwareDescriptorRanges((uint32_t)DstStarts.size(), DstStarts.data(), DstSizes.data(), (uint32_t)SrcStarts.size(), SrcStarts.data(), SrcSizes.data(), sizeof(SoftwareDescriptor));
+
+		std::vector<bool> Written(Dst.size(), false);
+		bool bCopied = true;
+		for (uint32_t i = 0; i < Total; i++)
+		{
+			bCopied &= SameDescriptor(Dst[DstSlots[i]], Src[SrcSlots[i]]);
+			Written[DstSlots[i]] = true;
+		}
+		bool bGapsUntouched = true;
+		for (size_t i = 0; i < Dst.size(); i++)
+		{
+			bGapsUntouched &= Written[i] || SameDescriptor(Dst[i], Untouched[i]);
+		}
+		CHECK(bCopied);
+		CHECK(bGapsUntouched);
+	}
+}
+
+static void TestNullSizes()
+{
+	SoftwareDescriptor Src[4] = { MakeDescriptor(0), MakeDescriptor(1), MakeDescriptor(2), MakeDescriptor(3) };
+	SoftwareDescriptor Dst[8] = {};
+
+	// Null source sizes: four single descriptors into one range of four
+	const TestHandle SrcStarts[4] = { { (size_t)&Src[3] }, { (size_t)&Src[0] }, { (size_t)&Src[2] }, { (size_t)&Src[1] } };
+	const TestHandle DstStart = { (size_t)&Dst[2] };
+	const uint32_t DstSize = 4;
+	CopySoftwareDescriptorRanges(1, &DstStart, &DstSize, 4, SrcStarts, (const uint32_t*)nullptr, sizeof(SoftwareDescriptor));
+	CHECK(SameDescriptor(Dst[2], Src[3]));
+	CHECK(SameDescriptor(Dst[3], Src[0]));
+	CHECK(SameDescriptor(Dst[4], Src[2]));
+	CHECK(SameDescriptor(Dst[5], Src[1]));
+	CHECK_EQ(0, Dst[1].Resource);
+	CHECK_EQ(0, Dst[6].Resource);
+
+	// Null destination sizes, and the copy stops when the shorter side runs out
+	SoftwareDescriptor Scattered[8] = {};
+	const TestHandle DstStarts[2] = { { (size_t)&Scattered[7] }, { (size_t)&Scattered[0] } };
+	const TestHandle SrcStart = { (size_t)&Src[0] };
+	const uint32_t SrcSize = 4;
+	CopySoftwareDescriptorRanges(2, DstStarts, (const uint32_t*)nullptr, 1, &SrcStart, &SrcSize, sizeof(SoftwareDescriptor));
+	CHECK(SameDescriptor(Scattered[7], Src[0]));
+	CHECK(SameDescriptor(Scattered[0], Src[1]));
+	CHECK_EQ(0, Scattered[1].Resource);
+}
+
+int main()
+{
+	TestMatchesFlatCopy();
+	TestNullSizes();
+	return TestResult("SoftwareDescriptorsTests");
+}
@@ -0,0 +1,13 @@
+// stb_image_write built without STBIW_PARALLEL_FOR, the way it writes a PNG in one pass on the calling
+// thread, for StbImageWriteTests to compare the ParallelFor build against. Static, so the two builds
+// don't collide.
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+unsigned char* WritePNGSerial(const unsigned char* Pixels, int Stride, int Width, int Height, int Comp, int ForceFilter, bool bFlip, int* OutLen)
+{
+	stbi_write_force_png_filter = ForceFilter;
+	stbi_flip_vertically_on_write(bFlip);
+	return stbi_write_png_to_mem(Pixels, Stride, Width, Height, Comp, OutLen);
+}
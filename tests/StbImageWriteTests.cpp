@@ -0,0 +1,694 @@
+#include "Core/Platform.h"
+#include "Core/Checksums.h"
+#include "Core/SyntheticImage.h"
+#include "Core/WorkStealingScheduler.h"
+
+// The writer as the benchmark builds it: row bands filtered and deflate chunks compressed on ParallelFor,
+// checksummed by the SIMD kernels
+#define STBIW_PARALLEL_FOR(count, func, context) ParallelFor(count, func, context)
+#define STBIW_CRC32(buffer, len) Crc32(buffer, len)
+#define STBIW_ADLER32(data, len) Adler32(data, len)
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "TestCommon.h"
+
+// The writer without STBIW_PARALLEL_FOR, from StbImageWriteSerial.cpp
+unsigned char* WritePNGSerial(const unsigned char* Pixels, int Stride, int Width, int Height, int Comp, int ForceFilter, bool bFlip, int* OutLen);
+
+// Checksums a bit at a time, independent of the writer's tables and kernels
+static uint32_t ReferenceCrc32(const uint8_t* Data, size_t Size)
+{
+	uint32_t Crc = ~0u;
+	for (size_t i = 0; i < Size; i++)
+	{
+		Crc ^= Data[i];
+		for (int Bit = 0; Bit < 8; Bit++)
+		{
+			Crc = (Crc >> 1) ^ (0xedb88320u & (0u - (Crc & 1)));
+		}
+	}
+	return ~Crc;
+}
+
+static uint32_t ReferenceAdler32(const uint8_t* Data, size_t Size)
+{
+	uint32_t A = 1, B = 0;
+	for (size_t i = 0; i < Size; i++)
+	{
+		A = (A + Data[i]) % 65521;
+		B = (B + A) % 65521;
+	}
+	return (B << 16) | A;
+}
+
+static uint32_t ReadBigEndian32(const uint8_t* Data)
+{
+	return ((uint32_t)Data[0] << 24) | ((uint32_t)Data[1] << 16) | ((uint32_t)Data[2] << 8) | Data[3];
+}
+
+// Canonical Huffman code decoded a bit at a time: Count[n] codes of length n, their symbols in code order
+struct InflateHuffman
+{
+	uint16_t Count[16];
+	uint16_t Symbol[288];
+
+	void Build(const uint8_t* Lengths, int NumSymbols)
+	{
+		uint16_t Offsets[16];
+		memset(Count, 0, sizeof(Count));
+		for (int i = 0; i < NumSymbols; i++)
+		{
+			Count[Lengths[i]]++;
+		}
+		Count[0] = 0;
+		Offsets[1] = 0;
+		for (int Len = 1; Len < 15; Len++)
+		{
+			Offsets[Len + 1] = Offsets[Len] + Count[Len];
+		}
+		for (int i = 0; i < NumSymbols; i++)
+		{
+			if (Lengths[i] != 0)
+			{
+				Symbol[Offsets[Lengths[i]]++] = (uint16_t)i;
+			}
+		}
+	}
+};
+
+// Inflates a zlib stream (RFC 1950 around RFC 1951), checking the header and the Adler-32 trailer.
+// Slow and simple: it only has to decide whether the writer's output is valid and what it holds.
+struct Inflater
+{
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+	size_t Pos = 0;
+	uint32_t BitBuffer = 0;
+	int BitCount = 0;
+	bool bError = false;
+
+	uint32_t Bits(int Count)
+	{
+		while (BitCount < Count)
+		{
+			if (Pos >= Size)
+			{
+				bError = true;
+				return 0;
+			}
+			BitBuffer |= (uint32_t)Data[Pos++] << BitCount;
+			BitCount += 8;
+		}
+		const uint32_t Value = BitBuffer & ((1u << Count) - 1);
+		BitBuffer >>= Count;
+		BitCount -= Count;
+		return Value;
+	}
+
+	int Decode(const InflateHuffman& Huffman)
+	{
+		int Code = 0, First = 0, Index = 0;
+		for (int Len = 1; Len < 16 && !bError; Len++)
+		{
+			Code |= (int)Bits(1);
+			const int Count = Huffman.Count[Len];
+			if (Code - Count < First)
+			{
+				return Huffman.Symbol[Index + (Code - First)];
+			}
+			Index += Count;
+			First = (First + Count) << 1;
+			Code <<= 1;
+		}
+		bError = true;
+		return 0;
+	}
+
+	bool Codes(const InflateHuffman& LengthCode, const InflateHuffman& DistanceCode, std::vector<uint8_t>& Out)
+	{
+		static const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		for (;;)
+		{
+			const int Symbol = Decode(LengthCode);
+			if (bError)
+			{
+				return false;
+			}
+			if (Symbol < 256)
+			{
+				Out.push_back((uint8_t)Symbol);
+			}
+			else if (Symbol == 256)
+			{
+				return true;
+			}
+			else
+			{
+				if (Symbol - 257 >= 29)
+				{
+					return false;
+				}
+				const size_t Length = LengthBase[Symbol - 257] + Bits(LengthExtra[Symbol - 257]);
+				const int DistanceSymbol = Decode(DistanceCode);
+				if (bError || DistanceSymbol >= 30)
+				{
+					return false;
+				}
+				const size_t Distance = DistanceBase[DistanceSymbol] + Bits(DistanceExtra[DistanceSymbol]);
+				if (bError || Distance > Out.size() || Distance > 32768)
+				{
+					return false;
+				}
+				for (size_t i = 0; i < Length; i++)
+				{
+					Out.push_back(Out[Out.size() - Distance]);
+				}
+			}
+		}
+	}
+
+	bool Dynamic(std::vector<uint8_t>& Out)
+	{
+		static const uint8_t Order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		const int NumLengths = (int)Bits(5) + 257;
+		const int NumDistances = (int)Bits(5) + 1;
+		const int NumCodeLengths = (int)Bits(4) + 4;
+		if (NumLengths > 286 || NumDistances > 30)
+		{
+			return false;
+		}
+
+		uint8_t Lengths[320] = {};
+		for (int i = 0; i < NumCodeLengths; i++)
+		{
+			Lengths[Order[i]] = (uint8_t)Bits(3);
+		}
+		InflateHuffman CodeLengthCode;
+		CodeLengthCode.Build(Lengths, 19);
+
+		int Index = 0;
+		while (Index < NumLengths + NumDistances && !bError)
+		{
+			const int Symbol = Decode(CodeLengthCode);
+			if (Symbol < 16)
+			{
+				Lengths[Index++] = (uint8_t)Symbol;
+				continue;
+			}
+			uint8_t Repeated = 0;
+			int Repeat = 0;
+			if (Symbol == 16)
+			{
+				if (Index == 0)
+				{
+					return false;
+				}
+				Repeated = Lengths[Index - 1];
+				Repeat = 3 + (int)Bits(2);
+			}
+			else if (Symbol == 17)
+			{
+				Repeat = 3 + (int)Bits(3);
+			}
+			else
+			{
+				Repeat = 11 + (int)Bits(7);
+			}
+			if (Index + Repeat > NumLengths + NumDistances)
+			{
+				return false;
+			}
+			while (Repeat--)
+			{
+				Lengths[Index++] = Repeated;
+			}
+		}
+
+		InflateHuffman LengthCode, DistanceCode;
+		LengthCode.Build(Lengths, NumLengths);
+		DistanceCode.Build(Lengths + NumLengths, NumDistances);
+		return !bError && Codes(LengthCode, DistanceCode, Out);
+	}
+
+	bool Fixed(std::vector<uint8_t>& Out)
+	{
+		uint8_t Lengths[288 + 30];
+		memset(Lengths, 8, 144);
+		memset(Lengths + 144, 9, 112);
+		memset(Lengths + 256, 7, 24);
+		memset(Lengths + 280, 8, 8);
+		memset(Lengths + 288, 5, 30);
+		InflateHuffman LengthCode, DistanceCode;
+		LengthCode.Build(Lengths, 288);
+		DistanceCode.Build(Lengths + 288, 30);
+		return Codes(LengthCode, DistanceCode, Out);
+	}
+
+	bool Stored(std::vector<uint8_t>& Out)
+	{
+		BitBuffer = 0;
+		BitCount = 0;
+		if (Pos + 4 > Size)
+		{
+			return false;
+		}
+		const uint32_t Length = Data[Pos] | (Data[Pos + 1] << 8);
+		const uint32_t NotLength = Data[Pos + 2] | (Data[Pos + 3] << 8);
+		Pos += 4;
+		if (Length != (~NotLength & 0xffff) || Pos + Length > Size)
+		{
+			return false;
+		}
+		Out.insert(Out.end(), Data + Pos, Data + Pos + Length);
+		Pos += Length;
+		return true;
+	}
+
+	bool Zlib(const uint8_t* InData, size_t InSize, std::vector<uint8_t>& Out)
+	{
+		Data = InData;
+		Size = InSize;
+		if (Size < 6 || (Data[0] & 0x0f) != 8 || ((Data[0] << 8) | Data[1]) % 31 != 0 || (Data[1] & 0x20) != 0)
+		{
+			return false;
+		}
+		Pos = 2;
+
+		bool bFinal = false;
+		while (!bFinal)
+		{
+			bFinal = Bits(1) != 0;
+			const uint32_t Type = Bits(2);
+			const bool bBlock = Type == 0 ? Stored(Out) : Type == 1 ? Fixed(Out) : Type == 2 ? Dynamic(Out) : false;
+			if (!bBlock || bError)
+			{
+				return false;
+			}
+		}
+
+		// The trailer starts on the next byte boundary and ends the stream
+		return Pos + 4 == Size && ReadBigEndian32(Data + Pos) == ReferenceAdler32(Out.data(), Out.size());
+	}
+};
+
+static bool ZlibInflate(const uint8_t* Data, size_t Size, std::vector<uint8_t>& Out)
+{
+	Inflater State;
+	return State.Zlib(Data, Size, Out);
+}
+
+static int PaethPredictor(int A, int B, int C)
+{
+	const int P = A + B - C;
+	const int PA = abs(P - A), PB = abs(P - B), PC = abs(P - C);
+	return PA <= PB && PA <= PC ? A : PB <= PC ? B : C;
+}
+
+struct DecodedPNG
+{
+	int Width = 0;
+	int Height = 0;
+	int Comp = 0;
+	std::vector<uint8_t> Pixels;	// Width * Comp bytes per row
+	int FilterCounts[5] = {};
+};
+
+// Decodes the 8 bit, non-interlaced PNGs the writer produces, checking every chunk's CRC
+static bool DecodePNG(const uint8_t* Data, size_t Size, DecodedPNG& Out)
+{
+	static const uint8_t Signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (Size < 8 || memcmp(Data, Signature, 8) != 0)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> Compressed;
+	bool bHeader = false, bEnd = false;
+	size_t Pos = 8;
+	while (!bEnd)
+	{
+		if (Pos + 12 > Size)
+		{
+			return false;
+		}
+		const uint32_t Length = ReadBigEndian32(Data + Pos);
+		if (Pos + 12 + Length > Size || ReadBigEndian32(Data + Pos + 8 + Length) != ReferenceCrc32(Data + Pos + 4, Length + 4))
+		{
+			return false;
+		}
+		const uint8_t* Type = Data + Pos + 4;
+		const uint8_t* Body = Data + Pos + 8;
+		if (memcmp(Type, "IHDR", 4) == 0)
+		{
+			const int Comps[7] = { 1, 0, 3, 0, 2, 0, 4 };
+			if (Length != 13 || Body[8] != 8 || Body[9] > 6 || Comps[Body[9]] == 0 || Body[12] != 0)
+			{
+				return false;
+			}
+			Out.Width = (int)ReadBigEndian32(Body);
+			Out.Height = (int)ReadBigEndian32(Body + 4);
+			Out.Comp = Comps[Body[9]];
+			bHeader = true;
+		}
+		else if (memcmp(Type, "IDAT", 4) == 0)
+		{
+			Compressed.insert(Compressed.end(), Body, Body + Length);
+		}
+		else if (memcmp(Type, "IEND", 4) == 0)
+		{
+			bEnd = true;
+		}
+		Pos += 12 + Length;
+	}
+
+	std::vector<uint8_t> Filtered;
+	const size_t RowBytes = (size_t)Out.Width * Out.Comp;
+	if (!bHeader || Pos != Size || !ZlibInflate(Compressed.data(), Compressed.size(), Filtered) || Filtered.size() != (RowBytes + 1) * Out.Height)
+	{
+		return false;
+	}
+
+	Out.Pixels.resize(RowBytes * Out.Height);
+	const int Bpp = Out.Comp;
+	for (int y = 0; y < Out.Height; y++)
+	{
+		const uint8_t* In = &Filtered[(RowBytes + 1) * y];
+		uint8_t* Row = &Out.Pixels[RowBytes * y];
+		const uint8_t* Up = y > 0 ? Row - RowBytes : nullptr;
+		if (In[0] > 4)
+		{
+			return false;
+		}
+		Out.FilterCounts[In[0]]++;
+		for (size_t i = 0; i < RowBytes; i++)
+		{
+			const int A = i >= (size_t)Bpp ? Row[i - Bpp] : 0;
+			const int B = Up ? Up[i] : 0;
+			const int C = Up && i >= (size_t)Bpp ? Up[i - Bpp] : 0;
+			const int Predictors[5] = { 0, A, B, (A + B) >> 1, PaethPredictor(A, B, C) };
+			Row[i] = (uint8_t)(In[1 + i] + Predictors[In[0]]);
+		}
+	}
+	return true;
+}
+
+// Source rows Stride bytes apart, the first Width * Comp of each from the synthetic image and the padding
+// a pattern the PNG mustn't contain
+static std::vector<uint8_t> MakeSourcePixels(int Width, int Height, int Comp, int Stride, uint32_t Seed)
+{
+	const std::vector<uint8_t> RGBA = MakeSyntheticImage(Width, Height, Seed);
+	std::vector<uint8_t> Pixels((size_t)Stride * Height, 0xa5);
+	for (int y = 0; y < Height; y++)
+	{
+		for (int x = 0; x < Width; x++)
+		{
+			memcpy(&Pixels[(size_t)y * Stride + x * Comp], &RGBA[((size_t)y * Width + x) * 4], Comp);
+		}
+	}
+	return Pixels;
+}
+
+static bool MatchesSource(const DecodedPNG& Decoded, const std::vector<uint8_t>& Source, int Width, int Height, int Comp, int Stride, bool bFlip)
+{
+	if (Decoded.Width != Width || Decoded.Height != Height || Decoded.Comp != Comp)
+	{
+		return false;
+	}
+	const size_t RowBytes = (size_t)Width * Comp;
+	for (int y = 0; y < Height; y++)
+	{
+		const int SourceRow = bFlip ? Height - 1 - y : y;
+		if (memcmp(&Decoded.Pixels[RowBytes * y], &Source[(size_t)Stride * SourceRow], RowBytes) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Both builds at every component count, tight and padded strides, flipped or not, and each filter mode
+// (-1 and 5 pick per row). The 700 x 300 RGBA image is four deflate chunks and many filter bands; it only
+// runs the adaptive filter and sub, to keep the test quick.
+static void TestPNGRoundTrip()
+{
+	struct Case
+	{
+		int Width;
+		int Height;
+		int MinComp;
+		std::vector<int> Filters;
+	};
+	const Case Cases[] = {
+		{ 1, 1, 1, { -1, 0, 1, 2, 3, 4, 5 } },
+		{ 37, 23, 1, { -1, 0, 1, 2, 3, 4, 5 } },
+		{ 700, 300, 4, { -1, 1 } },
+	};
+	uint32_t Seed = 1;
+	for (const Case& Size : Cases)
+	{
+		for (int Comp = Size.MinComp; Comp <= 4; Comp++)
+		{
+			for (int Padding : { 0, 13 })
+			{
+				const int Stride = Size.Width * Comp + Padding;
+				const std::vector<uint8_t> Source = MakeSourcePixels(Size.Width, Size.Height, Comp, Stride, Seed++);
+				for (int Flip = 0; Flip < 2; Flip++)
+				{
+					for (int Filter : Size.Filters)
+					{
+						stbi_write_force_png_filter = Filter;
+						stbi_flip_vertically_on_write(Flip);
+						int ParallelLen = 0, SerialLen = 0;
+						unsigned char* Parallel = stbi_write_png_to_mem(Source.data(), Stride, Size.Width, Size.Height, Comp, &ParallelLen);
+						unsigned char* Serial = WritePNGSerial(Source.data(), Stride, Size.Width, Size.Height, Comp, Filter, Flip != 0, &SerialLen);
+						CHECK(Parallel != nullptr);
+						CHECK(Serial != nullptr);
+						if (!Parallel || !Serial)
+						{
+							free(Parallel);
+							free(Serial);
+							continue;
+						}
+
+						DecodedPNG ParallelPNG, SerialPNG;
+						const bool bParallelDecoded = DecodePNG(Parallel, ParallelLen, ParallelPNG);
+						const bool bSerialDecoded = DecodePNG(Serial, SerialLen, SerialPNG);
+						const bool bParallelMatches = bParallelDecoded && MatchesSource(ParallelPNG, Source, Size.Width, Size.Height, Comp, Stride, Flip != 0);
+						const bool bSerialMatches = bSerialDecoded && MatchesSource(SerialPNG, Source, Size.Width, Size.Height, Comp, Stride, Flip != 0);
+
+						// A forced filter is used on every row but the first, which has no row above
+						bool bForcedFilter = true;
+						if (Filter >= 0 && Filter < 5 && Size.Height > 1)
+						{
+							bForcedFilter = ParallelPNG.FilterCounts[Filter] >= Size.Height - 1 && SerialPNG.FilterCounts[Filter] >= Size.Height - 1;
+						}
+
+						// The bands filter rows the same way, so the builds only differ once deflate is chunked
+						const bool bOneChunk = (size_t)(Size.Width * Comp + 1) * Size.Height <= 256 * 1024;
+						const bool bSameBytes = !bOneChunk || (ParallelLen == SerialLen && memcmp(Parallel, Serial, SerialLen) == 0);
+
+						if (!bParallelMatches || !bSerialMatches || !bForcedFilter || !bSameBytes)
+						{
+							printf("%d x %d, comp %d, stride %d, flip %d, filter %d\n", Size.Width, Size.Height, Comp, Stride, Flip, Filter);
+						}
+						CHECK(bParallelMatches);
+						CHECK(bSerialMatches);
+						CHECK(bForcedFilter);
+						CHECK(bSameBytes);
+						free(Parallel);
+						free(Serial);
+					}
+				}
+			}
+		}
+	}
+	stbi_write_force_png_filter = -1;
+	stbi_flip_vertically_on_write(0);
+}
+
+// Whole-buffer deflate of random, repetitive and image bytes at three qualities. Every stream has to
+// inflate back to its input, and be no bigger than stb's original chained-hash match finder made it,
+// which searched the same candidates the flat head/prev chains do.
+static void TestZlibCompress()
+{
+	std::vector<uint8_t> Random(64 * 1024);
+	uint32_t State = 1;
+	for (uint8_t& Byte : Random)
+	{
+		Byte = (uint8_t)NextXorShift32(State);
+	}
+
+	// A sentence with a counter and a growing run of zeros after each copy, for matches at many lengths
+	// and distances
+	const char* Text = "the quick brown fox jumps over the lazy dog; ";
+	std::vector<uint8_t> Repetitive;
+	for (int i = 0; Repetitive.size() < 100 * 1024; i++)
+	{
+		Repetitive.insert(Repetitive.end(), Text, Text + strlen(Text));
+		Repetitive.push_back((uint8_t)('0' + i % 10));
+		Repetitive.insert(Repetitive.end(), (size_t)(i % 37), 0);
+	}
+
+	struct Input
+	{
+		const char* Name;
+		std::vector<uint8_t> Data;
+		int BaselineSizes[3];	// stb v1.15's sizes at each of Qualities
+	};
+	const int Qualities[3] = { 5, 8, 12 };
+	const Input Inputs[] = {
+		{ "random", Random, { 69105, 69105, 69105 } },
+		{ "repetitive", Repetitive, { 6538, 5297, 5070 } },
+		{ "synthetic image", MakeSyntheticImage(256, 256), { 122819, 119736, 117724 } },
+	};
+
+	for (const Input& In : Inputs)
+	{
+		for (int q = 0; q < 3; q++)
+		{
+			int Len = 0;
+			unsigned char* Compressed = stbi_zlib_compress((unsigned char*)In.Data.data(), (int)In.Data.size(), &Len, Qualities[q]);
+			CHECK(Compressed != nullptr);
+			if (!Compressed)
+			{
+				continue;
+			}
+			std::vector<uint8_t> Inflated;
+			const bool bRoundTrip = ZlibInflate(Compressed, Len, Inflated) && Inflated == In.Data;
+			if (!bRoundTrip || Len > In.BaselineSizes[q])
+			{
+				printf("%s at quality %d: %d bytes, baseline %d\n", In.Name, Qualities[q], Len, In.BaselineSizes[q]);
+			}
+			CHECK(bRoundTrip);
+			CHECK(Len <= In.BaselineSizes[q]);
+			free(Compressed);
+		}
+	}
+}
+
+static void AppendToVector(void* Context, void* Data, int Size)
+{
+	std::vector<uint8_t>* Out = (std::vector<uint8_t>*)Context;
+	Out->insert(Out->end(), (uint8_t*)Data, (uint8_t*)Data + Size);
+}
+
+static void WriteFileBytes(const std::string& Path, const void* Data, size_t Size)
+{
+	FILE* File = nullptr;
+	if (fopen_s(&File, Path.c_str(), "wb") == 0 && File)
+	{
+		fwrite(Data, 1, Size, File);
+		fclose(File);
+	}
+}
+
+// JPEGs at every DCT kernel level (0 scalar, 1 SSE2/NEON, 2 AVX2, each falling back to the one below when
+// the CPU lacks it) must match the scalar encode byte for byte. The qualities either side of 90 cover
+// 4:2:0 and 4:4:4, and the odd size partial blocks and MCUs. With a JpegDirectory, each JPEG is written
+// there with its source as a PPM, which tests/check_jpeg_decode.py decodes with PIL and compares.
+static void TestJpegSimdLevels(const char* JpegDirectory)
+{
+	struct Size
+	{
+		int Width;
+		int Height;
+	};
+	const Size Sizes[] = { { 37, 23 }, { 256, 128 } };
+	const int Qualities[] = { 10, 50, 75, 90, 95, 100 };
+	const int SavedSimd = stbi_write_jpg_max_simd;
+	uint32_t Seed = 1;
+	for (const Size& Size : Sizes)
+	{
+		for (int Comp = 1; Comp <= 4; Comp++)
+		{
+			const std::vector<uint8_t> Source = MakeSourcePixels(Size.Width, Size.Height, Comp, Size.Width * Comp, Seed++);
+			char Prefix[256];
+			snprintf(Prefix, sizeof(Prefix), "%s/jpeg_%dx%d_c%d", JpegDirectory ? JpegDirectory : ".", Size.Width, Size.Height, Comp);
+			if (JpegDirectory)
+			{
+				// The writer takes 1 and 2 components as grey and ignores alpha
+				char Header[64];
+				const int HeaderLen = snprintf(Header, sizeof(Header), "P6\n%d %d\n255\n", Size.Width, Size.Height);
+				std::vector<uint8_t> PPM(Header, Header + HeaderLen);
+				for (size_t i = 0; i < Source.size(); i += Comp)
+				{
+					PPM.push_back(Source[i]);
+					PPM.push_back(Source[i + (Comp > 2 ? 1 : 0)]);
+					PPM.push_back(Source[i + (Comp > 2 ? 2 : 0)]);
+				}
+				WriteFileBytes(std::string(Prefix) + "_source.ppm", PPM.data(), PPM.size());
+			}
+
+			for (int Quality : Qualities)
+			{
+				std::vector<uint8_t> Reference;
+				for (int Level = 0; Level < 3; Level++)
+				{
+					stbi_write_jpg_max_simd = Level;
+					std::vector<uint8_t> Encoded;
+					CHECK(stbi_write_jpg_to_func(AppendToVector, &Encoded, Size.Width, Size.Height, Comp, Source.data(), Quality) != 0);
+					if (Level == 0)
+					{
+						Reference = Encoded;
+					}
+					else if (Encoded != Reference)
+					{
+						printf("%d x %d, comp %d, quality %d: level %d differs from scalar\n", Size.Width, Size.Height, Comp, Quality, Level);
+						CHECK(Encoded == Reference);
+					}
+					if (JpegDirectory)
+					{
+						char Filename[320];
+						snprintf(Filename, sizeof(Filename), "%s_q%d_l%d.jpg", Prefix, Quality, Level);
+						WriteFileBytes(Filename, Encoded.data(), Encoded.size());
+					}
+				}
+			}
+		}
+	}
+	stbi_write_jpg_max_simd = SavedSimd;
+}
+
+// The inflater itself, on a stream with a dynamic block and a stored one, which the writer never emits
+static void TestInflater()
+{
+	// zlib.compress of the 64 bytes below at level 9, which is one dynamic block, and a stored "abc"
+	const char* DynamicText = "abbaacaaaaacaaacbabaabcaaaaabbbaabccbababbbaaabcaabbacabaaaaaaaa";
+	const uint8_t Dynamic[] = { 0x78, 0xda, 0x25, 0x8a, 0xc9, 0x11, 0x00, 0x00, 0x0c, 0x01, 0x6b, 0xb5, 0xfa, 0xef, 0x21, 0x81, 0x87, 0x59, 0x87, 0x40,
+		0xb2, 0xa2, 0xb8, 0xd1, 0x67, 0x56, 0x40, 0xb9, 0x5d, 0xb9, 0xc3, 0x83, 0x73, 0x9a, 0x0e, 0x19, 0x10, 0x18, 0x63 };
+	const uint8_t Stored[] = { 0x78, 0x01, 0x01, 0x03, 0x00, 0xfc, 0xff, 'a', 'b', 'c', 0x02, 0x4d, 0x01, 0x27 };
+	std::vector<uint8_t> Out;
+	CHECK(ZlibInflate(Dynamic, sizeof(Dynamic), Out));
+	CHECK(std::string(Out.begin(), Out.end()) == DynamicText);
+
+	Out.clear();
+	CHECK(ZlibInflate(Stored, sizeof(Stored), Out));
+	CHECK(std::string(Out.begin(), Out.end()) == "abc");
+
+	// A corrupted trailer fails
+	uint8_t Corrupt[sizeof(Stored)];
+	memcpy(Corrupt, Stored, sizeof(Stored));
+	Corrupt[sizeof(Corrupt) - 1] ^= 1;
+	Out.clear();
+	CHECK(!ZlibInflate(Corrupt, sizeof(Corrupt), Out));
+}
+
+// --write-jpegs Directory only runs the JPEG test, writing its images for check_jpeg_decode.py
+int main(int argc, char** argv)
+{
+	if (argc == 3 && strcmp(argv[1], "--write-jpegs") == 0)
+	{
+		TestJpegSimdLevels(argv[2]);
+		return TestResult("StbImageWriteTests --write-jpegs");
+	}
+
+	TestInflater();
+	TestZlibCompress();
+	TestPNGRoundTrip();
+	TestJpegSimdLevels(nullptr);
+	return TestResult("StbImageWriteTests");
+}
@@ -0,0 +1,112 @@
+#include "Core/Swizzle.h"
+
+#include "TestCommon.h"
+
+static const SwizzleLayout* const AllLayouts[] = { &StandardSwizzle64KB, &MortonSwizzle4KB, &RowTiled64KB };
+
+static void TestBitHelpers()
+{
+	CHECK_EQ(0x14, DepositBits(3, 0x14));
+	CHECK_EQ(0x10, DepositBits(2, 0x14));
+	CHECK_EQ(0xa0, DepositBits(0xa, 0xf0));
+	for (uint32_t Value = 0; Value < 256; Value++)
+	{
+		CHECK_EQ(Value, ExtractBits(DepositBits(Value, 0xaaaa), 0xaaaa));
+	}
+
+	// The x and y masks of a layout split a tile's bytes between them without overlapping
+	for (const SwizzleLayout* Layout : AllLayouts)
+	{
+		CHECK_EQ(0, Layout->XMask & Layout->YMask);
+		CHECK_EQ((uint32_t)Layout->TileWidth * Layout->TileHeight * 4 - 4, Layout->XMask | Layout->YMask);
+	}
+	CHECK_EQ(3 * 2 * 65536, GetSwizzledSize(StandardSwizzle64KB, 300, 200));
+}
+
+static void TestKnownOffsets()
+{
+	for (const SwizzleKnownOffset& Known : StandardSwizzle64KBKnownOffsets)
+	{
+		CHECK_EQ(Known.Offset, GetSwizzledTexelOffset(StandardSwizzle64KB, 128, Known.X, Known.Y));
+	}
+
+	// A 4 x 4 block is 64 bytes of 4 texel rows, in both Morton layouts
+	for (const SwizzleLayout* Layout : { &StandardSwizzle64KB, &MortonSwizzle4KB })
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				CHECK_EQ((size_t)(y * 16 + x * 4), GetSwizzledTexelOffset(*Layout, Layout->TileWidth, x, y));
+			}
+		}
+	}
+
+	// The second tile of a row starts after the first
+	CHECK_EQ(65536, GetSwizzledTexelOffset(StandardSwizzle64KB, 256, 128, 0));
+}
+
+// Linear to tiled puts every texel where GetSwizzledTexelOffset says, and back again restores the linear
+// texture, for each SIMD level and for sizes with ragged tiles and ragged 4 x 4 blocks
+static void TestConvert()
+{
+	const int Sizes[][2] = { { 128, 128 }, { 256, 130 }, { 301, 77 }, { 5, 3 }, { 64, 1 } };
+	const int Levels[] = { 0, 1, 2 };
+	for (const SwizzleLayout* Layout : AllLayouts)
+	{
+		for (const int* Size : Sizes)
+		{
+			const int Width = Size[0];
+			const int Height = Size[1];
+			const int Pitch = (Width * 4 + 255) & ~255;
+			std::vector<uint32_t> Linear((size_t)Pitch / 4 * Height);
+			for (int y = 0; y < Height; y++)
+			{
+				for (int x = 0; x < Width; x++)
+				{
+					Linear[(size_t)y * Pitch / 4 + x] = (uint32_t)(y << 16 | x);
+				}
+			}
+
+			for (int Level : Levels)
+			{
+				std::vector<uint8_t> Tiled(GetSwizzledSize(*Layout, Width, Height), 0);
+				ConvertSwizzle(*Layout, (uint8_t*)Linear.data(), Pitch, Width, Height, Tiled.data(), true, Level);
+
+				bool bPlaced = true;
+				for (int y = 0; y < Height; y++)
+				{
+					for (int x = 0; x < Width; x++)
+					{
+						uint32_t Texel = 0;
+						memcpy(&Texel, &Tiled[GetSwizzledTexelOffset(*Layout, Width, x, y)], 4);
+						bPlaced &= Texel == (uint32_t)(y << 16 | x);
+					}
+				}
+
+				std::vector<uint32_t> RoundTrip(Linear.size(), 0);
+				ConvertSwizzle(*Layout, (uint8_t*)RoundTrip.data(), Pitch, Width, Height, Tiled.data(), false, Level);
+				bool bRestored = true;
+				for (int y = 0; y < Height; y++)
+				{
+					bRestored &= memcmp(&RoundTrip[(size_t)y * Pitch / 4], &Linear[(size_t)y * Pitch / 4], Width * 4) == 0;
+				}
+
+				if (!bPlaced || !bRestored)
+				{
+					printf("%s, %d x %d, SIMD level %d\n", Layout->Name, Width, Height, Level);
+				}
+				CHECK(bPlaced);
+				CHECK(bRestored);
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestBitHelpers();
+	TestKnownOffsets();
+	TestConvert();
+	return TestResult("SwizzleTests");
+}
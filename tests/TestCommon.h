@@ -0,0 +1,44 @@
+// Minimal test support for the Core/ tests: CHECK records a failure and keeps going, and each test
+// program returns TestResult() from main so ctest sees the failure count.
+#pragma once
+
+#include <stdio.h>
+
+inline int& TestFailures()
+{
+	static int Failures = 0;
+	return Failures;
+}
+
+#define CHECK(Condition) \
+	do \
+	{ \
+		if (!(Condition)) \
+		{ \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Condition); \
+			TestFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(Expected, Actual) \
+	do \
+	{ \
+		long long ExpectedValue = (long long)(Expected); \
+		long long ActualValue = (long long)(Actual); \
+		if (ExpectedValue != ActualValue) \
+		{ \
+			printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #Expected, #Actual, ExpectedValue, ActualValue); \
+			TestFailures()++; \
+		} \
+	} while (0)
+
+inline int TestResult(const char* Name)
+{
+	if (TestFailures() == 0)
+	{
+		printf("%s: passed\n", Name);
+		return 0;
+	}
+	printf("%s: %d check(s) failed\n", Name, TestFailures());
+	return 1;
+}
@@ -0,0 +1,162 @@
+#include "Core/WorkStealingScheduler.h"
+
+#include "TestCommon.h"
+
+struct CountContext
+{
+	std::vector<std::atomic<uint32_t>> Counts;
+	std::atomic<uint32_t> MaxRange;
+
+	explicit CountContext(uint32_t Count) : Counts(Count), MaxRange(0) {}
+};
+
+static void CountRange(void* Context, uint32_t Begin, uint32_t End)
+{
+	CountContext& Counts = *(CountContext*)Context;
+	for (uint32_t i = Begin; i < End; i++)
+	{
+		Counts.Counts[i]++;
+	}
+	uint32_t Size = End - Begin;
+	uint32_t Max = Counts.MaxRange;
+	while (Size > Max && !Counts.MaxRange.compare_exchange_weak(Max, Size))
+	{
+	}
+}
+
+// Every index runs exactly once, in ranges no bigger than the grain once the pool splits them
+static void TestRunCoversEveryIndex(int NumThreads)
+{
+	WorkStealingScheduler Scheduler;
+	Scheduler.Start(NumThreads);
+
+	const uint32_t Counts[] = { 1, 2, 3, 7, 100, 1000, 65537 };
+	const uint32_t Grains[] = { 1, 3, 64, 100000 };
+	for (uint32_t Count : Counts)
+	{
+		for (uint32_t Grain : Grains)
+		{
+			CountContext Context(Count);
+			Scheduler.Run(Count, Grain, CountRange, &Context);
+			bool bOnce = true;
+			for (uint32_t i = 0; i < Count; i++)
+			{
+				bOnce &= Context.Counts[i] == 1;
+			}
+			CHECK(bOnce);
+			if (NumThreads > 0)
+			{
+				CHECK(Context.MaxRange <= Grain);
+			}
+		}
+	}
+
+	// Nothing to do returns straight away, and the pool is reusable many times over
+	CountContext Empty(1);
+	Scheduler.Run(0, 1, CountRange, &Empty);
+	CHECK_EQ(0, Empty.Counts[0]);
+	for (int Repeat = 0; Repeat < 200; Repeat++)
+	{
+		CountContext Context(37);
+		Scheduler.Run(37, 1, CountRange, &Context);
+		bool bOnce = true;
+		for (uint32_t i = 0; i < 37; i++)
+		{
+			bOnce &= Context.Counts[i] == 1;
+		}
+		CHECK(bOnce);
+	}
+
+	Scheduler.Shutdown();
+}
+
+struct NestedContext
+{
+	std::vector<std::atomic<uint32_t>> Counts;
+	std::atomic<uint32_t> InlineInner;
+
+	NestedContext() : Counts(64 * 16), InlineInner(0) {}
+};
+
+// ParallelFor from inside ParallelFor, where the inner calls have to run on the thread that made them
+static void TestParallelForNested()
+{
+	NestedContext Context;
+	ParallelFor(64, [](void* Ctx, int Outer)
+	{
+		struct Inner
+		{
+			NestedContext* Context;
+			int Outer;
+			std::thread::id Thread;
+			bool bSameThread;
+		};
+		Inner In = { (NestedContext*)Ctx, Outer, std::this_thread::get_id(), true };
+		ParallelFor(16, [](void* InnerCtx, int i)
+		{
+			Inner& In = *(Inner*)InnerCtx;
+			In.Context->Counts[In.Outer * 16 + i]++;
+			In.bSameThread &= std::this_thread::get_id() == In.Thread;
+		}, &In);
+		In.Context->InlineInner += In.bSameThread ? 1 : 0;
+	}, &Context);
+
+	bool bOnce = true;
+	for (std::atomic<uint32_t>& Count : Context.Counts)
+	{
+		bOnce &= Count == 1;
+	}
+	CHECK(bOnce);
+	CHECK_EQ(64, Context.InlineInner);
+}
+
+// Several threads calling ParallelFor at once each get all their indices run once, whichever of them
+// has the pool
+static void TestParallelForConcurrent()
+{
+	const int NumCallers = 4;
+	std::vector<std::unique_ptr<CountContext>> Contexts;
+	for (int i = 0; i < NumCallers; i++)
+	{
+		Contexts.emplace_back(new CountContext(5000));
+	}
+
+	std::vector<std::thread> Callers;
+	for (int i = 0; i < NumCallers; i++)
+	{
+		Callers.emplace_back([&Contexts, i]()
+		{
+			for (int Repeat = 0; Repeat < 20; Repeat++)
+			{
+				ParallelFor(250, [](void* Ctx, int Block)
+				{
+					CountRange(Ctx, Block * 20, Block * 20 + 20);
+				}, Contexts[i].get());
+			}
+		});
+	}
+	for (std::thread& Caller : Callers)
+	{
+		Caller.join();
+	}
+
+	bool bAll = true;
+	for (const std::unique_ptr<CountContext>& Context : Contexts)
+	{
+		for (std::atomic<uint32_t>& Count : Context->Counts)
+		{
+			bAll &= Count == 20;
+		}
+	}
+	CHECK(bAll);
+}
+
+int main()
+{
+	TestRunCoversEveryIndex(0);
+	TestRunCoversEveryIndex(1);
+	TestRunCoversEveryIndex(4);
+	TestParallelForNested();
+	TestParallelForConcurrent();
+	return TestResult("WorkStealingSchedulerTests");
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Decodes the JPEGs StbImageWriteTests writes with PIL and compares them with their sources.
+
+StbImageWriteTests --write-jpegs DIR writes each JPEG its SIMD level test encodes, at every DCT kernel level,
+component count and quality, beside the source image as an RGB PPM. Every JPEG has to decode with a stock
+decoder to the source's size, and come within a PSNR that loosens only at the lowest quality. The test
+program itself checks the levels produce the same bytes.
+
+    python3 tests/check_jpeg_decode.py path/to/StbImageWriteTests
+
+Exits with 77, which CMake reports as skipped, when PIL isn't installed.
+"""
+
+import argparse
+import glob
+import math
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+SKIPPED = 77
+
+
+def min_psnr(quality):
+    return 30.0 if quality < 50 else 40.0
+
+
+def psnr(expected, actual):
+    squared_error = sum((a - b) * (a - b) for a, b in zip(expected, actual))
+    if squared_error == 0:
+        return float("inf")
+    return 10.0 * math.log10(255.0 * 255.0 * len(expected) / squared_error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("test_program", help="the StbImageWriteTests executable")
+    args = parser.parse_args()
+
+    try:
+        from PIL import Image
+    except ImportError:
+        print("PIL not installed, skipping")
+        return SKIPPED
+
+    with tempfile.TemporaryDirectory() as directory:
+        result = subprocess.run([args.test_program, "--write-jpegs", directory])
+        if result.returncode != 0:
+            sys.exit("%s --write-jpegs failed" % args.test_program)
+
+        filenames = sorted(glob.glob(os.path.join(directory, "jpeg_*.jpg")))
+        if not filenames:
+            sys.exit("no JPEGs were written")
+
+        failures = 0
+        for filename in filenames:
+            name = os.path.basename(filename)
+            match = re.match(r"(jpeg_\d+x\d+_c\d)_q(\d+)_l\d\.jpg$", name)
+            source = Image.open(os.path.join(directory, match.group(1) + "_source.ppm"))
+            try:
+                with Image.open(filename) as image:
+                    image.load()
+                    decoded = image.convert("RGB")
+            except Exception as error:
+                print("%s: does not decode: %s" % (name, error))
+                failures += 1
+                continue
+
+            if decoded.size != source.size:
+                print("%s: decodes to %s, the source is %s" % (name, decoded.size, source.size))
+                failures += 1
+                continue
+
+            quality = int(match.group(2))
+            value = psnr(source.tobytes(), decoded.tobytes())
+            if value < min_psnr(quality):
+                print("%s: PSNR %.1f dB, below %.1f dB" % (name, value, min_psnr(quality)))
+                failures += 1
+
+        print("%d JPEGs decoded, %d failed" % (len(filenames), failures))
+        return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())